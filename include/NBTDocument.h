@@ -0,0 +1,131 @@
+#ifndef ENBT_NBTDOCUMENT_H
+#define ENBT_NBTDOCUMENT_H
+
+// Mutable NBT tree for load, edit a few tags, write back.
+// All nodes live in one vector and refer to each other by NodeId. Containers
+// are only expanded into nodes when they're accessed, and untouched strings
+// keep pointing into the source bytes. Serializing copies every clean subtree
+// as a raw byte range (adjacent clean siblings in one go) and only re-encodes
+// the dirty path from an edit up to the root.
+//
+//	NBT::NBTDocument doc(std::filesystem::path("servers.dat"));
+//	auto server = doc.findServer("1.2.3.4");
+//	doc.setString(doc.find(server, "name"), "Renamed");
+//	doc.save("servers.dat");
+
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "NBTReader.h"
+#include "NBTWriter.h"
+#include "mapped_file.hpp"
+
+namespace NBT {
+
+template <std::endian E = std::endian::big>
+class NBTDocument {
+public:
+	using NodeId = std::uint32_t;
+	static constexpr NodeId npos = std::numeric_limits<NodeId>::max();
+
+	// Maps path. Check isOpen(). Throws parse_error on malformed data
+	explicit NBTDocument(const std::filesystem::path& path);
+	// Uses a buffer owned by the caller, which must outlive the document
+	explicit NBTDocument(std::string_view bytes);
+	// a string could be either, say which with a path or a string_view
+	NBTDocument(const std::string&) = delete;
+	NBTDocument(const char*) = delete;
+	// Empty document holding an empty root compound
+	NBTDocument();
+
+	bool isOpen() const { return opened; }
+	NodeId root() const { return 0; }
+
+	char type(NodeId id) const { return nodes[id].type; }
+	char listType(NodeId id) const { return nodes[id].listType; }
+	std::string_view name(NodeId id) const { return nodes[id].name; }
+	NodeId parent(NodeId id) const { return nodes[id].parent; }
+	bool isDirty(NodeId id) const { return nodes[id].dirty; }
+
+	// Children of compounds and lists, expanded on first access
+	std::size_t size(NodeId id);
+	NodeId firstChild(NodeId id);
+	NodeId nextSibling(NodeId id) const { return nodes[id].next; }
+	NodeId find(NodeId compound, std::string_view child_name);
+
+	std::string_view getString(NodeId id) const;
+	// byte, short, int and long
+	std::int64_t getInteger(NodeId id) const;
+	// float and double
+	double getReal(NodeId id) const;
+
+	void setString(NodeId id, std::string_view value);
+	void setInteger(NodeId id, std::int64_t value);
+	void setReal(NodeId id, double value);
+
+	// name is ignored when parent is a list. Returns npos when the type doesn't fit the list
+	NodeId addString(NodeId parent, std::string_view child_name, std::string_view value);
+	NodeId addInteger(NodeId parent, char type, std::string_view child_name, std::int64_t value);
+	NodeId addReal(NodeId parent, char type, std::string_view child_name, double value);
+	NodeId addCompound(NodeId parent, std::string_view child_name);
+	NodeId addList(NodeId parent, std::string_view child_name, char element_type);
+	void remove(NodeId id);
+
+	// 'servers' list helpers
+	NodeId serverList();
+	NodeId findServer(std::string_view ip);
+	NodeId addServer(std::string_view server_name, std::string_view icon, std::string_view ip, bool accept_textures);
+
+	void serialize(std::string& out) const;
+	std::string serialize() const;
+	// Replaces path atomically (see atomic_output), so saving over the mapped source is safe
+	bool save(const std::filesystem::path& path) const;
+
+private:
+	struct Node {
+		char type = idEnd;
+		char listType = idEnd;
+		bool expanded = true; // children are nodes; false while they're only in raw
+		bool dirty = true; // raw no longer matches the node
+		std::string_view name{};
+		std::string_view raw{}; // source bytes of the tag, header included for named tags
+		std::string_view payload{}; // source bytes of the payload
+		std::string_view str{}; // string value, into the source or the string arena
+		std::int64_t integer = 0;
+		double real = 0;
+		NodeId parent = npos;
+		NodeId first = npos;
+		NodeId last = npos;
+		NodeId next = npos;
+		std::uint32_t childCount = 0;
+	};
+
+	using Reader = NBTReader<E>;
+
+	void load();
+	void expand(NodeId id);
+	NodeId addChild(NodeId parent, char type, std::string_view child_name);
+	NodeId nodeFromTag(const typename Reader::Tag& tag, bool named);
+	void markDirty(NodeId id);
+	std::string_view intern(std::string_view str);
+	void writeNode(std::string& out, NodeId id, bool named) const;
+	void writePayload(std::string& out, NodeId id) const;
+
+	mapped_file file;
+	std::string_view source;
+	bool opened = false;
+	std::vector<Node> nodes;
+	std::pmr::monotonic_buffer_resource strings;
+};
+
+extern template class NBTDocument<std::endian::big>;
+extern template class NBTDocument<std::endian::little>;
+
+}
+
+#endif
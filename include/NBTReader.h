@@ -0,0 +1,232 @@
+#ifndef ENBT_NBTREADER_H
+#define ENBT_NBTREADER_H
+
+// Zero copy reader counterpart of NBTWriter.
+// Tags are walked lazily straight out of a memory mapped file (or any buffer
+// that outlives the reader). Names and strings are string_views into that
+// buffer. Skipping a tag is O(1) for scalars, strings, arrays and lists of
+// fixed size elements; compounds have no length prefix and are walked.
+//
+//	NBT::NBTReader reader(std::filesystem::path("servers.dat"));
+//	for (const auto& server : reader.servers())
+//		std::cout << server.name << ' ' << server.ip << '\n';
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "NBTWriter.h"
+#include "mapped_file.hpp"
+
+namespace NBT {
+
+class parse_error : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+template <std::endian E = std::endian::big>
+class NBTReader {
+public:
+	class Tag;
+	class CompoundIterator;
+	class ListIterator;
+	class ServerIterator;
+
+	template <typename It>
+	struct Range {
+		It first;
+		It begin() const { return first; }
+		std::default_sentinel_t end() const { return {}; }
+	};
+
+	// A tag in the buffer. Named when it's a child of a compound, unnamed as a list element
+	class Tag {
+	public:
+		Tag() = default;
+		Tag(char type, std::string_view name, const char* header, const char* payload, const char* limit)
+			: tagType(type), tagName(name), header(header), payloadBegin(payload), limit(limit) {}
+
+		bool exists() const { return tagType != idEnd; }
+		char type() const { return tagType; }
+		std::string_view name() const { return tagName; }
+		const char* payload() const { return payloadBegin; }
+		// first byte after this tag. Walks compounds and lists of non fixed size elements
+		const char* end() const { return skipPayload(tagType, payloadBegin, limit, 0); }
+		// the whole tag as stored, header included for named tags
+		std::string_view raw() const { const char* e = end(); return {header, static_cast<std::size_t>(e - header)}; }
+
+		std::int8_t asByte() const { return number<std::int8_t>(idByte); }
+		std::int16_t asShort() const { return number<std::int16_t>(idShort); }
+		std::int32_t asInt() const { return number<std::int32_t>(idInt); }
+		std::int64_t asLong() const { return number<std::int64_t>(idLong); }
+		float asFloat() const { return std::bit_cast<float>(number<std::uint32_t>(idFloat)); }
+		double asDouble() const { return std::bit_cast<double>(number<std::uint64_t>(idDouble)); }
+		std::string_view asString() const;
+
+		// compound
+		Range<CompoundIterator> children() const;
+		Tag find(std::string_view child_name) const;
+
+		// list
+		char listType() const;
+		std::int32_t listSize() const;
+		Range<ListIterator> elements() const;
+
+		// byte/int/long array; elements are raw stored values
+		std::int32_t arraySize() const;
+		const char* arrayData() const { return payloadBegin + 4; }
+
+	private:
+		void expect(char expected) const {
+			if (tagType != expected)
+				throw parse_error("unexpected nbt tag type");
+		}
+
+		template <typename T>
+		T number(char expected) const {
+			expect(expected);
+			need(payloadBegin, sizeof(T), limit);
+			return readNumber<T>(payloadBegin);
+		}
+
+		char tagType = idEnd;
+		std::string_view tagName{};
+		const char* header = nullptr;
+		const char* payloadBegin = nullptr;
+		const char* limit = nullptr;
+	};
+
+	class CompoundIterator {
+	public:
+		using value_type = Tag;
+		using difference_type = std::ptrdiff_t;
+
+		CompoundIterator() = default;
+		CompoundIterator(const char* pos, const char* limit) : limit(limit) { load(pos); }
+		const Tag& operator*() const { return current; }
+		const Tag* operator->() const { return &current; }
+		CompoundIterator& operator++() { load(current.end()); return *this; }
+		CompoundIterator operator++(int) { auto copy = *this; ++*this; return copy; }
+		bool operator==(std::default_sentinel_t) const { return !current.exists(); }
+		// position of the idEnd closing the compound, once the iterator is exhausted
+		const char* position() const { return pos; }
+
+	private:
+		void load(const char* at);
+
+		Tag current{};
+		const char* pos = nullptr;
+		const char* limit = nullptr;
+	};
+
+	class ListIterator {
+	public:
+		using value_type = Tag;
+		using difference_type = std::ptrdiff_t;
+
+		ListIterator() = default;
+		ListIterator(char type, std::int32_t remaining, const char* pos, const char* limit)
+			: type(type), remaining(remaining), limit(limit) { load(pos); }
+		const Tag& operator*() const { return current; }
+		const Tag* operator->() const { return &current; }
+		ListIterator& operator++() { --remaining; load(current.end()); return *this; }
+		ListIterator operator++(int) { auto copy = *this; ++*this; return copy; }
+		bool operator==(std::default_sentinel_t) const { return remaining <= 0; }
+
+	private:
+		void load(const char* at) { current = remaining > 0 ? Tag(type, {}, at, at, limit) : Tag(); }
+
+		Tag current{};
+		char type = idEnd;
+		std::int32_t remaining = 0;
+		const char* limit = nullptr;
+	};
+
+	// One entry of the 'servers' list. Missing fields are left empty
+	struct ServerView {
+		std::string_view name;
+		std::string_view icon;
+		std::string_view ip;
+		bool acceptTextures = false;
+		std::string_view raw; // the encoded compound payload, idEnd included
+	};
+
+	class ServerIterator {
+	public:
+		using value_type = ServerView;
+		using difference_type = std::ptrdiff_t;
+
+		ServerIterator() = default;
+		explicit ServerIterator(ListIterator it) : it(it) { load(); }
+		const ServerView& operator*() const { return current; }
+		const ServerView* operator->() const { return &current; }
+		ServerIterator& operator++() { ++it; load(); return *this; }
+		ServerIterator operator++(int) { auto copy = *this; ++*this; return copy; }
+		bool operator==(std::default_sentinel_t s) const { return it == s; }
+
+	private:
+		void load();
+
+		ListIterator it{};
+		ServerView current{};
+	};
+
+	// Maps path. Check isOpen()
+	explicit NBTReader(const std::filesystem::path& path);
+	// Reads a buffer owned by the caller
+	explicit NBTReader(std::string_view bytes);
+	// a string could be either, say which with a path or a string_view
+	NBTReader(const std::string&) = delete;
+	NBTReader(const char*) = delete;
+
+	bool isOpen() const { return opened; }
+	std::string_view bytes() const { return data; }
+
+	// Throws parse_error when the buffer doesn't start with a compound
+	Tag root() const;
+	// The root 'servers' list; serverCount() is read from its header without walking it
+	Tag serverList() const;
+	std::int32_t serverCount() const { return serverList().listSize(); }
+	Range<ServerIterator> servers() const;
+
+	static const char* skipPayload(char type, const char* pos, const char* limit, int depth);
+
+	template <typename T>
+	static T readNumber(const char* pos) {
+		T value;
+		std::memcpy(&value, pos, sizeof(T));
+		if constexpr (E != std::endian::native && sizeof(T) > 1)
+			value = std::byteswap(value);
+		return value;
+	}
+
+	static void need(const char* pos, std::size_t count, const char* limit) {
+		if (pos > limit || static_cast<std::size_t>(limit - pos) < count)
+			throw parse_error("nbt data is truncated");
+	}
+
+	static std::string_view readString(const char* pos, const char* limit) {
+		need(pos, 2, limit);
+		const std::size_t len = readNumber<std::uint16_t>(pos);
+		need(pos + 2, len, limit);
+		return {pos + 2, len};
+	}
+
+private:
+	mapped_file file;
+	std::string_view data;
+	bool opened = false;
+};
+
+extern template class NBTReader<std::endian::big>;
+extern template class NBTReader<std::endian::little>;
+
+}
+
+#endif
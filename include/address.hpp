@@ -0,0 +1,66 @@
+#ifndef ENBT_ADDRESS_H
+#define ENBT_ADDRESS_H
+
+// Server address parsing. An address is "a.b.c.d", "[v6]" or a host name, each with
+// an optional ":port", or a bare IPv6 address without a port. The canonical text has
+// no surrounding whitespace, no leading zeros in IPv4 octets, RFC 5952 IPv6, a
+// lowercase host name and no port when it's the default one
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct nbtserver;
+
+constexpr std::uint16_t default_port = 25565;
+
+enum class address_kind : std::uint8_t { none, ipv4, ipv6, host };
+
+enum class address_error : std::uint8_t { none, empty, ipv4, ipv6, port, host };
+constexpr std::size_t address_error_count = 6;
+
+// Binary form of an address. The host name itself stays in the server's ip string
+struct server_address {
+	address_kind kind = address_kind::none; // none until parsed
+	std::uint16_t port = default_port;
+	std::uint32_t ipv4 = 0; // a.b.c.d is a << 24 | b << 16 | c << 8 | d
+	std::array<std::uint8_t, 16> ipv6{}; // network order
+
+	bool operator==(const server_address&) const = default;
+};
+
+// Parses a dotted quad of exactly four decimal octets of 1 to 3 digits. Vectorized on
+// SSE2, which every x86-64 cpu has; scalar elsewhere
+bool parse_ipv4(std::string_view text, std::uint32_t& value);
+// Full, compressed or with a trailing dotted quad, no brackets and no zone
+bool parse_ipv6(std::string_view text, std::array<std::uint8_t, 16>& value);
+
+// On success address is filled and host (when given) is set to the host name part of
+// text for host addresses, as written
+address_error parse_address(std::string_view text, server_address& address, std::string_view* host = nullptr);
+
+// Canonical text. host is only used for host addresses and is lowercased
+std::string format_address(const server_address& address, std::string_view host = {});
+
+std::string_view address_error_name(address_error error);
+
+// text with surrounding whitespace removed
+std::string_view trim_address(std::string_view text);
+
+struct canonicalize_stats {
+	static constexpr std::size_t max_examples = 5;
+
+	std::size_t changed = 0; // ip strings that were rewritten
+	std::size_t rejected = 0;
+	std::array<std::size_t, address_error_count> errors{}; // rejected, by address_error
+	std::vector<std::string> examples; // the first max_examples rejected ips
+};
+
+// Parses every server's ip, stores the binary form in its address and replaces the ip
+// with the canonical text. Servers with an invalid address are removed
+canonicalize_stats canonicalize_servers(std::vector<nbtserver>& servers);
+
+#endif
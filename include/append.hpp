@@ -0,0 +1,24 @@
+#ifndef ENBT_APPEND_H
+#define ENBT_APPEND_H
+
+#include <bit>
+#include <filesystem>
+#include <vector>
+#include "parse.hpp"
+
+// Adds servers to the end of the 'servers' list of an existing servers.dat without
+// encoding it again: the file up to the closing end tags is copied, sharing its extents
+// where the filesystem can (reflink), the new compounds are written after the last one
+// and the count is patched, then the copy is renamed over the file. Only the tag headers
+// of the old compounds are read, writing costs O(new servers) on such filesystems, and
+// an interrupted append leaves the old file. Returns false without touching the file
+// when it isn't laid out the way enbt writes servers.dat, the root holding nothing but
+// the list; rewrite it in full in that case
+bool append_servers_in_place(const std::filesystem::path& dat_path, const std::vector<nbtserver>& servers, std::endian endian);
+
+// Reads every server of an existing servers.dat into servers, for the full rewrite.
+// Root tags other than 'servers' aren't kept. Returns false when the file can't be read
+// as a servers.dat
+bool read_servers_dat(const std::filesystem::path& dat_path, std::vector<nbtserver>& servers, std::endian endian);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ENBT_BLOCKLIST_H
+#define ENBT_BLOCKLIST_H
+
+// CIDR blocklist for dropping servers by address, sized for hundreds of thousands of
+// ranges. The text file has one range (a.b.c.d/n, v6/n) or single address per line,
+// with # comments. Its ranges are merged into an interval_table, which is saved in a
+// cache file next to the text (path + ".cache") and memory mapped on the next run
+//
+//	cidr_blocklist blocklist("blocked.txt");
+//	if (blocklist.is_open())
+//		blocklist.exclude(servers);
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "interval_table.hpp"
+#include "parse.hpp"
+
+class cidr_blocklist {
+public:
+	// Loads path, through its cache when that's up to date. Check is_open(), error() says
+	// what was wrong otherwise
+	explicit cidr_blocklist(const std::filesystem::path& path);
+
+	cidr_blocklist(const cidr_blocklist&) = delete;
+	cidr_blocklist& operator=(const cidr_blocklist&) = delete;
+
+	bool is_open() const { return opened; }
+	const std::string& error() const { return problem; }
+	// loaded from the cache instead of the text
+	bool cached() const { return from_cache; }
+	// intervals after merging
+	std::size_t size() const { return table.size(); }
+
+	// IPv4-mapped IPv6 addresses (::ffff:a.b.c.d) are checked as IPv4 too. Host names
+	// and invalid addresses are never blocked
+	bool contains(const server_address& address) const;
+	// Drops the servers with a blocked address, keeping the order of the rest. Uses
+	// their parsed address when there is one. Returns how many were dropped
+	std::size_t exclude(std::vector<nbtserver>& servers) const;
+
+private:
+	bool compile(std::string_view text);
+
+	bool opened = false;
+	bool from_cache = false;
+	std::string problem{};
+	interval_table table{};
+};
+
+#endif
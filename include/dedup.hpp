@@ -0,0 +1,81 @@
+#ifndef ENBT_DEDUP_H
+#define ENBT_DEDUP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "parse.hpp"
+
+// Set of server addresses, open addressing with linear probing.
+// An IPv4 address and its port are packed into the key itself. IPv6 addresses are
+// keyed by a hash of their bytes, host names by a hash of the lowercased name and
+// addresses that don't parse by a hash of their trimmed text. Those get a record
+// with what parsing found: the port and the IPv6 bytes, or where the host name or
+// text is in the server's ip. A hash match compares records, so every address is
+// parsed once and no text is copied. A slot is 12 bytes and the table is kept between
+// 3/8 and 3/4 full once it grows, so 16 to 32 bytes an address. Hashed keys add a 16
+// byte record and IPv6 addresses 16 bytes more, in vectors grown by doubling: up to 64
+// bytes for a host name and 96 for an IPv6 address
+class address_set {
+public:
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	explicit address_set(const std::vector<nbtserver>& servers);
+
+	// Adds the address of servers[index]. Returns the index already holding that
+	// address, or npos when it's new
+	std::size_t insert(std::size_t index);
+	std::size_t size() const { return count; }
+	// addresses that were inserted more than once
+	std::size_t duplicated() const { return duplicated_count; }
+	std::size_t memory() const {
+		return keys.capacity() * sizeof(std::uint64_t) + indices.capacity() * sizeof(std::uint32_t) + records.capacity() * sizeof(record)
+			+ ipv6s.capacity() * sizeof(ipv6s[0]);
+	}
+
+private:
+	struct record {
+		std::uint32_t index; // of the server
+		std::uint32_t start; // of the host name or text in the server's ip, or the index in ipv6s
+		std::uint32_t size;
+		std::uint16_t port;
+		address_kind kind; // none for text that isn't an address
+	};
+
+	void grow();
+	// Parses servers[index]. Hashed keys leave what was found in pending
+	std::uint64_t key_of(std::size_t index);
+	std::string_view text_of(const record& entry) const;
+	bool same_address(const record& entry) const;
+
+	const std::vector<nbtserver>& servers;
+	std::vector<std::uint64_t> keys;
+	// empty, or the server index (the record index for hashed keys) with the top bit set once it had a duplicate
+	std::vector<std::uint32_t> indices;
+	std::vector<record> records;
+	std::vector<std::array<std::uint8_t, 16>> ipv6s;
+	record pending{};
+	std::array<std::uint8_t, 16> pending_ipv6{};
+	std::size_t count = 0;
+	std::size_t duplicated_count = 0;
+};
+
+// key of address_set: IPv4 and port packed in the low 48 bits, otherwise a hash with
+// the top bit set
+std::uint64_t address_key(const server_address& address, std::string_view host);
+std::uint64_t address_key(std::string_view ip);
+
+enum class dedup_mode { first, last };
+
+struct dedup_stats {
+	std::size_t removed = 0; // servers dropped as duplicates
+	std::size_t addresses = 0; // addresses that had duplicates
+};
+
+// Keeps one server per address, the first or the last one listed. The kept servers
+// stay in input order
+dedup_stats dedup_servers(std::vector<nbtserver>& servers, dedup_mode mode);
+
+#endif
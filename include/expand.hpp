@@ -0,0 +1,126 @@
+#ifndef ENBT_EXPAND_H
+#define ENBT_EXPAND_H
+
+// Server lists given as ranges instead of one line per server (-t ranges). Lines have
+// the csv columns name,icon,ip,accept_textures, with a pattern for the ip:
+//	10.20.0.0/16			every address of an IPv4 or IPv6 CIDR block
+//	10.20.0.0/16:25566		the same with a port, [2001:db8::/120]:25566 for IPv6
+//	play-[1-500].example.net	numeric ranges in brackets, [001-500] keeps the zero
+//					padding. Several ranges multiply: 10.0.[0-3].[1-254]
+// name and icon are templates, {ip} is replaced by the generated ip and {n} by the
+// server's position in the expansion, from 1.
+// Nothing is materialized. The count is worked out from the patterns and the i-th
+// server is generated on demand, so a /12 takes as much memory as a single server
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parse.hpp"
+
+class server_ranges {
+public:
+	// Parses the range list. Check ok(), error() says which line was wrong otherwise
+	explicit server_ranges(std::string_view text);
+
+	bool ok() const { return problem.empty(); }
+	const std::string& error() const { return problem; }
+	// servers in the expansion, at most INT32_MAX (the longest NBT list)
+	std::uint64_t size() const { return total; }
+
+	// Fills server with the index-th server of the expansion, reusing its strings.
+	// Its address is filled in too
+	void at(std::uint64_t index, nbtserver& server) const;
+
+	// Whether some line's icon template starts with '@', a PNG file (see icon.hpp)
+	bool has_file_icons() const;
+
+private:
+	// literals[0] fields[0] literals[1] ... where a field is 'i' ({ip}) or 'n' ({n})
+	struct template_text {
+		std::vector<std::string> literals;
+		std::string fields;
+	};
+
+	struct number_range {
+		std::uint64_t first;
+		std::uint64_t count;
+		unsigned width; // zero padded to this many digits
+	};
+
+	enum class pattern_kind : std::uint8_t { ipv4, ipv6, text };
+
+	struct range_line {
+		template_text name;
+		template_text icon;
+		bool accept_textures;
+		pattern_kind kind;
+		server_address base; // network address and port of a CIDR block
+		std::vector<std::string> literals; // text: literals[0] numbers[0] literals[1] ...
+		std::vector<number_range> numbers;
+		std::uint64_t first; // index of the line's first server in the expansion
+		std::uint64_t count;
+	};
+
+	static template_text split_template(std::string_view text);
+	static void render(const template_text& text, std::string_view ip, std::uint64_t n, std::string& out);
+	bool parse_pattern(std::string_view pattern, range_line& line);
+
+	std::vector<range_line> lines;
+	std::uint64_t total = 0;
+	std::string problem{};
+};
+
+// The servers of a server_ranges as a sized range that generates them while it's
+// iterated, so it can go to write_servers like a vector. With a keep stage only the
+// servers it accepts are produced, and it may rewrite them before they are; they are
+// counted up front with an extra pass over the expansion, so the size is still exact
+// before anything is written
+class expanded_servers {
+public:
+	using predicate = std::function<bool(nbtserver&)>;
+
+	explicit expanded_servers(const server_ranges& ranges, predicate keep = {});
+
+	std::size_t size() const { return kept; }
+
+	class iterator {
+	public:
+		using value_type = nbtserver;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+		iterator(const expanded_servers* owner, std::uint64_t index) : owner(owner), index(index) { load(); }
+
+		const nbtserver& operator*() const { return server; }
+		const nbtserver* operator->() const { return &server; }
+		iterator& operator++() {
+			++index;
+			load();
+			return *this;
+		}
+		void operator++(int) { ++*this; }
+		bool operator==(std::default_sentinel_t) const { return index >= owner->ranges.size(); }
+
+	private:
+		// generates the server at index, or the next one that's kept
+		void load();
+
+		const expanded_servers* owner = nullptr;
+		std::uint64_t index = 0;
+		nbtserver server{};
+	};
+
+	iterator begin() const { return iterator(this, 0); }
+	std::default_sentinel_t end() const { return {}; }
+
+private:
+	const server_ranges& ranges;
+	predicate keep;
+	std::size_t kept = 0;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef ENBT_EXPORT_H
+#define ENBT_EXPORT_H
+
+#include <bit>
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+
+// Streams the servers of an existing servers.dat to out as csv, toml or json,
+// laid out the way parse_servers_csv/_toml/_json read them back.
+// The file is memory mapped and walked once, so memory use doesn't grow with its size.
+// Returns false when the file can't be read
+bool export_servers(const std::filesystem::path& dat_path, std::ostream& out, std::string_view format, std::endian endian);
+
+#endif
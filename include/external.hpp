@@ -0,0 +1,50 @@
+#ifndef ENBT_EXTERNAL_H
+#define ENBT_EXTERNAL_H
+
+// servers.dat generation for inputs that don't fit in memory.
+// The input is parsed in batches that fit the memory budget. Without sorting or
+// dedup every batch is encoded straight into the output. Otherwise every batch is
+// sorted (and deduplicated) into a run file in a temporary directory, and the runs
+// are k-way merged into the output, in more than one pass when there are too many
+// for the budget. The list count isn't known up front and is patched in at the end.
+// csv is read a batch at a time; json and toml have to be parsed whole first
+
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <string_view>
+#include <vector>
+#include "dedup.hpp"
+#include "output.hpp"
+#include "parse.hpp"
+#include "sort.hpp"
+
+struct external_options {
+	std::uint64_t mem_limit = 0;
+	bool sort = false;
+	sort_key key = sort_key::addr; // also the order when only deduplicating
+	bool reverse = false;
+	bool dedup = false;
+	dedup_mode dedup_keep = dedup_mode::first;
+	std::endian endian = std::endian::big;
+};
+
+struct external_stats {
+	std::uint64_t read = 0; // servers after prepare
+	std::uint64_t written = 0;
+	std::uint64_t duplicates = 0;
+	std::size_t runs = 0;
+	bool too_many = false; // more servers than a list holds, INT32_MAX
+};
+
+// Runs on every batch before it's sorted or written, e.g. to canonicalize it
+using batch_hook = std::function<void(std::vector<nbtserver>&)>;
+
+// Writes servers.dat to output through atomic_output. Returns false when the input
+// or a temporary file can't be read or written, or there are too many servers
+bool write_servers_external(std::istream& input, std::string_view format, const std::filesystem::path& output,
+	const external_options& options, const batch_hook& prepare, external_stats& stats, output_result& result);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef ENBT_FILTER_H
+#define ENBT_FILTER_H
+
+// Filter expressions over server fields, e.g.
+//
+//	accept_textures == 1 && name ~ "^EU-" && ip in 10.0.0.0/8
+//
+// Comparisons: field == value, !=, ~ (regex search), !~, and for numbers <, <=, >, >=.
+// Fields: name, icon, ip (text), port and accept_textures (numbers). ip in CIDR and
+// ip in [CIDR, ...] test the parsed address, host names never match. Combine with
+// &&, ||, ! and parentheses.
+// The expression is compiled once into bytecode for a one register machine: every
+// test sets the register and && and || jump over what they don't need. Regexes that
+// are only a literal with ^ or $ anchors run as plain prefix/suffix/substring compares
+
+#include <array>
+#include <cstdint>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parse.hpp"
+
+class filter_error : public std::runtime_error {
+public:
+	filter_error(const std::string& message, std::size_t column)
+		: std::runtime_error(message), at(column) {}
+	std::size_t column() const { return at; }
+
+private:
+	std::size_t at;
+};
+
+class server_filter {
+public:
+	// Throws filter_error
+	explicit server_filter(std::string_view expression);
+
+	bool matches(const nbtserver& server) const;
+	// Drops the servers that don't match, keeping the order of the rest. Returns how many were dropped
+	std::size_t apply(std::vector<nbtserver>& servers) const;
+
+private:
+	enum class op : std::uint8_t {
+		equals, prefix, suffix, contains, regex, // string field against strings[arg]
+		in_cidr, // addresses against cidrs[arg, arg2)
+		less, less_equal, number_equals, // number field against arg
+		negate,
+		jump_false, jump_true, // to arg
+	};
+	enum class field : std::uint8_t { name, icon, ip, port, accept_textures };
+
+	struct instruction {
+		op code;
+		field source = field::name;
+		std::uint32_t arg = 0;
+		std::uint32_t arg2 = 0;
+	};
+
+	struct cidr {
+		address_kind kind;
+		std::array<std::uint8_t, 16> bytes; // IPv4 in the first 4
+		std::uint8_t prefix;
+	};
+
+	class parser;
+
+	std::vector<instruction> code;
+	std::vector<std::string> strings;
+	std::vector<std::regex> regexes;
+	std::vector<cidr> cidrs;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ENBT_HASH_H
+#define ENBT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Streaming XXH64. Feed it with update() in any split, digest() doesn't reset it
+class xxh64 {
+public:
+	explicit xxh64(std::uint64_t seed = 0);
+	void update(const void* data, std::size_t len);
+	void update(std::string_view data) { update(data.data(), data.size()); }
+	std::uint64_t digest() const;
+
+private:
+	std::uint64_t acc[4];
+	std::uint64_t seed;
+	std::uint64_t total = 0;
+	unsigned char pending[32];
+	std::size_t pending_len = 0;
+};
+
+// One shot XXH64
+std::uint64_t hash_bytes(const void* data, std::size_t len, std::uint64_t seed = 0);
+inline std::uint64_t hash_bytes(std::string_view data, std::uint64_t seed = 0) {
+	return hash_bytes(data.data(), data.size(), seed);
+}
+
+// 16 lowercase hex digits
+std::string hash_hex(std::uint64_t hash);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef ENBT_ICON_H
+#define ENBT_ICON_H
+
+// Server icons. servers.dat holds them as base64 of a 64x64 PNG. In the input an
+// icon can instead be @path/to/icon.png (relative to the working directory), which is
+// read, checked and encoded when the servers are prepared. base64 has no '@', so such
+// an icon can't be mistaken for an encoded one
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "parse.hpp"
+
+constexpr std::size_t icon_size = 64; // pixels, both ways
+// Longest string the status protocol carries, so no server could send a bigger icon
+constexpr std::size_t icon_max_base64 = 32767;
+
+// Standard base64 with padding. Encodes with SSSE3 where the cpu has it
+std::string base64_encode(std::string_view bytes);
+
+// Whether every char of text is one of the 64 base64 digits ('=' isn't). Checks 16
+// chars at a time with SSSE3 where the cpu has it
+bool in_base64_alphabet(std::string_view text);
+
+enum class icon_error : std::uint8_t { none, unreadable, not_png, dimensions, base64, oversize };
+constexpr std::size_t icon_error_count = 6;
+
+// Checks the PNG signature and that the IHDR chunk is first and says 64x64
+icon_error check_png(std::string_view bytes);
+
+// Checks an icon as stored in servers.dat: base64 alphabet and padding, then the PNG
+// header, decoding only its first 24 bytes, then the length. Empty icons are fine
+icon_error check_icon(std::string_view base64);
+
+std::string_view icon_error_name(icon_error error);
+
+struct icon_check_stats {
+	static constexpr std::size_t max_examples = 5;
+
+	std::size_t cleared = 0;
+	std::array<std::size_t, icon_error_count> errors{}; // cleared, by icon_error
+	std::vector<std::string> examples; // ips of the first max_examples servers with a broken icon
+};
+
+// --validate-icons: clears the icons that fail check_icon, the servers are kept
+icon_check_stats validate_icons(std::vector<nbtserver>& servers);
+
+// Resolves @path icons. Every path is read and checked once, and files with the same
+// content are encoded once, so thousands of servers sharing an icon cost one encode
+class icon_cache {
+public:
+	// Replaces an @path icon with the base64 of the file, or clears it when the file
+	// can't be used. Other icons are left alone
+	void resolve(nbtserver& server);
+	void resolve(std::vector<nbtserver>& servers);
+
+	// paths that were read
+	std::size_t files() const { return by_path.size(); }
+	std::vector<std::string> paths() const;
+	// distinct contents that were encoded
+	std::size_t images() const { return by_content.size(); }
+	// paths that couldn't be used, and why
+	const std::vector<std::pair<std::string, icon_error>>& failures() const { return failed; }
+
+private:
+	using encoded_icon = std::shared_ptr<const std::string>;
+
+	encoded_icon load(const std::string& path);
+
+	std::unordered_map<std::string, encoded_icon> by_path; // null when the file can't be used
+	std::unordered_map<std::uint64_t, encoded_icon> by_content; // xxh64 of the PNG
+	std::vector<std::pair<std::string, icon_error>> failed;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef ENBT_INTERVAL_TABLE_H
+#define ENBT_INTERVAL_TABLE_H
+
+// Sorted, disjoint IPv4 and IPv6 intervals with an optional 32-bit payload each, the
+// compiled form of the blocklist and the prefix labels. IPv4 intervals come with a
+// table of where every /16 starts, so a lookup is a short binary search. The table can
+// be saved to a cache file and memory mapped on the next run, as long as the size and
+// modification time of the text it was compiled from still match. The cache is in
+// native byte order and only meant for this machine
+//
+//	interval_table table;
+//	std::string_view extra;
+//	if (!table.load(cache_path, magic, stamp, extra)) {
+//		table.assign(v4, v6, false);
+//		table.save(cache_path, magic, stamp, {});
+//	}
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "address.hpp"
+#include "mapped_file.hpp"
+
+class interval_table {
+public:
+	// an IPv6 address as a number, high half first
+	struct u128 {
+		std::uint64_t hi;
+		std::uint64_t lo;
+		auto operator<=>(const u128&) const = default;
+	};
+
+	template <typename T>
+	struct interval {
+		T start;
+		T end; // inclusive
+		std::uint32_t payload;
+	};
+
+	// size and modification time of the text a table was compiled from
+	struct source_stamp {
+		std::uint64_t size;
+		std::int64_t time;
+		bool operator==(const source_stamp&) const = default;
+	};
+
+	enum class cidr_error { none, address, prefix_length };
+
+	// a.b.c.d/n, v6/n or a single address, a /32 or /128. Host bits set below the
+	// prefix are ignored, 10.1.2.3/8 is 10.0.0.0/8. Fills v4 or v6 and says which
+	static cidr_error parse_cidr(std::string_view text, interval<std::uint32_t>& v4, interval<u128>& v6, bool& is_v4);
+	static u128 to_u128(const std::array<std::uint8_t, 16>& ipv6);
+	static bool stamp_of(const std::filesystem::path& path, source_stamp& stamp);
+
+	// value + 1 and value - 1 for std::uint32_t and u128
+	template <typename T>
+	static T successor(T value) {
+		if constexpr (std::is_integral_v<T>)
+			return value + 1;
+		else
+			return T{ value.hi + (value.lo == ~std::uint64_t{0}), value.lo + 1 };
+	}
+	template <typename T>
+	static T predecessor(T value) {
+		if constexpr (std::is_integral_v<T>)
+			return value - 1;
+		else
+			return T{ value.hi - (value.lo == 0), value.lo - 1 };
+	}
+
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	interval_table() = default;
+	interval_table(const interval_table&) = delete;
+	interval_table& operator=(const interval_table&) = delete;
+
+	// Takes sorted, disjoint intervals, their payloads only when with_payloads
+	void assign(const std::vector<interval<std::uint32_t>>& v4, const std::vector<interval<u128>>& v6, bool with_payloads);
+	// Maps cache_path when it holds a table saved with magic for the text with stamp.
+	// extra is what was saved along, 8 byte aligned
+	bool load(const std::filesystem::path& cache_path, const char (&magic)[8], const source_stamp& stamp, std::string_view& extra);
+	// Best effort: without a cache the text is compiled again next time
+	void save(const std::filesystem::path& cache_path, const char (&magic)[8], const source_stamp& stamp, std::string_view extra) const;
+
+	std::size_t size() const { return v4_starts.size() + v6_starts.size(); }
+	// The interval holding address, IPv4 ones first, or npos. IPv4-mapped IPv6 addresses
+	// (::ffff:a.b.c.d) are looked up as IPv4 too, host names and invalid addresses are
+	// never found
+	std::size_t find(const server_address& address) const;
+	// 0 for tables without payloads
+	std::uint32_t payload(std::size_t interval) const { return payloads.empty() ? 0 : payloads[interval]; }
+
+private:
+	std::size_t find_v4(std::uint32_t ip) const;
+
+	// the intervals live either in these or in the mapped cache
+	mapped_file cache{};
+	std::vector<std::uint32_t> owned_v4{}; // index, starts, ends
+	std::vector<u128> owned_v6{}; // starts, ends
+	std::vector<std::uint32_t> owned_payloads{};
+
+	std::span<const std::uint32_t> v4_index{}; // 65537 entries: first interval ending at or after every /16
+	std::span<const std::uint32_t> v4_starts{};
+	std::span<const std::uint32_t> v4_ends{};
+	std::span<const u128> v6_starts{};
+	std::span<const u128> v6_ends{};
+	std::span<const std::uint32_t> payloads{}; // IPv4 ones first, empty without payloads
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef ENBT_MAPPED_FILE_H
+#define ENBT_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read only memory mapping of a whole file. Check is_open() like an ifstream
+class mapped_file {
+public:
+	mapped_file() = default;
+	explicit mapped_file(const std::string& path);
+	~mapped_file();
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file(mapped_file&& other) noexcept;
+	mapped_file& operator=(mapped_file&& other) noexcept;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool is_open() const { return opened; }
+	const char* data() const { return bytes; }
+	std::size_t size() const { return length; }
+	std::string_view view() const { return {bytes, length}; }
+
+private:
+	const char* bytes = nullptr;
+	std::size_t length = 0;
+	bool opened = false;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
+
+#endif
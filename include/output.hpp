@@ -0,0 +1,110 @@
+#ifndef ENBT_OUTPUT_H
+#define ENBT_OUTPUT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <vector>
+#include "hash.hpp"
+
+struct output_result {
+	bool written; // false when the target already held the same bytes
+	std::uint64_t hash; // xxh64 of the output, when hashed
+	std::uint64_t size;
+	bool hashed = true; // false after start_from(), whose copied bytes are never read
+};
+
+// Output that goes to a temporary file next to target, hashed while it's written.
+// commit() compares it against the existing target and either throws it away or
+// fsyncs it and renames it over the target, so readers never see a half written file.
+// Dropped without commit() the temporary file is removed
+class atomic_output {
+public:
+	explicit atomic_output(const std::filesystem::path& target);
+	~atomic_output();
+
+	atomic_output(const atomic_output&) = delete;
+	atomic_output& operator=(const atomic_output&) = delete;
+
+	bool is_open() const { return file != nullptr; }
+	std::ostream& stream() { return out; }
+	const std::filesystem::path& temp_path() const { return temp; }
+
+	// Instead of writing to stream(): fills the temporary file with a copy of source,
+	// which holds bytes hashing to hash. Shares source's extents (reflink) where the
+	// filesystem can, copies in the kernel (copy_file_range) otherwise and writes bytes
+	// as the last resort
+	bool copy_from(const std::filesystem::path& source, std::string_view bytes, std::uint64_t hash);
+
+	// Like copy_from(), but bytes are only the start of source and stream() and patch()
+	// carry on after them. commit() then leaves the output unhashed, so it costs what
+	// comes after them, and always replaces the target
+	bool start_from(const std::filesystem::path& source, std::string_view bytes);
+
+	// Overwrites bytes already written at offset, for a value only known at the end.
+	// commit() then hashes the finished file instead of the stream, unless it started
+	// from another one
+	bool patch(std::uint64_t offset, std::string_view bytes);
+
+	// Returns false when writing, syncing or renaming failed; the target is left as it was
+	bool commit(output_result& result);
+
+private:
+	class hashing_buf : public std::streambuf {
+	public:
+		hashing_buf();
+		void attach(std::FILE* f) { file = f; }
+		std::uint64_t hash() const { return hasher.digest(); }
+		std::uint64_t size() const { return written; }
+		bool ok() const { return good; }
+
+	protected:
+		int_type overflow(int_type ch) override;
+		std::streamsize xsputn(const char* s, std::streamsize n) override;
+		int sync() override;
+
+	private:
+		bool drain(const char* data, std::size_t len);
+
+		std::vector<char> buffer;
+		std::FILE* file = nullptr;
+		xxh64 hasher;
+		std::uint64_t written = 0;
+		bool good = true;
+	};
+
+	void discard();
+
+	std::filesystem::path target;
+	std::filesystem::path temp;
+	std::FILE* file = nullptr;
+	hashing_buf buf;
+	std::ostream out;
+	bool copied = false; // copy_from() filled the file, the hash below is already known
+	std::uint64_t copied_hash = 0;
+	std::uint64_t copied_size = 0;
+	bool patched = false;
+	std::uint64_t base = 0; // bytes start_from() put in the file before the stream's
+};
+
+// Flushes f and has its contents reach the disk, false when either failed
+bool sync_file(std::FILE* f);
+// Moves f to offset, which may be past 2 GiB where long is 32 bits
+bool seek_file(std::FILE* f, std::uint64_t offset);
+
+// Hash of a file's contents, false when it can't be read
+bool hash_file(const std::filesystem::path& path, std::uint64_t& hash);
+
+// Whether path is a regular file of the given size and hash
+bool file_matches(const std::filesystem::path& path, std::uint64_t size, std::uint64_t hash);
+
+// Writes bytes, which hash to hash, to every target through atomic_output. The first
+// target is written from memory and the others in parallel, reflinked or kernel copied
+// from it when it was written. Returns whether each target holds bytes now, results
+// says how
+std::vector<char> write_outputs(const std::vector<std::filesystem::path>& targets, std::string_view bytes, std::uint64_t hash, std::vector<output_result>& results);
+
+#endif
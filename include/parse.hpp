@@ -3,12 +3,14 @@
 
 #include <string>
 #include <vector>
+#include "address.hpp"
 
 struct nbtserver {
 	std::string icon; // base64
 	std::string ip;
 	std::string name;
 	bool accept_textures;
+	server_address address{}; // filled by canonicalize_servers and range expansion
 };
 
 std::vector<nbtserver> parse_servers_json(const std::string& content);
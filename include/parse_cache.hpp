@@ -0,0 +1,67 @@
+#ifndef ENBT_PARSE_CACHE_H
+#define ENBT_PARSE_CACHE_H
+
+// Outputs of earlier runs, for running enbt again on input that didn't change. An
+// entry is keyed by the xxh64 of the input bytes and by the options that shape the
+// output, and holds the encoded servers.dat, so a hit only has to write it. So that a
+// hit doesn't even read the input, the hash of an input file is remembered along with
+// its size and modification time and trusted while both match. Every entry and every
+// remembered hash is its own file in the directory, replaced atomically, so runs
+// sharing the directory at worst redo each other's work. Nothing is ever evicted,
+// delete the directory to empty it
+//
+//	parse_cache cache("cache");
+//	if (!cache.known_hash(input, stamp, hash))
+//		hash = hash_bytes(text), cache.remember_hash(input, stamp, hash);
+//	parse_cache::entry entry{};
+//	if (cache.load(hash, options, entry))
+//		write(entry.bytes);
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include "mapped_file.hpp"
+
+class parse_cache {
+public:
+	// Opens directory, creating it when needed. Check is_open(), error() says what was
+	// wrong otherwise
+	explicit parse_cache(const std::filesystem::path& directory);
+
+	bool is_open() const { return opened; }
+	const std::string& error() const { return problem; }
+
+	// Size and modification time of a file, when it was looked at
+	struct file_stamp {
+		std::uint64_t size = 0;
+		std::int64_t time = 0;
+	};
+
+	// Fills stamp with input's current size and time, and hash with the hash remembered
+	// for them. False when input can't be stat'ed (stamp stays empty) or its hash has to
+	// be computed
+	bool known_hash(const std::filesystem::path& input, file_stamp& stamp, std::uint64_t& hash) const;
+	// Remembers hash for input as it was when stamp was taken. Skipped when the file was
+	// modified in the last seconds, as a change in the same clock tick would go unnoticed
+	void remember_hash(const std::filesystem::path& input, const file_stamp& stamp, std::uint64_t hash) const;
+
+	struct entry {
+		mapped_file file;
+		std::uint64_t server_count = 0;
+		std::string_view bytes; // the encoded servers.dat, in file
+	};
+	// Maps the entry for the input hash and the options key
+	bool load(std::uint64_t input_hash, std::string_view options, entry& found) const;
+	bool store(std::uint64_t input_hash, std::string_view options, std::uint64_t server_count, std::string_view bytes) const;
+
+private:
+	std::filesystem::path input_path(const std::filesystem::path& input) const;
+	std::filesystem::path entry_path(std::uint64_t input_hash, std::string_view options) const;
+
+	std::filesystem::path directory;
+	bool opened = false;
+	std::string problem{};
+};
+
+#endif
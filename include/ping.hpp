@@ -0,0 +1,74 @@
+#ifndef ENBT_PING_H
+#define ENBT_PING_H
+
+// Server List Ping, the status request of the multiplayer screen. Every server gets a
+// handshake and a status request, and its JSON answer gives the MOTD and the favicon.
+// The connections are non-blocking and driven by a single epoll loop, with at most
+// concurrency of them open and each one given up after timeout. Host names are
+// resolved first by a few threads, since getaddrinfo blocks. Linux only
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parse.hpp"
+
+struct ping_options {
+	std::size_t concurrency = 1000; // connections open at once, lowered to fit the open file limit
+	std::chrono::milliseconds timeout{3000}; // per server, from connecting to the whole answer
+	std::chrono::seconds ttl{24 * 60 * 60}; // how long a cached answer is used
+	std::chrono::seconds negative_ttl{60 * 60}; // how long a cached failure is used
+};
+
+enum class ping_status : std::uint8_t { ok, unresolved, unreachable, timeout, bad_response };
+constexpr std::size_t ping_status_count = 5;
+
+std::string_view ping_status_name(ping_status status);
+
+struct ping_result {
+	ping_status status = ping_status::unreachable;
+	std::uint32_t latency_ms = 0; // from sending the request to the whole answer
+	std::string motd; // description as plain text, on one line
+	std::string favicon; // base64 PNG, without the data: prefix
+};
+
+// Whether this build can ping, the other functions work everywhere
+bool ping_supported();
+
+// Pings every address, written like a server's ip. results[i] answers addresses[i]
+std::vector<ping_result> ping_addresses(const std::vector<std::string>& addresses, const ping_options& options);
+
+// Handshake (next state status) followed by the status request
+std::string status_request(std::string_view host, std::uint16_t port);
+
+enum class response_frame : std::uint8_t { incomplete, complete, invalid };
+
+// Finds the status response packet at the start of bytes and points json at its text
+response_frame read_status_response(std::string_view bytes, std::string_view& json);
+
+// Fills motd and favicon from the status JSON. False when it isn't a JSON object
+bool parse_status_json(std::string_view json, ping_result& result);
+
+class ping_cache;
+
+struct ping_stats {
+	std::size_t pinged = 0; // distinct addresses that were pinged
+	std::size_t cached = 0; // more distinct addresses, answered from the cache
+	std::array<std::size_t, ping_status_count> statuses{}; // pinged and cached, by ping_status
+	std::size_t names = 0; // names filled in
+	std::size_t icons = 0; // icons filled in
+};
+
+// Key of an address in a ping_cache: its canonical text, or the text as it is when it
+// isn't a valid address
+std::string ping_cache_key(std::string_view address);
+
+// --ping: fills empty names with the MOTD and empty icons with the favicon. Only
+// servers missing one of them are pinged, each address once. With a cache, addresses
+// with an entry that hasn't expired aren't pinged, and the others are stored in it
+ping_stats ping_servers(std::vector<nbtserver>& servers, const ping_options& options, ping_cache* cache = nullptr);
+
+#endif
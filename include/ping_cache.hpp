@@ -0,0 +1,77 @@
+#ifndef ENBT_PING_CACHE_H
+#define ENBT_PING_CACHE_H
+
+// Ping results kept between runs, keyed by canonical address. Every entry carries the
+// time it was checked and the time it expires, so answers and failures (negative
+// entries) can live for different times. The file is memory mapped and holds an open
+// addressing hash index ahead of the entries, so lookups read a slot and one entry and
+// opening costs nothing whatever its size. New entries are appended and the index is
+// rewritten in place; once the index is half full or most entries are replaced ones,
+// the file is rewritten with only the live entries
+//
+//	ping_cache cache("ping.cache");
+//	if (!cache.lookup(key, now, result))
+//		cache.store(key, fresh_result, now, now + ttl);
+//	cache.flush();
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mapped_file.hpp"
+#include "ping.hpp"
+
+class ping_cache {
+public:
+	// Opens path, an empty cache when it doesn't exist yet. Check is_open(), a file that
+	// isn't a ping cache is never touched. A cache from another byte order is started over
+	explicit ping_cache(const std::filesystem::path& path);
+
+	bool is_open() const { return opened; }
+	// entries in the file, not counting the ones queued by store
+	std::uint64_t size() const { return header.entry_count; }
+
+	// Fills result from key's entry when it expires after now (unix seconds)
+	bool lookup(std::string_view key, std::int64_t now, ping_result& result) const;
+	// Queues an entry for key, replacing the one it has
+	void store(std::string_view key, const ping_result& result, std::int64_t checked_at, std::int64_t expires_at);
+	// Writes the queued entries and syncs them. Does nothing when none are queued
+	bool flush();
+
+	struct file_header {
+		char magic[8];
+		std::uint32_t byte_order;
+		std::uint32_t reserved;
+		std::uint64_t slot_count; // a power of two, or 0 in an empty cache
+		std::uint64_t entry_count;
+		std::uint64_t data_size; // bytes of entries after the index
+		std::uint64_t dead_size; // of them, bytes of replaced entries
+	};
+
+	struct index_slot {
+		std::uint64_t hash;
+		std::uint64_t offset; // of the entry in the data, plus one. 0 when the slot is empty
+	};
+
+private:
+	// entries, followed by appended ones that aren't in the file yet
+	std::string_view entry_bytes(std::uint64_t offset, std::string_view appended = {}) const;
+	std::vector<index_slot> read_index() const;
+	// the slot holding key, or the empty slot where it would go
+	std::uint64_t probe(const std::vector<index_slot>& slots, std::uint64_t hash, std::string_view key, std::string_view appended) const;
+	// writes a new file with the live entries and the queued ones
+	bool rewrite();
+
+	std::filesystem::path path;
+	mapped_file file;
+	file_header header{};
+	std::vector<std::pair<std::string, std::string>> pending; // key, encoded entry
+	std::unordered_map<std::string, std::size_t> pending_index; // key -> position in pending
+	std::int64_t newest = 0; // latest checked_at queued; entries that expired before it are dropped by a rewrite
+	bool opened = false;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef ENBT_PREFIX_LABELS_H
+#define ENBT_PREFIX_LABELS_H
+
+// Labels for address prefixes, like a local geo or ASN database, for naming servers by
+// where they're hosted. The text file has one "cidr,label" line per prefix (a single
+// address is a /32 or /128), with # comment lines and an optional header line. Where
+// prefixes nest the longest one gives the label, and a prefix listed twice keeps its
+// last label. The prefixes are compiled into an interval_table of disjoint intervals
+// with a label each. Like the blocklist, it is saved next to the text (path + ".cache")
+// with the labels and memory mapped on the next run
+//
+//	prefix_labels labels("asn.csv");
+//	if (labels.is_open())
+//		labels.name_servers(servers, "[{label}] {ip}");
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "interval_table.hpp"
+#include "parse.hpp"
+
+class prefix_labels {
+public:
+	// Loads path, through its cache when that's up to date. Check is_open(), error() says
+	// what was wrong otherwise
+	explicit prefix_labels(const std::filesystem::path& path);
+
+	prefix_labels(const prefix_labels&) = delete;
+	prefix_labels& operator=(const prefix_labels&) = delete;
+
+	bool is_open() const { return opened; }
+	const std::string& error() const { return problem; }
+	// loaded from the cache instead of the text
+	bool cached() const { return from_cache; }
+	// intervals after splitting nested prefixes
+	std::size_t size() const { return table.size(); }
+	// distinct labels
+	std::size_t label_count() const { return label_offsets.empty() ? 0 : label_offsets.size() - 1; }
+
+	// The label of the longest prefix holding address, empty when there's none.
+	// IPv4-mapped IPv6 addresses (::ffff:a.b.c.d) are looked up as IPv4 too, host names
+	// and invalid addresses have no label
+	std::string_view lookup(const server_address& address) const;
+
+	// When server has no name and its address has a label, names it after name_template,
+	// where {label} is replaced by the label and {ip} by the server's ip. Uses the parsed
+	// address when there is one. Returns whether it was named
+	bool name(nbtserver& server, std::string_view name_template) const;
+	// name() for every server, returns how many were named
+	std::size_t name_servers(std::vector<nbtserver>& servers, std::string_view name_template) const;
+
+private:
+	bool compile(std::string_view text);
+	// the labels as saved along with the table, false when extra doesn't hold them
+	bool read_labels(std::string_view extra);
+	std::string write_labels() const;
+
+	bool opened = false;
+	bool from_cache = false;
+	std::string problem{};
+	interval_table table{};
+
+	// the labels live either in these or in the mapped cache
+	std::vector<std::uint32_t> owned_label_offsets{};
+	std::string owned_label_text{};
+	std::span<const std::uint32_t> label_offsets{}; // label i is label_text[offsets[i], offsets[i + 1])
+	std::string_view label_text{};
+};
+
+#endif
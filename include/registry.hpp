@@ -0,0 +1,118 @@
+#ifndef ENBT_REGISTRY_H
+#define ENBT_REGISTRY_H
+
+// Persistent set of servers keyed by ip, for big lists that change a little at a time.
+// The registry file is an append-only log of upsert and delete records. An upsert
+// carries the server's encoded compound, and exporting copies those compounds into
+// servers.dat as they are, so a refresh only parses and encodes the servers that
+// changed. The ip index is rebuilt from the record headers on open. Once most of the
+// log is dead, compact() rewrites it with only the live records
+//
+//	server_registry registry("servers.enbtr");
+//	registry.upsert(server);
+//	registry.flush();
+//	registry.write_servers_dat(out, std::endian::big);
+
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.hpp"
+#include "parse.hpp"
+
+class server_registry {
+public:
+	// Opens path, creating an empty registry when it doesn't exist. Check is_open()
+	explicit server_registry(const std::filesystem::path& path);
+
+	bool is_open() const { return opened; }
+	// live servers
+	std::size_t size() const { return live_count; }
+	// bytes in the log, flushed or not, and how many of them belong to live records
+	std::uint64_t log_size() const { return valid_size + pending.size(); }
+	std::uint64_t live_size() const { return live; }
+
+	// Returns false when ip already holds exactly this server, nothing is logged then
+	bool upsert(const nbtserver& server);
+	// Returns false when ip isn't in the registry
+	bool erase(std::string_view ip);
+	// Appends the records queued by upsert and erase and syncs them to disk
+	bool flush();
+
+	// Most of the log is dead records
+	bool should_compact() const;
+	// Replaces the log atomically with the live records, in export order. Flushes too
+	bool compact();
+
+	// Writes a whole servers.dat, servers in the order they were first added.
+	// Big endian compounds are copied as stored, little endian ones are re-encoded
+	bool write_servers_dat(std::ostream& out, std::endian endian) const;
+
+private:
+	// where a live server's compound is; size is 0 once the server is erased. The ip is
+	// right before the compound's length
+	struct slot {
+		std::uint64_t offset = 0;
+		std::uint32_t size = 0;
+		std::uint16_t ip_size = 0;
+	};
+	// a slot as the checkpoint stores it
+	struct stored_slot {
+		std::uint64_t offset;
+		std::uint32_t size;
+		std::uint16_t ip_size;
+		std::uint16_t reserved;
+	};
+	// a live ip in the checkpoint, sorted by hash
+	struct stored_ip {
+		std::uint64_t hash;
+		std::uint64_t slot;
+	};
+	static_assert(sizeof(stored_slot) == 16 && sizeof(stored_ip) == 16);
+	static constexpr std::uint32_t no_slot = ~std::uint32_t{0};
+
+	bool load();
+	bool load_checkpoint();
+	// Best effort, needs every record flushed: without it the next open reads more of the log
+	void save_checkpoint();
+
+	std::size_t slot_count() const { return base_slots.size() + added.size(); }
+	slot get(std::uint32_t i) const;
+	void set(std::uint32_t i, const slot& s);
+	std::string_view ip_of(const slot& s) const { return bytes(s.offset - 4 - s.ip_size, s.ip_size); }
+	std::uint32_t find(std::string_view ip) const;
+	// points ip, found at i or new when i is no_slot, to current
+	void place(std::string_view ip, std::uint32_t i, const slot& current);
+	// drops ip from the index without logging it
+	bool forget(std::string_view ip);
+	std::string_view bytes(std::uint64_t offset, std::size_t size) const;
+	std::string_view compound(const slot& s) const { return bytes(s.offset, s.size); }
+	// returns the offset of the compound in the log
+	std::uint64_t queue(char kind, std::string_view ip, std::string_view compound);
+
+	std::filesystem::path path;
+	mapped_file file;
+	std::uint64_t valid_size = 0; // a torn record at the end of the file is cut off by the next flush
+	std::string pending; // records not flushed yet. Their offsets continue after the file's
+
+	// slots in export order: the checkpoint's, then the ones added since. Erased servers
+	// leave a hole until compaction
+	mapped_file checkpoint;
+	std::uint64_t checkpoint_size = 0; // log bytes the checkpoint covers
+	std::span<const stored_slot> base_slots{};
+	std::span<const stored_ip> base_ips{};
+	std::unordered_map<std::uint32_t, slot> changed; // checkpoint slots replaced or erased since
+	std::vector<slot> added;
+	std::unordered_map<std::string, std::uint32_t> added_index; // ip -> slot, for ips not live in the checkpoint
+
+	std::uint64_t live = 0;
+	std::size_t live_count = 0;
+	bool opened = false;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ENBT_SAMPLE_H
+#define ENBT_SAMPLE_H
+
+// Uniform random samples of server lists, read once and in O(sample size) memory.
+// Items are picked with reservoir sampling (Algorithm L), which draws how many items
+// to skip until the next pick instead of a random number per item. Picked servers
+// keep their input order. csv lines that aren't picked are only scanned for their
+// delimiters, never split into strings
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <random>
+#include <vector>
+#include "external.hpp"
+#include "parse.hpp"
+
+class reservoir_sampler {
+public:
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	reservoir_sampler(std::size_t capacity, std::uint64_t seed);
+
+	// Call with the positions of the items, 0, 1, ... Returns the reservoir slot that
+	// the item at position goes into, replacing what was there, or npos when it's skipped
+	std::size_t offer(std::uint64_t position);
+	// Position of the next item that will be picked. Everything before it is skipped
+	std::uint64_t next() const { return next_pick; }
+
+private:
+	double uniform();
+	void skip();
+
+	std::size_t capacity;
+	std::mt19937_64 random;
+	double weight = 0;
+	std::uint64_t next_pick = 0;
+};
+
+struct sample_stats {
+	std::uint64_t seen = 0; // servers sampled from
+	std::uint64_t invalid = 0; // csv lines missing fields
+};
+
+// Samples count servers out of csv input. When prepare is set, lines are parsed in
+// batches that go through it and the sample is taken from the servers it keeps
+std::vector<nbtserver> sample_csv(std::istream& input, std::size_t count, std::uint64_t seed, const batch_hook& prepare, sample_stats& stats);
+
+// Keeps count of servers, in their order
+void sample_servers(std::vector<nbtserver>& servers, std::size_t count, std::uint64_t seed);
+
+#endif
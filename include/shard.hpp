@@ -0,0 +1,33 @@
+#ifndef ENBT_SHARD_H
+#define ENBT_SHARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include "parse.hpp"
+
+struct shard_limits {
+	std::size_t max_entries = 0; // 0 is unbounded
+	std::uint64_t max_bytes = 0; // encoded size of a whole shard file, 0 is unbounded
+	bool by_ip_hash = false; // otherwise consecutive runs in input order
+
+	bool enabled() const { return max_entries || max_bytes; }
+};
+
+// Splits servers into shards that each stay within limits. A shard is the list of
+// indices into servers it holds, in input order. By ip hash the same ip always lands
+// in the same shard for a given shard count, shard hash(ip) % count, and shards no ip
+// hashes to are there empty. A single server bigger than max_bytes gets a shard of its own.
+// Returns false when no shard count spreads the ip hashes within limits, as for more
+// servers with one ip than a shard holds; write nothing then
+bool partition_servers(const std::vector<nbtserver>& servers, const shard_limits& limits, std::vector<std::vector<std::size_t>>& shards);
+
+// servers.dat -> servers.0.dat, servers.1.dat, ...
+std::filesystem::path shard_path(const std::filesystem::path& output_path, std::size_t index);
+
+// Deletes the shards from index count on, up to the first one that doesn't exist, which
+// an earlier run writing more of them left behind. Returns the files it deleted
+std::vector<std::filesystem::path> remove_stale_shards(const std::filesystem::path& output_path, std::size_t count);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef ENBT_SORT_H
+#define ENBT_SORT_H
+
+#include <cstdint>
+#include <vector>
+#include "parse.hpp"
+
+enum class sort_key {
+	name, // ascii case insensitive
+	ip, // the ip text, byte by byte
+	addr, // numeric: IPv4, then IPv6, each by address and port, then host names and invalid addresses as text
+};
+
+// Order to write servers in, as a permutation of their indices. Stable: servers with
+// equal keys keep their input order, reversed or not. Only keys and indices are
+// sorted, the servers themselves aren't touched. Large inputs are sorted in parallel
+std::vector<std::uint32_t> sort_order(const std::vector<nbtserver>& servers, sort_key key, bool reverse);
+
+// Puts servers in the order given by sort_order. Strings are moved, not copied
+void apply_order(std::vector<nbtserver>& servers, const std::vector<std::uint32_t>& order);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef ENBT_STATIC_SERVERS_H
+#define ENBT_STATIC_SERVERS_H
+
+// Compile time servers.dat generation for fixed server lists.
+// The encoding is byte for byte what NBT::NBTWriter produces for ips_to_dat,
+// so a list baked in here can be emitted with a single write.
+//
+//	static constexpr std::array<static_server, 1> defaults{{
+//		{ .name = "Hub", .icon = "", .ip = "play.example.net", .accept_textures = true },
+//	}};
+//	constexpr auto dat = make_servers_dat<defaults>();
+//	constexpr auto dat_csv = make_servers_dat_csv<"Hub,,play.example.net,1\n">();
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include "NBTWriter.h"
+
+struct static_server {
+	std::string_view name;
+	std::string_view icon; // base64
+	std::string_view ip;
+	bool accept_textures;
+};
+
+template <std::size_t N>
+struct fixed_string {
+	char data[N]{};
+	constexpr fixed_string(const char (&str)[N]) { std::copy_n(str, N, data); }
+	constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+namespace static_nbt {
+
+template <std::endian E, typename Out>
+constexpr Out put_u16(Out out, std::uint16_t value) {
+	if constexpr (E == std::endian::big) {
+		*out++ = static_cast<std::byte>(value >> 8);
+		*out++ = static_cast<std::byte>(value & 0xff);
+	} else {
+		*out++ = static_cast<std::byte>(value & 0xff);
+		*out++ = static_cast<std::byte>(value >> 8);
+	}
+	return out;
+}
+
+template <std::endian E, typename Out>
+constexpr Out put_u32(Out out, std::uint32_t value) {
+	if constexpr (E == std::endian::big) {
+		out = put_u16<E>(out, static_cast<std::uint16_t>(value >> 16));
+		return put_u16<E>(out, static_cast<std::uint16_t>(value & 0xffff));
+	} else {
+		out = put_u16<E>(out, static_cast<std::uint16_t>(value & 0xffff));
+		return put_u16<E>(out, static_cast<std::uint16_t>(value >> 16));
+	}
+}
+
+template <std::endian E, typename Out>
+constexpr Out put_str(Out out, std::string_view str) {
+	if (str.size() > 0xffff)
+		throw std::length_error("nbt strings are limited to 65535 bytes");
+	out = put_u16<E>(out, static_cast<std::uint16_t>(str.size()));
+	for (const char c : str)
+		*out++ = static_cast<std::byte>(c);
+	return out;
+}
+
+template <std::endian E, typename Out>
+constexpr Out put_string_tag(Out out, std::string_view name, std::string_view value) {
+	*out++ = static_cast<std::byte>(NBT::idString);
+	return put_str<E>(put_str<E>(out, name), value);
+}
+
+constexpr std::size_t string_tag_size(std::string_view name, std::string_view value) {
+	return 1 + 2 + name.size() + 2 + value.size();
+}
+
+// Splits csv exactly like parse_servers_csv and calls fn for every complete entry
+template <typename Fn>
+constexpr void for_each_csv_server(std::string_view csv, Fn&& fn) {
+	while (!csv.empty()) {
+		const std::size_t eol = csv.find('\n');
+		const std::string_view line = csv.substr(0, eol);
+		csv.remove_prefix(eol == std::string_view::npos ? csv.size() : eol + 1);
+
+		std::array<std::string_view, 4> items{};
+		std::size_t item_count = 0;
+		for (std::size_t pos = 0; pos < line.size() && item_count < items.size();) {
+			std::size_t next_pos = line.find_first_of(",|;", pos);
+			if (next_pos == std::string_view::npos)
+				next_pos = line.size();
+			items[item_count++] = line.substr(pos, next_pos - pos);
+			pos = next_pos == line.size() ? line.size() : next_pos + 1;
+		}
+
+		if (item_count < items.size())
+			continue;
+
+		fn(static_server{
+			.name = items[0],
+			.icon = items[1],
+			.ip = items[2],
+			.accept_textures = !items[3].empty() && items[3][0] == '1'
+		});
+	}
+}
+
+}
+
+// Size of one encoded server compound as an element of the 'servers' list
+constexpr std::size_t server_nbt_size(const static_server& server) {
+	using static_nbt::string_tag_size;
+	return string_tag_size("name", server.name)
+		+ string_tag_size("icon", server.icon)
+		+ string_tag_size("ip", server.ip)
+		+ 1 + 2 + std::string_view("acceptTextures").size() + 1
+		+ 1; // idEnd
+}
+
+// Encodes one server compound (without a list header). Usable at runtime too
+template <std::endian E = std::endian::big, typename Out>
+constexpr Out encode_server_nbt(Out out, const static_server& server) {
+	using namespace static_nbt;
+	out = put_string_tag<E>(out, "name", server.name);
+	out = put_string_tag<E>(out, "icon", server.icon);
+	out = put_string_tag<E>(out, "ip", server.ip);
+	*out++ = static_cast<std::byte>(NBT::idByte);
+	out = put_str<E>(out, "acceptTextures");
+	*out++ = static_cast<std::byte>(server.accept_textures);
+	*out++ = static_cast<std::byte>(NBT::idEnd);
+	return out;
+}
+
+// Root compound and 'servers' list header in front of count compounds
+constexpr std::size_t servers_dat_head_size = 3 + 1 + 2 + std::string_view("servers").size() + 1 + 4;
+
+template <std::endian E = std::endian::big, typename Out>
+constexpr Out encode_servers_dat_head(Out out, std::uint32_t count) {
+	using namespace static_nbt;
+	*out++ = static_cast<std::byte>(NBT::idCompound);
+	out = put_str<E>(out, "");
+	*out++ = static_cast<std::byte>(NBT::idList);
+	out = put_str<E>(out, "servers");
+	*out++ = static_cast<std::byte>(NBT::idCompound);
+	return put_u32<E>(out, count);
+}
+
+template <typename Out>
+constexpr Out encode_servers_dat_tail(Out out) {
+	*out++ = static_cast<std::byte>(NBT::idEnd);
+	return out;
+}
+
+template <typename Servers>
+constexpr std::size_t servers_dat_size(const Servers& servers) {
+	std::size_t size = servers_dat_head_size + 1;
+	for (const static_server& server : servers)
+		size += server_nbt_size(server);
+	return size;
+}
+
+template <const auto& Servers, std::endian E = std::endian::big>
+constexpr auto make_servers_dat() {
+	std::array<std::byte, servers_dat_size(Servers)> bytes{};
+	auto out = encode_servers_dat_head<E>(bytes.begin(), static_cast<std::uint32_t>(std::size(Servers)));
+	for (const static_server& server : Servers)
+		out = encode_server_nbt<E>(out, server);
+	encode_servers_dat_tail(out);
+	return bytes;
+}
+
+template <fixed_string Csv>
+constexpr std::size_t csv_servers_dat_size() {
+	std::size_t size = servers_dat_head_size + 1;
+	static_nbt::for_each_csv_server(Csv.view(), [&](const static_server& server) {
+		size += server_nbt_size(server);
+	});
+	return size;
+}
+
+template <fixed_string Csv, std::endian E = std::endian::big>
+constexpr auto make_servers_dat_csv() {
+	std::uint32_t count = 0;
+	static_nbt::for_each_csv_server(Csv.view(), [&](const static_server&) { ++count; });
+
+	std::array<std::byte, csv_servers_dat_size<Csv>()> bytes{};
+	auto out = encode_servers_dat_head<E>(bytes.begin(), count);
+	static_nbt::for_each_csv_server(Csv.view(), [&](const static_server& server) {
+		out = encode_server_nbt<E>(out, server);
+	});
+	encode_servers_dat_tail(out);
+	return bytes;
+}
+
+#endif
@@ -32,6 +32,7 @@ This file is part of SlopeCraft.
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <bit>
 //using namespace std;
 #define TwinStackSize 128
 namespace NBT{
@@ -57,13 +58,20 @@ namespace NBT{
 
     bool isSysBE();
 
+//E is the byte order written to the file. Java edition NBT is big endian,
+//Bedrock edition NBT is little endian. Swaps are resolved at compile time
+//and disappear entirely when E matches the host byte order.
+template <std::endian E = std::endian::big>
 class NBTWriter
 {
+	static_assert(E==std::endian::big||E==std::endian::little,"NBT is either big or little endian");
+	static_assert(std::endian::native==std::endian::big||std::endian::native==std::endian::little,"mixed endian hosts are not supported");
 	private:
 		//Vars
+		static constexpr bool needSwap=(E!=std::endian::native);
 		bool isOpen;
-		bool isBE;
         std::fstream *File;
+        std::ostream *Stream;//File, or a stream owned by the caller
 		bool Stdout_output;
 		unsigned long long ByteCount;
 		short top;
@@ -86,6 +94,7 @@ class NBTWriter
 	public:
 		//Construct&deConstruct
 		NBTWriter(const char*path, bool stdout_output);
+		NBTWriter(std::ostream*stream);
 		~NBTWriter();
         NBTWriter();
         void open(const char*path);
@@ -128,7 +137,9 @@ class NBTWriter
         unsigned long long getByteCount();
 };
 
-
+//Instantiated in NBTWriter.cpp
+extern template class NBTWriter<std::endian::big>;
+extern template class NBTWriter<std::endian::little>;
 
 //NameSpace NBT ends here
 }
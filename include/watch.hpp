@@ -0,0 +1,132 @@
+#ifndef ENBT_WATCH_H
+#define ENBT_WATCH_H
+
+// --watch: servers.dat kept up to date with its input. input_watcher waits on inotify
+// for the inputs to change, blocking without a timeout in between so an idle watch
+// uses no cpu, and lets a burst of changes settle before returning. incremental_servers
+// keeps what the last round parsed: csv files line by line, toml and json files whole,
+// each with its prepared servers and their encoded compounds. A round only parses,
+// prepares and encodes the lines and files whose text it hasn't seen, and the ones
+// whose preparing read other files, the rest is copied into the new servers.dat as it
+// is. Linux only
+//
+//	input_watcher watcher({"servers.csv"});
+//	incremental_servers servers(std::endian::big);
+//	do {
+//		servers.update({{"servers.csv", "csv"}}, prepare);
+//		write(servers.servers_dat());
+//	} while (watcher.wait(std::chrono::milliseconds(50)));
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "parse.hpp"
+
+// Whether this build can watch, incremental_servers works everywhere
+bool watch_supported();
+
+// The inputs of a path given with -i: the file itself with format, or the csv, toml and
+// json files of a directory in name order, each in the format of its extension
+struct watched_input {
+	std::filesystem::path path;
+	std::string format;
+};
+std::vector<watched_input> list_inputs(const std::filesystem::path& path, const std::string& format);
+
+class input_watcher {
+public:
+	// Watches every path: a file through its directory, so files replaced by a rename
+	// are still seen, and a directory for the input files in it. Check is_open()
+	explicit input_watcher(const std::vector<std::filesystem::path>& paths);
+	~input_watcher();
+
+	input_watcher(const input_watcher&) = delete;
+	input_watcher& operator=(const input_watcher&) = delete;
+
+	bool is_open() const { return fd >= 0; }
+	const std::string& error() const { return problem; }
+
+	// Watches file too from now on, like the files given to the constructor except that
+	// its directory going away only counts as a change. Files already watched are skipped.
+	// False when it can't be watched
+	bool add(const std::filesystem::path& file);
+
+	// Blocks until an input is written, created, renamed or deleted, then until debounce
+	// passes without another change. False when watching failed, error() says why
+	bool wait(std::chrono::milliseconds debounce);
+
+private:
+	struct watched_dir {
+		int wd;
+		std::filesystem::path dir;
+		std::string file; // the one input file in it, or empty for every input file
+		bool optional; // added later, the watch goes on without it
+	};
+
+	bool watch(const std::filesystem::path& path, bool optional);
+
+	bool relevant(const watched_dir& dir, std::string_view name) const;
+
+	int fd = -1;
+	std::vector<watched_dir> dirs;
+	std::string problem{};
+};
+
+class incremental_servers {
+public:
+	// Returns false when the result depends on more than the servers, like the icon
+	// files they name. Those are prepared again every round
+	using stage = std::function<bool(std::vector<nbtserver>&)>;
+
+	explicit incremental_servers(std::endian endian) : endian(endian) {}
+
+	struct update_stats {
+		std::size_t files = 0;
+		std::size_t parsed = 0; // lines and files parsed in this round
+		std::size_t reused = 0; // lines and files taken from the last round
+		std::size_t invalid = 0; // csv lines missing required fields
+		std::size_t failed = 0; // files that couldn't be read or parsed, kept as they were
+	};
+
+	// Reads inputs again. prepare runs on the servers of every line or file that is
+	// parsed, before they're encoded, and has to give the same result for the same servers
+	update_stats update(const std::vector<watched_input>& inputs, const stage& prepare);
+	// Drops what the last rounds prepared, for when prepare itself changed
+	void clear();
+
+	// servers after the last update, in input order
+	std::size_t size() const { return count; }
+	std::vector<nbtserver> servers() const;
+	// servers.dat of the servers in input order, or of servers()[order[0]], ...
+	std::string servers_dat() const;
+	std::string servers_dat(const std::vector<std::uint32_t>& order) const;
+
+private:
+	struct chunk {
+		std::vector<nbtserver> servers; // prepared
+		std::string compounds; // their encoded compounds, back to back
+		std::size_t invalid = 0;
+		std::uint64_t round = 0; // the last update that used it
+		bool reusable = true; // what prepare returned
+	};
+
+	// The chunk for key marked as used in this round, or nullptr when it's not there yet
+	// or has to be prepared again
+	chunk* take(std::uint64_t key, update_stats& stats);
+
+	std::endian endian;
+	std::unordered_map<std::uint64_t, chunk> chunks; // by hash of the text, csv lines seeded differently from files
+	std::uint64_t round = 0;
+	std::vector<std::uint64_t> order; // chunk keys in input order, a line listed twice is there twice
+	std::unordered_map<std::string, std::vector<std::uint64_t>> file_keys; // file -> keys of its chunks, kept when it can't be read
+	std::size_t count = 0;
+};
+
+#endif
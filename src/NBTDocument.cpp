@@ -0,0 +1,419 @@
+#include "NBTDocument.h"
+#include "output.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace NBT;
+
+namespace {
+template <std::endian E, typename T>
+void put_number(std::string& out, T value) {
+	if constexpr (E != std::endian::native && sizeof(T) > 1)
+		value = std::byteswap(value);
+	char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	out.append(bytes, sizeof(T));
+}
+
+template <std::endian E>
+void put_string(std::string& out, std::string_view str) {
+	put_number<E>(out, static_cast<std::uint16_t>(str.size()));
+	out.append(str);
+}
+
+bool is_integer_type(char type) {
+	return type == idByte || type == idShort || type == idInt || type == idLong;
+}
+
+bool is_real_type(char type) {
+	return type == idFloat || type == idDouble;
+}
+}
+
+template <std::endian E>
+NBTDocument<E>::NBTDocument(const std::filesystem::path& path) {
+	opened = file.open(path.string());
+	source = file.view();
+	if (opened)
+		load();
+}
+
+template <std::endian E>
+NBTDocument<E>::NBTDocument(std::string_view bytes) : source(bytes), opened(true) {
+	load();
+}
+
+template <std::endian E>
+NBTDocument<E>::NBTDocument() : opened(true) {
+	nodes.push_back(Node{.type = idCompound});
+}
+
+template <std::endian E>
+void NBTDocument<E>::load() {
+	nodes.clear();
+	const Reader reader(source);
+	nodeFromTag(reader.root(), true);
+}
+
+template <std::endian E>
+auto NBTDocument<E>::nodeFromTag(const typename Reader::Tag& tag, bool named) -> NodeId {
+	Node node{
+		.type = tag.type(),
+		.expanded = tag.type() != idCompound && tag.type() != idList,
+		.dirty = false,
+		.name = tag.name(),
+	};
+	node.raw = named ? tag.raw() : std::string_view(tag.payload(), static_cast<std::size_t>(tag.end() - tag.payload()));
+	node.payload = node.raw.substr(static_cast<std::size_t>(tag.payload() - node.raw.data()));
+	if (node.type == idString)
+		node.str = tag.asString();
+	else if (node.type == idList)
+		node.listType = tag.listType();
+	nodes.push_back(node);
+	return static_cast<NodeId>(nodes.size() - 1);
+}
+
+template <std::endian E>
+void NBTDocument<E>::expand(NodeId id) {
+	if (nodes[id].expanded)
+		return;
+	nodes[id].expanded = true;
+
+	// the container's own tag, re-read from its source bytes
+	const std::string_view payload = nodes[id].payload;
+	const char* limit = payload.data() + payload.size();
+	const typename Reader::Tag tag(nodes[id].type, {}, payload.data(), payload.data(), limit);
+	const auto append = [&](NodeId child) {
+		nodes[child].parent = id;
+		if (nodes[id].last == npos)
+			nodes[id].first = child;
+		else
+			nodes[nodes[id].last].next = child;
+		nodes[id].last = child;
+		nodes[id].childCount++;
+	};
+
+	if (tag.type() == idCompound) {
+		for (const auto& child : tag.children())
+			append(nodeFromTag(child, true));
+	} else {
+		nodes.reserve(nodes.size() + static_cast<std::size_t>(std::max(tag.listSize(), 0)));
+		for (const auto& element : tag.elements())
+			append(nodeFromTag(element, false));
+	}
+}
+
+template <std::endian E>
+std::size_t NBTDocument<E>::size(NodeId id) {
+	expand(id);
+	return nodes[id].childCount;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::firstChild(NodeId id) -> NodeId {
+	expand(id);
+	return nodes[id].first;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::find(NodeId compound, std::string_view child_name) -> NodeId {
+	if (nodes[compound].type != idCompound)
+		return npos;
+	for (NodeId child = firstChild(compound); child != npos; child = nodes[child].next) {
+		if (nodes[child].name == child_name)
+			return child;
+	}
+	return npos;
+}
+
+template <std::endian E>
+std::string_view NBTDocument<E>::getString(NodeId id) const {
+	return nodes[id].str;
+}
+
+template <std::endian E>
+std::int64_t NBTDocument<E>::getInteger(NodeId id) const {
+	const Node& node = nodes[id];
+	if (node.dirty || node.payload.empty())
+		return node.integer;
+	switch (node.type) {
+		case idByte: return Reader::template readNumber<std::int8_t>(node.payload.data());
+		case idShort: return Reader::template readNumber<std::int16_t>(node.payload.data());
+		case idInt: return Reader::template readNumber<std::int32_t>(node.payload.data());
+		case idLong: return Reader::template readNumber<std::int64_t>(node.payload.data());
+		default: return 0;
+	}
+}
+
+template <std::endian E>
+double NBTDocument<E>::getReal(NodeId id) const {
+	const Node& node = nodes[id];
+	if (node.dirty || node.payload.empty())
+		return node.real;
+	if (node.type == idFloat)
+		return std::bit_cast<float>(Reader::template readNumber<std::uint32_t>(node.payload.data()));
+	if (node.type == idDouble)
+		return std::bit_cast<double>(Reader::template readNumber<std::uint64_t>(node.payload.data()));
+	return 0;
+}
+
+template <std::endian E>
+void NBTDocument<E>::setString(NodeId id, std::string_view value) {
+	if (nodes[id].type != idString)
+		return;
+	nodes[id].str = intern(value);
+	markDirty(id);
+}
+
+template <std::endian E>
+void NBTDocument<E>::setInteger(NodeId id, std::int64_t value) {
+	if (!is_integer_type(nodes[id].type))
+		return;
+	nodes[id].integer = value;
+	markDirty(id);
+}
+
+template <std::endian E>
+void NBTDocument<E>::setReal(NodeId id, double value) {
+	if (!is_real_type(nodes[id].type))
+		return;
+	nodes[id].real = value;
+	markDirty(id);
+}
+
+template <std::endian E>
+void NBTDocument<E>::markDirty(NodeId id) {
+	while (id != npos && !nodes[id].dirty) {
+		nodes[id].dirty = true;
+		id = nodes[id].parent;
+	}
+}
+
+template <std::endian E>
+std::string_view NBTDocument<E>::intern(std::string_view str) {
+	if (str.empty())
+		return {};
+	char* copy = static_cast<char*>(strings.allocate(str.size(), 1));
+	std::memcpy(copy, str.data(), str.size());
+	return {copy, str.size()};
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addChild(NodeId parent, char type, std::string_view child_name) -> NodeId {
+	const char parent_type = nodes[parent].type;
+	if (parent_type != idCompound && parent_type != idList)
+		return npos;
+	expand(parent);
+	if (parent_type == idList) {
+		if (nodes[parent].childCount == 0)
+			nodes[parent].listType = type;
+		else if (nodes[parent].listType != type)
+			return npos;
+		child_name = {};
+	}
+
+	nodes.push_back(Node{.type = type, .name = intern(child_name), .parent = parent});
+	const NodeId id = static_cast<NodeId>(nodes.size() - 1);
+	if (nodes[parent].last == npos)
+		nodes[parent].first = id;
+	else
+		nodes[nodes[parent].last].next = id;
+	nodes[parent].last = id;
+	nodes[parent].childCount++;
+	markDirty(parent);
+	return id;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addString(NodeId parent, std::string_view child_name, std::string_view value) -> NodeId {
+	const NodeId id = addChild(parent, idString, child_name);
+	if (id != npos)
+		nodes[id].str = intern(value);
+	return id;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addInteger(NodeId parent, char type, std::string_view child_name, std::int64_t value) -> NodeId {
+	if (!is_integer_type(type))
+		return npos;
+	const NodeId id = addChild(parent, type, child_name);
+	if (id != npos)
+		nodes[id].integer = value;
+	return id;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addReal(NodeId parent, char type, std::string_view child_name, double value) -> NodeId {
+	if (!is_real_type(type))
+		return npos;
+	const NodeId id = addChild(parent, type, child_name);
+	if (id != npos)
+		nodes[id].real = value;
+	return id;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addCompound(NodeId parent, std::string_view child_name) -> NodeId {
+	return addChild(parent, idCompound, child_name);
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addList(NodeId parent, std::string_view child_name, char element_type) -> NodeId {
+	const NodeId id = addChild(parent, idList, child_name);
+	if (id != npos)
+		nodes[id].listType = element_type;
+	return id;
+}
+
+template <std::endian E>
+void NBTDocument<E>::remove(NodeId id) {
+	const NodeId parent = nodes[id].parent;
+	if (parent == npos)
+		return;
+
+	NodeId prev = npos;
+	for (NodeId child = nodes[parent].first; child != npos && child != id; child = nodes[child].next)
+		prev = child;
+	if (prev == npos)
+		nodes[parent].first = nodes[id].next;
+	else
+		nodes[prev].next = nodes[id].next;
+	if (nodes[parent].last == id)
+		nodes[parent].last = prev;
+	nodes[parent].childCount--;
+	nodes[id].parent = npos;
+	nodes[id].next = npos;
+	markDirty(parent);
+}
+
+template <std::endian E>
+auto NBTDocument<E>::serverList() -> NodeId {
+	const NodeId list = find(root(), "servers");
+	if (list == npos)
+		return addList(root(), "servers", idCompound);
+	return nodes[list].type == idList ? list : npos;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::findServer(std::string_view ip) -> NodeId {
+	const NodeId list = serverList();
+	if (list == npos || nodes[list].listType != idCompound)
+		return npos;
+	for (NodeId server = firstChild(list); server != npos; server = nodes[server].next) {
+		const NodeId server_ip = find(server, "ip");
+		if (server_ip != npos && nodes[server_ip].type == idString && nodes[server_ip].str == ip)
+			return server;
+	}
+	return npos;
+}
+
+template <std::endian E>
+auto NBTDocument<E>::addServer(std::string_view server_name, std::string_view icon, std::string_view ip, bool accept_textures) -> NodeId {
+	const NodeId list = serverList();
+	if (list == npos)
+		return npos;
+	const NodeId server = addCompound(list, "");
+	if (server == npos)
+		return npos;
+	addString(server, "name", server_name);
+	addString(server, "icon", icon);
+	addString(server, "ip", ip);
+	addInteger(server, idByte, "acceptTextures", accept_textures);
+	return server;
+}
+
+template <std::endian E>
+void NBTDocument<E>::writeNode(std::string& out, NodeId id, bool named) const {
+	const Node& node = nodes[id];
+	if (!node.dirty) {
+		out.append(named ? node.raw : node.payload);
+		return;
+	}
+	if (named) {
+		out.push_back(node.type);
+		put_string<E>(out, node.name);
+	}
+	writePayload(out, id);
+}
+
+template <std::endian E>
+void NBTDocument<E>::writePayload(std::string& out, NodeId id) const {
+	const Node& node = nodes[id];
+	switch (node.type) {
+		case idByte: put_number<E>(out, static_cast<std::int8_t>(node.integer)); return;
+		case idShort: put_number<E>(out, static_cast<std::int16_t>(node.integer)); return;
+		case idInt: put_number<E>(out, static_cast<std::int32_t>(node.integer)); return;
+		case idLong: put_number<E>(out, static_cast<std::int64_t>(node.integer)); return;
+		case idFloat: put_number<E>(out, std::bit_cast<std::uint32_t>(static_cast<float>(node.real))); return;
+		case idDouble: put_number<E>(out, std::bit_cast<std::uint64_t>(node.real)); return;
+		case idString: put_string<E>(out, node.str); return;
+		case idCompound:
+		case idList: break;
+		default:
+			// arrays can't be edited, a dirty one is a new empty array
+			put_number<E>(out, std::int32_t{0});
+			return;
+	}
+
+	const bool named = node.type == idCompound;
+	if (!named) {
+		out.push_back(node.childCount ? node.listType : idEnd);
+		put_number<E>(out, static_cast<std::int32_t>(node.childCount));
+	}
+
+	// clean siblings that were adjacent in the source go out as one copy
+	const char* run_begin = nullptr;
+	const char* run_end = nullptr;
+	for (NodeId child = node.first; child != npos; child = nodes[child].next) {
+		const Node& c = nodes[child];
+		if (!c.dirty) {
+			const std::string_view bytes = named ? c.raw : c.payload;
+			if (run_end != bytes.data()) {
+				if (run_begin)
+					out.append(run_begin, run_end);
+				run_begin = bytes.data();
+			}
+			run_end = bytes.data() + bytes.size();
+			continue;
+		}
+		if (run_begin) {
+			out.append(run_begin, run_end);
+			run_begin = run_end = nullptr;
+		}
+		writeNode(out, child, named);
+	}
+	if (run_begin)
+		out.append(run_begin, run_end);
+
+	if (named)
+		out.push_back(idEnd);
+}
+
+template <std::endian E>
+void NBTDocument<E>::serialize(std::string& out) const {
+	writeNode(out, root(), true);
+}
+
+template <std::endian E>
+std::string NBTDocument<E>::serialize() const {
+	std::string out;
+	if (!nodes[root()].dirty)
+		return std::string(nodes[root()].raw);
+	out.reserve(source.size() + 4096);
+	serialize(out);
+	return out;
+}
+
+template <std::endian E>
+bool NBTDocument<E>::save(const std::filesystem::path& path) const {
+	atomic_output output(path);
+	if (!output.is_open())
+		return false;
+	const std::string bytes = serialize();
+	output.stream().write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	output_result result{};
+	return output.commit(result);
+}
+
+template class NBT::NBTDocument<std::endian::big>;
+template class NBT::NBTDocument<std::endian::little>;
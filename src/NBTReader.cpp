@@ -0,0 +1,196 @@
+#include "NBTReader.h"
+
+using namespace NBT;
+
+namespace {
+// nesting limit so hostile files can't exhaust the stack
+constexpr int max_depth = 512;
+
+constexpr std::size_t fixed_payload_size(char type) {
+	switch (type) {
+		case idByte: return 1;
+		case idShort: return 2;
+		case idInt: return 4;
+		case idLong: return 8;
+		case idFloat: return 4;
+		case idDouble: return 8;
+		default: return 0;
+	}
+}
+}
+
+template <std::endian E>
+NBTReader<E>::NBTReader(const std::filesystem::path& path) {
+	opened = file.open(path.string());
+	data = file.view();
+}
+
+template <std::endian E>
+NBTReader<E>::NBTReader(std::string_view bytes) : data(bytes), opened(true) {}
+
+template <std::endian E>
+const char* NBTReader<E>::skipPayload(char type, const char* pos, const char* limit, int depth) {
+	if (depth > max_depth)
+		throw parse_error("nbt data is nested too deeply");
+
+	if (const std::size_t size = fixed_payload_size(type)) {
+		need(pos, size, limit);
+		return pos + size;
+	}
+
+	switch (type) {
+		case idString: {
+			const std::string_view str = readString(pos, limit);
+			return str.data() + str.size();
+		}
+		case idByteArray:
+		case idIntArray:
+		case idLongArray: {
+			need(pos, 4, limit);
+			const std::int32_t count = readNumber<std::int32_t>(pos);
+			if (count < 0)
+				throw parse_error("negative nbt array length");
+			const std::size_t element = type == idByteArray ? 1 : type == idIntArray ? 4 : 8;
+			need(pos + 4, static_cast<std::size_t>(count) * element, limit);
+			return pos + 4 + static_cast<std::size_t>(count) * element;
+		}
+		case idList: {
+			need(pos, 5, limit);
+			const char element_type = pos[0];
+			const std::int32_t count = readNumber<std::int32_t>(pos + 1);
+			pos += 5;
+			if (count <= 0)
+				return pos;
+			if (const std::size_t size = fixed_payload_size(element_type)) {
+				need(pos, static_cast<std::size_t>(count) * size, limit);
+				return pos + static_cast<std::size_t>(count) * size;
+			}
+			for (std::int32_t i = 0; i < count; ++i)
+				pos = skipPayload(element_type, pos, limit, depth + 1);
+			return pos;
+		}
+		case idCompound: {
+			while (true) {
+				need(pos, 1, limit);
+				const char child_type = *pos++;
+				if (child_type == idEnd)
+					return pos;
+				pos = skipPayload(child_type, pos + 2 + readString(pos, limit).size(), limit, depth + 1);
+			}
+		}
+		default:
+			throw parse_error("unknown nbt tag type");
+	}
+}
+
+template <std::endian E>
+std::string_view NBTReader<E>::Tag::asString() const {
+	expect(idString);
+	return readString(payloadBegin, limit);
+}
+
+template <std::endian E>
+auto NBTReader<E>::Tag::children() const -> Range<CompoundIterator> {
+	expect(idCompound);
+	return {CompoundIterator(payloadBegin, limit)};
+}
+
+template <std::endian E>
+auto NBTReader<E>::Tag::find(std::string_view child_name) const -> Tag {
+	for (const Tag& child : children()) {
+		if (child.name() == child_name)
+			return child;
+	}
+	return {};
+}
+
+template <std::endian E>
+char NBTReader<E>::Tag::listType() const {
+	expect(idList);
+	need(payloadBegin, 5, limit);
+	return payloadBegin[0];
+}
+
+template <std::endian E>
+std::int32_t NBTReader<E>::Tag::listSize() const {
+	expect(idList);
+	need(payloadBegin, 5, limit);
+	return readNumber<std::int32_t>(payloadBegin + 1);
+}
+
+template <std::endian E>
+auto NBTReader<E>::Tag::elements() const -> Range<ListIterator> {
+	return {ListIterator(listType(), listSize(), payloadBegin + 5, limit)};
+}
+
+template <std::endian E>
+std::int32_t NBTReader<E>::Tag::arraySize() const {
+	if (tagType != idByteArray && tagType != idIntArray && tagType != idLongArray)
+		throw parse_error("unexpected nbt tag type");
+	need(payloadBegin, 4, limit);
+	return readNumber<std::int32_t>(payloadBegin);
+}
+
+template <std::endian E>
+void NBTReader<E>::CompoundIterator::load(const char* at) {
+	pos = at;
+	need(at, 1, limit);
+	const char type = at[0];
+	if (type == idEnd) {
+		current = Tag();
+		return;
+	}
+	const std::string_view name = readString(at + 1, limit);
+	current = Tag(type, name, at, name.data() + name.size(), limit);
+}
+
+template <std::endian E>
+void NBTReader<E>::ServerIterator::load() {
+	current = ServerView();
+	if (it == std::default_sentinel)
+		return;
+
+	const Tag& compound = *it;
+	CompoundIterator child = compound.children().begin();
+	for (; child != std::default_sentinel; ++child) {
+		const std::string_view name = child->name();
+		if (child->type() == idString) {
+			if (name == "name")
+				current.name = child->asString();
+			else if (name == "icon")
+				current.icon = child->asString();
+			else if (name == "ip")
+				current.ip = child->asString();
+		} else if (child->type() == idByte && name == "acceptTextures") {
+			current.acceptTextures = child->asByte() != 0;
+		}
+	}
+	current.raw = {compound.payload(), static_cast<std::size_t>(child.position() + 1 - compound.payload())};
+}
+
+template <std::endian E>
+auto NBTReader<E>::root() const -> Tag {
+	const char* begin = data.data();
+	const char* limit = begin + data.size();
+	need(begin, 1, limit);
+	if (begin[0] != idCompound)
+		throw parse_error("nbt data doesn't start with a compound");
+	const std::string_view name = readString(begin + 1, limit);
+	return Tag(idCompound, name, begin, name.data() + name.size(), limit);
+}
+
+template <std::endian E>
+auto NBTReader<E>::serverList() const -> Tag {
+	const Tag list = root().find("servers");
+	if (list.type() != idList || (list.listType() != idCompound && list.listSize() > 0))
+		throw parse_error("nbt data has no 'servers' list of compounds");
+	return list;
+}
+
+template <std::endian E>
+auto NBTReader<E>::servers() const -> Range<ServerIterator> {
+	return {ServerIterator(serverList().elements().begin())};
+}
+
+template class NBT::NBTReader<std::endian::big>;
+template class NBT::NBTReader<std::endian::little>;
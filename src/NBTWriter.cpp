@@ -56,14 +56,17 @@ bool NBT::isSysBE()
     return false;
 }
 
-NBTWriter::NBTWriter(const char*path, bool stdout_output)
+template <std::endian E>
+NBTWriter<E>::NBTWriter(const char*path, bool stdout_output)
 {
     Stdout_output = stdout_output;
     allowEmergencyFill=true;
-    isBE=isSysBE();
     ByteCount=0;
+    File=NULL;
+    Stream=NULL;
     if (!Stdout_output) {
     	File=new std::fstream(path,std::ios::out|std::ios::binary);
+    	Stream=File;
     }
         char temp[3]={10,0,0};
         this->write(temp,3);ByteCount+=3;
@@ -78,12 +81,35 @@ NBTWriter::NBTWriter(const char*path, bool stdout_output)
 
 }
 
-NBTWriter::NBTWriter()
+template <std::endian E>
+NBTWriter<E>::NBTWriter(std::ostream*stream)
 {
+    Stdout_output=false;
     allowEmergencyFill=true;
-    isBE=isSysBE();
     ByteCount=0;
+    File=NULL;
+    Stream=stream;
+        char temp[3]={10,0,0};
+        this->write(temp,3);ByteCount+=3;
+    isOpen=true;
+    for(top=0;top<TwinStackSize;top++)
+    {
+        CLA[top]=114;
+        Size[top]=114514;
+    }
+
+    top=-1;
+
+}
+
+template <std::endian E>
+NBTWriter<E>::NBTWriter()
+{
+    allowEmergencyFill=true;
+    ByteCount=0;
+    Stdout_output=false;
     File=NULL;//new fstream(path,ios::out|ios::binary);
+    Stream=NULL;
         //char temp[3]={10,0,0};
         //this->write(temp,3);ByteCount+=3;
     isOpen=false;
@@ -97,84 +123,100 @@ NBTWriter::NBTWriter()
 
 }
 
+template <std::endian E>
 template<typename T>
-void NBTWriter::write(T* data, size_t len) {
+void NBTWriter<E>::write(T* data, size_t len) {
 	if (Stdout_output) {
 		std::fwrite(data, sizeof(T), len, stdout);		
 	} else {
-		File->write(reinterpret_cast<const char*>(data), sizeof(T)*len);
+		Stream->write(reinterpret_cast<const char*>(data), sizeof(T)*len);
 	}
 }
 
-void NBTWriter::open(const char*path)
+template <std::endian E>
+void NBTWriter<E>::open(const char*path)
 {
     if(isOpen)
     {
         return;
     }
     File=new std::fstream(path,std::ios::out|std::ios::binary);
+    Stream=File;
     char temp[3]={10,0,0};
     this->write(temp,3);ByteCount+=3;
     isOpen=true;
 }
 
 
-NBTWriter::~NBTWriter()
+template <std::endian E>
+NBTWriter<E>::~NBTWriter()
 {
     if(isOpen)close();
     delete File;
     return;
 }
 
-unsigned long long NBTWriter::close()
+template <std::endian E>
+unsigned long long NBTWriter<E>::close()
 {
     if(isOpen)
     {
         if(!isEmpty())emergencyFill();
 
     this->write(&idEnd,1);ByteCount+=1;
-    if (!Stdout_output)
+    if (File)
     	File->close();
+    else if (Stream)
+    	Stream->flush();
+    isOpen=false;
     }
     return ByteCount;
 }
 
-bool NBTWriter::isEmpty()
+template <std::endian E>
+bool NBTWriter<E>::isEmpty()
 {
     return (top==-1);
 }
 
-bool NBTWriter::isFull()
+template <std::endian E>
+bool NBTWriter<E>::isFull()
 {
     return top>=TwinStackSize;
 }
 
-bool NBTWriter::isListFinished()
+template <std::endian E>
+bool NBTWriter<E>::isListFinished()
 {
     return (Size[top]<=0);
 }
 
-char NBTWriter::readType()
+template <std::endian E>
+char NBTWriter<E>::readType()
 {
     return CLA[top];
 }
 
-bool NBTWriter::isInCompound()
+template <std::endian E>
+bool NBTWriter<E>::isInCompound()
 {
     return isEmpty()||(readType()==0);
 }
 
-bool NBTWriter::isInList()
+template <std::endian E>
+bool NBTWriter<E>::isInList()
 {
     return !isInCompound();
 }
 
-bool NBTWriter::typeMatch(char typeId)
+template <std::endian E>
+bool NBTWriter<E>::typeMatch(char typeId)
 {
     return(readType()==typeId);
 }
 
-void NBTWriter::endList()
+template <std::endian E>
+void NBTWriter<E>::endList()
 {
     if(isInList()&&isListFinished())
     {
@@ -184,7 +226,8 @@ void NBTWriter::endList()
     return;
 }
 
-void NBTWriter::pop()
+template <std::endian E>
+void NBTWriter<E>::pop()
 {
     if(!isEmpty()){
     top--;
@@ -194,7 +237,8 @@ void NBTWriter::pop()
     return;
 }
 
-void NBTWriter::push(char typeId,int size)
+template <std::endian E>
+void NBTWriter<E>::push(char typeId,int size)
 {
     if(!isFull())
     {
@@ -207,7 +251,8 @@ void NBTWriter::push(char typeId,int size)
     return;
 }
 
-void NBTWriter:: elementWritten()
+template <std::endian E>
+void NBTWriter<E>:: elementWritten()
 {
     if(isInList()&&!isListFinished())
     Size[top]--;
@@ -216,17 +261,19 @@ void NBTWriter:: elementWritten()
     return;
 }
 
-int NBTWriter::writeEnd()
+template <std::endian E>
+int NBTWriter<E>::writeEnd()
 {
     this->write(&idEnd,1);
     return 1;
 }
 
+template <std::endian E>
 template <typename T>
-int NBTWriter::writeSingleTag(char typeId,const char*Name,T value)
+int NBTWriter<E>::writeSingleTag(char typeId,const char*Name,T value)
 {
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
-    if(!isBE)
+    if constexpr(needSwap)
     {
         IE2BE(writeNameL);IE2BE(value);//value不需要读取，只需要写入
     }
@@ -252,10 +299,11 @@ int NBTWriter::writeSingleTag(char typeId,const char*Name,T value)
 
 
 
-int NBTWriter::writeLongDirectly(const char*Name,long long value)
+template <std::endian E>
+int NBTWriter<E>::writeLongDirectly(const char*Name,long long value)
 {
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
-    if(!isBE)
+    if constexpr(needSwap)
     {
         IE2BE(writeNameL);//value不需要读取，只需要写入
     }
@@ -280,11 +328,12 @@ int NBTWriter::writeLongDirectly(const char*Name,long long value)
 }
 
 
-int NBTWriter::writeCompound(const char*Name)
+template <std::endian E>
+int NBTWriter<E>::writeCompound(const char*Name)
 {
     if (!isOpen)return 0;
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
-    if(!isBE)
+    if constexpr(needSwap)
     {
         IE2BE(writeNameL);
     }
@@ -311,7 +360,8 @@ int NBTWriter::writeCompound(const char*Name)
 
 }
 
-int NBTWriter::endCompound()
+template <std::endian E>
+int NBTWriter<E>::endCompound()
 {
     if(!isOpen)return 0;
     int ThisCount=0;
@@ -326,11 +376,12 @@ int NBTWriter::endCompound()
     return ThisCount;
 }
 
-int NBTWriter::writeListHead(const char*Name,char TypeId,int listSize)
+template <std::endian E>
+int NBTWriter<E>::writeListHead(const char*Name,char TypeId,int listSize)
 {
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
     int writeListSize=listSize;//listSize->readListSize
-    if(!isBE){IE2BE(writeNameL);IE2BE(writeListSize);}
+    if constexpr(needSwap){IE2BE(writeNameL);IE2BE(writeListSize);}
 
     if(isInCompound())
     {
@@ -358,41 +409,48 @@ int NBTWriter::writeListHead(const char*Name,char TypeId,int listSize)
 
 }
 
-int NBTWriter::writeByte(const char*Name,char value)
+template <std::endian E>
+int NBTWriter<E>::writeByte(const char*Name,char value)
 {
     return writeSingleTag(idByte,Name,value);
 }
 
-int NBTWriter::writeShort(const char*Name,short value)
+template <std::endian E>
+int NBTWriter<E>::writeShort(const char*Name,short value)
 {
     return writeSingleTag(idShort,Name,value);
 }
 
-int NBTWriter::writeInt(const char*Name,int value)
+template <std::endian E>
+int NBTWriter<E>::writeInt(const char*Name,int value)
 {
     return writeSingleTag(idInt,Name,value);
 }
 
-int NBTWriter::writeLong(const char*Name,long long value)
+template <std::endian E>
+int NBTWriter<E>::writeLong(const char*Name,long long value)
 {
     return writeSingleTag(idLong,Name,value);
 }
 
-int NBTWriter::writeFloat(const char*Name,float value)
+template <std::endian E>
+int NBTWriter<E>::writeFloat(const char*Name,float value)
 {
     return writeSingleTag(idFloat,Name,value);
 }
 
-int NBTWriter::writeDouble(const char*Name,double value)
+template <std::endian E>
+int NBTWriter<E>::writeDouble(const char*Name,double value)
 {
     return writeSingleTag(idDouble,Name,value);
 }
 
-int NBTWriter::writeLongArrayHead(const char*Name,int arraySize)
+template <std::endian E>
+int NBTWriter<E>::writeLongArrayHead(const char*Name,int arraySize)
 {
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
     int writeArraySize=arraySize;//arraSize->readArraySize
-    if(!isBE){IE2BE(writeNameL);IE2BE(writeArraySize);}
+    if constexpr(needSwap){IE2BE(writeNameL);IE2BE(writeArraySize);}
 
     if(isInCompound())
     {
@@ -419,11 +477,12 @@ int NBTWriter::writeLongArrayHead(const char*Name,int arraySize)
     return ThisCount;
 }
 
-int NBTWriter::writeByteArrayHead(const char*Name,int arraySize)
+template <std::endian E>
+int NBTWriter<E>::writeByteArrayHead(const char*Name,int arraySize)
 {
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
     int writeArraySize=arraySize;//arraSize->readArraySize
-    if(!isBE){IE2BE(writeNameL);IE2BE(writeArraySize);}
+    if constexpr(needSwap){IE2BE(writeNameL);IE2BE(writeArraySize);}
 
     if(isInCompound())
     {
@@ -450,11 +509,12 @@ int NBTWriter::writeByteArrayHead(const char*Name,int arraySize)
     return ThisCount;
 }
 
-int NBTWriter::writeIntArrayHead(const char*Name,int arraySize)
+template <std::endian E>
+int NBTWriter<E>::writeIntArrayHead(const char*Name,int arraySize)
 {
     int ThisCount=0;short realNameL=strlen(Name),writeNameL=realNameL;
     int writeArraySize=arraySize;//arraySize->readArraySize
-    if(!isBE){IE2BE(writeNameL);IE2BE(writeArraySize);}
+    if constexpr(needSwap){IE2BE(writeNameL);IE2BE(writeArraySize);}
 
     if(isInCompound())
     {
@@ -481,12 +541,13 @@ int NBTWriter::writeIntArrayHead(const char*Name,int arraySize)
     return ThisCount;
 }
 
-int NBTWriter::writeString(const char*Name,const char*value)
+template <std::endian E>
+int NBTWriter<E>::writeString(const char*Name,const char*value)
 {
     int ThisCount=0;
     short realNameL=strlen(Name),writeNameL=realNameL;
     short realValL=strlen(value),writeValL=realValL;
-    if(!isBE){IE2BE(writeNameL);IE2BE(writeValL);}
+    if constexpr(needSwap){IE2BE(writeNameL);IE2BE(writeValL);}
 
     if(isInCompound())
     {
@@ -511,12 +572,14 @@ int NBTWriter::writeString(const char*Name,const char*value)
     return ThisCount;
 }
 
-char NBTWriter::CurrentType()
+template <std::endian E>
+char NBTWriter<E>::CurrentType()
 {
     return readType();
 }
 
-int NBTWriter::emergencyFill()
+template <std::endian E>
+int NBTWriter<E>::emergencyFill()
 {
     if(!allowEmergencyFill)return 0;
     if(isEmpty())return 0;
@@ -571,9 +634,13 @@ int NBTWriter::emergencyFill()
     ThisCount+=writeString("TokiNoBug'sWarning","There's sth wrong with ur NBTWriter, the file format is completed automatically instead of manually.");
     return ThisCount;
 }
-unsigned long long NBTWriter::getByteCount()
+template <std::endian E>
+unsigned long long NBTWriter<E>::getByteCount()
 {
     return ByteCount;
 }
 
+template class NBT::NBTWriter<std::endian::big>;
+template class NBT::NBTWriter<std::endian::little>;
+
 #endif
@@ -0,0 +1,363 @@
+#include "address.hpp"
+#include "parse.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+char lower(char c) {
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+int hex_value(char c) {
+	if (is_digit(c))
+		return c - '0';
+	c = lower(c);
+	return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+bool parse_port(std::string_view text, std::uint16_t& port) {
+	if (text.empty() || text.size() > 5)
+		return false;
+	std::uint32_t value = 0;
+	for (const char c : text) {
+		if (!is_digit(c))
+			return false;
+		value = value * 10 + static_cast<std::uint32_t>(c - '0');
+	}
+	if (value == 0 || value > 65535)
+		return false;
+	port = static_cast<std::uint16_t>(value);
+	return true;
+}
+
+// labels of letters, digits, '-' and '_', 1 to 63 long, not starting or ending with '-'
+bool valid_host(std::string_view host) {
+	if (host.empty() || host.size() > 253)
+		return false;
+	std::size_t label = 0;
+	for (std::size_t i = 0; i <= host.size(); ++i) {
+		if (i == host.size() || host[i] == '.') {
+			if (label == 0 || label > 63 || host[i - 1] == '-' || host[i - label] == '-')
+				return false;
+			label = 0;
+			continue;
+		}
+		const char c = lower(host[i]);
+		if (!(c >= 'a' && c <= 'z') && !is_digit(c) && c != '-' && c != '_')
+			return false;
+		++label;
+	}
+	return true;
+}
+
+// fields split at the bits of dots, each 1 to 3 digits. digits holds the digit values
+bool combine_octets(const unsigned char* digits, unsigned dots, std::size_t size, std::uint32_t& value) {
+	std::uint32_t result = 0;
+	unsigned ends = dots | 1u << size;
+	std::size_t start = 0;
+	for (int part = 0; part < 4; ++part) {
+		const std::size_t end = static_cast<std::size_t>(std::countr_zero(ends));
+		const std::size_t len = end - start;
+		if (len == 0 || len > 3)
+			return false;
+		std::uint32_t octet = 0;
+		for (std::size_t i = start; i < end; ++i)
+			octet = octet * 10 + digits[i];
+		if (octet > 255)
+			return false;
+		result = result << 8 | octet;
+		start = end + 1;
+		ends &= ends - 1;
+	}
+	value = result;
+	return true;
+}
+
+void append_hex(std::string& out, std::uint16_t group) {
+	constexpr char digits[] = "0123456789abcdef";
+	bool started = false;
+	for (int shift = 12; shift >= 0; shift -= 4) {
+		const int nibble = group >> shift & 0xf;
+		if (nibble || started || shift == 0) {
+			out += digits[nibble];
+			started = true;
+		}
+	}
+}
+
+void append_ipv4(std::string& out, std::uint32_t value) {
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out += std::to_string(value >> shift & 0xff);
+		if (shift)
+			out += '.';
+	}
+}
+
+std::string format_ipv6(const std::array<std::uint8_t, 16>& bytes) {
+	std::array<std::uint16_t, 8> groups{};
+	for (std::size_t i = 0; i < 8; ++i)
+		groups[i] = static_cast<std::uint16_t>(bytes[2 * i] << 8 | bytes[2 * i + 1]);
+
+	std::string out;
+	// IPv4 mapped addresses keep the dotted quad
+	if (std::all_of(groups.begin(), groups.begin() + 5, [](std::uint16_t g) { return g == 0; }) && groups[5] == 0xffff) {
+		out = "::ffff:";
+		append_ipv4(out, static_cast<std::uint32_t>(groups[6]) << 16 | groups[7]);
+		return out;
+	}
+
+	// the longest run of at least two zero groups becomes "::", the first one on a tie
+	std::size_t best = 8, best_len = 1;
+	for (std::size_t i = 0; i < 8;) {
+		if (groups[i] != 0) {
+			++i;
+			continue;
+		}
+		std::size_t j = i;
+		while (j < 8 && groups[j] == 0)
+			++j;
+		if (j - i > best_len) {
+			best = i;
+			best_len = j - i;
+		}
+		i = j;
+	}
+
+	for (std::size_t i = 0; i < 8; ++i) {
+		if (i == best) {
+			out += "::";
+			i += best_len - 1;
+			continue;
+		}
+		if (i && i != best + best_len)
+			out += ':';
+		append_hex(out, groups[i]);
+	}
+	return out;
+}
+}
+
+bool parse_ipv4(std::string_view text, std::uint32_t& value) {
+	if (text.size() < 7 || text.size() > 15)
+		return false;
+	const unsigned used = (1u << text.size()) - 1;
+	alignas(16) unsigned char digits[16];
+
+#ifdef __SSE2__
+	alignas(16) char padded[16] = {};
+	std::memcpy(padded, text.data(), text.size());
+	const __m128i chunk = _mm_load_si128(reinterpret_cast<const __m128i*>(padded));
+	// bytes above '0' + 127 wrap around to negative and fail the range check too
+	const __m128i values = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+	const __m128i digit_mask = _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(-1)), _mm_cmplt_epi8(values, _mm_set1_epi8(10)));
+	const __m128i dot_mask = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('.'));
+	const unsigned digit_bits = static_cast<unsigned>(_mm_movemask_epi8(digit_mask)) & used;
+	const unsigned dots = static_cast<unsigned>(_mm_movemask_epi8(dot_mask)) & used;
+	_mm_store_si128(reinterpret_cast<__m128i*>(digits), values);
+#else
+	unsigned digit_bits = 0;
+	unsigned dots = 0;
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		digits[i] = static_cast<unsigned char>(text[i] - '0');
+		digit_bits |= static_cast<unsigned>(is_digit(text[i])) << i;
+		dots |= static_cast<unsigned>(text[i] == '.') << i;
+	}
+#endif
+
+	if ((digit_bits | dots) != used || std::popcount(dots) != 3)
+		return false;
+	return combine_octets(digits, dots, text.size(), value);
+}
+
+bool parse_ipv6(std::string_view text, std::array<std::uint8_t, 16>& value) {
+	std::array<std::uint16_t, 8> groups{};
+	std::size_t count = 0;
+	std::size_t gap = 8; // where "::" was, 8 when there's none
+
+	if (text.starts_with("::")) {
+		gap = 0;
+		text.remove_prefix(2);
+	} else if (text.starts_with(':')) {
+		return false;
+	}
+
+	while (!text.empty()) {
+		const std::size_t end = text.find(':');
+		const std::string_view part = text.substr(0, end);
+		if (part.find('.') != std::string_view::npos) {
+			// a dotted quad may only end the address
+			std::uint32_t ipv4 = 0;
+			if (end != std::string_view::npos || count > 6 || !parse_ipv4(part, ipv4))
+				return false;
+			groups[count++] = static_cast<std::uint16_t>(ipv4 >> 16);
+			groups[count++] = static_cast<std::uint16_t>(ipv4);
+			break;
+		}
+		if (part.empty() || part.size() > 4 || count == 8)
+			return false;
+		std::uint16_t group = 0;
+		for (const char c : part) {
+			const int digit = hex_value(c);
+			if (digit < 0)
+				return false;
+			group = static_cast<std::uint16_t>(group << 4 | digit);
+		}
+		groups[count++] = group;
+		if (end == std::string_view::npos)
+			break;
+
+		text.remove_prefix(end + 1);
+		if (text.starts_with(':')) {
+			if (gap != 8)
+				return false;
+			gap = count;
+			text.remove_prefix(1);
+		} else if (text.empty()) {
+			return false;
+		}
+	}
+
+	if (gap == 8 ? count != 8 : count > 7)
+		return false;
+
+	std::array<std::uint16_t, 8> expanded{};
+	std::copy_n(groups.begin(), gap == 8 ? count : gap, expanded.begin());
+	if (gap != 8)
+		std::copy(groups.begin() + gap, groups.begin() + count, expanded.end() - (count - gap));
+	for (std::size_t i = 0; i < 8; ++i) {
+		value[2 * i] = static_cast<std::uint8_t>(expanded[i] >> 8);
+		value[2 * i + 1] = static_cast<std::uint8_t>(expanded[i]);
+	}
+	return true;
+}
+
+address_error parse_address(std::string_view text, server_address& address, std::string_view* host) {
+	text = trim_address(text);
+	if (text.empty())
+		return address_error::empty;
+
+	server_address parsed{};
+	if (text.front() == '[') {
+		const std::size_t close = text.find(']');
+		if (close == std::string_view::npos || !parse_ipv6(text.substr(1, close - 1), parsed.ipv6))
+			return address_error::ipv6;
+		const std::string_view rest = text.substr(close + 1);
+		if (!rest.empty() && (rest.front() != ':' || !parse_port(rest.substr(1), parsed.port)))
+			return address_error::port;
+		parsed.kind = address_kind::ipv6;
+		address = parsed;
+		return address_error::none;
+	}
+
+	const std::size_t colon = text.find(':');
+	if (colon != std::string_view::npos && text.find(':', colon + 1) != std::string_view::npos) {
+		// bare IPv6 can't have a port
+		if (!parse_ipv6(text, parsed.ipv6))
+			return address_error::ipv6;
+		parsed.kind = address_kind::ipv6;
+		address = parsed;
+		return address_error::none;
+	}
+
+	std::string_view name = text.substr(0, colon);
+	if (colon != std::string_view::npos && !parse_port(text.substr(colon + 1), parsed.port))
+		return address_error::port;
+
+	if (parse_ipv4(name, parsed.ipv4)) {
+		parsed.kind = address_kind::ipv4;
+		address = parsed;
+		return address_error::none;
+	}
+	// nothing but numbers is a broken IPv4 address rather than a host name
+	if (std::all_of(name.begin(), name.end(), [](char c) { return is_digit(c) || c == '.'; }))
+		return address_error::ipv4;
+
+	if (name.ends_with('.'))
+		name.remove_suffix(1);
+	if (!valid_host(name))
+		return address_error::host;
+	parsed.kind = address_kind::host;
+	address = parsed;
+	if (host)
+		*host = name;
+	return address_error::none;
+}
+
+std::string format_address(const server_address& address, std::string_view host) {
+	std::string out;
+	switch (address.kind) {
+	case address_kind::ipv4:
+		append_ipv4(out, address.ipv4);
+		break;
+	case address_kind::ipv6:
+		out = format_ipv6(address.ipv6);
+		if (address.port != default_port)
+			out = '[' + out + ']';
+		break;
+	case address_kind::host:
+		out.resize(host.size());
+		std::transform(host.begin(), host.end(), out.begin(), lower);
+		break;
+	case address_kind::none:
+		return out;
+	}
+	if (address.port != default_port)
+		out += ':' + std::to_string(address.port);
+	return out;
+}
+
+std::string_view address_error_name(address_error error) {
+	switch (error) {
+	case address_error::none: return "valid";
+	case address_error::empty: return "empty";
+	case address_error::ipv4: return "bad ipv4";
+	case address_error::ipv6: return "bad ipv6";
+	case address_error::port: return "bad port";
+	case address_error::host: return "bad host name";
+	}
+	return "unknown";
+}
+
+std::string_view trim_address(std::string_view text) {
+	const std::size_t first = text.find_first_not_of(" \t\r\n");
+	if (first == std::string_view::npos)
+		return {};
+	return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+canonicalize_stats canonicalize_servers(std::vector<nbtserver>& servers) {
+	canonicalize_stats stats{};
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		nbtserver& server = servers[i];
+		std::string_view host{};
+		const address_error error = parse_address(server.ip, server.address, &host);
+		if (error != address_error::none) {
+			++stats.rejected;
+			++stats.errors[static_cast<std::size_t>(error)];
+			if (stats.examples.size() < canonicalize_stats::max_examples)
+				stats.examples.push_back(server.ip);
+			continue;
+		}
+
+		std::string canonical = format_address(server.address, host);
+		if (canonical != server.ip) {
+			server.ip = std::move(canonical);
+			++stats.changed;
+		}
+		if (kept != i)
+			servers[kept] = std::move(server);
+		++kept;
+	}
+	servers.resize(kept);
+	return stats;
+}
@@ -0,0 +1,158 @@
+#include "append.hpp"
+#include "NBTReader.h"
+#include "mapped_file.hpp"
+#include "output.hpp"
+#include "static_servers.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+namespace {
+// the tag every server compound written by enbt ends with, before its value and idEnd
+template <std::endian E>
+constexpr auto accept_textures_header() {
+	std::array<std::byte, 1 + 2 + 14> header{};
+	auto out = header.begin();
+	*out++ = static_cast<std::byte>(NBT::idByte);
+	static_nbt::put_str<E>(out, "acceptTextures");
+	return header;
+}
+
+template <std::endian E>
+constexpr auto servers_dat_head(std::uint32_t count) {
+	std::array<std::byte, servers_dat_head_size> head{};
+	encode_servers_dat_head<E>(head.begin(), count);
+	return head;
+}
+
+// The list count sits in the last 4 bytes of the head
+constexpr std::size_t count_offset = servers_dat_head_size - 4;
+
+// enbt closes the root compound once, older versions did it twice
+constexpr std::size_t max_end_tags = 2;
+
+template <std::endian E>
+std::uint16_t get_u16(std::string_view bytes, std::size_t at) {
+	const auto first = static_cast<std::uint8_t>(bytes[at]);
+	const auto second = static_cast<std::uint8_t>(bytes[at + 1]);
+	return static_cast<std::uint16_t>(E == std::endian::big ? first << 8 | second : second << 8 | first);
+}
+
+// Where the string tag called name that starts at at ends, or npos when there isn't one
+template <std::endian E>
+std::size_t skip_string_tag(std::string_view file, std::size_t at, std::string_view name) {
+	const std::size_t header = 1 + 2 + name.size() + 2;
+	if (file.size() - at < header || file[at] != NBT::idString || get_u16<E>(file, at + 1) != name.size() || file.substr(at + 3, name.size()) != name)
+		return std::string_view::npos;
+	const std::size_t end = at + header + get_u16<E>(file, at + 3 + name.size());
+	return end <= file.size() ? end : std::string_view::npos;
+}
+
+// Where the server compound that starts at at ends, or npos when it isn't one the way
+// encode_server_nbt() writes it. Only the tag headers are read, the values are skipped
+template <std::endian E>
+std::size_t skip_server(std::string_view file, std::size_t at) {
+	for (const std::string_view name : { "name", "icon", "ip" }) {
+		at = skip_string_tag<E>(file, at, name);
+		if (at == std::string_view::npos)
+			return at;
+	}
+	constexpr auto marker_bytes = accept_textures_header<E>();
+	const std::string_view marker(reinterpret_cast<const char*>(marker_bytes.data()), marker_bytes.size());
+	if (file.size() - at < marker.size() + 2 || file.substr(at, marker.size()) != marker)
+		return std::string_view::npos;
+	at += marker.size();
+	if ((file[at] != 0 && file[at] != 1) || file[at + 1] != NBT::idEnd)
+		return std::string_view::npos;
+	return at + 2;
+}
+
+template <std::endian E>
+bool append_servers_in_place(const std::filesystem::path& dat_path, const std::vector<nbtserver>& servers) {
+	const mapped_file mapped(dat_path.string());
+	if (!mapped.is_open() || mapped.size() < servers_dat_head_size + 1)
+		return false;
+	const std::string_view file = mapped.view();
+
+	// the head has to match byte for byte, apart from the count
+	std::array<std::byte, servers_dat_head_size> head{};
+	std::memcpy(head.data(), file.data(), head.size());
+	std::uint32_t count = 0;
+	for (std::size_t i = 0; i < 4; ++i) {
+		const auto byte = std::to_integer<std::uint32_t>(head[count_offset + i]);
+		count |= E == std::endian::big ? byte << (8 * (3 - i)) : byte << (8 * i);
+	}
+	if (head != servers_dat_head<E>(count))
+		return false;
+	if (servers.size() > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()) - count)
+		return false;
+
+	// walk every compound to where the list ends. After it only the end tags closing the
+	// root may follow: another root tag would end up inside the appended compounds
+	std::size_t list_end = servers_dat_head_size;
+	for (std::uint32_t i = 0; i < count; ++i) {
+		list_end = skip_server<E>(file, list_end);
+		if (list_end == std::string_view::npos)
+			return false;
+	}
+	const std::string_view tail = file.substr(list_end);
+	if (tail.empty() || tail.size() > max_end_tags || std::any_of(tail.begin(), tail.end(), [](char c) { return c != NBT::idEnd; }))
+		return false;
+
+	std::vector<std::byte> appended;
+	for (const nbtserver& server : servers) {
+		const static_server view{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures };
+		const std::size_t at = appended.size();
+		appended.resize(at + server_nbt_size(view));
+		encode_server_nbt<E>(appended.begin() + at, view);
+	}
+	encode_servers_dat_tail(std::back_inserter(appended));
+
+	// a copy of the list so far (shared extents where the filesystem can), the new
+	// compounds after it and the new count, renamed over the old file once complete
+	atomic_output output(dat_path);
+	if (!output.is_open() || !output.start_from(dat_path, file.substr(0, list_end)))
+		return false;
+	output.stream().write(reinterpret_cast<const char*>(appended.data()), static_cast<std::streamsize>(appended.size()));
+	const auto new_head = servers_dat_head<E>(count + static_cast<std::uint32_t>(servers.size()));
+	if (!output.patch(count_offset, std::string_view(reinterpret_cast<const char*>(new_head.data() + count_offset), 4)))
+		return false;
+	output_result result{};
+	return output.commit(result);
+}
+
+template <std::endian E>
+bool read_servers_dat(const std::filesystem::path& dat_path, std::vector<nbtserver>& servers) {
+	NBT::NBTReader<E> reader(dat_path);
+	if (!reader.isOpen())
+		return false;
+	try {
+		servers.reserve(servers.size() + static_cast<std::size_t>(std::max(reader.serverCount(), 0)));
+		for (const auto& server : reader.servers()) {
+			servers.emplace_back(nbtserver{
+				.icon = std::string(server.icon),
+				.ip = std::string(server.ip),
+				.name = std::string(server.name),
+				.accept_textures = server.acceptTextures
+			});
+		}
+	} catch (const NBT::parse_error&) {
+		return false;
+	}
+	return true;
+}
+}
+
+bool append_servers_in_place(const std::filesystem::path& dat_path, const std::vector<nbtserver>& servers, std::endian endian) {
+	if (endian == std::endian::little)
+		return append_servers_in_place<std::endian::little>(dat_path, servers);
+	return append_servers_in_place<std::endian::big>(dat_path, servers);
+}
+
+bool read_servers_dat(const std::filesystem::path& dat_path, std::vector<nbtserver>& servers, std::endian endian) {
+	if (endian == std::endian::little)
+		return read_servers_dat<std::endian::little>(dat_path, servers);
+	return read_servers_dat<std::endian::big>(dat_path, servers);
+}
@@ -0,0 +1,108 @@
+#include "blocklist.hpp"
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char cache_magic[8] = {'E', 'N', 'B', 'T', 'C', 'I', 'D', '\x02'};
+
+// Sorts and joins overlapping and touching intervals
+template <typename T>
+void merge_intervals(std::vector<interval_table::interval<T>>& intervals, T max) {
+	std::sort(intervals.begin(), intervals.end(), [](const auto& a, const auto& b) {
+		return a.start < b.start || (a.start == b.start && a.end < b.end);
+	});
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < intervals.size(); ++i) {
+		if (kept && (intervals[kept - 1].end == max || intervals[i].start <= intervals[kept - 1].end
+			|| intervals[i].start == interval_table::successor(intervals[kept - 1].end))) {
+			intervals[kept - 1].end = std::max(intervals[kept - 1].end, intervals[i].end);
+			continue;
+		}
+		intervals[kept++] = intervals[i];
+	}
+	intervals.resize(kept);
+}
+}
+
+cidr_blocklist::cidr_blocklist(const fs::path& path) {
+	interval_table::source_stamp stamp{};
+	if (!interval_table::stamp_of(path, stamp)) {
+		problem = "can't read " + path.string();
+		return;
+	}
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	std::string_view extra;
+	if (table.load(cache_path, cache_magic, stamp, extra)) {
+		opened = from_cache = true;
+		return;
+	}
+
+	const mapped_file text(path.string());
+	if (!text.is_open()) {
+		problem = "can't read " + path.string();
+		return;
+	}
+	if (!compile(text.view()))
+		return;
+	table.save(cache_path, cache_magic, stamp, {});
+	opened = true;
+}
+
+bool cidr_blocklist::compile(std::string_view text) {
+	using u128 = interval_table::u128;
+	std::vector<interval_table::interval<std::uint32_t>> v4;
+	std::vector<interval_table::interval<u128>> v6;
+
+	std::size_t line_number = 0;
+	while (!text.empty()) {
+		++line_number;
+		const std::size_t newline = text.find('\n');
+		std::string_view line = text.substr(0, newline);
+		text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+		line = trim_address(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+
+		interval_table::interval<std::uint32_t> range_v4{};
+		interval_table::interval<u128> range_v6{};
+		bool is_v4 = false;
+		const interval_table::cidr_error error = interval_table::parse_cidr(line, range_v4, range_v6, is_v4);
+		if (error != interval_table::cidr_error::none) {
+			const char* what = error == interval_table::cidr_error::address ? "invalid address" : "invalid prefix length";
+			problem = "line " + std::to_string(line_number) + ": " + what + " '" + std::string(line) + '\'';
+			return false;
+		}
+		if (is_v4)
+			v4.push_back(range_v4);
+		else
+			v6.push_back(range_v6);
+	}
+
+	merge_intervals(v4, ~std::uint32_t{0});
+	merge_intervals(v6, u128{ ~std::uint64_t{0}, ~std::uint64_t{0} });
+	table.assign(v4, v6, false);
+	return true;
+}
+
+bool cidr_blocklist::contains(const server_address& address) const {
+	return table.find(address) != interval_table::npos;
+}
+
+std::size_t cidr_blocklist::exclude(std::vector<nbtserver>& servers) const {
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		server_address address = servers[i].address;
+		if (address.kind == address_kind::none && parse_address(servers[i].ip, address) != address_error::none)
+			address.kind = address_kind::none;
+		if (contains(address))
+			continue;
+		if (kept != i)
+			servers[kept] = std::move(servers[i]);
+		++kept;
+	}
+	const std::size_t dropped = servers.size() - kept;
+	servers.resize(kept);
+	return dropped;
+}
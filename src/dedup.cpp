@@ -0,0 +1,169 @@
+#include "dedup.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr std::uint32_t empty_slot = std::numeric_limits<std::uint32_t>::max();
+constexpr std::uint32_t duplicated_bit = 1u << 31;
+constexpr std::uint64_t hashed_bit = 1ull << 63;
+
+char lower(char c) {
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::uint64_t hash_text(std::string_view text, std::uint16_t port) {
+	xxh64 hasher(port);
+	char lowered[64];
+	while (!text.empty()) {
+		const std::size_t n = std::min(text.size(), sizeof(lowered));
+		std::transform(text.begin(), text.begin() + n, lowered, lower);
+		hasher.update(lowered, n);
+		text.remove_prefix(n);
+	}
+	return hasher.digest() | hashed_bit;
+}
+
+std::uint64_t mix(std::uint64_t key) {
+	// murmur3 finalizer, packed addresses are far from uniform in the low bits
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	return key ^ key >> 33;
+}
+}
+
+std::uint64_t address_key(const server_address& address, std::string_view host) {
+	switch (address.kind) {
+	case address_kind::ipv4:
+		return static_cast<std::uint64_t>(address.ipv4) << 16 | address.port;
+	case address_kind::ipv6:
+		return hash_bytes(address.ipv6.data(), address.ipv6.size(), address.port) | hashed_bit;
+	case address_kind::host:
+		return hash_text(host, address.port);
+	case address_kind::none:
+		break;
+	}
+	return 0;
+}
+
+std::uint64_t address_key(std::string_view ip) {
+	server_address address{};
+	std::string_view host{};
+	if (parse_address(ip, address, &host) != address_error::none)
+		return hash_text(trim_address(ip), 0);
+	return address_key(address, host);
+}
+
+address_set::address_set(const std::vector<nbtserver>& servers) : servers(servers), keys(16), indices(16, empty_slot) {}
+
+std::uint64_t address_set::key_of(std::size_t index) {
+	const std::string_view ip = servers[index].ip;
+	// canonicalized servers already carry their binary address
+	server_address address = servers[index].address;
+	std::string_view host{};
+	pending = { .index = static_cast<std::uint32_t>(index), .start = 0, .size = 0, .port = 0, .kind = address_kind::none };
+	if (address.kind != address_kind::ipv4 && address.kind != address_kind::ipv6 && parse_address(ip, address, &host) != address_error::none) {
+		const std::string_view text = trim_address(ip);
+		pending.start = static_cast<std::uint32_t>(text.data() - ip.data());
+		pending.size = static_cast<std::uint32_t>(text.size());
+		return hash_text(text, 0);
+	}
+	pending.kind = address.kind;
+	pending.port = address.port;
+	if (address.kind == address_kind::ipv6)
+		pending_ipv6 = address.ipv6;
+	if (address.kind == address_kind::host) {
+		pending.start = static_cast<std::uint32_t>(host.data() - ip.data());
+		pending.size = static_cast<std::uint32_t>(host.size());
+	}
+	return address_key(address, host);
+}
+
+std::string_view address_set::text_of(const record& entry) const {
+	return std::string_view(servers[entry.index].ip).substr(entry.start, entry.size);
+}
+
+bool address_set::same_address(const record& entry) const {
+	if (entry.kind != pending.kind || entry.port != pending.port)
+		return false;
+	if (entry.kind == address_kind::ipv6)
+		return ipv6s[entry.start] == pending_ipv6;
+	return std::ranges::equal(text_of(entry), text_of(pending), [](char l, char r) { return lower(l) == lower(r); });
+}
+
+void address_set::grow() {
+	std::vector<std::uint64_t> old_keys(keys.size() * 2);
+	std::vector<std::uint32_t> old_indices(indices.size() * 2, empty_slot);
+	old_keys.swap(keys);
+	old_indices.swap(indices);
+
+	const std::size_t mask = keys.size() - 1;
+	for (std::size_t i = 0; i < old_keys.size(); ++i) {
+		if (old_indices[i] == empty_slot)
+			continue;
+		std::size_t slot = mix(old_keys[i]) & mask;
+		while (indices[slot] != empty_slot)
+			slot = (slot + 1) & mask;
+		keys[slot] = old_keys[i];
+		indices[slot] = old_indices[i];
+	}
+}
+
+std::size_t address_set::insert(std::size_t index) {
+	if ((count + 1) * 4 > keys.size() * 3)
+		grow();
+
+	const std::uint64_t key = key_of(index);
+	const bool hashed = key & hashed_bit;
+	const std::size_t mask = keys.size() - 1;
+	for (std::size_t slot = mix(key) & mask;; slot = (slot + 1) & mask) {
+		if (indices[slot] == empty_slot) {
+			keys[slot] = key;
+			indices[slot] = static_cast<std::uint32_t>(index);
+			if (hashed) {
+				if (pending.kind == address_kind::ipv6) {
+					pending.start = static_cast<std::uint32_t>(ipv6s.size());
+					ipv6s.push_back(pending_ipv6);
+				}
+				indices[slot] = static_cast<std::uint32_t>(records.size());
+				records.push_back(pending);
+			}
+			++count;
+			return npos;
+		}
+		const std::uint32_t existing = indices[slot] & ~duplicated_bit;
+		if (keys[slot] != key || (hashed && !same_address(records[existing])))
+			continue;
+		if (!(indices[slot] & duplicated_bit)) {
+			indices[slot] |= duplicated_bit;
+			++duplicated_count;
+		}
+		return hashed ? records[existing].index : existing;
+	}
+}
+
+dedup_stats dedup_servers(std::vector<nbtserver>& servers, dedup_mode mode) {
+	address_set addresses(servers);
+	std::vector<char> keep(servers.size(), false);
+	if (mode == dedup_mode::first) {
+		for (std::size_t i = 0; i < servers.size(); ++i)
+			keep[i] = addresses.insert(i) == address_set::npos;
+	} else {
+		for (std::size_t i = servers.size(); i-- > 0;)
+			keep[i] = addresses.insert(i) == address_set::npos;
+	}
+
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		if (!keep[i])
+			continue;
+		if (kept != i)
+			servers[kept] = std::move(servers[i]);
+		++kept;
+	}
+	const dedup_stats stats{ .removed = servers.size() - kept, .addresses = addresses.duplicated() };
+	servers.resize(kept);
+	return stats;
+}
@@ -0,0 +1,301 @@
+#include "expand.hpp"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+namespace {
+constexpr std::uint64_t max_servers = INT32_MAX;
+// digits of a bracket bound, small enough that counts can't overflow
+constexpr std::size_t max_number_digits = 18;
+
+bool all_digits(std::string_view text) {
+	return !text.empty() && text.size() <= max_number_digits && text.find_first_not_of("0123456789") == std::string_view::npos;
+}
+
+std::uint64_t to_number(std::string_view digits) {
+	std::uint64_t value = 0;
+	std::from_chars(digits.data(), digits.data() + digits.size(), value);
+	return value;
+}
+
+bool parse_port(std::string_view text, std::uint16_t& port) {
+	unsigned value = 0;
+	const auto [rest, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (text.empty() || ec != std::errc() || rest != text.data() + text.size() || value == 0 || value > 0xffff)
+		return false;
+	port = static_cast<std::uint16_t>(value);
+	return true;
+}
+
+void append_number(std::string& out, std::uint64_t value, unsigned width) {
+	char digits[24];
+	const char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+	const auto size = static_cast<std::size_t>(end - digits);
+	if (size < width)
+		out.append(width - size, '0');
+	out.append(digits, size);
+}
+}
+
+server_ranges::server_ranges(std::string_view text) {
+	std::size_t line_number = 0;
+	while (!text.empty()) {
+		++line_number;
+		const std::size_t newline = text.find('\n');
+		std::string_view line = text.substr(0, newline);
+		text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+		if (line.ends_with('\r'))
+			line.remove_suffix(1);
+		if (line.empty())
+			continue;
+
+		// split like csv
+		std::array<std::string_view, 4> items{};
+		std::size_t item_count = 0;
+		for (std::size_t pos = 0; pos < line.size() && item_count < items.size();) {
+			std::size_t next_pos = line.find_first_of(",|;", pos);
+			if (next_pos == std::string_view::npos)
+				next_pos = line.size();
+			items[item_count++] = line.substr(pos, next_pos - pos);
+			pos = next_pos == line.size() ? line.size() : next_pos + 1;
+		}
+		if (item_count < items.size()) {
+			std::cout << "warning: a server entry is missing required fields. it will not be added to the servers list\n";
+			continue;
+		}
+
+		range_line range{
+			.name = split_template(items[0]),
+			.icon = split_template(items[1]),
+			.accept_textures = !items[3].empty() && items[3][0] == '1',
+			.kind = pattern_kind::text,
+			.base = {},
+			.literals = {},
+			.numbers = {},
+			.first = total,
+			.count = 1,
+		};
+		if (!parse_pattern(items[2], range)) {
+			problem = "line " + std::to_string(line_number) + ": " + problem + " in '" + std::string(items[2]) + '\'';
+			return;
+		}
+		total += range.count;
+		if (total > max_servers) {
+			problem = "line " + std::to_string(line_number) + ": the ranges expand to more than " + std::to_string(max_servers) + " servers";
+			return;
+		}
+		lines.push_back(std::move(range));
+	}
+}
+
+server_ranges::template_text server_ranges::split_template(std::string_view text) {
+	template_text out{ .literals = {""}, .fields = {} };
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		const std::string_view rest = text.substr(i);
+		if (rest.starts_with("{ip}") || rest.starts_with("{n}")) {
+			out.fields += rest[1];
+			out.literals.emplace_back();
+			i += rest[1] == 'i' ? 3 : 2;
+			continue;
+		}
+		out.literals.back() += text[i];
+	}
+	return out;
+}
+
+void server_ranges::render(const template_text& text, std::string_view ip, std::uint64_t n, std::string& out) {
+	out.assign(text.literals[0]);
+	for (std::size_t i = 0; i < text.fields.size(); ++i) {
+		if (text.fields[i] == 'i')
+			out += ip;
+		else
+			append_number(out, n, 0);
+		out += text.literals[i + 1];
+	}
+}
+
+bool server_ranges::parse_pattern(std::string_view pattern, range_line& line) {
+	const std::size_t slash = pattern.find('/');
+	if (slash != std::string_view::npos) {
+		// CIDR: a.b.c.d/n[:port] or [v6/n][:port]
+		std::string_view block = pattern;
+		std::string_view port{};
+		if (block.starts_with('[')) {
+			const std::size_t close = block.find(']');
+			if (close == std::string_view::npos) {
+				problem = "missing ']'";
+				return false;
+			}
+			if (close + 1 < block.size()) {
+				if (block[close + 1] != ':') {
+					problem = "unexpected text after ']'";
+					return false;
+				}
+				port = block.substr(close + 2);
+			}
+			block = block.substr(1, close - 1);
+		} else if (const std::size_t colon = block.find(':', slash); colon != std::string_view::npos) {
+			port = block.substr(colon + 1);
+			block = block.substr(0, colon);
+		}
+
+		const std::size_t bits_at = block.find('/');
+		const std::string_view address = block.substr(0, bits_at);
+		const std::string_view bits_text = block.substr(bits_at + 1);
+		server_address& base = line.base;
+		unsigned max_bits = 32;
+		if (parse_ipv4(address, base.ipv4)) {
+			base.kind = address_kind::ipv4;
+			line.kind = pattern_kind::ipv4;
+		} else if (parse_ipv6(address, base.ipv6)) {
+			base.kind = address_kind::ipv6;
+			line.kind = pattern_kind::ipv6;
+			max_bits = 128;
+		} else {
+			problem = "invalid CIDR address";
+			return false;
+		}
+		unsigned bits = 0;
+		const auto [rest, ec] = std::from_chars(bits_text.data(), bits_text.data() + bits_text.size(), bits);
+		if (bits_text.empty() || ec != std::errc() || rest != bits_text.data() + bits_text.size() || bits > max_bits) {
+			problem = "invalid prefix length";
+			return false;
+		}
+		if (!port.empty() || pattern.ends_with(':')) {
+			if (!parse_port(port, base.port)) {
+				problem = "invalid port";
+				return false;
+			}
+		}
+
+		const unsigned host_bits = max_bits - bits;
+		if (host_bits >= 32) {
+			problem = "too many addresses";
+			return false;
+		}
+		line.count = std::uint64_t{1} << host_bits;
+		// clear the host bits, 10.1.2.3/8 is 10.0.0.0/8. They all sit in the last 4 bytes
+		const std::uint32_t host_mask = static_cast<std::uint32_t>(line.count - 1);
+		if (base.kind == address_kind::ipv4) {
+			base.ipv4 &= ~host_mask;
+		} else {
+			for (std::size_t i = 0; i < 4; ++i)
+				base.ipv6[15 - i] &= static_cast<std::uint8_t>(~(host_mask >> (8 * i)));
+		}
+		return true;
+	}
+
+	// text with [a-b] ranges. A bracket that isn't a range, like an IPv6 literal, stays as it is
+	line.kind = pattern_kind::text;
+	line.literals.assign(1, "");
+	for (std::size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] == '[') {
+			const std::size_t close = pattern.find(']', i);
+			const std::string_view inside = close == std::string_view::npos ? std::string_view{} : pattern.substr(i + 1, close - i - 1);
+			const std::size_t dash = inside.find('-');
+			if (dash != std::string_view::npos && all_digits(inside.substr(0, dash)) && all_digits(inside.substr(dash + 1))) {
+				const std::string_view low = inside.substr(0, dash);
+				const std::uint64_t first = to_number(low);
+				const std::uint64_t last = to_number(inside.substr(dash + 1));
+				if (first > last) {
+					problem = "empty range [" + std::string(inside) + ']';
+					return false;
+				}
+				const unsigned width = low.size() > 1 && low[0] == '0' ? static_cast<unsigned>(low.size()) : 0;
+				line.numbers.push_back(number_range{ .first = first, .count = last - first + 1, .width = width });
+				line.literals.emplace_back();
+				if (line.numbers.back().count > max_servers || line.count * line.numbers.back().count > max_servers) {
+					problem = "too many servers";
+					return false;
+				}
+				line.count *= line.numbers.back().count;
+				i = close;
+				continue;
+			}
+		}
+		line.literals.back() += pattern[i];
+	}
+	return true;
+}
+
+void server_ranges::at(std::uint64_t index, nbtserver& server) const {
+	// the last line starting at or before index
+	std::size_t low = 0;
+	std::size_t high = lines.size();
+	while (high - low > 1) {
+		const std::size_t middle = (low + high) / 2;
+		if (lines[middle].first <= index)
+			low = middle;
+		else
+			high = middle;
+	}
+	const range_line& line = lines[low];
+	const std::uint64_t offset = index - line.first;
+
+	server.address = line.base;
+	switch (line.kind) {
+	case pattern_kind::ipv4:
+		server.address.ipv4 |= static_cast<std::uint32_t>(offset);
+		server.ip = format_address(server.address);
+		break;
+	case pattern_kind::ipv6:
+		for (std::size_t i = 0; i < 4; ++i)
+			server.address.ipv6[15 - i] |= static_cast<std::uint8_t>(offset >> (8 * i));
+		server.ip = format_address(server.address);
+		break;
+	case pattern_kind::text: {
+		// the last range varies fastest
+		std::array<std::uint64_t, 16> small{};
+		std::vector<std::uint64_t> large;
+		std::uint64_t* values = small.data();
+		if (line.numbers.size() > small.size()) {
+			large.resize(line.numbers.size());
+			values = large.data();
+		}
+		std::uint64_t rest = offset;
+		for (std::size_t i = line.numbers.size(); i-- > 0;) {
+			values[i] = line.numbers[i].first + rest % line.numbers[i].count;
+			rest /= line.numbers[i].count;
+		}
+		server.ip.assign(line.literals[0]);
+		for (std::size_t i = 0; i < line.numbers.size(); ++i) {
+			append_number(server.ip, values[i], line.numbers[i].width);
+			server.ip += line.literals[i + 1];
+		}
+		if (parse_address(server.ip, server.address) != address_error::none)
+			server.address = server_address{};
+		break;
+	}
+	}
+
+	render(line.name, server.ip, index + 1, server.name);
+	render(line.icon, server.ip, index + 1, server.icon);
+	server.accept_textures = line.accept_textures;
+}
+
+bool server_ranges::has_file_icons() const {
+	return std::any_of(lines.begin(), lines.end(), [](const range_line& line) { return line.icon.literals.front().starts_with('@'); });
+}
+
+expanded_servers::expanded_servers(const server_ranges& ranges, predicate keep) : ranges(ranges), keep(std::move(keep)) {
+	if (!this->keep) {
+		kept = static_cast<std::size_t>(ranges.size());
+		return;
+	}
+	nbtserver server{};
+	for (std::uint64_t i = 0; i < ranges.size(); ++i) {
+		ranges.at(i, server);
+		kept += this->keep(server);
+	}
+}
+
+void expanded_servers::iterator::load() {
+	for (; index < owner->ranges.size(); ++index) {
+		owner->ranges.at(index, server);
+		if (!owner->keep || owner->keep(server))
+			return;
+	}
+}
@@ -0,0 +1,115 @@
+#include "export.hpp"
+#include "NBTReader.h"
+#include <iostream>
+#include <string>
+
+namespace {
+// flushed to the stream whenever it passes this size
+constexpr std::size_t chunk_size = 1 << 20;
+
+constexpr std::string_view hex_digits = "0123456789abcdef";
+
+// json and toml basic strings share the same escapes
+void append_quoted(std::string& out, std::string_view str) {
+	out.push_back('"');
+	for (const char c : str) {
+		switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+					out += "\\u00";
+					out.push_back(hex_digits[(c >> 4) & 0xf]);
+					out.push_back(hex_digits[c & 0xf]);
+				} else {
+					out.push_back(c);
+				}
+		}
+	}
+	out.push_back('"');
+}
+
+bool csv_safe(std::string_view field) {
+	return field.find_first_of(",|;\n") == std::string_view::npos;
+}
+
+template <std::endian E>
+bool export_servers(const std::filesystem::path& dat_path, std::ostream& out, std::string_view format) {
+	NBT::NBTReader<E> reader(dat_path);
+	if (!reader.isOpen()) {
+		std::cerr << "Unable to open servers.dat for reading (" << dat_path.string() << ")\n";
+		return false;
+	}
+
+	std::string chunk;
+	chunk.reserve(chunk_size + (1 << 16));
+	const auto flush = [&](bool force) {
+		if (force || chunk.size() >= chunk_size) {
+			out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+			chunk.clear();
+		}
+	};
+
+	std::size_t exported = 0;
+	std::size_t skipped = 0;
+	try {
+		if (format == "json")
+			chunk += "{\n  \"servers\": [";
+
+		for (const auto& server : reader.servers()) {
+			if (format == "csv") {
+				if (!csv_safe(server.name) || !csv_safe(server.icon) || !csv_safe(server.ip)) {
+					++skipped;
+					continue;
+				}
+				chunk.append(server.name).push_back(',');
+				chunk.append(server.icon).push_back(',');
+				chunk.append(server.ip).push_back(',');
+				chunk += server.acceptTextures ? "1\n" : "0\n";
+			} else if (format == "toml") {
+				chunk += "[[servers]]\nicon = ";
+				append_quoted(chunk, server.icon);
+				chunk += "\nip = ";
+				append_quoted(chunk, server.ip);
+				chunk += "\nname = ";
+				append_quoted(chunk, server.name);
+				chunk += server.acceptTextures ? "\naccept_textures = true\n\n" : "\naccept_textures = false\n\n";
+			} else {
+				chunk += exported ? ",\n    {\n      \"icon\": " : "\n    {\n      \"icon\": ";
+				append_quoted(chunk, server.icon);
+				chunk += ",\n      \"ip\": ";
+				append_quoted(chunk, server.ip);
+				chunk += ",\n      \"name\": ";
+				append_quoted(chunk, server.name);
+				chunk += server.acceptTextures ? ",\n      \"accept_textures\": true\n    }" : ",\n      \"accept_textures\": false\n    }";
+			}
+			++exported;
+			flush(false);
+		}
+
+		if (format == "json")
+			chunk += exported ? "\n  ]\n}\n" : "]\n}\n";
+	} catch (const NBT::parse_error& e) {
+		flush(true);
+		std::cerr << "servers.dat is malformed (" << e.what() << "). exported " << exported << " servers before the error\n";
+		return false;
+	}
+	flush(true);
+	out.flush();
+
+	if (skipped)
+		std::cerr << "warning: " << skipped << " server entries have a csv delimiter in a field and were not exported\n";
+	return true;
+}
+}
+
+bool export_servers(const std::filesystem::path& dat_path, std::ostream& out, std::string_view format, std::endian endian) {
+	if (endian == std::endian::little)
+		return export_servers<std::endian::little>(dat_path, out, format);
+	return export_servers<std::endian::big>(dat_path, out, format);
+}
@@ -0,0 +1,394 @@
+#include "external.hpp"
+#include "static_servers.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+// rough heap cost of a parsed server besides its strings
+constexpr std::uint64_t record_overhead = sizeof(nbtserver) + 96;
+constexpr std::size_t min_stream_buffer = 1 << 16;
+constexpr std::size_t count_offset = servers_dat_head_size - 4;
+// the list count is a signed 32-bit int
+constexpr std::uint64_t max_servers = INT32_MAX;
+
+struct run_record {
+	std::string key; // memcmp order is the sort order
+	std::uint64_t seq = 0; // position in the input
+	nbtserver server{};
+};
+
+std::uint64_t memory_of(const nbtserver& server) {
+	return record_overhead + server.name.size() + server.icon.size() + server.ip.size();
+}
+
+char lower(char c) {
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::string lowered(std::string_view text) {
+	std::string out(text.size(), '\0');
+	std::transform(text.begin(), text.end(), out.begin(), lower);
+	return out;
+}
+
+// Same order as sort_order, except that host names are ordered by their canonical text.
+// For addr, equal keys are equal addresses, which is what dedup compares
+std::string make_key(const nbtserver& server, sort_key key) {
+	switch (key) {
+	case sort_key::name:
+		return lowered(server.name);
+	case sort_key::ip:
+		return server.ip;
+	case sort_key::addr:
+		break;
+	}
+
+	server_address address = server.address;
+	std::string_view host{};
+	const bool valid = parse_address(server.ip, address, &host) == address_error::none;
+	std::string out;
+	if (valid && (address.kind == address_kind::ipv4 || address.kind == address_kind::ipv6)) {
+		out.resize(1 + 16 + 2);
+		out[0] = address.kind == address_kind::ipv4 ? 0 : 1;
+		if (address.kind == address_kind::ipv4) {
+			for (std::size_t i = 0; i < 4; ++i)
+				out[1 + i] = static_cast<char>(address.ipv4 >> (24 - 8 * i));
+		} else {
+			std::memcpy(out.data() + 1, address.ipv6.data(), 16);
+		}
+		out[17] = static_cast<char>(address.port >> 8);
+		out[18] = static_cast<char>(address.port);
+		return out;
+	}
+	if (valid)
+		return '\x02' + format_address(address, host);
+	return '\x03' + lowered(trim_address(server.ip));
+}
+
+// Sort order of run records: key, reversed or not, then input position. Keeping the
+// last duplicate puts the latest position first so that it's the one kept
+struct record_order {
+	bool reverse;
+	bool latest_first;
+
+	bool operator()(const run_record& a, const run_record& b) const {
+		const int cmp = a.key.compare(b.key);
+		if (cmp != 0)
+			return reverse ? cmp > 0 : cmp < 0;
+		return latest_first ? a.seq > b.seq : a.seq < b.seq;
+	}
+};
+
+template <typename T>
+void put(std::ostream& out, T value) {
+	out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_string(std::ostream& out, std::string_view text) {
+	put(out, static_cast<std::uint32_t>(text.size()));
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value) {
+	return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool get_string(std::istream& in, std::string& text) {
+	std::uint32_t size = 0;
+	if (!get(in, size))
+		return false;
+	text.resize(size);
+	return static_cast<bool>(in.read(text.data(), size));
+}
+
+// Run files are only read back by this process, numbers are stored native
+void write_record(std::ostream& out, const run_record& record) {
+	put_string(out, record.key);
+	put(out, record.seq);
+	put_string(out, record.server.name);
+	put_string(out, record.server.icon);
+	put_string(out, record.server.ip);
+	put(out, static_cast<char>(record.server.accept_textures));
+}
+
+bool read_record(std::istream& in, run_record& record) {
+	char accept = 0;
+	if (!get_string(in, record.key) || !get(in, record.seq) || !get_string(in, record.server.name)
+		|| !get_string(in, record.server.icon) || !get_string(in, record.server.ip) || !get(in, accept))
+		return false;
+	record.server.accept_textures = accept != 0;
+	return true;
+}
+
+// Removed with everything in it when it goes out of scope
+class temp_directory {
+public:
+	temp_directory() {
+		std::random_device random;
+		const std::uint64_t id = static_cast<std::uint64_t>(random()) << 32 | random();
+		path = fs::temp_directory_path() / ("enbt-" + hash_hex(id));
+		std::error_code ec;
+		if (!fs::create_directory(path, ec))
+			path.clear();
+	}
+	~temp_directory() {
+		std::error_code ec;
+		if (!path.empty())
+			fs::remove_all(path, ec);
+	}
+	temp_directory(const temp_directory&) = delete;
+	temp_directory& operator=(const temp_directory&) = delete;
+
+	bool ok() const { return !path.empty(); }
+	fs::path next() { return path / ("run" + std::to_string(count++)); }
+
+private:
+	fs::path path;
+	std::size_t count = 0;
+};
+
+class run_reader {
+public:
+	run_reader(const fs::path& path, std::size_t buffer_size) : buffer(buffer_size) {
+		in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		in.open(path, std::ios::binary);
+		advance();
+	}
+	bool done() const { return finished; }
+	const run_record& current() const { return record; }
+	run_record& current() { return record; }
+	void advance() { finished = !in.is_open() || !read_record(in, record); }
+	// end of file, not a short read
+	bool clean() const { return in.is_open() && in.eof(); }
+
+private:
+	std::vector<char> buffer;
+	std::ifstream in;
+	run_record record;
+	bool finished = true;
+};
+
+// Calls fn with batches of parsed servers that each stay within budget bytes
+template <typename Fn>
+bool for_each_batch(std::istream& input, std::string_view format, std::uint64_t budget, Fn&& fn) {
+	if (format != "csv") {
+		std::stringstream buffer;
+		buffer << input.rdbuf();
+		std::vector<nbtserver> all = format == "toml" ? parse_servers_toml(buffer.str()) : parse_servers_json(buffer.str());
+		std::vector<nbtserver> batch;
+		std::uint64_t used = 0;
+		for (nbtserver& server : all) {
+			used += memory_of(server);
+			batch.push_back(std::move(server));
+			if (used >= budget) {
+				fn(batch);
+				batch.clear();
+				used = 0;
+			}
+		}
+		if (!batch.empty())
+			fn(batch);
+		return true;
+	}
+
+	std::string chunk;
+	std::string line;
+	std::uint64_t lines = 0;
+	while (true) {
+		const bool more = static_cast<bool>(std::getline(input, line));
+		if (more) {
+			chunk += line;
+			chunk += '\n';
+			++lines;
+		}
+		// the chunk, plus what parsing it turns into
+		if (!chunk.empty() && (!more || 2 * chunk.size() + lines * record_overhead >= budget)) {
+			std::vector<nbtserver> batch = parse_servers_csv(chunk);
+			chunk.clear();
+			lines = 0;
+			fn(batch);
+		}
+		if (!more)
+			return input.eof();
+	}
+}
+
+template <std::endian E>
+class dat_sink {
+public:
+	explicit dat_sink(atomic_output& output) : output(output) {
+		std::array<std::byte, servers_dat_head_size> head{};
+		encode_servers_dat_head<E>(head.begin(), 0);
+		output.stream().write(reinterpret_cast<const char*>(head.data()), head.size());
+	}
+
+	void add(const nbtserver& server) {
+		if (count == max_servers) {
+			overflowed = true;
+			return;
+		}
+		const static_server view{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures };
+		encoded.resize(server_nbt_size(view));
+		encode_server_nbt<E>(encoded.data(), view);
+		output.stream().write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+		++count;
+	}
+
+	bool finish() {
+		if (overflowed)
+			return false;
+		output.stream().put(NBT::idEnd);
+		std::array<std::byte, 4> bytes{};
+		static_nbt::put_u32<E>(bytes.begin(), static_cast<std::uint32_t>(count));
+		return output.patch(count_offset, std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+	}
+
+	std::uint64_t written() const { return count; }
+	bool too_many() const { return overflowed; }
+
+private:
+	atomic_output& output;
+	std::vector<std::byte> encoded;
+	std::uint64_t count = 0;
+	bool overflowed = false;
+};
+
+// k-way merge of runs into emit, dropping equal keys after the first when deduplicating
+template <typename Emit>
+bool merge_runs(const std::vector<fs::path>& runs, std::size_t buffer_size, const external_options& options, std::uint64_t& duplicates, Emit&& emit) {
+	std::vector<std::unique_ptr<run_reader>> readers;
+	for (const fs::path& run : runs)
+		readers.push_back(std::make_unique<run_reader>(run, buffer_size));
+
+	const record_order order{ .reverse = options.reverse, .latest_first = options.dedup && options.dedup_keep == dedup_mode::last };
+	const auto later = [&](std::size_t a, std::size_t b) { return order(readers[b]->current(), readers[a]->current()); };
+	std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap(later);
+	for (std::size_t i = 0; i < readers.size(); ++i) {
+		if (!readers[i]->done())
+			heap.push(i);
+	}
+
+	std::string last_key;
+	bool any = false;
+	while (!heap.empty()) {
+		const std::size_t i = heap.top();
+		heap.pop();
+		run_record& record = readers[i]->current();
+		if (options.dedup && any && record.key == last_key) {
+			++duplicates;
+		} else {
+			last_key = record.key;
+			any = true;
+			emit(record);
+		}
+		readers[i]->advance();
+		if (!readers[i]->done())
+			heap.push(i);
+	}
+	return std::all_of(readers.begin(), readers.end(), [](const auto& reader) { return reader->clean(); });
+}
+
+template <std::endian E>
+bool write_external(std::istream& input, std::string_view format, const fs::path& output_path,
+	const external_options& options, const batch_hook& prepare, external_stats& stats, output_result& result) {
+	atomic_output output(output_path);
+	if (!output.is_open())
+		return false;
+	dat_sink<E> sink(output);
+
+	// nothing to reorder: batches go straight to the output
+	if (!options.sort && !options.dedup) {
+		const bool read = for_each_batch(input, format, options.mem_limit, [&](std::vector<nbtserver>& batch) {
+			if (prepare)
+				prepare(batch);
+			stats.read += batch.size();
+			for (const nbtserver& server : batch)
+				sink.add(server);
+		});
+		stats.written = sink.written();
+		stats.too_many = sink.too_many();
+		return read && sink.finish() && output.commit(result);
+	}
+
+	temp_directory temp;
+	if (!temp.ok())
+		return false;
+	std::vector<fs::path> runs;
+	const record_order order{ .reverse = options.reverse, .latest_first = options.dedup && options.dedup_keep == dedup_mode::last };
+	bool runs_ok = true;
+	std::uint64_t seq = 0;
+	const bool read = for_each_batch(input, format, options.mem_limit / 2, [&](std::vector<nbtserver>& batch) {
+		if (prepare)
+			prepare(batch);
+		stats.read += batch.size();
+		if (batch.empty())
+			return;
+
+		std::vector<run_record> records(batch.size());
+		for (std::size_t i = 0; i < batch.size(); ++i) {
+			records[i].key = make_key(batch[i], options.key);
+			records[i].seq = seq++;
+			records[i].server = std::move(batch[i]);
+		}
+		batch.clear();
+		batch.shrink_to_fit();
+		std::sort(records.begin(), records.end(), order);
+
+		runs.push_back(temp.next());
+		std::ofstream run(runs.back(), std::ios::binary);
+		for (std::size_t i = 0; i < records.size(); ++i) {
+			if (options.dedup && i > 0 && records[i].key == records[i - 1].key) {
+				++stats.duplicates;
+				continue;
+			}
+			write_record(run, records[i]);
+		}
+		runs_ok = runs_ok && run.flush();
+	});
+	if (!read || !runs_ok)
+		return false;
+	stats.runs = runs.size();
+
+	// every open run gets a read buffer, merge in passes while there are too many of them
+	const std::size_t fan_in = static_cast<std::size_t>(std::max<std::uint64_t>(2, options.mem_limit / (2 * min_stream_buffer)));
+	while (runs.size() > fan_in) {
+		std::vector<fs::path> merged;
+		for (std::size_t first = 0; first < runs.size(); first += fan_in) {
+			const std::vector<fs::path> group(runs.begin() + first, runs.begin() + std::min(runs.size(), first + fan_in));
+			merged.push_back(temp.next());
+			std::ofstream run(merged.back(), std::ios::binary);
+			if (!merge_runs(group, options.mem_limit / (2 * group.size()), options, stats.duplicates, [&](const run_record& record) { write_record(run, record); })
+				|| !run.flush())
+				return false;
+			for (const fs::path& done : group)
+				fs::remove(done);
+		}
+		runs.swap(merged);
+	}
+
+	const std::size_t buffer_size = std::max<std::size_t>(min_stream_buffer, static_cast<std::size_t>(options.mem_limit / (2 * std::max<std::size_t>(runs.size(), 1))));
+	if (!merge_runs(runs, buffer_size, options, stats.duplicates, [&](const run_record& record) { sink.add(record.server); }))
+		return false;
+	stats.written = sink.written();
+	stats.too_many = sink.too_many();
+	return sink.finish() && output.commit(result);
+}
+}
+
+bool write_servers_external(std::istream& input, std::string_view format, const fs::path& output,
+	const external_options& options, const batch_hook& prepare, external_stats& stats, output_result& result) {
+	if (options.endian == std::endian::little)
+		return write_external<std::endian::little>(input, format, output, options, prepare, stats, result);
+	return write_external<std::endian::big>(input, format, output, options, prepare, stats, result);
+}
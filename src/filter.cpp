@@ -0,0 +1,412 @@
+#include "filter.hpp"
+#include <algorithm>
+#include <charconv>
+
+namespace {
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_word(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool prefix_matches(const std::array<std::uint8_t, 16>& a, const std::array<std::uint8_t, 16>& b, unsigned bits) {
+	const unsigned whole = bits / 8;
+	if (!std::equal(a.begin(), a.begin() + whole, b.begin()))
+		return false;
+	const unsigned rest = bits % 8;
+	if (rest == 0)
+		return true;
+	const auto mask = static_cast<std::uint8_t>(0xff << (8 - rest));
+	return (a[whole] & mask) == (b[whole] & mask);
+}
+
+std::array<std::uint8_t, 16> ipv4_bytes(std::uint32_t ipv4) {
+	return {static_cast<std::uint8_t>(ipv4 >> 24), static_cast<std::uint8_t>(ipv4 >> 16), static_cast<std::uint8_t>(ipv4 >> 8), static_cast<std::uint8_t>(ipv4)};
+}
+
+// a regex that is only a literal with optional anchors
+bool literal_pattern(std::string_view pattern, std::string& literal, bool& anchored_start, bool& anchored_end) {
+	anchored_start = pattern.starts_with('^');
+	if (anchored_start)
+		pattern.remove_prefix(1);
+	anchored_end = pattern.ends_with('$') && !pattern.ends_with("\\$");
+	if (anchored_end)
+		pattern.remove_suffix(1);
+
+	literal.clear();
+	for (std::size_t i = 0; i < pattern.size(); ++i) {
+		const char c = pattern[i];
+		if (c == '\\') {
+			// escaped punctuation is literal, \d and friends aren't
+			if (i + 1 == pattern.size() || is_word(pattern[i + 1]))
+				return false;
+			literal += pattern[++i];
+			continue;
+		}
+		if (std::string_view(".[]()*+?{}|^$").find(c) != std::string_view::npos)
+			return false;
+		literal += c;
+	}
+	return true;
+}
+}
+
+class server_filter::parser {
+public:
+	parser(server_filter& filter, std::string_view text) : filter(filter), text(text) {}
+
+	void parse() {
+		parse_or();
+		skip_space();
+		if (pos != text.size())
+			fail("unexpected '" + std::string(text.substr(pos, 1)) + "'");
+	}
+
+private:
+	[[noreturn]] void fail(const std::string& message) const {
+		throw filter_error(message, pos + 1);
+	}
+
+	void skip_space() {
+		while (pos < text.size() && is_space(text[pos]))
+			++pos;
+	}
+
+	bool accept(std::string_view token) {
+		skip_space();
+		if (!text.substr(pos).starts_with(token))
+			return false;
+		pos += token.size();
+		return true;
+	}
+
+	void expect(std::string_view token) {
+		if (!accept(token))
+			fail("expected '" + std::string(token) + "'");
+	}
+
+	std::string_view word() {
+		skip_space();
+		const std::size_t start = pos;
+		while (pos < text.size() && is_word(text[pos]))
+			++pos;
+		return text.substr(start, pos - start);
+	}
+
+	std::size_t emit(op code, field source = field::name, std::uint32_t arg = 0, std::uint32_t arg2 = 0) {
+		filter.code.push_back(instruction{ .code = code, .source = source, .arg = arg, .arg2 = arg2 });
+		return filter.code.size() - 1;
+	}
+
+	void patch_jumps(const std::vector<std::size_t>& jumps) {
+		for (const std::size_t jump : jumps)
+			filter.code[jump].arg = static_cast<std::uint32_t>(filter.code.size());
+	}
+
+	// a || b: a, jump_true end, b, end
+	void parse_or() {
+		parse_and();
+		std::vector<std::size_t> jumps;
+		while (accept("||")) {
+			jumps.push_back(emit(op::jump_true));
+			parse_and();
+		}
+		patch_jumps(jumps);
+	}
+
+	void parse_and() {
+		parse_unary();
+		std::vector<std::size_t> jumps;
+		while (accept("&&")) {
+			jumps.push_back(emit(op::jump_false));
+			parse_unary();
+		}
+		patch_jumps(jumps);
+	}
+
+	void parse_unary() {
+		if (accept("!")) {
+			parse_unary();
+			emit(op::negate);
+		} else if (accept("(")) {
+			parse_or();
+			expect(")");
+		} else {
+			parse_comparison();
+		}
+	}
+
+	std::string string_value() {
+		skip_space();
+		if (pos < text.size() && text[pos] == '"') {
+			std::string value;
+			for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+				if (text[pos] == '\\' && pos + 1 < text.size())
+					++pos;
+				value += text[pos];
+			}
+			expect("\"");
+			return value;
+		}
+		const std::string_view value = word();
+		if (value.empty())
+			fail("expected a string");
+		return std::string(value);
+	}
+
+	std::uint32_t number_value() {
+		skip_space();
+		const std::size_t start = pos;
+		const std::string_view value = word();
+		if (value == "true")
+			return 1;
+		if (value == "false")
+			return 0;
+		std::uint32_t number = 0;
+		const auto [rest, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+		if (value.empty() || ec != std::errc() || rest != value.data() + value.size()) {
+			pos = start;
+			fail("expected a number");
+		}
+		return number;
+	}
+
+	cidr cidr_value() {
+		skip_space();
+		const std::size_t value_pos = pos;
+		const bool quoted = pos < text.size() && text[pos] == '"';
+		if (quoted)
+			++pos;
+		const std::size_t start = pos;
+		while (pos < text.size() && (is_word(text[pos]) || text[pos] == '.' || text[pos] == ':' || text[pos] == '/'))
+			++pos;
+		const std::string_view value = text.substr(start, pos - start);
+		if (quoted)
+			expect("\"");
+
+		const std::size_t slash = value.find('/');
+		const std::string_view address = value.substr(0, slash);
+		cidr range{ .kind = address_kind::ipv4, .bytes = {}, .prefix = 32 };
+		std::uint32_t ipv4 = 0;
+		if (parse_ipv4(address, ipv4)) {
+			range.bytes = ipv4_bytes(ipv4);
+		} else if (parse_ipv6(address, range.bytes)) {
+			range.kind = address_kind::ipv6;
+			range.prefix = 128;
+		} else {
+			pos = value_pos;
+			fail("expected a CIDR range like 10.0.0.0/8");
+		}
+		if (slash != std::string_view::npos) {
+			unsigned prefix = 0;
+			const std::string_view bits = value.substr(slash + 1);
+			const auto [rest, ec] = std::from_chars(bits.data(), bits.data() + bits.size(), prefix);
+			if (bits.empty() || ec != std::errc() || rest != bits.data() + bits.size() || prefix > range.prefix) {
+				pos = value_pos;
+				fail("invalid CIDR prefix length");
+			}
+			range.prefix = static_cast<std::uint8_t>(prefix);
+		}
+		return range;
+	}
+
+	void parse_comparison() {
+		const std::size_t field_pos = pos;
+		const std::string_view name = word();
+		field source;
+		if (name == "name")
+			source = field::name;
+		else if (name == "icon")
+			source = field::icon;
+		else if (name == "ip")
+			source = field::ip;
+		else if (name == "port")
+			source = field::port;
+		else if (name == "accept_textures" || name == "acceptTextures")
+			source = field::accept_textures;
+		else {
+			pos = field_pos;
+			skip_space();
+			fail(name.empty() ? "expected a field" : "unknown field '" + std::string(name) + "'");
+		}
+		const bool numeric = source == field::port || source == field::accept_textures;
+
+		const std::size_t op_pos = pos;
+		if (!numeric && word() == "in") {
+			if (source != field::ip) {
+				pos = op_pos;
+				skip_space();
+				fail("only ip can be tested with 'in'");
+			}
+			const auto first = static_cast<std::uint32_t>(filter.cidrs.size());
+			if (accept("[")) {
+				do
+					filter.cidrs.push_back(cidr_value());
+				while (accept(","));
+				expect("]");
+			} else {
+				filter.cidrs.push_back(cidr_value());
+			}
+			emit(op::in_cidr, source, first, static_cast<std::uint32_t>(filter.cidrs.size()));
+			return;
+		}
+		pos = op_pos;
+
+		if (numeric) {
+			if (accept("==")) {
+				emit(op::number_equals, source, number_value());
+			} else if (accept("!=")) {
+				emit(op::number_equals, source, number_value());
+				emit(op::negate);
+			} else if (accept("<=")) {
+				emit(op::less_equal, source, number_value());
+			} else if (accept(">=")) {
+				emit(op::less, source, number_value());
+				emit(op::negate);
+			} else if (accept("<")) {
+				emit(op::less, source, number_value());
+			} else if (accept(">")) {
+				emit(op::less_equal, source, number_value());
+				emit(op::negate);
+			} else {
+				fail("expected ==, !=, <, <=, > or >=");
+			}
+			return;
+		}
+
+		bool negate = false;
+		if (accept("==") || (negate = accept("!="))) {
+			emit(op::equals, source, add_string(string_value()));
+		} else if (accept("~") || (negate = accept("!~"))) {
+			const std::size_t pattern_pos = pos;
+			const std::string pattern = string_value();
+			std::string literal;
+			bool anchored_start = false, anchored_end = false;
+			if (literal_pattern(pattern, literal, anchored_start, anchored_end)) {
+				const op code = anchored_start && anchored_end ? op::equals : anchored_start ? op::prefix : anchored_end ? op::suffix : op::contains;
+				emit(code, source, add_string(std::move(literal)));
+			} else {
+				try {
+					filter.regexes.emplace_back(pattern, std::regex::ECMAScript | std::regex::optimize);
+				} catch (const std::regex_error& e) {
+					pos = pattern_pos;
+					skip_space();
+					fail(std::string("invalid regex: ") + e.what());
+				}
+				emit(op::regex, source, static_cast<std::uint32_t>(filter.regexes.size() - 1));
+			}
+		} else {
+			fail("expected ==, !=, ~, !~ or in");
+		}
+		if (negate)
+			emit(op::negate);
+	}
+
+	std::uint32_t add_string(std::string value) {
+		filter.strings.push_back(std::move(value));
+		return static_cast<std::uint32_t>(filter.strings.size() - 1);
+	}
+
+	server_filter& filter;
+	std::string_view text;
+	std::size_t pos = 0;
+};
+
+server_filter::server_filter(std::string_view expression) {
+	parser(*this, expression).parse();
+	if (code.empty())
+		throw filter_error("empty filter", 1);
+}
+
+bool server_filter::matches(const nbtserver& server) const {
+	// parsed on first use, and only once per server
+	server_address address = server.address;
+	bool address_known = address.kind != address_kind::none;
+	const auto parsed = [&]() -> const server_address& {
+		if (!address_known) {
+			if (parse_address(server.ip, address) != address_error::none)
+				address = server_address{};
+			address_known = true;
+		}
+		return address;
+	};
+	const auto text = [&](field source) -> std::string_view {
+		return source == field::name ? server.name : source == field::icon ? server.icon : server.ip;
+	};
+	const auto number = [&](field source) -> std::uint32_t {
+		if (source == field::accept_textures)
+			return server.accept_textures;
+		return parsed().kind == address_kind::none ? 0 : parsed().port;
+	};
+
+	bool result = true;
+	for (std::size_t pc = 0; pc < code.size(); ++pc) {
+		const instruction& in = code[pc];
+		switch (in.code) {
+		case op::equals:
+			result = text(in.source) == strings[in.arg];
+			break;
+		case op::prefix:
+			result = text(in.source).starts_with(strings[in.arg]);
+			break;
+		case op::suffix:
+			result = text(in.source).ends_with(strings[in.arg]);
+			break;
+		case op::contains:
+			result = text(in.source).find(strings[in.arg]) != std::string_view::npos;
+			break;
+		case op::regex: {
+			const std::string_view value = text(in.source);
+			result = std::regex_search(value.begin(), value.end(), regexes[in.arg]);
+			break;
+		}
+		case op::in_cidr: {
+			const server_address& a = parsed();
+			result = false;
+			if (a.kind != address_kind::ipv4 && a.kind != address_kind::ipv6)
+				break;
+			const std::array<std::uint8_t, 16> bytes = a.kind == address_kind::ipv4 ? ipv4_bytes(a.ipv4) : a.ipv6;
+			for (std::uint32_t i = in.arg; i < in.arg2 && !result; ++i)
+				result = cidrs[i].kind == a.kind && prefix_matches(bytes, cidrs[i].bytes, cidrs[i].prefix);
+			break;
+		}
+		case op::less:
+			result = number(in.source) < in.arg;
+			break;
+		case op::less_equal:
+			result = number(in.source) <= in.arg;
+			break;
+		case op::number_equals:
+			result = number(in.source) == in.arg;
+			break;
+		case op::negate:
+			result = !result;
+			break;
+		case op::jump_false:
+			if (!result)
+				pc = in.arg - 1;
+			break;
+		case op::jump_true:
+			if (result)
+				pc = in.arg - 1;
+			break;
+		}
+	}
+	return result;
+}
+
+std::size_t server_filter::apply(std::vector<nbtserver>& servers) const {
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		if (!matches(servers[i]))
+			continue;
+		if (kept != i)
+			servers[kept] = std::move(servers[i]);
+		++kept;
+	}
+	const std::size_t dropped = servers.size() - kept;
+	servers.resize(kept);
+	return dropped;
+}
@@ -0,0 +1,119 @@
+#include "hash.hpp"
+#include <bit>
+#include <cstring>
+
+namespace {
+constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+template <typename T>
+T read_le(const unsigned char* p) {
+	T value;
+	std::memcpy(&value, p, sizeof(T));
+	if constexpr (std::endian::native == std::endian::big)
+		value = std::byteswap(value);
+	return value;
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+	acc += input * prime2;
+	acc = std::rotl(acc, 31);
+	return acc * prime1;
+}
+
+std::uint64_t merge_round(std::uint64_t acc, std::uint64_t value) {
+	acc ^= round(0, value);
+	return acc * prime1 + prime4;
+}
+}
+
+xxh64::xxh64(std::uint64_t seed) : seed(seed) {
+	acc[0] = seed + prime1 + prime2;
+	acc[1] = seed + prime2;
+	acc[2] = seed;
+	acc[3] = seed - prime1;
+}
+
+void xxh64::update(const void* data, std::size_t len) {
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	total += len;
+
+	if (pending_len + len < sizeof(pending)) {
+		std::memcpy(pending + pending_len, p, len);
+		pending_len += len;
+		return;
+	}
+
+	if (pending_len) {
+		const std::size_t fill = sizeof(pending) - pending_len;
+		std::memcpy(pending + pending_len, p, fill);
+		for (int i = 0; i < 4; ++i)
+			acc[i] = round(acc[i], read_le<std::uint64_t>(pending + 8 * i));
+		p += fill;
+		len -= fill;
+		pending_len = 0;
+	}
+
+	while (len >= 32) {
+		for (int i = 0; i < 4; ++i)
+			acc[i] = round(acc[i], read_le<std::uint64_t>(p + 8 * i));
+		p += 32;
+		len -= 32;
+	}
+
+	std::memcpy(pending, p, len);
+	pending_len = len;
+}
+
+std::uint64_t xxh64::digest() const {
+	std::uint64_t h;
+	if (total >= 32) {
+		h = std::rotl(acc[0], 1) + std::rotl(acc[1], 7) + std::rotl(acc[2], 12) + std::rotl(acc[3], 18);
+		for (int i = 0; i < 4; ++i)
+			h = merge_round(h, acc[i]);
+	} else {
+		h = seed + prime5;
+	}
+	h += total;
+
+	const unsigned char* p = pending;
+	std::size_t len = pending_len;
+	for (; len >= 8; p += 8, len -= 8) {
+		h ^= round(0, read_le<std::uint64_t>(p));
+		h = std::rotl(h, 27) * prime1 + prime4;
+	}
+	if (len >= 4) {
+		h ^= static_cast<std::uint64_t>(read_le<std::uint32_t>(p)) * prime1;
+		h = std::rotl(h, 23) * prime2 + prime3;
+		p += 4;
+		len -= 4;
+	}
+	for (; len > 0; ++p, --len) {
+		h ^= *p * prime5;
+		h = std::rotl(h, 11) * prime1;
+	}
+
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+std::uint64_t hash_bytes(const void* data, std::size_t len, std::uint64_t seed) {
+	xxh64 hasher(seed);
+	hasher.update(data, len);
+	return hasher.digest();
+}
+
+std::string hash_hex(std::uint64_t hash) {
+	constexpr char digits[] = "0123456789abcdef";
+	std::string hex(16, '0');
+	for (int i = 15; i >= 0; --i, hash >>= 4)
+		hex[i] = digits[hash & 0xf];
+	return hex;
+}
@@ -0,0 +1,238 @@
+#include "icon.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+#include <array>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ENBT_BASE64_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace {
+constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr unsigned char png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+constexpr std::size_t png_header_size = 8 + 8 + 8; // signature, IHDR length and type, width and height
+
+// value of every base64 digit, -1 for anything else
+constexpr std::array<signed char, 256> digit_values = [] {
+	std::array<signed char, 256> values{};
+	values.fill(-1);
+	for (signed char i = 0; i < 64; ++i)
+		values[static_cast<unsigned char>(alphabet[i])] = i;
+	return values;
+}();
+
+std::uint32_t read_u32_be(const char* bytes) {
+	const auto* b = reinterpret_cast<const unsigned char*>(bytes);
+	return static_cast<std::uint32_t>(b[0]) << 24 | static_cast<std::uint32_t>(b[1]) << 16 | static_cast<std::uint32_t>(b[2]) << 8 | b[3];
+}
+
+// Encodes whole groups of 3 bytes, returns how many bytes it consumed
+std::size_t encode_scalar(const unsigned char* in, std::size_t size, char* out) {
+	std::size_t i = 0;
+	for (; i + 3 <= size; i += 3, out += 4) {
+		const std::uint32_t group = static_cast<std::uint32_t>(in[i]) << 16 | static_cast<std::uint32_t>(in[i + 1]) << 8 | in[i + 2];
+		out[0] = alphabet[group >> 18];
+		out[1] = alphabet[group >> 12 & 63];
+		out[2] = alphabet[group >> 6 & 63];
+		out[3] = alphabet[group & 63];
+	}
+	return i;
+}
+
+#ifdef ENBT_BASE64_SSSE3
+// 12 input bytes to 16 output characters per step (Muła and Lemire). Every load reads
+// 16 bytes, so it stops while 16 are left and the scalar loop does the rest
+__attribute__((target("ssse3"))) std::size_t encode_ssse3(const unsigned char* in, std::size_t size, char* out) {
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 12, out += 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		// every 32 bit lane gets bytes 1, 0, 2, 1 of its 3 byte group
+		const __m128i spread = _mm_shuffle_epi8(bytes, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+		// move the four 6 bit fields of a lane into its four bytes
+		const __m128i high = _mm_mulhi_epu16(_mm_and_si128(spread, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		const __m128i low = _mm_mullo_epi16(_mm_and_si128(spread, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+		const __m128i indices = _mm_or_si128(high, low);
+
+		// offset to add to each index by its alphabet range: A-Z, a-z, 0-9, + and /
+		__m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+		const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+		const __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+	}
+	return i;
+}
+
+// Looks every char up by its low and high nibble. Each high nibble has a bit for the
+// digits in its row of the ascii table (+ and /, 0-9, A-O and a-o, P-Z and p-z), and the
+// low nibble's entry has the bits of the rows it's a digit in, so a char is a digit
+// when the two entries share a bit. High nibbles from 8 have no bits
+__attribute__((target("ssse3"))) std::size_t alphabet_ssse3(const char* text, std::size_t size, bool& valid) {
+	const __m128i low_table = _mm_setr_epi8(0x0a, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0c, 0x05, 0x04, 0x04, 0x04, 0x05);
+	const __m128i high_table = _mm_setr_epi8(0, 0, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	__m128i invalid = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+		const __m128i low = _mm_shuffle_epi8(low_table, _mm_and_si128(chars, nibble));
+		const __m128i high = _mm_shuffle_epi8(high_table, _mm_and_si128(_mm_srli_epi16(chars, 4), nibble));
+		invalid = _mm_or_si128(invalid, _mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128()));
+	}
+	valid = _mm_movemask_epi8(invalid) == 0;
+	return i;
+}
+
+bool has_ssse3() {
+	static const bool supported = __builtin_cpu_supports("ssse3");
+	return supported;
+}
+#endif
+}
+
+std::string base64_encode(std::string_view bytes) {
+	std::string out((bytes.size() + 2) / 3 * 4, '\0');
+	const auto* in = reinterpret_cast<const unsigned char*>(bytes.data());
+	std::size_t done = 0;
+#ifdef ENBT_BASE64_SSSE3
+	if (has_ssse3())
+		done = encode_ssse3(in, bytes.size(), out.data());
+#endif
+	done += encode_scalar(in + done, bytes.size() - done, out.data() + done / 3 * 4);
+
+	const std::size_t rest = bytes.size() - done;
+	if (rest) {
+		char* tail = out.data() + done / 3 * 4;
+		const std::uint32_t group = static_cast<std::uint32_t>(in[done]) << 16 | (rest == 2 ? static_cast<std::uint32_t>(in[done + 1]) << 8 : 0);
+		tail[0] = alphabet[group >> 18];
+		tail[1] = alphabet[group >> 12 & 63];
+		tail[2] = rest == 2 ? alphabet[group >> 6 & 63] : '=';
+		tail[3] = '=';
+	}
+	return out;
+}
+
+bool in_base64_alphabet(std::string_view text) {
+	std::size_t i = 0;
+#ifdef ENBT_BASE64_SSSE3
+	if (has_ssse3()) {
+		bool valid = true;
+		i = alphabet_ssse3(text.data(), text.size(), valid);
+		if (!valid)
+			return false;
+	}
+#endif
+	for (; i < text.size(); ++i) {
+		if (digit_values[static_cast<unsigned char>(text[i])] < 0)
+			return false;
+	}
+	return true;
+}
+
+icon_error check_png(std::string_view bytes) {
+	// signature, then the IHDR chunk: length, type, width, height
+	if (bytes.size() < png_header_size || std::memcmp(bytes.data(), png_signature, sizeof(png_signature)) != 0
+		|| read_u32_be(bytes.data() + 8) != 13 || bytes.substr(12, 4) != "IHDR")
+		return icon_error::not_png;
+	if (read_u32_be(bytes.data() + 16) != icon_size || read_u32_be(bytes.data() + 20) != icon_size)
+		return icon_error::dimensions;
+	return icon_error::none;
+}
+
+icon_error check_icon(std::string_view base64) {
+	if (base64.empty())
+		return icon_error::none;
+	// up to two '=' at the end, never before the last two chars
+	const std::size_t padding = base64.ends_with("==") ? 2 : base64.ends_with('=');
+	if (base64.size() % 4 != 0 || !in_base64_alphabet(base64.substr(0, base64.size() - padding)))
+		return icon_error::base64;
+
+	const std::size_t header_chars = png_header_size / 3 * 4;
+	if (base64.size() - padding < header_chars)
+		return icon_error::not_png;
+	std::array<char, png_header_size> header{};
+	for (std::size_t i = 0, out = 0; i < header_chars; i += 4, out += 3) {
+		const std::uint32_t group = static_cast<std::uint32_t>(digit_values[static_cast<unsigned char>(base64[i])]) << 18
+			| static_cast<std::uint32_t>(digit_values[static_cast<unsigned char>(base64[i + 1])]) << 12
+			| static_cast<std::uint32_t>(digit_values[static_cast<unsigned char>(base64[i + 2])]) << 6
+			| static_cast<std::uint32_t>(digit_values[static_cast<unsigned char>(base64[i + 3])]);
+		header[out] = static_cast<char>(group >> 16);
+		header[out + 1] = static_cast<char>(group >> 8);
+		header[out + 2] = static_cast<char>(group);
+	}
+	if (const icon_error error = check_png(std::string_view(header.data(), header.size())); error != icon_error::none)
+		return error;
+
+	if (base64.size() > icon_max_base64)
+		return icon_error::oversize;
+	return icon_error::none;
+}
+
+std::string_view icon_error_name(icon_error error) {
+	switch (error) {
+	case icon_error::none: return "valid";
+	case icon_error::unreadable: return "unreadable";
+	case icon_error::not_png: return "not a PNG";
+	case icon_error::dimensions: return "not 64x64";
+	case icon_error::base64: return "bad base64";
+	case icon_error::oversize: return "too large";
+	}
+	return "unknown";
+}
+
+icon_check_stats validate_icons(std::vector<nbtserver>& servers) {
+	icon_check_stats stats{};
+	for (nbtserver& server : servers) {
+		const icon_error error = check_icon(server.icon);
+		if (error == icon_error::none)
+			continue;
+		++stats.cleared;
+		++stats.errors[static_cast<std::size_t>(error)];
+		if (stats.examples.size() < icon_check_stats::max_examples)
+			stats.examples.push_back(server.ip);
+		server.icon.clear();
+	}
+	return stats;
+}
+
+icon_cache::encoded_icon icon_cache::load(const std::string& path) {
+	const mapped_file file(path);
+	icon_error error = file.is_open() ? check_png(file.view()) : icon_error::unreadable;
+	if (error != icon_error::none) {
+		failed.emplace_back(path, error);
+		return nullptr;
+	}
+	encoded_icon& encoded = by_content[hash_bytes(file.view())];
+	if (!encoded)
+		encoded = std::make_shared<const std::string>(base64_encode(file.view()));
+	return encoded;
+}
+
+void icon_cache::resolve(nbtserver& server) {
+	if (!server.icon.starts_with('@'))
+		return;
+	const std::string path = server.icon.substr(1);
+	auto it = by_path.find(path);
+	if (it == by_path.end())
+		it = by_path.emplace(path, load(path)).first;
+	if (it->second)
+		server.icon = *it->second;
+	else
+		server.icon.clear();
+}
+
+std::vector<std::string> icon_cache::paths() const {
+	std::vector<std::string> out;
+	out.reserve(by_path.size());
+	for (const auto& [path, icon] : by_path)
+		out.push_back(path);
+	return out;
+}
+
+void icon_cache::resolve(std::vector<nbtserver>& servers) {
+	for (nbtserver& server : servers)
+		resolve(server);
+}
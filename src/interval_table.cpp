@@ -0,0 +1,223 @@
+#include "interval_table.hpp"
+#include "output.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Cache layout, native byte order, every part padded to 8 bytes:
+//	cache_header
+//	IPv4: /16 index (65537), starts, ends
+//	IPv6: starts, ends (16 bytes each, high half first)
+//	payloads, IPv4 ones first, when there are any
+//	what the owner saved along
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+constexpr std::size_t v4_index_size = (1 << 16) + 1;
+
+struct cache_header {
+	char magic[8];
+	std::uint32_t byte_order;
+	std::uint32_t with_payloads;
+	std::uint64_t source_size;
+	std::int64_t source_time;
+	std::uint64_t v4_count;
+	std::uint64_t v6_count;
+	std::uint64_t extra_size;
+};
+
+std::size_t padded(std::size_t bytes) {
+	return (bytes + 7) & ~std::size_t{7};
+}
+
+std::size_t v4_bytes(std::uint64_t count) {
+	return padded((v4_index_size + 2 * count) * sizeof(std::uint32_t));
+}
+}
+
+interval_table::cidr_error interval_table::parse_cidr(std::string_view text, interval<std::uint32_t>& v4, interval<u128>& v6, bool& is_v4) {
+	const std::size_t slash = text.find('/');
+	const std::string_view address = text.substr(0, slash);
+	std::uint32_t ipv4 = 0;
+	std::array<std::uint8_t, 16> ipv6{};
+	is_v4 = parse_ipv4(address, ipv4);
+	if (!is_v4 && !parse_ipv6(address, ipv6))
+		return cidr_error::address;
+	const unsigned max_bits = is_v4 ? 32 : 128;
+	unsigned bits = max_bits;
+	if (slash != std::string_view::npos) {
+		const std::string_view prefix = text.substr(slash + 1);
+		const auto [rest, ec] = std::from_chars(prefix.data(), prefix.data() + prefix.size(), bits);
+		if (prefix.empty() || ec != std::errc() || rest != prefix.data() + prefix.size() || bits > max_bits)
+			return cidr_error::prefix_length;
+	}
+
+	if (is_v4) {
+		const std::uint32_t mask = bits == 0 ? 0 : ~std::uint32_t{0} << (32 - bits);
+		v4 = { ipv4 & mask, ipv4 | ~mask, 0 };
+	} else {
+		const u128 value = to_u128(ipv6);
+		const std::uint64_t hi_mask = bits == 0 ? 0 : bits >= 64 ? ~std::uint64_t{0} : ~std::uint64_t{0} << (64 - bits);
+		const std::uint64_t lo_mask = bits <= 64 ? 0 : ~std::uint64_t{0} << (128 - bits);
+		v6 = { u128{ value.hi & hi_mask, value.lo & lo_mask }, u128{ value.hi | ~hi_mask, value.lo | ~lo_mask }, 0 };
+	}
+	return cidr_error::none;
+}
+
+interval_table::u128 interval_table::to_u128(const std::array<std::uint8_t, 16>& ipv6) {
+	u128 value{};
+	for (std::size_t i = 0; i < 8; ++i) {
+		value.hi = value.hi << 8 | ipv6[i];
+		value.lo = value.lo << 8 | ipv6[8 + i];
+	}
+	return value;
+}
+
+bool interval_table::stamp_of(const fs::path& path, source_stamp& stamp) {
+	std::error_code ec;
+	stamp.size = fs::file_size(path, ec);
+	const fs::file_time_type time = ec ? fs::file_time_type{} : fs::last_write_time(path, ec);
+	stamp.time = static_cast<std::int64_t>(time.time_since_epoch().count());
+	return !ec;
+}
+
+void interval_table::assign(const std::vector<interval<std::uint32_t>>& v4, const std::vector<interval<u128>>& v6, bool with_payloads) {
+	cache.close();
+	owned_v4.assign(v4_index_size + 2 * v4.size(), 0);
+	std::uint32_t* const index = owned_v4.data();
+	std::uint32_t* const starts = index + v4_index_size;
+	std::uint32_t* const ends = starts + v4.size();
+	for (std::size_t i = 0; i < v4.size(); ++i) {
+		starts[i] = v4[i].start;
+		ends[i] = v4[i].end;
+	}
+	std::size_t first = 0;
+	for (std::size_t b = 0; b < v4_index_size; ++b) {
+		while (first < v4.size() && ends[first] < (b << 16))
+			++first;
+		index[b] = static_cast<std::uint32_t>(first);
+	}
+
+	owned_v6.resize(2 * v6.size());
+	for (std::size_t i = 0; i < v6.size(); ++i) {
+		owned_v6[i] = v6[i].start;
+		owned_v6[v6.size() + i] = v6[i].end;
+	}
+
+	owned_payloads.clear();
+	if (with_payloads) {
+		for (const interval<std::uint32_t>& range : v4)
+			owned_payloads.push_back(range.payload);
+		for (const interval<u128>& range : v6)
+			owned_payloads.push_back(range.payload);
+	}
+
+	v4_index = std::span<const std::uint32_t>(index, v4_index_size);
+	v4_starts = std::span<const std::uint32_t>(starts, v4.size());
+	v4_ends = std::span<const std::uint32_t>(ends, v4.size());
+	v6_starts = std::span<const u128>(owned_v6.data(), v6.size());
+	v6_ends = std::span<const u128>(owned_v6.data() + v6.size(), v6.size());
+	payloads = owned_payloads;
+}
+
+bool interval_table::load(const fs::path& cache_path, const char (&magic)[8], const source_stamp& stamp, std::string_view& extra) {
+	if (!cache.open(cache_path.string()))
+		return false;
+	cache_header header{};
+	if (cache.size() < sizeof(header)) {
+		cache.close();
+		return false;
+	}
+	std::memcpy(&header, cache.data(), sizeof(header));
+	const std::uint64_t payload_count = header.with_payloads ? header.v4_count + header.v6_count : 0;
+	const bool valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0 && header.byte_order == byte_order_mark
+		&& header.source_size == stamp.size && header.source_time == stamp.time && header.with_payloads <= 1
+		&& header.v4_count <= UINT32_MAX && header.v6_count <= UINT32_MAX && header.extra_size <= cache.size()
+		&& cache.size() == sizeof(header) + v4_bytes(header.v4_count) + 2 * header.v6_count * sizeof(u128)
+			+ padded(payload_count * sizeof(std::uint32_t)) + header.extra_size;
+	if (!valid) {
+		cache.close();
+		return false;
+	}
+
+	// the mapping is page aligned and every part starts on an 8 byte boundary
+	const auto v4_count = static_cast<std::size_t>(header.v4_count);
+	const auto v6_count = static_cast<std::size_t>(header.v6_count);
+	const char* at = cache.data() + sizeof(header);
+	const auto* v4 = reinterpret_cast<const std::uint32_t*>(at);
+	v4_index = std::span<const std::uint32_t>(v4, v4_index_size);
+	v4_starts = std::span<const std::uint32_t>(v4 + v4_index_size, v4_count);
+	v4_ends = std::span<const std::uint32_t>(v4 + v4_index_size + v4_count, v4_count);
+	at += v4_bytes(v4_count);
+	const auto* v6 = reinterpret_cast<const u128*>(at);
+	v6_starts = std::span<const u128>(v6, v6_count);
+	v6_ends = std::span<const u128>(v6 + v6_count, v6_count);
+	at += 2 * v6_count * sizeof(u128);
+	payloads = std::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t*>(at), static_cast<std::size_t>(payload_count));
+	at += padded(payloads.size_bytes());
+	extra = std::string_view(at, static_cast<std::size_t>(header.extra_size));
+	if (!std::is_sorted(v4_index.begin(), v4_index.end()) || v4_index.back() != v4_count) {
+		cache.close();
+		return false;
+	}
+	owned_v4.clear();
+	owned_v6.clear();
+	owned_payloads.clear();
+	return true;
+}
+
+void interval_table::save(const fs::path& cache_path, const char (&magic)[8], const source_stamp& stamp, std::string_view extra) const {
+	atomic_output output(cache_path);
+	if (!output.is_open())
+		return;
+	cache_header header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.byte_order = byte_order_mark;
+	header.with_payloads = !payloads.empty();
+	header.source_size = stamp.size;
+	header.source_time = stamp.time;
+	header.v4_count = v4_starts.size();
+	header.v6_count = v6_starts.size();
+	header.extra_size = extra.size();
+
+	std::ostream& out = output.stream();
+	const auto write_padded = [&](const void* data, std::size_t bytes) {
+		out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+		out.write("\0\0\0\0\0\0\0", static_cast<std::streamsize>(padded(bytes) - bytes));
+	};
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	// the parts are contiguous, whether owned or mapped
+	write_padded(v4_index.data(), (v4_index_size + 2 * v4_starts.size()) * sizeof(std::uint32_t));
+	write_padded(v6_starts.data(), 2 * v6_starts.size() * sizeof(u128));
+	write_padded(payloads.data(), payloads.size_bytes());
+	out.write(extra.data(), static_cast<std::streamsize>(extra.size()));
+	output_result result{};
+	output.commit(result);
+}
+
+std::size_t interval_table::find_v4(std::uint32_t ip) const {
+	// the interval holding ip, if any, is the first one ending at or after it, and
+	// that one is between where ip's /16 and the next /16 start
+	const std::size_t b = ip >> 16;
+	const std::size_t first = v4_index[b];
+	const std::size_t last = std::min<std::size_t>(v4_index[b + 1] + 1, v4_ends.size());
+	const auto it = std::lower_bound(v4_ends.begin() + first, v4_ends.begin() + last, ip);
+	if (it == v4_ends.begin() + last || v4_starts[it - v4_ends.begin()] > ip)
+		return npos;
+	return static_cast<std::size_t>(it - v4_ends.begin());
+}
+
+std::size_t interval_table::find(const server_address& address) const {
+	if (address.kind == address_kind::ipv4)
+		return find_v4(address.ipv4);
+	if (address.kind != address_kind::ipv6)
+		return npos;
+	const u128 value = to_u128(address.ipv6);
+	const auto it = std::lower_bound(v6_ends.begin(), v6_ends.end(), value);
+	if (it != v6_ends.end() && v6_starts[it - v6_ends.begin()] <= value)
+		return v4_starts.size() + static_cast<std::size_t>(it - v6_ends.begin());
+	if (value.hi == 0 && value.lo >> 32 == 0xffff)
+		return find_v4(static_cast<std::uint32_t>(value.lo));
+	return npos;
+}
@@ -6,7 +6,36 @@
 #include <filesystem>
 #include "parse.hpp"
 #include "NBTWriter.h"
+#include "export.hpp"
+#include "append.hpp"
+#include "output.hpp"
+#include "shard.hpp"
+#include "registry.hpp"
+#include "dedup.hpp"
+#include "sort.hpp"
+#include "external.hpp"
+#include "filter.hpp"
+#include "blocklist.hpp"
+#include "interval_table.hpp"
+#include "expand.hpp"
+#include "sample.hpp"
+#include "icon.hpp"
+#include "ping.hpp"
+#include "ping_cache.hpp"
+#include "prefix_labels.hpp"
+#include "parse_cache.hpp"
+#include "watch.hpp"
 #include <vector>
+#include <bit>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <numeric>
+#include <chrono>
+#include <ranges>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -15,15 +44,46 @@ namespace fs = std::filesystem;
 #define isatty _isatty
 #else
 #include <unistd.h> // isatty
+#include <glob.h>
 #endif
 
 void usage(const std::string_view program) {
 	std::cout << "Usage: " << program << " -i <ip_list_input> [options]\n";
 	std::cout << "Options\n";
 	std::cout << "\t-i <input_file>\t\t\tInput file with list of ips\n";
-	std::cout << "\t-t <csv|toml|json>\t\tSpecifies the type of input file\n";
-	std::cout << "\t-o <output_path>\t\tSpecifies the output. Default is 'servers.dat'\n";
+	std::cout << "\t-t <csv|toml|json|ranges>\tSpecifies the type of input file. ranges is csv with CIDR blocks or [a-b] patterns for ips\n";
+	std::cout << "\t-o <output_path>\t\tSpecifies the output. Default is 'servers.dat'. Repeat it, or give a glob or @list_file, to write many copies\n";
 	std::cout << "\t--stdout\t\t\tOutputs the servers nbt to stdout. Equivalent to -o stdout\n";
+	std::cout << "\t--nbt-endian <big|little>\tByte order of the output. Default is 'big' (Java). Use 'little' for Bedrock\n";
+	std::cout << "\t--append\t\t\tAdds the servers to the end of an existing servers.dat instead of replacing it\n";
+	std::cout << "\t--shard-max-entries <n>\t\tSplits the output into servers.0.dat, servers.1.dat, ... of at most n servers each\n";
+	std::cout << "\t--shard-max-bytes <size>\tSplits the output into files of at most size bytes each (k, m and g suffixes allowed)\n";
+	std::cout << "\t--shard-by <order|ip>\t\tFills shards in input order, or spreads servers by a hash of their ip. Default is 'order'\n";
+	std::cout << "\t--filter <expression>\t\tKeeps only the servers that match, e.g. 'port == 25565 && name ~ \"^EU\"' or 'ip in 10.0.0.0/8'\n";
+	std::cout << "\t--exclude-cidr <file>\t\tDrops the servers whose address is in one of the CIDR ranges listed in file\n";
+	std::cout << "\t--canonicalize\t\t\tRewrites ips in canonical form (no default port, lowercase hosts, ...) and drops invalid ones\n";
+	std::cout << "\t--validate-icons\t\tClears icons that aren't valid base64 of a 64x64 PNG or are too large\n";
+	std::cout << "\t--ping\t\t\t\tAsks the servers for their status and fills in empty names with the MOTD and empty icons with the favicon\n";
+	std::cout << "\t--ping-timeout <ms>\t\tGives up on a server after this long. Default is 3000\n";
+	std::cout << "\t--ping-concurrency <n>\t\tServers pinged at once. Default is 1000\n";
+	std::cout << "\t--ping-cache <file>\t\tKeeps ping results in file and only pings the servers whose result expired\n";
+	std::cout << "\t--ping-ttl <duration>\t\tHow long an answer stays in the cache (s, m, h and d suffixes allowed). Default is 1d\n";
+	std::cout << "\t--ping-negative-ttl <duration>\tHow long a server that didn't answer stays in the cache. Default is 1h\n";
+	std::cout << "\t--prefix-labels <file>\t\tNames the servers without a name by the label of their address in a cidr,label csv file\n";
+	std::cout << "\t--label-names <template>\tName given by --prefix-labels, {label} and {ip} are replaced. Default is '[{label}] {ip}'\n";
+	std::cout << "\t--dedup [first|last]\t\tKeeps only the first (default) or the last server listed for each address\n";
+	std::cout << "\t--sort <name|ip|addr>\t\tSorts the servers by name, by ip text or by numeric address\n";
+	std::cout << "\t--reverse\t\t\tSorts in descending order\n";
+	std::cout << "\t--sample <n>\t\t\tKeeps a uniform random sample of n servers, in input order\n";
+	std::cout << "\t--seed <number>\t\t\tSeed for --sample, to repeat a sample. Default is random\n";
+	std::cout << "\t--mem-limit <size>\t\tProcesses the input in batches of about size bytes, sorting and deduplicating through temporary files\n";
+	std::cout << "\t--registry <file>\t\tAdds the input servers to a registry file and writes servers.dat from all servers in it\n";
+	std::cout << "\t--registry-delete\t\tRemoves the input servers (by ip) from the registry instead\n";
+	std::cout << "\t--registry-compact\t\tRewrites the registry without its replaced and deleted records\n";
+	std::cout << "\t--watch\t\t\t\tKeeps running and rewrites the output whenever the -i file, or a file in the -i directory, changes\n";
+	std::cout << "\t--watch-debounce <ms>\t\tWaits this long after a change for more of them before rewriting. Default is 50\n";
+	std::cout << "\t--parse-cache <dir>\t\tKeeps the output of every run in dir and reuses it when the input and options are the same\n";
+	std::cout << "\t--export <csv|toml|json>\tReads the servers.dat given with -i and writes its servers in that format. Default output is stdout\n";
 }
 
 void parse_arg(const std::string_view cmd, 
@@ -43,38 +103,84 @@ void parse_arg(const std::string_view cmd,
 }
 
 
-void ips_to_dat(std::istream* ip_stream, const std::string_view output_path, const std::string_view format) {
-	fs::path output_fs_path = output_path;
-	if (output_fs_path.empty()) {
-		std::cout << "Output path is empty\n";
-		exit(1);
-	}
-
-	if (fs::is_directory(output_fs_path)) {
-		output_fs_path = output_fs_path / "servers.dat";	
-	}
-
-	std::stringstream buffer;
-	buffer << ip_stream->rdbuf();
+// Parses a count or byte size with an optional k/m/g suffix (powers of 1024)
+bool parse_size(const std::string_view text, std::uint64_t& value) {
+	std::uint64_t number = 0;
+	const auto [rest, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+	if (ec != std::errc() || rest == text.data())
+		return false;
+	const std::string_view suffix(rest, text.data() + text.size() - rest);
+	int shift = 0;
+	if (suffix == "k" || suffix == "K")
+		shift = 10;
+	else if (suffix == "m" || suffix == "M")
+		shift = 20;
+	else if (suffix == "g" || suffix == "G")
+		shift = 30;
+	else if (!suffix.empty())
+		return false;
+	if (number > (UINT64_MAX >> shift))
+		return false;
+	value = number << shift;
+	return true;
+}
 
-	const std::string ips_content = buffer.str();
-	const std::vector<nbtserver> servers = [&](){
-		if (format == "csv")
-			return parse_servers_csv(ips_content);
-		else if (format == "toml")
-			return parse_servers_toml(ips_content);
-		else if (format == "json")
-			return parse_servers_json(ips_content);
-		return std::vector<nbtserver>{};
-	}(); 
+// Parses a duration in seconds with an optional s/m/h/d suffix
+bool parse_duration(const std::string_view text, std::chrono::seconds& value) {
+	std::uint64_t number = 0;
+	const auto [rest, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+	if (ec != std::errc() || rest == text.data())
+		return false;
+	const std::string_view suffix(rest, text.data() + text.size() - rest);
+	std::uint64_t unit = 1;
+	if (suffix == "m")
+		unit = 60;
+	else if (suffix == "h")
+		unit = 60 * 60;
+	else if (suffix == "d")
+		unit = 24 * 60 * 60;
+	else if (!suffix.empty() && suffix != "s")
+		return false;
+	// a hundred years is plenty, and keeps expiry times far from overflowing
+	constexpr std::uint64_t max_seconds = 100ull * 365 * 24 * 60 * 60;
+	if (number > max_seconds / unit)
+		return false;
+	value = std::chrono::seconds(number * unit);
+	return true;
+}
 
-	if (servers.empty()) {
-		std::cout << "There are no servers in your input file\n";
-		exit(1);
-	}
+struct output_options {
+	std::endian endian = std::endian::big;
+	bool append = false;
+	shard_limits shards{};
+	bool canonicalize = false;
+	bool validate_icons = false;
+	bool ping = false;
+	ping_options ping_limits{};
+	ping_cache* ping_results = nullptr; // --ping-cache, owned by main
+	std::optional<server_filter> filter{};
+	std::optional<cidr_blocklist> blocklist{};
+	std::optional<prefix_labels> labels{};
+	std::string label_names = "[{label}] {ip}";
+	bool sort = false;
+	sort_key sort_by = sort_key::name;
+	bool reverse = false;
+	std::uint64_t mem_limit = 0; // 0 keeps everything in memory
+	std::size_t sample = 0; // 0 keeps every server
+	std::uint64_t seed = 0;
+	bool dedup = false;
+	dedup_mode dedup_keep = dedup_mode::first;
+	std::string registry{};
+	bool registry_delete = false;
+	bool registry_compact = false;
+	parse_cache* parse_results = nullptr; // --parse-cache, owned by main
+	std::string parse_key{}; // what shapes the output besides the input, keys the parse cache
+	fs::path input_path{}; // empty when the input is piped
+};
 
-	NBT::NBTWriter writer(output_fs_path.string().data(), output_fs_path == "stdout");
-	writer.writeListHead("servers", NBT::idCompound, servers.size());
+template <std::endian E, typename Servers>
+void write_servers(NBT::NBTWriter<E>& writer, const Servers& servers) {
+	writer.writeListHead("servers", NBT::idCompound, std::ranges::size(servers));
 	for (const nbtserver& server : servers) {	
 		#if 0
 		std::cout << server.name << '\n';
@@ -90,20 +196,844 @@ void ips_to_dat(std::istream* ip_stream, const std::string_view output_path, con
 		writer.writeByte("acceptTextures", server.accept_textures);
 		writer.endCompound();
 	}
-	writer.endCompound();
-	writer.close();
+	writer.close(); // ends the root compound
+}
+
+// readers of the old file never see a half written one, and identical output leaves it alone
+template <std::endian E, typename Servers>
+bool write_servers_file(const fs::path& output_fs_path, const Servers& servers, output_result& result) {
+	atomic_output output(output_fs_path);
+	if (!output.is_open())
+		return false;
+	NBT::NBTWriter<E> writer(&output.stream());
+	write_servers(writer, servers);
+	return output.commit(result);
+}
+
+void report_output(const fs::path& output_fs_path, const std::size_t server_count, const output_result& result) {
+	if (result.written)
+		std::cout << "wrote " << server_count << " servers to " << output_fs_path.string() << " (xxh64 " << hash_hex(result.hash) << ")\n";
+	else
+		std::cout << output_fs_path.string() << " is unchanged (xxh64 " << hash_hex(result.hash) << ")\n";
+}
+
+template <std::endian E, typename Servers>
+void write_servers(const fs::path& output_fs_path, const Servers& servers) {
+	if (output_fs_path == "stdout") {
+		NBT::NBTWriter<E> writer(output_fs_path.string().data(), true);
+		write_servers(writer, servers);
+		return;
+	}
+
+	output_result result{};
+	if (!write_servers_file<E>(output_fs_path, servers, result)) {
+		std::cout << "Unable to write " << output_fs_path.string() << '\n';
+		exit(1);
+	}
+	report_output(output_fs_path, std::ranges::size(servers), result);
+}
+
+// Every shard is encoded and written by its own worker
+template <std::endian E>
+void write_shards(const fs::path& output_fs_path, const std::vector<nbtserver>& servers, const shard_limits& limits) {
+	std::vector<std::vector<std::size_t>> shards{};
+	if (!partition_servers(servers, limits, shards)) {
+		std::cout << "Can't spread the servers by ip hash within the shard limits, servers sharing an ip always share a shard. Raise the limits or use --shard-by order\n";
+		exit(1);
+	}
+	std::vector<output_result> results(shards.size());
+	std::vector<char> written(shards.size(), false);
+
+	std::atomic<std::size_t> next_shard{0};
+	const auto worker = [&]() {
+		for (std::size_t i; (i = next_shard++) < shards.size();) {
+			const auto shard_servers = shards[i] | std::views::transform([&](std::size_t index) -> const nbtserver& {
+				return servers[index];
+			});
+			written[i] = write_servers_file<E>(shard_path(output_fs_path, i), shard_servers, results[i]);
+		}
+	};
+	{
+		const std::size_t thread_count = std::min<std::size_t>(shards.size(), std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<std::jthread> threads;
+		for (std::size_t i = 1; i < thread_count; ++i)
+			threads.emplace_back(worker);
+		worker();
+	}
+
+	bool failed = false;
+	for (std::size_t i = 0; i < shards.size(); ++i) {
+		if (!written[i]) {
+			std::cout << "Unable to write " << shard_path(output_fs_path, i).string() << '\n';
+			failed = true;
+			continue;
+		}
+		report_output(shard_path(output_fs_path, i), shards[i].size(), results[i]);
+	}
+	if (failed)
+		exit(1);
+	for (const fs::path& stale : remove_stale_shards(output_fs_path, shards.size()))
+		std::cout << "removed " << stale.string() << ", left over from a run with more shards\n";
+}
+
+template <std::endian E>
+std::string encode_servers(const std::vector<nbtserver>& servers) {
+	std::ostringstream encoded;
+	{
+		NBT::NBTWriter<E> writer(&encoded);
+		write_servers(writer, servers);
+	}
+	return std::move(encoded).str();
+}
+
+// Writes an encoded servers.dat to every target and reports it
+void write_encoded(const std::vector<fs::path>& output_fs_paths, const std::string_view bytes, const std::size_t server_count) {
+	if (output_fs_paths.front() == "stdout") {
+		std::fwrite(bytes.data(), 1, bytes.size(), stdout);
+		std::fflush(stdout);
+		return;
+	}
+	const std::uint64_t hash = hash_bytes(bytes);
+
+	std::vector<output_result> results{};
+	const std::vector<char> written = write_outputs(output_fs_paths, bytes, hash, results);
+
+	if (output_fs_paths.size() == 1) {
+		if (!written[0]) {
+			std::cout << "Unable to write " << output_fs_paths[0].string() << '\n';
+			exit(1);
+		}
+		report_output(output_fs_paths[0], server_count, results[0]);
+		return;
+	}
+	std::size_t changed = 0;
+	std::size_t failed = 0;
+	for (std::size_t i = 0; i < output_fs_paths.size(); ++i) {
+		if (!written[i]) {
+			std::cout << "Unable to write " << output_fs_paths[i].string() << '\n';
+			++failed;
+		} else if (results[i].written) {
+			++changed;
+		}
+	}
+	std::cout << "wrote " << server_count << " servers to " << changed << " of " << output_fs_paths.size() << " outputs, "
+		<< output_fs_paths.size() - changed - failed << " unchanged (xxh64 " << hash_hex(hash) << ")\n";
+	if (failed)
+		exit(1);
+}
+
+// Encodes once into memory for every target
+template <std::endian E>
+void write_fanout(const std::vector<fs::path>& output_fs_paths, const std::vector<nbtserver>& servers) {
+	write_encoded(output_fs_paths, encode_servers<E>(servers), servers.size());
+}
+
+// -o values: a path, a glob pattern, or @file with one path per line
+std::vector<std::string> expand_output_targets(const std::vector<std::string>& targets) {
+	std::vector<std::string> expanded{};
+	for (const std::string& target : targets) {
+		if (target.starts_with('@')) {
+			std::ifstream list(target.substr(1));
+			if (!list.is_open()) {
+				std::cout << "Unable to open output list for reading (" << target.substr(1) << ")\n";
+				exit(1);
+			}
+			for (std::string line; std::getline(list, line);) {
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!line.empty() && !line.starts_with('#'))
+					expanded.push_back(line);
+			}
+			continue;
+		}
+#ifndef _WIN32
+		if (target.find_first_of("*?[") != std::string::npos) {
+			glob_t matches{};
+			if (glob(target.c_str(), 0, nullptr, &matches) != 0 || matches.gl_pathc == 0) {
+				globfree(&matches);
+				std::cout << "No outputs match '" << target << "'\n";
+				exit(1);
+			}
+			for (std::size_t i = 0; i < matches.gl_pathc; ++i)
+				expanded.emplace_back(matches.gl_pathv[i]);
+			globfree(&matches);
+			continue;
+		}
+#endif
+		expanded.push_back(target);
+	}
+	return expanded;
+}
+
+std::vector<nbtserver> parse_servers(std::istream* ip_stream, const std::string_view format) {
+	std::stringstream buffer;
+	buffer << ip_stream->rdbuf();
+
+	const std::string ips_content = buffer.str();
+	if (format == "csv")
+		return parse_servers_csv(ips_content);
+	else if (format == "toml")
+		return parse_servers_toml(ips_content);
+	else if (format == "json")
+		return parse_servers_json(ips_content);
+	return std::vector<nbtserver>{};
+}
+
+// What the prepare stages dropped or changed, summed over every batch
+struct prepare_stats {
+	canonicalize_stats canonical{};
+	std::uint64_t excluded = 0;
+	std::uint64_t filtered = 0;
+	ping_stats pinged{};
+	std::uint64_t labelled = 0;
+	icon_cache icons{}; // shared by every batch, so each icon file is read once
+	icon_check_stats checked_icons{};
+};
+
+// Per server stages that run before anything is ordered or written. They only drop
+// or rewrite servers, so they can run on one batch of the input at a time.
+// The selecting stages decide which servers are kept
+void select_servers(std::vector<nbtserver>& servers, const output_options& options, prepare_stats& prepared) {
+	if (options.canonicalize) {
+		canonicalize_stats& canonical = prepared.canonical;
+		const canonicalize_stats stats = canonicalize_servers(servers);
+		canonical.changed += stats.changed;
+		canonical.rejected += stats.rejected;
+		for (std::size_t i = 0; i < address_error_count; ++i)
+			canonical.errors[i] += stats.errors[i];
+		for (const std::string& example : stats.examples) {
+			if (canonical.examples.size() < canonicalize_stats::max_examples)
+				canonical.examples.push_back(example);
+		}
+	}
+	// after canonicalizing, so these see the canonical text and the parsed address
+	if (options.blocklist)
+		prepared.excluded += options.blocklist->exclude(servers);
+	if (options.filter)
+		prepared.filtered += options.filter->apply(servers);
+}
+
+// The enriching stages fill in the kept servers, so dropped servers are never pinged
+// and never load their icon
+void enrich_servers(std::vector<nbtserver>& servers, const output_options& options, prepare_stats& prepared) {
+	if (options.ping) {
+		ping_stats& pinged = prepared.pinged;
+		const ping_stats stats = ping_servers(servers, options.ping_limits, options.ping_results);
+		if (options.ping_results && !options.ping_results->flush())
+			std::cerr << "warning: unable to update the ping cache\n";
+		pinged.pinged += stats.pinged;
+		pinged.cached += stats.cached;
+		for (std::size_t i = 0; i < ping_status_count; ++i)
+			pinged.statuses[i] += stats.statuses[i];
+		pinged.names += stats.names;
+		pinged.icons += stats.icons;
+	}
+	// after pinging, so a server's own MOTD is preferred to a label
+	if (options.labels)
+		prepared.labelled += options.labels->name_servers(servers, options.label_names);
+	// after pinging, so favicons are validated too
+	prepared.icons.resolve(servers);
+	if (options.validate_icons) {
+		icon_check_stats& checked = prepared.checked_icons;
+		const icon_check_stats stats = validate_icons(servers);
+		checked.cleared += stats.cleared;
+		for (std::size_t i = 0; i < icon_error_count; ++i)
+			checked.errors[i] += stats.errors[i];
+		for (const std::string& example : stats.examples) {
+			if (checked.examples.size() < icon_check_stats::max_examples)
+				checked.examples.push_back(example);
+		}
+	}
+}
+
+void prepare_servers(std::vector<nbtserver>& servers, const output_options& options, prepare_stats& prepared) {
+	select_servers(servers, options, prepared);
+	enrich_servers(servers, options, prepared);
+}
+
+void report_pinged(const ping_stats& pinged, const bool quiet) {
+	if (quiet)
+		return;
+	std::cout << "pinged " << pinged.pinged << " servers";
+	if (pinged.cached)
+		std::cout << ", " << pinged.cached << " more from the cache";
+	std::cout << " (";
+	const char* separator = "";
+	for (std::size_t i = 0; i < ping_status_count; ++i) {
+		if (pinged.statuses[i]) {
+			std::cout << separator << pinged.statuses[i] << ' ' << ping_status_name(static_cast<ping_status>(i));
+			separator = ", ";
+		}
+	}
+	std::cout << "), filled in " << pinged.names << " names and " << pinged.icons << " icons\n";
+}
+
+void report_icons(const icon_cache& icons, const bool quiet) {
+	if (icons.files() && !quiet)
+		std::cout << "loaded " << icons.files() << " icon files (" << icons.images() << " distinct images)\n";
+	const auto& failures = icons.failures();
+	if (failures.empty())
+		return;
+	std::cerr << "warning: " << failures.size() << " icon files can't be used, their servers have no icon\n";
+	for (std::size_t i = 0; i < failures.size() && i < 5; ++i)
+		std::cerr << "\t'" << failures[i].first << "': " << icon_error_name(failures[i].second) << '\n';
+}
+
+void report_checked_icons(const icon_check_stats& checked, const bool quiet, const std::string_view scope) {
+	if (!checked.cleared) {
+		if (!quiet)
+			std::cout << "all icons are valid" << scope << '\n';
+		return;
+	}
+	std::cerr << "warning: cleared " << checked.cleared << " broken icons (";
+	const char* separator = "";
+	for (std::size_t i = 1; i < icon_error_count; ++i) {
+		if (checked.errors[i]) {
+			std::cerr << separator << checked.errors[i] << ' ' << icon_error_name(static_cast<icon_error>(i));
+			separator = ", ";
+		}
+	}
+	std::cerr << ')' << scope << '\n';
+	for (const std::string& example : checked.examples)
+		std::cerr << "\t'" << example << "'\n";
+}
+
+// scope says which servers the counts are of when it's not all of them
+void report_prepared(const output_options& options, const prepare_stats& prepared, const bool quiet, const std::string_view scope = {}) {
+	if (options.ping)
+		report_pinged(prepared.pinged, quiet);
+	if (options.labels && !quiet)
+		std::cout << "named " << prepared.labelled << " servers from prefix labels" << scope << '\n';
+	report_icons(prepared.icons, quiet);
+	if (options.blocklist && !quiet)
+		std::cout << "excluded " << prepared.excluded << " blocklisted servers" << scope << '\n';
+	if (options.filter && !quiet)
+		std::cout << "filtered out " << prepared.filtered << " servers" << scope << '\n';
+	if (options.validate_icons)
+		report_checked_icons(prepared.checked_icons, quiet, scope);
+	if (!options.canonicalize)
+		return;
+	const canonicalize_stats& canonical = prepared.canonical;
+	if (!quiet)
+		std::cout << "canonicalized " << canonical.changed << " addresses" << scope << '\n';
+	if (canonical.rejected) {
+		std::cerr << "warning: dropped " << canonical.rejected << " servers with an invalid address (";
+		const char* separator = "";
+		for (std::size_t i = 1; i < address_error_count; ++i) {
+			if (canonical.errors[i]) {
+				std::cerr << separator << canonical.errors[i] << ' ' << address_error_name(static_cast<address_error>(i));
+				separator = ", ";
+			}
+		}
+		std::cerr << ')' << scope << '\n';
+		for (const std::string& example : canonical.examples)
+			std::cerr << "\t'" << example << "'\n";
+	}
+}
+
+// Applies the input to the registry, then writes servers.dat from everything in it.
+// ip_stream is null when there's no input and the registry is only exported
+void registry_to_dat(std::istream* ip_stream, const fs::path& output_fs_path, const std::string_view format, const output_options& options) {
+	server_registry registry(options.registry);
+	if (!registry.is_open()) {
+		std::cout << "Unable to open registry " << options.registry << '\n';
+		exit(1);
+	}
+
+	std::size_t changed = 0;
+	if (ip_stream) {
+		std::vector<nbtserver> servers = parse_servers(ip_stream, format);
+		prepare_stats prepared{};
+		prepare_servers(servers, options, prepared);
+		report_prepared(options, prepared, false);
+		for (const nbtserver& server : servers)
+			changed += options.registry_delete ? registry.erase(server.ip) : registry.upsert(server);
+	}
+	if (!registry.flush()) {
+		std::cout << "Unable to update registry " << options.registry << '\n';
+		exit(1);
+	}
+	if ((options.registry_compact || registry.should_compact()) && !registry.compact()) {
+		std::cout << "Unable to compact registry " << options.registry << '\n';
+		exit(1);
+	}
+	if (output_fs_path == "stdout") {
+		registry.write_servers_dat(std::cout, options.endian);
+		return;
+	}
+
+	std::cout << "registry " << options.registry << ": " << changed << (options.registry_delete ? " removed, " : " added or changed, ")
+		<< registry.size() << " servers\n";
+	atomic_output output(output_fs_path);
+	output_result result{};
+	if (!output.is_open() || !registry.write_servers_dat(output.stream(), options.endian) || !output.commit(result)) {
+		std::cout << "Unable to write " << output_fs_path.string() << '\n';
+		exit(1);
+	}
+	report_output(output_fs_path, registry.size(), result);
+}
+
+// --sample: the selecting stages run first, so the sample is taken from the servers
+// that pass them. Only the sample is enriched
+std::vector<nbtserver> sample_input(std::istream* ip_stream, const std::string_view format, const output_options& options, prepare_stats& prepared, const bool quiet) {
+	const bool selecting = options.canonicalize || options.filter || options.blocklist;
+	sample_stats stats{};
+	std::vector<nbtserver> servers;
+	if (format == "csv") {
+		batch_hook select{};
+		if (selecting)
+			select = [&](std::vector<nbtserver>& batch) { select_servers(batch, options, prepared); };
+		servers = sample_csv(*ip_stream, options.sample, options.seed, select, stats);
+	} else {
+		servers = parse_servers(ip_stream, format);
+		select_servers(servers, options, prepared);
+		stats.seen = servers.size();
+		sample_servers(servers, options.sample, options.seed);
+	}
+	enrich_servers(servers, options, prepared);
+	if (stats.invalid)
+		std::cerr << "warning: skipped " << stats.invalid << " lines that are missing required fields\n";
+	if (!quiet)
+		std::cout << "sampled " << servers.size() << " of " << stats.seen << " servers (--seed " << options.seed << ")\n";
+	return servers;
+}
+
+// -t ranges: servers are generated while they're written, the expansion is never in memory
+void ranges_to_dat(std::istream* ip_stream, const fs::path& output_fs_path, const output_options& options) {
+	std::stringstream buffer;
+	buffer << ip_stream->rdbuf();
+	const server_ranges ranges(buffer.str());
+	if (!ranges.ok()) {
+		std::cout << "Invalid range list: " << ranges.error() << '\n';
+		exit(1);
+	}
+
+	// generated servers already carry their parsed address
+	const bool filtering = options.filter || options.blocklist;
+	const auto dropped = [&](const nbtserver& server) {
+		return (options.blocklist && options.blocklist->contains(server.address)) || (options.filter && !options.filter->matches(server));
+	};
+	icon_cache icons{};
+	const bool quiet = output_fs_path == "stdout";
+	if (options.sample) {
+		// picks positions without generating the servers in between, unless they have to be filtered
+		reservoir_sampler sampler(options.sample, options.seed);
+		std::vector<std::pair<std::uint64_t, nbtserver>> picked;
+		std::uint64_t seen = 0;
+		nbtserver server{};
+		for (std::uint64_t i = filtering ? 0 : sampler.next(); i < ranges.size(); i = filtering ? i + 1 : sampler.next()) {
+			ranges.at(i, server);
+			if (filtering && dropped(server))
+				continue;
+			const std::uint64_t position = filtering ? seen++ : i;
+			const std::size_t slot = sampler.offer(position);
+			if (slot == picked.size())
+				picked.emplace_back(i, server);
+			else if (slot != reservoir_sampler::npos)
+				picked[slot] = {i, server};
+		}
+		std::sort(picked.begin(), picked.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		std::vector<nbtserver> servers;
+		for (auto& [index, sampled] : picked)
+			servers.push_back(std::move(sampled));
+		const std::size_t labelled = options.labels ? options.labels->name_servers(servers, options.label_names) : 0;
+		icons.resolve(servers);
+		if (options.labels && !quiet)
+			std::cout << "named " << labelled << " servers from prefix labels\n";
+		report_icons(icons, quiet);
+		if (!quiet)
+			std::cout << "sampled " << servers.size() << " of " << (filtering ? seen : ranges.size()) << " servers (--seed " << options.seed << ")\n";
+		if (servers.empty()) {
+			std::cout << "All servers were filtered out\n";
+			exit(1);
+		}
+		if (options.endian == std::endian::little)
+			write_servers<std::endian::little>(output_fs_path, servers);
+		else
+			write_servers<std::endian::big>(output_fs_path, servers);
+		return;
+	}
+
+	expanded_servers::predicate keep{};
+	std::size_t labelled = 0; // reported after the pass that counts the servers, before writing runs keep again
+	if (filtering || ranges.has_file_icons() || options.labels) {
+		keep = [&](nbtserver& server) {
+			if (filtering && dropped(server))
+				return false;
+			if (options.labels)
+				labelled += options.labels->name(server, options.label_names);
+			icons.resolve(server);
+			return true;
+		};
+	}
+	const expanded_servers servers(ranges, keep);
+	if (options.labels && !quiet)
+		std::cout << "named " << labelled << " servers from prefix labels\n";
+	report_icons(icons, quiet);
+	if (filtering && !quiet)
+		std::cout << "filtered out " << ranges.size() - servers.size() << " of " << ranges.size() << " servers\n";
+	if (servers.size() == 0) {
+		std::cout << (filtering ? "All servers were filtered out\n" : "There are no servers in your input file\n");
+		exit(1);
+	}
+
+	if (options.endian == std::endian::little)
+		write_servers<std::endian::little>(output_fs_path, servers);
+	else
+		write_servers<std::endian::big>(output_fs_path, servers);
+}
+
+// --mem-limit: batches, spilled to sorted runs when they have to be reordered
+void external_to_dat(std::istream& ip_stream, const fs::path& output_fs_path, const std::string_view format, const output_options& options) {
+	const external_options external{
+		.mem_limit = options.mem_limit,
+		.sort = options.sort,
+		.key = options.sort ? options.sort_by : sort_key::addr,
+		.reverse = options.reverse,
+		.dedup = options.dedup,
+		.dedup_keep = options.dedup_keep,
+		.endian = options.endian,
+	};
+	prepare_stats prepared{};
+	external_stats stats{};
+	output_result result{};
+	const bool written = write_servers_external(ip_stream, format, output_fs_path, external, [&](std::vector<nbtserver>& batch) {
+		prepare_servers(batch, options, prepared);
+	}, stats, result);
+	report_prepared(options, prepared, false);
+	if (stats.too_many) {
+		std::cout << "Too many servers: a servers.dat list holds at most " << INT32_MAX << '\n';
+		exit(1);
+	}
+	if (!written) {
+		std::cout << "Unable to write " << output_fs_path.string() << '\n';
+		exit(1);
+	}
+	if (stats.written == 0) {
+		std::cout << "There are no servers in your input file\n";
+		exit(1);
+	}
+	if (stats.runs)
+		std::cout << "sorted " << stats.read << " servers in " << stats.runs << " runs\n";
+	if (options.dedup)
+		std::cout << "removed " << stats.duplicates << " duplicate servers\n";
+	report_output(output_fs_path, stats.written, result);
+}
+
+// --parse-cache: writes the output of an earlier run on the same input with the same
+// options. An input file is only read when its size or time changed since it was last
+// hashed. On a miss the input is left in content, and input_hash keys the new entry
+bool reuse_parsed(std::istream* ip_stream, const std::vector<fs::path>& output_fs_paths, const output_options& options, std::string& content, std::uint64_t& input_hash) {
+	const parse_cache& cache = *options.parse_results;
+	const auto read_input = [&]() {
+		std::stringstream buffer;
+		buffer << ip_stream->rdbuf();
+		content = std::move(buffer).str();
+	};
+	parse_cache::file_stamp stamp{};
+	const bool from_file = !options.input_path.empty();
+	const bool known = from_file && cache.known_hash(options.input_path, stamp, input_hash);
+	if (!known) {
+		read_input();
+		input_hash = hash_bytes(content);
+		// taken before reading, a change while reading is seen next time
+		if (from_file && stamp.size == content.size())
+			cache.remember_hash(options.input_path, stamp, input_hash);
+	}
+
+	parse_cache::entry entry{};
+	if (cache.load(input_hash, options.parse_key, entry)) {
+		if (output_fs_paths.front() != "stdout")
+			std::cout << "reusing the output of an earlier run on the same input\n";
+		write_encoded(output_fs_paths, entry.bytes, static_cast<std::size_t>(entry.server_count));
+		return true;
+	}
+	if (known)
+		read_input();
+	return false;
+}
+
+// -o paths as files, a directory gets a servers.dat in it
+std::vector<fs::path> resolve_output_paths(const std::vector<std::string>& output_paths) {
+	std::vector<fs::path> output_fs_paths{};
+	for (const std::string& output_path : output_paths) {
+		fs::path output_fs_path = output_path;
+		if (output_fs_path.empty()) {
+			std::cout << "Output path is empty\n";
+			exit(1);
+		}
+
+		if (fs::is_directory(output_fs_path)) {
+			output_fs_path = output_fs_path / "servers.dat";	
+		}
+		output_fs_paths.push_back(output_fs_path);
+	}
+	return output_fs_paths;
+}
+
+// Loads path again into loaded when it changed since stamp. A file that no longer
+// loads is reported and the last one is kept. Returns whether loaded was replaced
+template <typename T>
+bool reload_option_file(std::optional<T>& loaded, const fs::path& path, interval_table::source_stamp& stamp, const char* option) {
+	interval_table::source_stamp now{};
+	if (path.empty() || !interval_table::stamp_of(path, now) || now == stamp)
+		return false;
+	stamp = now;
+	// checked apart first, emplace would drop the last one before knowing
+	if (const T fresh(path); !fresh.is_open()) {
+		std::cerr << "warning: " << option << ' ' << path.string() << " can't be used, keeping the last one: " << fresh.error() << '\n';
+		return false;
+	}
+	loaded.emplace(path);
+	return loaded->is_open();
+}
+
+// --watch: regenerates the outputs whenever the input changes, until it's interrupted.
+// Only the lines and files that changed are parsed, prepared and encoded again. The
+// --exclude-cidr and --prefix-labels files are watched too and every server is
+// prepared again when one changes, as are servers with an @path icon every round
+void watch_to_dat(const fs::path& input_fs_path, const std::vector<std::string>& output_paths, const std::string_view format, output_options& options,
+	const fs::path& blocklist_path, const fs::path& labels_path, const std::chrono::milliseconds debounce) {
+	const std::vector<fs::path> output_fs_paths = resolve_output_paths(output_paths);
+	std::vector<fs::path> watched{ input_fs_path };
+	interval_table::source_stamp blocklist_stamp{}, labels_stamp{};
+	if (!blocklist_path.empty() && interval_table::stamp_of(blocklist_path, blocklist_stamp))
+		watched.push_back(blocklist_path);
+	if (!labels_path.empty() && interval_table::stamp_of(labels_path, labels_stamp))
+		watched.push_back(labels_path);
+	input_watcher watcher(watched);
+	if (!watcher.is_open()) {
+		std::cout << "Unable to watch " << input_fs_path.string() << ": " << watcher.error() << '\n';
+		exit(1);
+	}
+	std::cout << "watching " << input_fs_path.string() << " for changes\n";
+
+	incremental_servers incremental(options.endian);
+	do {
+		const bool reloaded_blocklist = reload_option_file(options.blocklist, blocklist_path, blocklist_stamp, "--exclude-cidr");
+		const bool reloaded_labels = reload_option_file(options.labels, labels_path, labels_stamp, "--prefix-labels");
+		if (reloaded_blocklist || reloaded_labels)
+			incremental.clear();
+		prepare_stats prepared{};
+		const incremental_servers::update_stats stats = incremental.update(list_inputs(input_fs_path, std::string(format)), [&](std::vector<nbtserver>& batch) {
+			// icon files aren't part of what's hashed
+			const bool reads_icons = std::ranges::any_of(batch, [](const nbtserver& server) { return server.icon.starts_with('@'); });
+			prepare_servers(batch, options, prepared);
+			return !reads_icons;
+		});
+		for (const std::string& icon_path : prepared.icons.paths())
+			watcher.add(icon_path);
+		std::cout << "parsed " << stats.parsed << " new lines and files, reused " << stats.reused << " from " << stats.files << " inputs\n";
+		// only what was parsed is prepared, the reused servers were counted in their round
+		report_prepared(options, prepared, false, " in the new lines and files");
+		if (stats.invalid)
+			std::cerr << "warning: skipped " << stats.invalid << " lines that are missing required fields\n";
+		if (incremental.size() == 0) {
+			std::cerr << "warning: there are no servers in the input, the outputs are left as they are\n";
+			continue;
+		}
+		if (!options.dedup && !options.sort) {
+			write_encoded(output_fs_paths, incremental.servers_dat(), incremental.size());
+			continue;
+		}
+
+		// which servers to write and in what order, the compounds themselves are reused
+		std::vector<nbtserver> servers = incremental.servers();
+		std::vector<std::uint32_t> positions{};
+		if (options.dedup) {
+			address_set addresses(servers);
+			std::vector<char> keep(servers.size(), false);
+			for (std::size_t n = 0; n < servers.size(); ++n) {
+				const std::size_t i = options.dedup_keep == dedup_mode::first ? n : servers.size() - 1 - n;
+				keep[i] = addresses.insert(i) == address_set::npos;
+			}
+			for (std::size_t i = 0; i < servers.size(); ++i) {
+				if (keep[i])
+					positions.push_back(static_cast<std::uint32_t>(i));
+			}
+			std::cout << "removed " << servers.size() - positions.size() << " duplicate servers of " << addresses.duplicated() << " addresses\n";
+		} else {
+			positions.resize(servers.size());
+			std::iota(positions.begin(), positions.end(), 0u);
+		}
+		if (options.sort) {
+			std::vector<nbtserver> kept{};
+			kept.reserve(positions.size());
+			for (const std::uint32_t position : positions)
+				kept.push_back(std::move(servers[position]));
+			const std::vector<std::uint32_t> order = sort_order(kept, options.sort_by, options.reverse);
+			std::vector<std::uint32_t> sorted(order.size());
+			for (std::size_t i = 0; i < order.size(); ++i)
+				sorted[i] = positions[order[i]];
+			positions = std::move(sorted);
+		}
+		write_encoded(output_fs_paths, incremental.servers_dat(positions), positions.size());
+		// the round's report is out before the wait, also when stdout is a pipe or a file
+	} while (std::cout.flush() && watcher.wait(debounce));
+
+	std::cout << "Stopped watching " << input_fs_path.string() << ": " << watcher.error() << '\n';
+	exit(1);
+}
+
+void ips_to_dat(std::istream* ip_stream, const std::vector<std::string>& output_paths, const std::string_view format, const output_options& options) {
+	const std::vector<fs::path> output_fs_paths = resolve_output_paths(output_paths);
+	const fs::path& output_fs_path = output_fs_paths.front();
+
+	if (format == "ranges") {
+		ranges_to_dat(ip_stream, output_fs_path, options);
+		return;
+	}
+
+	if (!options.registry.empty()) {
+		registry_to_dat(ip_stream, output_fs_path, format, options);
+		return;
+	}
+
+	if (options.mem_limit) {
+		external_to_dat(*ip_stream, output_fs_path, format, options);
+		return;
+	}
+
+	std::istringstream read_input{};
+	std::uint64_t input_hash = 0;
+	if (options.parse_results) {
+		std::string content{};
+		if (reuse_parsed(ip_stream, output_fs_paths, options, content, input_hash))
+			return;
+		read_input.str(std::move(content));
+		ip_stream = &read_input;
+	}
+
+	std::vector<nbtserver> servers{};
+	prepare_stats prepared{};
+	if (options.sample) {
+		servers = sample_input(ip_stream, format, options, prepared, output_fs_path == "stdout");
+	} else {
+		servers = parse_servers(ip_stream, format);
+		if (servers.empty()) {
+			std::cout << "There are no servers in your input file\n";
+			exit(1);
+		}
+		prepare_servers(servers, options, prepared);
+	}
+	report_prepared(options, prepared, output_fs_path == "stdout");
+	if (servers.empty()) {
+		std::cout << (options.filter || options.blocklist ? "All servers were filtered out\n" : "There are no servers with a valid address in your input file\n");
+		exit(1);
+	}
+
+	if (options.dedup) {
+		const dedup_stats stats = dedup_servers(servers, options.dedup_keep);
+		if (output_fs_path != "stdout")
+			std::cout << "removed " << stats.removed << " duplicate servers of " << stats.addresses << " addresses\n";
+	}
+
+	if (options.sort)
+		apply_order(servers, sort_order(servers, options.sort_by, options.reverse));
+
+	const std::endian endian = options.endian;
+	if (options.append && output_fs_path != "stdout" && fs::exists(output_fs_path)) {
+		if (append_servers_in_place(output_fs_path, servers, endian))
+			return;
+
+		std::cerr << "warning: " << output_fs_path.string() << " isn't laid out the way enbt writes servers.dat. rewriting it in full, dropping any root tags besides 'servers'\n";
+		std::vector<nbtserver> existing{};
+		if (!read_servers_dat(output_fs_path, existing, endian)) {
+			std::cout << "Can't append to " << output_fs_path.string() << ": it isn't a servers.dat file\n";
+			exit(1);
+		}
+		servers.insert(servers.begin(), std::make_move_iterator(existing.begin()), std::make_move_iterator(existing.end()));
+	}
+
+	if (options.parse_results) {
+		const std::string bytes = endian == std::endian::little ? encode_servers<std::endian::little>(servers) : encode_servers<std::endian::big>(servers);
+		// icon files aren't part of the key, so their servers are never cached
+		if (prepared.icons.files() == 0 && !options.parse_results->store(input_hash, options.parse_key, servers.size(), bytes))
+			std::cerr << "warning: unable to update the parse cache\n";
+		write_encoded(output_fs_paths, bytes, servers.size());
+		return;
+	}
+
+	if (output_fs_paths.size() > 1) {
+		if (endian == std::endian::little)
+			write_fanout<std::endian::little>(output_fs_paths, servers);
+		else
+			write_fanout<std::endian::big>(output_fs_paths, servers);
+		return;
+	}
+
+	if (options.shards.enabled()) {
+		if (endian == std::endian::little)
+			write_shards<std::endian::little>(output_fs_path, servers, options.shards);
+		else
+			write_shards<std::endian::big>(output_fs_path, servers, options.shards);
+		return;
+	}
+
+	if (endian == std::endian::little)
+		write_servers<std::endian::little>(output_fs_path, servers);
+	else
+		write_servers<std::endian::big>(output_fs_path, servers);
+}
+
+// --parse-cache key: the options as given, less the ones naming the input, the outputs
+// and the cache, then the input format and the size and time of the files options read
+std::string parse_cache_key(const std::vector<std::string_view>& arguments, const std::string_view format, const std::vector<std::string>& option_files) {
+	std::string key = "-t " + std::string(format);
+	for (std::size_t i = 0; i < arguments.size(); ++i) {
+		if (arguments[i] == "-i" || arguments[i] == "-o" || arguments[i] == "--parse-cache") {
+			++i;
+			continue;
+		}
+		if (arguments[i] != "--stdout")
+			key.append("\n").append(arguments[i]);
+	}
+	for (const std::string& path : option_files) {
+		if (path.empty())
+			continue;
+		std::error_code ec;
+		const std::uint64_t size = fs::file_size(path, ec);
+		const fs::file_time_type time = ec ? fs::file_time_type{} : fs::last_write_time(path, ec);
+		key += "\n" + path + ' ' + std::to_string(size) + ' ' + std::to_string(time.time_since_epoch().count());
+	}
+	return key;
 }
 
 int main(int argc, char** argv) {
 	const std::string_view program = argv[0];
 	argv++;
 	argc--;
+	const std::vector<std::string_view> arguments(argv, argv + argc);
 
 	std::string input_path{};
-	std::string output_path = "servers.dat";	
+	std::vector<std::string> output_targets{};
 	std::string input_type = "csv";
+	std::string nbt_endian = "big";
+	std::string export_format{};
 	bool output_to_stdout = false;
 	bool explicit_extension = false;
+	std::string shard_max_entries{};
+	std::string shard_max_bytes{};
+	std::string shard_by = "order";
+	std::string sort_by{};
+	std::string mem_limit{};
+	std::string filter{};
+	std::string exclude_cidr{};
+	std::string prefix_labels_path{};
+	std::string label_names{};
+	std::string sample{};
+	std::string seed{};
+	std::string ping_timeout{};
+	std::string ping_concurrency{};
+	std::string ping_cache_path{};
+	std::string ping_ttl{};
+	std::string ping_negative_ttl{};
+	std::optional<ping_cache> ping_results{};
+	std::string parse_cache_path{};
+	bool watch = false;
+	std::string watch_debounce{};
+	std::optional<parse_cache> parse_results{};
+	output_options options{};
 
 	while (argc > 0) {
 		const std::string_view cmd = argv[0];
@@ -114,12 +1044,80 @@ int main(int argc, char** argv) {
 		} else if (cmd == "-i") {
 			parse_arg(cmd, input_path, "", &argc, &argv, true);	
 		} else if (cmd == "-o") {
-			parse_arg(cmd, output_path, "servers.dat", &argc, &argv, true);
+			std::string target{};
+			parse_arg(cmd, target, "", &argc, &argv, true);
+			output_targets.push_back(target);
 		} else if (cmd == "--stdout") {
 			output_to_stdout = true;
 		} else if (cmd == "-t") {
 			parse_arg(cmd, input_type, "csv", &argc, &argv, true);
 			explicit_extension = true;
+		} else if (cmd == "--nbt-endian") {
+			parse_arg(cmd, nbt_endian, "big", &argc, &argv, true);
+		} else if (cmd == "--append") {
+			options.append = true;
+		} else if (cmd == "--shard-max-entries") {
+			parse_arg(cmd, shard_max_entries, "", &argc, &argv, true);
+		} else if (cmd == "--shard-max-bytes") {
+			parse_arg(cmd, shard_max_bytes, "", &argc, &argv, true);
+		} else if (cmd == "--shard-by") {
+			parse_arg(cmd, shard_by, "order", &argc, &argv, true);
+		} else if (cmd == "--filter") {
+			parse_arg(cmd, filter, "", &argc, &argv, true);
+		} else if (cmd == "--exclude-cidr") {
+			parse_arg(cmd, exclude_cidr, "", &argc, &argv, true);
+		} else if (cmd == "--prefix-labels") {
+			parse_arg(cmd, prefix_labels_path, "", &argc, &argv, true);
+		} else if (cmd == "--label-names") {
+			parse_arg(cmd, label_names, "", &argc, &argv, true);
+		} else if (cmd == "--canonicalize") {
+			options.canonicalize = true;
+		} else if (cmd == "--validate-icons") {
+			options.validate_icons = true;
+		} else if (cmd == "--ping") {
+			options.ping = true;
+		} else if (cmd == "--ping-timeout") {
+			parse_arg(cmd, ping_timeout, "", &argc, &argv, true);
+		} else if (cmd == "--ping-concurrency") {
+			parse_arg(cmd, ping_concurrency, "", &argc, &argv, true);
+		} else if (cmd == "--ping-cache") {
+			parse_arg(cmd, ping_cache_path, "", &argc, &argv, true);
+		} else if (cmd == "--ping-ttl") {
+			parse_arg(cmd, ping_ttl, "", &argc, &argv, true);
+		} else if (cmd == "--ping-negative-ttl") {
+			parse_arg(cmd, ping_negative_ttl, "", &argc, &argv, true);
+		} else if (cmd == "--dedup") {
+			options.dedup = true;
+			// the mode is optional
+			if (argc > 1 && (std::string_view(argv[1]) == "first" || std::string_view(argv[1]) == "last")) {
+				options.dedup_keep = std::string_view(argv[1]) == "last" ? dedup_mode::last : dedup_mode::first;
+				argv++;
+				argc--;
+			}
+		} else if (cmd == "--sort") {
+			parse_arg(cmd, sort_by, "", &argc, &argv, true);
+		} else if (cmd == "--reverse") {
+			options.reverse = true;
+		} else if (cmd == "--sample") {
+			parse_arg(cmd, sample, "", &argc, &argv, true);
+		} else if (cmd == "--seed") {
+			parse_arg(cmd, seed, "", &argc, &argv, true);
+		} else if (cmd == "--mem-limit") {
+			parse_arg(cmd, mem_limit, "", &argc, &argv, true);
+		} else if (cmd == "--registry") {
+			parse_arg(cmd, options.registry, "", &argc, &argv, true);
+		} else if (cmd == "--registry-delete") {
+			options.registry_delete = true;
+		} else if (cmd == "--registry-compact") {
+			options.registry_compact = true;
+		} else if (cmd == "--watch") {
+			watch = true;
+		} else if (cmd == "--watch-debounce") {
+			parse_arg(cmd, watch_debounce, "", &argc, &argv, true);
+		} else if (cmd == "--parse-cache") {
+			parse_arg(cmd, parse_cache_path, "", &argc, &argv, true);
+		} else if (cmd == "--export") {
+			parse_arg(cmd, export_format, "", &argc, &argv, true);
 		} else {		
 			std::cout << "unknown option '" << cmd << "'\n";
 			usage(program);
@@ -129,14 +1127,266 @@ int main(int argc, char** argv) {
 		argc--;
 	}
 
+	if (nbt_endian != "big" && nbt_endian != "little") {
+		std::cout << "Invalid value for --nbt-endian '" << nbt_endian << "'\n";
+		exit(1);
+	}
+	std::vector<std::string> output_paths = expand_output_targets(output_targets);
+	if (output_paths.empty())
+		output_paths.push_back("servers.dat");
+	std::string& output_path = output_paths.front();
+	if (output_paths.size() > 1 && (output_to_stdout || options.append || !export_format.empty()
+		|| std::find(output_paths.begin(), output_paths.end(), "stdout") != output_paths.end())) {
+		std::cout << "Multiple outputs can't be combined with --append, --export or stdout\n";
+		exit(1);
+	}
+
+	const std::endian endian = nbt_endian == "little" ? std::endian::little : std::endian::big;
+	options.endian = endian;
+
+	std::uint64_t max_entries = 0;
+	if (!shard_max_entries.empty() && (!parse_size(shard_max_entries, max_entries) || max_entries == 0)) {
+		std::cout << "Invalid value for --shard-max-entries '" << shard_max_entries << "'\n";
+		exit(1);
+	}
+	options.shards.max_entries = static_cast<std::size_t>(max_entries);
+	if (!shard_max_bytes.empty() && (!parse_size(shard_max_bytes, options.shards.max_bytes) || options.shards.max_bytes == 0)) {
+		std::cout << "Invalid value for --shard-max-bytes '" << shard_max_bytes << "'\n";
+		exit(1);
+	}
+	if (shard_by != "order" && shard_by != "ip") {
+		std::cout << "Invalid value for --shard-by '" << shard_by << "'\n";
+		exit(1);
+	}
+	options.shards.by_ip_hash = shard_by == "ip";
+	if (options.shards.enabled() && (options.append || output_to_stdout || output_path == "stdout" || output_paths.size() > 1)) {
+		std::cout << "Sharded output can't be combined with --append, stdout or multiple outputs\n";
+		exit(1);
+	}
+
+	if (!sort_by.empty()) {
+		if (sort_by != "name" && sort_by != "ip" && sort_by != "addr") {
+			std::cout << "Invalid value for --sort '" << sort_by << "'\n";
+			exit(1);
+		}
+		options.sort = true;
+		options.sort_by = sort_by == "name" ? sort_key::name : sort_by == "ip" ? sort_key::ip : sort_key::addr;
+	}
+	if (options.reverse && !options.sort) {
+		std::cout << "--reverse needs --sort\n";
+		exit(1);
+	}
+
+	if (!filter.empty()) {
+		try {
+			options.filter.emplace(filter);
+		} catch (const filter_error& e) {
+			std::cout << "Invalid --filter: " << e.what() << " at column " << e.column() << '\n';
+			std::cout << "\t" << filter << "\n\t" << std::string(e.column() - 1, ' ') << "^\n";
+			exit(1);
+		}
+	}
+
+	if (!exclude_cidr.empty()) {
+		options.blocklist.emplace(exclude_cidr);
+		if (!options.blocklist->is_open()) {
+			std::cout << "Invalid --exclude-cidr " << exclude_cidr << ": " << options.blocklist->error() << '\n';
+			exit(1);
+		}
+	}
+
+	if (!prefix_labels_path.empty()) {
+		options.labels.emplace(prefix_labels_path);
+		if (!options.labels->is_open()) {
+			std::cout << "Invalid --prefix-labels " << prefix_labels_path << ": " << options.labels->error() << '\n';
+			exit(1);
+		}
+	}
+	if (!label_names.empty()) {
+		if (!options.labels) {
+			std::cout << "--label-names needs --prefix-labels\n";
+			exit(1);
+		}
+		options.label_names = label_names;
+	}
+
+	if (!sample.empty()) {
+		std::uint64_t sample_size = 0;
+		if (!parse_size(sample, sample_size) || sample_size == 0 || sample_size > INT32_MAX) {
+			std::cout << "Invalid value for --sample '" << sample << "'\n";
+			exit(1);
+		}
+		options.sample = static_cast<std::size_t>(sample_size);
+		if (!options.registry.empty() || !mem_limit.empty()) {
+			std::cout << "--sample can't be combined with --registry or --mem-limit\n";
+			exit(1);
+		}
+	}
+	if (!seed.empty()) {
+		const auto [rest, ec] = std::from_chars(seed.data(), seed.data() + seed.size(), options.seed);
+		if (ec != std::errc() || rest != seed.data() + seed.size()) {
+			std::cout << "Invalid value for --seed '" << seed << "'\n";
+			exit(1);
+		}
+		if (!options.sample) {
+			std::cout << "--seed needs --sample\n";
+			exit(1);
+		}
+	} else {
+		std::random_device random;
+		options.seed = static_cast<std::uint64_t>(random()) << 32 | random();
+	}
+
+	if (options.ping && !ping_supported()) {
+		std::cout << "--ping is only supported on Linux\n";
+		exit(1);
+	}
+	if ((!ping_timeout.empty() || !ping_concurrency.empty() || !ping_cache_path.empty()) && !options.ping) {
+		std::cout << "--ping-timeout, --ping-concurrency and --ping-cache need --ping\n";
+		exit(1);
+	}
+	if ((!ping_ttl.empty() || !ping_negative_ttl.empty()) && ping_cache_path.empty()) {
+		std::cout << "--ping-ttl and --ping-negative-ttl need --ping-cache\n";
+		exit(1);
+	}
+	if (!ping_ttl.empty() && !parse_duration(ping_ttl, options.ping_limits.ttl)) {
+		std::cout << "Invalid value for --ping-ttl '" << ping_ttl << "'\n";
+		exit(1);
+	}
+	if (!ping_negative_ttl.empty() && !parse_duration(ping_negative_ttl, options.ping_limits.negative_ttl)) {
+		std::cout << "Invalid value for --ping-negative-ttl '" << ping_negative_ttl << "'\n";
+		exit(1);
+	}
+	if (!ping_cache_path.empty()) {
+		ping_results.emplace(ping_cache_path);
+		if (!ping_results->is_open()) {
+			std::cout << "Unable to open ping cache " << ping_cache_path << '\n';
+			exit(1);
+		}
+		options.ping_results = &*ping_results;
+	}
+	if (!ping_timeout.empty()) {
+		std::uint64_t timeout_ms = 0;
+		const auto [rest, ec] = std::from_chars(ping_timeout.data(), ping_timeout.data() + ping_timeout.size(), timeout_ms);
+		if (ec != std::errc() || rest != ping_timeout.data() + ping_timeout.size() || timeout_ms == 0 || timeout_ms > INT32_MAX) {
+			std::cout << "Invalid value for --ping-timeout '" << ping_timeout << "'\n";
+			exit(1);
+		}
+		options.ping_limits.timeout = std::chrono::milliseconds(timeout_ms);
+	}
+	if (!ping_concurrency.empty()) {
+		std::uint64_t concurrency = 0;
+		if (!parse_size(ping_concurrency, concurrency) || concurrency == 0 || concurrency > INT32_MAX) {
+			std::cout << "Invalid value for --ping-concurrency '" << ping_concurrency << "'\n";
+			exit(1);
+		}
+		options.ping_limits.concurrency = static_cast<std::size_t>(concurrency);
+	}
+
+	if (!mem_limit.empty()) {
+		constexpr std::uint64_t min_mem_limit = 1 << 20;
+		if (!parse_size(mem_limit, options.mem_limit) || options.mem_limit < min_mem_limit) {
+			std::cout << "Invalid value for --mem-limit '" << mem_limit << "', it has to be at least 1m\n";
+			exit(1);
+		}
+		if (options.dedup && options.sort && options.sort_by != sort_key::addr) {
+			std::cout << "--dedup with --mem-limit sorts by address, it can't be combined with --sort " << sort_by << '\n';
+			exit(1);
+		}
+		if (options.append || options.shards.enabled() || output_paths.size() > 1 || !options.registry.empty()
+			|| output_to_stdout || output_path == "stdout") {
+			std::cout << "--mem-limit writes a single output file, it can't be combined with --append, --registry, sharding, stdout or multiple outputs\n";
+			exit(1);
+		}
+	}
+
+	if ((options.registry_delete || options.registry_compact) && options.registry.empty()) {
+		std::cout << "--registry-delete and --registry-compact need --registry\n";
+		exit(1);
+	}
+	// the registry keeps one server per ip in the order they were added
+	if (!options.registry.empty() && (options.append || options.shards.enabled() || output_paths.size() > 1 || !export_format.empty() || options.sort || options.dedup)) {
+		std::cout << "--registry can't be combined with --append, --export, --sort, --dedup, sharding or multiple outputs\n";
+		exit(1);
+	}
+
+	if (!export_format.empty()) {
+		if (export_format != "csv" && export_format != "toml" && export_format != "json") {
+			std::cout << "Invalid value for --export '" << export_format << "'\n";
+			exit(1);
+		}
+		if (input_path.empty()) {
+			std::cout << "--export requires a servers.dat given with -i\n";
+			exit(1);
+		}
+		// the servers.dat default of -o makes no sense here, stdout unless a path was given
+		if (output_to_stdout || output_targets.empty() || output_path == "stdout")
+			return export_servers(input_path, std::cout, export_format, endian) ? 0 : 1;
+
+		std::ofstream export_stream(output_path, std::ios::out | std::ios::binary);
+		if (!export_stream.is_open()) {
+			std::cout << "Unable to open output file for writing (" << output_path << ")\n";
+			exit(1);
+		}
+		return export_servers(input_path, export_stream, export_format, endian) ? 0 : 1;
+	}
+
 	if (output_to_stdout) {
 		output_path = "stdout"; //--stdout overrides -o
 	}
 
+	if (!watch_debounce.empty() && !watch) {
+		std::cout << "--watch-debounce needs --watch\n";
+		exit(1);
+	}
+	if (watch) {
+		if (!watch_supported()) {
+			std::cout << "--watch is only supported on Linux\n";
+			exit(1);
+		}
+		if (input_path.empty()) {
+			std::cout << "--watch needs an input file or directory given with -i\n";
+			exit(1);
+		}
+		if (output_path == "stdout" || options.append || options.shards.enabled() || !options.registry.empty() || options.mem_limit
+			|| options.sample || options.ping || !parse_cache_path.empty() || input_type == "ranges") {
+			std::cout << "--watch can't be combined with stdout, --append, --registry, --mem-limit, --sample, --ping, --parse-cache, -t ranges or sharding\n";
+			exit(1);
+		}
+		std::uint64_t debounce_ms = 50;
+		if (!watch_debounce.empty()) {
+			const auto [rest, ec] = std::from_chars(watch_debounce.data(), watch_debounce.data() + watch_debounce.size(), debounce_ms);
+			if (ec != std::errc() || rest != watch_debounce.data() + watch_debounce.size() || debounce_ms > INT32_MAX) {
+				std::cout << "Invalid value for --watch-debounce '" << watch_debounce << "'\n";
+				exit(1);
+			}
+		}
+		// a directory's files each have the format of their extension
+		std::error_code ec;
+		if (!fs::is_directory(input_path, ec)) {
+			if (!fs::exists(input_path)) {
+				std::cout << "Can't load '" << input_path << "': file doesn't exist\n";
+				exit(1);
+			}
+			if (!explicit_extension)
+				input_type = fs::path(input_path).extension().string().erase(0, 1);
+			if (input_type != "csv" && input_type != "toml" && input_type != "json") {
+				std::cout << "--watch reads csv, toml and json files. Provide an explicit input type with the -t option\n";
+				exit(1);
+			}
+		}
+		watch_to_dat(input_path, output_paths, input_type, options, exclude_cidr, prefix_labels_path, std::chrono::milliseconds(debounce_ms));
+		return 0;
+	}
+
 	std::ifstream ip_file_stream;
 	std::istream* ip_stream;
 	bool cin_piped = !isatty(fileno(stdin));
 	if (input_path.empty()) {
+		if (!cin_piped && !options.registry.empty()) {
+			ips_to_dat(nullptr, output_paths, input_type, options); // nothing to apply, only export the registry
+			return 0;
+		}
 		if (!cin_piped) {
 			std::cout << "No input data provided\n";
 			exit(1);
@@ -172,12 +1422,37 @@ int main(int argc, char** argv) {
 		input_type = ext.erase(0, 1); //remove '.'
 	}
 
-	if (input_type != "csv" && input_type != "toml" && input_type != "json") {
+	if (input_type != "csv" && input_type != "toml" && input_type != "json" && input_type != "ranges") {
 		std::cout << "Invalid value for -t '" << input_type << "'\n";
 		exit(1);
 	}
+	if (input_type == "ranges" && (options.append || options.shards.enabled() || output_paths.size() > 1 || !options.registry.empty()
+		|| options.sort || options.dedup || options.canonicalize || options.validate_icons || options.ping || options.mem_limit)) {
+		std::cout << "-t ranges streams the servers into one output, it can't be combined with --append, --registry, --sort, --dedup, --canonicalize, --validate-icons, --ping, --mem-limit, sharding or multiple outputs\n";
+		exit(1);
+	}
 	
-	ips_to_dat(ip_stream, output_path, input_type);
+	if (!parse_cache_path.empty()) {
+		if (input_type == "ranges" || options.append || options.shards.enabled() || !options.registry.empty() || options.mem_limit || options.ping) {
+			std::cout << "--parse-cache can't be combined with -t ranges, --append, --registry, --mem-limit, --ping or sharding\n";
+			exit(1);
+		}
+		if (options.sample && seed.empty()) {
+			std::cout << "--parse-cache with --sample needs --seed\n";
+			exit(1);
+		}
+		parse_results.emplace(parse_cache_path);
+		if (!parse_results->is_open()) {
+			std::cout << "Unable to open parse cache " << parse_cache_path << ": " << parse_results->error() << '\n';
+			exit(1);
+		}
+		options.parse_results = &*parse_results;
+		options.parse_key = parse_cache_key(arguments, input_type, { exclude_cidr, prefix_labels_path });
+		if (ip_stream == &ip_file_stream)
+			options.input_path = input_path;
+	}
+
+	ips_to_dat(ip_stream, output_paths, input_type, options);
 	
 	return 0;
 }
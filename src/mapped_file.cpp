@@ -0,0 +1,127 @@
+#include "mapped_file.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file(const std::string& path) {
+	open(path);
+}
+
+mapped_file::~mapped_file() {
+	close();
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept {
+	*this = std::move(other);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+	if (this != &other) {
+		close();
+		bytes = std::exchange(other.bytes, nullptr);
+		length = std::exchange(other.length, 0);
+		opened = std::exchange(other.opened, false);
+#ifdef _WIN32
+		file_handle = std::exchange(other.file_handle, nullptr);
+		mapping_handle = std::exchange(other.mapping_handle, nullptr);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+bool mapped_file::open(const std::string& path) {
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	opened = true;
+	if (file_size.QuadPart == 0)
+		return true; // empty files can't be mapped
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		if (mapping)
+			CloseHandle(mapping);
+		close();
+		return false;
+	}
+
+	mapping_handle = mapping;
+	bytes = static_cast<const char*>(view);
+	length = static_cast<std::size_t>(file_size.QuadPart);
+	return true;
+}
+
+void mapped_file::close() {
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+	bytes = nullptr;
+	length = 0;
+	opened = false;
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+}
+#else
+bool mapped_file::open(const std::string& path) {
+	close();
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st{};
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	opened = true;
+	if (st.st_size == 0) {
+		::close(fd);
+		return true; // empty files can't be mapped
+	}
+
+	void* view = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the file referenced
+	if (view == MAP_FAILED) {
+		opened = false;
+		return false;
+	}
+
+	// walked front to back
+	madvise(view, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+	bytes = static_cast<const char*>(view);
+	length = static_cast<std::size_t>(st.st_size);
+	return true;
+}
+
+void mapped_file::close() {
+	if (bytes)
+		munmap(const_cast<char*>(bytes), length);
+	bytes = nullptr;
+	length = 0;
+	opened = false;
+}
+#endif
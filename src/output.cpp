@@ -0,0 +1,319 @@
+#include "output.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h> // _commit
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h> // FICLONE
+#include <sys/ioctl.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr std::size_t buffer_size = 1 << 16;
+
+// the new file takes the old one's place, readable and writable by the same users
+void keep_permissions(const fs::path& target, const fs::path& temp) {
+	std::error_code ec;
+	const fs::file_status status = fs::status(target, ec);
+	if (!ec && fs::is_regular_file(status))
+		fs::permissions(temp, status.permissions(), fs::perm_options::replace, ec);
+}
+
+// makes the rename itself durable
+void sync_directory(const fs::path& dir) {
+#ifndef _WIN32
+	const int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+#else
+	(void)dir;
+#endif
+}
+}
+
+atomic_output::hashing_buf::hashing_buf() : buffer(buffer_size) {
+	setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+bool atomic_output::hashing_buf::drain(const char* data, std::size_t len) {
+	if (!len)
+		return good;
+	hasher.update(data, len);
+	written += len;
+	if (good && (!file || std::fwrite(data, 1, len, file) != len))
+		good = false;
+	return good;
+}
+
+atomic_output::hashing_buf::int_type atomic_output::hashing_buf::overflow(int_type ch) {
+	if (!drain(pbase(), static_cast<std::size_t>(pptr() - pbase())))
+		return traits_type::eof();
+	setp(buffer.data(), buffer.data() + buffer.size());
+	if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(ch);
+		pbump(1);
+	}
+	return traits_type::not_eof(ch);
+}
+
+std::streamsize atomic_output::hashing_buf::xsputn(const char* s, std::streamsize n) {
+	// big writes skip the buffer
+	if (n >= static_cast<std::streamsize>(buffer.size())) {
+		if (sync() != 0 || !drain(s, static_cast<std::size_t>(n)))
+			return 0;
+		return n;
+	}
+	return std::streambuf::xsputn(s, n);
+}
+
+int atomic_output::hashing_buf::sync() {
+	if (!drain(pbase(), static_cast<std::size_t>(pptr() - pbase())))
+		return -1;
+	setp(buffer.data(), buffer.data() + buffer.size());
+	return 0;
+}
+
+atomic_output::atomic_output(const fs::path& target) : target(target), out(&buf) {
+	std::random_device random;
+	const fs::path dir = target.parent_path();
+	for (int attempt = 0; attempt < 16 && !file; ++attempt) {
+		const std::uint64_t suffix = (static_cast<std::uint64_t>(random()) << 32) | random();
+		temp = dir / ("." + target.filename().string() + ".enbt-" + hash_hex(suffix).substr(0, 8));
+		// 'x' fails instead of reusing an existing file
+		file = std::fopen(temp.string().c_str(), "wbx");
+	}
+	if (!file) {
+		temp.clear();
+		out.setstate(std::ios::badbit);
+		return;
+	}
+	buf.attach(file);
+}
+
+atomic_output::~atomic_output() {
+	discard();
+}
+
+void atomic_output::discard() {
+	if (file) {
+		std::fclose(file);
+		file = nullptr;
+	}
+	if (!temp.empty()) {
+		std::error_code ec;
+		fs::remove(temp, ec);
+		temp.clear();
+	}
+}
+
+bool atomic_output::commit(output_result& result) {
+	out.flush();
+	result = output_result{ .written = false, .hash = buf.hash(), .size = base + buf.size() };
+	if (copied) {
+		result.hash = copied_hash;
+		result.size = copied_size;
+	}
+	if (!file || !buf.ok() || !out) {
+		discard();
+		return false;
+	}
+	if (base > 0) {
+		result.hash = 0;
+		result.hashed = false;
+	} else if (patched && (std::fflush(file) != 0 || !hash_file(temp, result.hash))) {
+		discard();
+		return false;
+	}
+
+	if (result.hashed && file_matches(target, result.size, result.hash)) {
+		discard();
+		return true;
+	}
+
+	std::error_code ec;
+	keep_permissions(target, temp);
+	if (!sync_file(file)) {
+		discard();
+		return false;
+	}
+	std::fclose(file);
+	file = nullptr;
+
+	fs::rename(temp, target, ec);
+	if (ec) {
+		discard();
+		return false;
+	}
+	temp.clear();
+	sync_directory(target.parent_path());
+	result.written = true;
+	return true;
+}
+
+bool atomic_output::patch(std::uint64_t offset, std::string_view bytes) {
+	out.flush();
+	const std::uint64_t end = base + buf.size();
+	if (!file || !buf.ok() || !out || copied || offset + bytes.size() > end || std::fflush(file) != 0)
+		return false;
+	if (!seek_file(file, offset) || std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size() || !seek_file(file, end))
+		return false;
+	patched = true;
+	return true;
+}
+
+namespace {
+// Fills the empty file with bytes, which are source's contents or, with prefix, the
+// start of them: shares source's extents (reflink) where the filesystem can, copies in
+// the kernel (copy_file_range) otherwise and writes bytes as the last resort. Leaves
+// the file positioned after them
+bool fill_from(std::FILE* file, const fs::path& source, std::string_view bytes, bool prefix) {
+	bool done = false;
+#ifdef __linux__
+	const int source_fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+	if (source_fd >= 0) {
+		struct stat st{};
+		const int fd = fileno(file);
+		const std::uint64_t source_size = fstat(source_fd, &st) == 0 ? static_cast<std::uint64_t>(st.st_size) : 0;
+		if (source_size == bytes.size() || (prefix && source_size > bytes.size())) {
+			// a clone takes the whole file, the rest is cut off again
+			done = ioctl(fd, FICLONE, source_fd) == 0 && (source_size == bytes.size() || ftruncate(fd, static_cast<off_t>(bytes.size())) == 0);
+			loff_t in_offset = 0;
+			loff_t out_offset = 0;
+			std::size_t left = bytes.size();
+			if (!done && ftruncate(fd, 0) != 0) {
+				close(source_fd);
+				return false;
+			}
+			while (!done && left > 0) {
+				const ssize_t n = copy_file_range(source_fd, &in_offset, fd, &out_offset, left, 0);
+				if (n <= 0)
+					break;
+				left -= static_cast<std::size_t>(n);
+			}
+			done = done || left == 0;
+			if (!done && ftruncate(fd, 0) != 0) {
+				close(source_fd);
+				return false;
+			}
+		}
+		close(source_fd);
+	}
+	// the kernel wrote behind the stream's back
+	if (done && !seek_file(file, bytes.size()))
+		return false;
+#else
+	(void)source;
+	(void)prefix;
+#endif
+	return done || std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+}
+}
+
+bool atomic_output::copy_from(const fs::path& source, std::string_view bytes, std::uint64_t hash) {
+	if (!file || buf.size() != 0 || base != 0)
+		return false;
+	if (!fill_from(file, source, bytes, false))
+		return false;
+	copied = true;
+	copied_hash = hash;
+	copied_size = bytes.size();
+	return true;
+}
+
+bool atomic_output::start_from(const fs::path& source, std::string_view bytes) {
+	out.flush();
+	if (!file || buf.size() != 0 || base != 0 || copied)
+		return false;
+	if (!fill_from(file, source, bytes, true))
+		return false;
+	base = bytes.size();
+	patched = true; // the stream only saw what comes after them
+	return true;
+}
+
+bool sync_file(std::FILE* f) {
+	if (std::fflush(f) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+bool seek_file(std::FILE* f, std::uint64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+	return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool file_matches(const fs::path& path, std::uint64_t size, std::uint64_t hash) {
+	std::error_code ec;
+	if (!fs::is_regular_file(path, ec) || fs::file_size(path, ec) != size || ec)
+		return false;
+	std::uint64_t existing_hash = 0;
+	return hash_file(path, existing_hash) && existing_hash == hash;
+}
+
+bool hash_file(const fs::path& path, std::uint64_t& hash) {
+	const mapped_file file(path.string());
+	if (!file.is_open())
+		return false;
+	hash = hash_bytes(file.data(), file.size());
+	return true;
+}
+
+std::vector<char> write_outputs(const std::vector<fs::path>& targets, std::string_view bytes, std::uint64_t hash, std::vector<output_result>& results) {
+	results.assign(targets.size(), output_result{});
+	std::vector<char> written(targets.size(), false);
+	const auto write_target = [&](std::size_t i) {
+		if (file_matches(targets[i], bytes.size(), hash)) {
+			results[i] = output_result{ .written = false, .hash = hash, .size = bytes.size() };
+			written[i] = true;
+			return;
+		}
+		atomic_output output(targets[i]);
+		if (!output.is_open())
+			return;
+		// the first target is only a source for the others once it holds bytes, an
+		// old file of the same size left there by a failed write isn't
+		if (i == 0 || !written[0])
+			output.stream().write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		else if (!output.copy_from(targets[0], bytes, hash))
+			return;
+		written[i] = output.commit(results[i]);
+	};
+
+	if (targets.empty())
+		return written;
+	write_target(0);
+	std::atomic<std::size_t> next_target{1};
+	const auto worker = [&]() {
+		for (std::size_t i; (i = next_target++) < targets.size();)
+			write_target(i);
+	};
+	const std::size_t thread_count = std::min<std::size_t>(targets.size() - 1, std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::jthread> threads;
+	for (std::size_t i = 1; i < thread_count; ++i)
+		threads.emplace_back(worker);
+	worker();
+	threads.clear();
+	return written;
+}
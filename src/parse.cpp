@@ -74,7 +74,8 @@ std::vector<nbtserver> parse_servers_toml(const std::string& content) {
 		auto name = toml::find_or<std::string>(server, "name", "");
 		auto accept_textures = toml::find_or<bool>(server, "accept_textures", false);
 
-		if (icon.empty() || ip.empty() || name.empty()) {
+		// an empty icon or name is still one, they're written out as icon = "" and name = ""
+		if (!server.contains("icon") || !server.contains("name") || ip.empty()) {
 			std::cout << "warning: a server entry is missing required fields. it will not be added to the servers list\n";
 			continue;
 		}
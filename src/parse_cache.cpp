@@ -0,0 +1,154 @@
+#include "parse_cache.hpp"
+#include "hash.hpp"
+#include "output.hpp"
+#include <chrono>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Files in the directory, native byte order:
+//	<hash of the input path>.input: input_header, path
+//	<hash of the options, seeded with the input hash>.nbt: entry_header, options, servers.dat
+constexpr char input_magic[8] = {'E', 'N', 'B', 'T', 'I', 'N', 'P', '\x01'};
+// bump the version whenever the same input and options would encode differently
+constexpr char entry_magic[8] = {'E', 'N', 'B', 'T', 'P', 'R', 'S', '\x01'};
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+// modification times this close to now can still change without the time changing
+constexpr std::chrono::seconds racy_window{2};
+
+struct input_header {
+	char magic[8];
+	std::uint32_t byte_order;
+	std::uint32_t reserved;
+	std::uint64_t size;
+	std::int64_t time;
+	std::uint64_t hash;
+	std::uint64_t path_size;
+};
+
+struct entry_header {
+	char magic[8];
+	std::uint32_t byte_order;
+	std::uint32_t reserved;
+	std::uint64_t input_hash;
+	std::uint64_t server_count;
+	std::uint64_t options_size;
+	std::uint64_t data_size;
+};
+
+// The path as it's keyed, the same whatever the working directory
+std::string absolute_text(const fs::path& input) {
+	std::error_code ec;
+	const fs::path absolute = fs::absolute(input, ec);
+	return (ec ? input : absolute).lexically_normal().string();
+}
+}
+
+parse_cache::parse_cache(const fs::path& directory) : directory(directory) {
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+	if (!fs::is_directory(directory, ec)) {
+		problem = "can't create the directory " + directory.string();
+		return;
+	}
+	opened = true;
+}
+
+fs::path parse_cache::input_path(const fs::path& input) const {
+	return directory / (hash_hex(hash_bytes(absolute_text(input))) + ".input");
+}
+
+fs::path parse_cache::entry_path(std::uint64_t input_hash, std::string_view options) const {
+	return directory / (hash_hex(hash_bytes(options, input_hash)) + ".nbt");
+}
+
+bool parse_cache::known_hash(const fs::path& input, file_stamp& stamp, std::uint64_t& hash) const {
+	std::error_code ec;
+	const std::uint64_t size = fs::file_size(input, ec);
+	const fs::file_time_type time = ec ? fs::file_time_type{} : fs::last_write_time(input, ec);
+	if (ec)
+		return false;
+	stamp = { size, static_cast<std::int64_t>(time.time_since_epoch().count()) };
+
+	const mapped_file record(input_path(input).string());
+	input_header header{};
+	if (!record.is_open() || record.size() < sizeof(header))
+		return false;
+	std::memcpy(&header, record.data(), sizeof(header));
+	const std::string path = absolute_text(input);
+	if (std::memcmp(header.magic, input_magic, sizeof(input_magic)) != 0 || header.byte_order != byte_order_mark
+		|| header.size != stamp.size || header.time != stamp.time
+		|| header.path_size != path.size() || record.size() != sizeof(header) + path.size()
+		|| record.view().substr(sizeof(header)) != path)
+		return false;
+	hash = header.hash;
+	return true;
+}
+
+// Best effort: without it the input is hashed again next time
+void parse_cache::remember_hash(const fs::path& input, const file_stamp& stamp, std::uint64_t hash) const {
+	const fs::file_time_type time{ fs::file_time_type::duration(stamp.time) };
+	if (time > fs::file_time_type::clock::now() - racy_window)
+		return;
+	const std::string path = absolute_text(input);
+	input_header header{};
+	std::memcpy(header.magic, input_magic, sizeof(input_magic));
+	header.byte_order = byte_order_mark;
+	header.size = stamp.size;
+	header.time = stamp.time;
+	header.hash = hash;
+	header.path_size = path.size();
+
+	atomic_output output(input_path(input));
+	if (!output.is_open())
+		return;
+	output.stream().write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.stream().write(path.data(), static_cast<std::streamsize>(path.size()));
+	output_result result{};
+	output.commit(result);
+}
+
+bool parse_cache::load(std::uint64_t input_hash, std::string_view options, entry& found) const {
+	if (!found.file.open(entry_path(input_hash, options).string()))
+		return false;
+	entry_header header{};
+	const std::string_view bytes = found.file.view();
+	if (bytes.size() < sizeof(header)) {
+		found.file.close();
+		return false;
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	// the options are kept in full, so two keys with the same hash never mix up
+	const bool valid = std::memcmp(header.magic, entry_magic, sizeof(entry_magic)) == 0 && header.byte_order == byte_order_mark
+		&& header.input_hash == input_hash && header.options_size == options.size()
+		&& bytes.size() - sizeof(header) >= options.size() && bytes.size() - sizeof(header) - options.size() == header.data_size
+		&& bytes.substr(sizeof(header), options.size()) == options;
+	if (!valid) {
+		found.file.close();
+		return false;
+	}
+	found.server_count = header.server_count;
+	found.bytes = bytes.substr(sizeof(header) + options.size());
+	return true;
+}
+
+bool parse_cache::store(std::uint64_t input_hash, std::string_view options, std::uint64_t server_count, std::string_view bytes) const {
+	entry_header header{};
+	std::memcpy(header.magic, entry_magic, sizeof(entry_magic));
+	header.byte_order = byte_order_mark;
+	header.input_hash = input_hash;
+	header.server_count = server_count;
+	header.options_size = options.size();
+	header.data_size = bytes.size();
+
+	atomic_output output(entry_path(input_hash, options));
+	if (!output.is_open())
+		return false;
+	std::ostream& out = output.stream();
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(options.data(), static_cast<std::streamsize>(options.size()));
+	out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	output_result result{};
+	return output.commit(result);
+}
@@ -0,0 +1,492 @@
+#include "ping.hpp"
+#include "ping_cache.hpp"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+using json = nlohmann::json;
+
+// by convention, for clients that don't know the server's version yet
+constexpr std::uint32_t any_protocol = static_cast<std::uint32_t>(-1);
+// favicons are at most 32767 chars of a string, this leaves room for the rest of the JSON
+constexpr std::size_t max_response = 1 << 18;
+constexpr std::string_view favicon_prefix = "data:image/png;base64,";
+
+void write_varint(std::string& out, std::uint32_t value) {
+	do {
+		auto byte = static_cast<unsigned char>(value & 0x7f);
+		value >>= 7;
+		if (value)
+			byte |= 0x80;
+		out += static_cast<char>(byte);
+	} while (value);
+}
+
+// Bytes the VarInt at the start of bytes takes, 0 when it's cut off, -1 when it's too long
+int read_varint(std::string_view bytes, std::uint32_t& value) {
+	value = 0;
+	for (std::size_t i = 0; i < 5; ++i) {
+		if (i == bytes.size())
+			return 0;
+		const auto byte = static_cast<unsigned char>(bytes[i]);
+		value |= static_cast<std::uint32_t>(byte & 0x7f) << (7 * i);
+		if (!(byte & 0x80))
+			return static_cast<int>(i + 1);
+	}
+	return -1;
+}
+
+// Text of a chat component: a string, an array of components or an object with text and extra
+void append_text(const json& component, std::string& out) {
+	if (component.is_string()) {
+		out += component.get_ref<const std::string&>();
+	} else if (component.is_array()) {
+		for (const json& part : component)
+			append_text(part, out);
+	} else if (component.is_object()) {
+		if (const auto text = component.find("text"); text != component.end())
+			append_text(*text, out);
+		if (const auto extra = component.find("extra"); extra != component.end())
+			append_text(*extra, out);
+	}
+}
+
+// Drops § formatting codes and puts the lines together, a server name has one line
+std::string plain_text(std::string_view text) {
+	std::string out;
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		if (text.substr(i, 2) == "\xc2\xa7") { // §
+			i += 2; // and the code after it
+			continue;
+		}
+		const char c = text[i] == '\n' || text[i] == '\r' || text[i] == '\t' ? ' ' : text[i];
+		if (c == ' ' && (out.empty() || out.back() == ' '))
+			continue;
+		out += c;
+	}
+	if (!out.empty() && out.back() == ' ')
+		out.pop_back();
+	return out;
+}
+
+#ifdef __linux__
+using ping_clock = std::chrono::steady_clock;
+
+constexpr std::size_t resolver_threads = 16;
+// descriptors left for everything else while pinging
+constexpr rlim_t reserved_files = 64;
+
+struct ping_target {
+	bool resolved = false;
+	sockaddr_storage address{};
+	socklen_t length = 0;
+	std::string host; // sent in the handshake
+	std::uint16_t port = default_port;
+};
+
+bool resolve(std::string_view text, ping_target& target) {
+	server_address parsed{};
+	std::string_view host{};
+	if (parse_address(text, parsed, &host) != address_error::none)
+		return false;
+	target.port = parsed.port;
+	if (parsed.kind == address_kind::ipv4) {
+		auto& address = reinterpret_cast<sockaddr_in&>(target.address);
+		address.sin_family = AF_INET;
+		address.sin_port = htons(parsed.port);
+		address.sin_addr.s_addr = htonl(parsed.ipv4);
+		target.length = sizeof(sockaddr_in);
+	} else if (parsed.kind == address_kind::ipv6) {
+		auto& address = reinterpret_cast<sockaddr_in6&>(target.address);
+		address.sin6_family = AF_INET6;
+		address.sin6_port = htons(parsed.port);
+		std::memcpy(address.sin6_addr.s6_addr, parsed.ipv6.data(), parsed.ipv6.size());
+		target.length = sizeof(sockaddr_in6);
+	} else {
+		const addrinfo hints{ .ai_flags = 0, .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_protocol = 0,
+			.ai_addrlen = 0, .ai_addr = nullptr, .ai_canonname = nullptr, .ai_next = nullptr };
+		addrinfo* found = nullptr;
+		if (getaddrinfo(std::string(host).c_str(), nullptr, &hints, &found) != 0 || !found)
+			return false;
+		std::memcpy(&target.address, found->ai_addr, found->ai_addrlen);
+		target.length = found->ai_addrlen;
+		freeaddrinfo(found);
+		if (target.address.ss_family == AF_INET)
+			reinterpret_cast<sockaddr_in&>(target.address).sin_port = htons(parsed.port);
+		else
+			reinterpret_cast<sockaddr_in6&>(target.address).sin6_port = htons(parsed.port);
+	}
+	// the handshake carries the address without its port
+	parsed.port = default_port;
+	target.host = format_address(parsed, host);
+	target.resolved = true;
+	return true;
+}
+
+// Raises the soft limit of open files to the hard one and returns how many sockets fit
+std::size_t socket_budget() {
+	rlimit limit{};
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+		return 256;
+	if (limit.rlim_cur != limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+			getrlimit(RLIMIT_NOFILE, &limit);
+	}
+	if (limit.rlim_cur == RLIM_INFINITY)
+		return SIZE_MAX;
+	return limit.rlim_cur > 2 * reserved_files ? static_cast<std::size_t>(limit.rlim_cur - reserved_files) : static_cast<std::size_t>(limit.rlim_cur / 2);
+}
+
+struct connection {
+	int fd = -1;
+	std::size_t target = 0;
+	std::uint64_t generation = 0; // bumped when it finishes, so stale deadlines can be told apart
+	bool connected = false;
+	std::string request;
+	std::size_t written = 0;
+	std::string response;
+	ping_clock::time_point sent{};
+};
+
+class ping_loop {
+public:
+	ping_loop(const std::vector<ping_target>& targets, std::vector<ping_result>& results, const ping_options& options)
+		: targets(targets), results(results), timeout(options.timeout) {
+		slots.resize(std::max<std::size_t>(1, std::min({options.concurrency, socket_budget(), targets.size()})));
+		for (std::size_t i = slots.size(); i-- > 0;)
+			free_slots.push_back(i);
+	}
+
+	void run() {
+		epoll = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll < 0)
+			return; // every result stays unreachable
+		std::vector<epoll_event> events(256);
+		for (start(); free_slots.size() < slots.size(); start()) {
+			const ping_clock::time_point now = ping_clock::now();
+			int wait_ms = -1;
+			while (!deadlines.empty()) {
+				const auto [deadline, slot, generation] = deadlines.front();
+				if (slots[slot].generation != generation) {
+					deadlines.pop_front();
+				} else if (deadline <= now) {
+					deadlines.pop_front();
+					finish(slot, ping_status::timeout);
+				} else {
+					// every connection has the same timeout, so the front one expires first
+					wait_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+					break;
+				}
+			}
+			if (free_slots.size() == slots.size())
+				continue;
+			const int ready = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), wait_ms);
+			for (int i = 0; i < ready; ++i)
+				handle(static_cast<std::size_t>(events[i].data.u64), events[i].events);
+		}
+		close(epoll);
+	}
+
+private:
+	struct deadline_entry {
+		ping_clock::time_point deadline;
+		std::size_t slot;
+		std::uint64_t generation;
+	};
+
+	// Opens connections until the slots or the targets run out
+	void start() {
+		while (!free_slots.empty() && next_target < targets.size()) {
+			const std::size_t index = next_target++;
+			const ping_target& target = targets[index];
+			if (!target.resolved)
+				continue;
+			const int fd = socket(target.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+				continue;
+			if (connect(fd, reinterpret_cast<const sockaddr*>(&target.address), target.length) != 0 && errno != EINPROGRESS) {
+				close(fd);
+				continue;
+			}
+			const std::size_t slot = free_slots.back();
+			epoll_event event{ .events = EPOLLOUT, .data = { .u64 = slot } };
+			if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+				close(fd);
+				continue;
+			}
+			free_slots.pop_back();
+			connection& c = slots[slot];
+			c.fd = fd;
+			c.target = index;
+			c.connected = false;
+			c.request = status_request(target.host, target.port);
+			c.written = 0;
+			c.response.clear();
+			deadlines.push_back({ ping_clock::now() + timeout, slot, c.generation });
+		}
+	}
+
+	void finish(std::size_t slot, ping_status status) {
+		connection& c = slots[slot];
+		close(c.fd); // also takes it out of the epoll set
+		c.fd = -1;
+		++c.generation;
+		results[c.target].status = status;
+		free_slots.push_back(slot);
+	}
+
+	void handle(std::size_t slot, std::uint32_t events) {
+		connection& c = slots[slot];
+		if (!c.connected) {
+			int error = 0;
+			socklen_t length = sizeof(error);
+			if (getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0 || !(events & EPOLLOUT)) {
+				finish(slot, ping_status::unreachable);
+				return;
+			}
+			c.connected = true;
+		}
+
+		if (c.written < c.request.size()) {
+			const ssize_t sent = send(c.fd, c.request.data() + c.written, c.request.size() - c.written, MSG_NOSIGNAL);
+			if (sent < 0) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					finish(slot, ping_status::unreachable);
+				return;
+			}
+			c.written += static_cast<std::size_t>(sent);
+			if (c.written == c.request.size()) {
+				c.sent = ping_clock::now();
+				epoll_event event{ .events = EPOLLIN | EPOLLRDHUP, .data = { .u64 = slot } };
+				epoll_ctl(epoll, EPOLL_CTL_MOD, c.fd, &event);
+			}
+			return;
+		}
+
+		bool closed = false;
+		char buffer[16384];
+		for (;;) {
+			const ssize_t got = recv(c.fd, buffer, sizeof(buffer), 0);
+			if (got > 0) {
+				c.response.append(buffer, static_cast<std::size_t>(got));
+				if (c.response.size() > max_response)
+					break;
+				continue;
+			}
+			if (got < 0 && errno == EINTR)
+				continue;
+			closed = got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+			break;
+		}
+
+		std::string_view text{};
+		const response_frame frame = read_status_response(c.response, text);
+		ping_result& result = results[c.target];
+		if (frame == response_frame::complete) {
+			const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(ping_clock::now() - c.sent).count();
+			result.latency_ms = static_cast<std::uint32_t>(std::min<long long>(latency, UINT32_MAX));
+			finish(slot, parse_status_json(text, result) ? ping_status::ok : ping_status::bad_response);
+		} else if (frame == response_frame::invalid || c.response.size() > max_response) {
+			finish(slot, ping_status::bad_response);
+		} else if (closed) {
+			finish(slot, c.response.empty() ? ping_status::unreachable : ping_status::bad_response);
+		}
+	}
+
+	const std::vector<ping_target>& targets;
+	std::vector<ping_result>& results;
+	const std::chrono::milliseconds timeout;
+	int epoll = -1;
+	std::vector<connection> slots;
+	std::vector<std::size_t> free_slots;
+	std::deque<deadline_entry> deadlines; // in the order the connections were opened
+	std::size_t next_target = 0;
+};
+#endif
+}
+
+std::string_view ping_status_name(ping_status status) {
+	switch (status) {
+	case ping_status::ok: return "answered";
+	case ping_status::unresolved: return "unresolved";
+	case ping_status::unreachable: return "unreachable";
+	case ping_status::timeout: return "timed out";
+	case ping_status::bad_response: return "bad response";
+	}
+	return "unknown";
+}
+
+bool ping_supported() {
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::string status_request(std::string_view host, std::uint16_t port) {
+	std::string handshake;
+	write_varint(handshake, 0x00); // packet id
+	write_varint(handshake, any_protocol);
+	write_varint(handshake, static_cast<std::uint32_t>(host.size()));
+	handshake += host;
+	handshake += static_cast<char>(port >> 8);
+	handshake += static_cast<char>(port & 0xff);
+	write_varint(handshake, 1); // next state: status
+
+	std::string out;
+	write_varint(out, static_cast<std::uint32_t>(handshake.size()));
+	out += handshake;
+	out += std::string_view("\x01\x00", 2); // status request: length 1, packet id 0
+	return out;
+}
+
+response_frame read_status_response(std::string_view bytes, std::string_view& json) {
+	std::uint32_t length = 0;
+	const int length_size = read_varint(bytes, length);
+	if (length_size < 0 || length > max_response)
+		return response_frame::invalid;
+	if (length_size == 0 || bytes.size() - static_cast<std::size_t>(length_size) < length)
+		return response_frame::incomplete;
+	std::string_view packet = bytes.substr(static_cast<std::size_t>(length_size), length);
+
+	std::uint32_t id = 0;
+	const int id_size = read_varint(packet, id);
+	if (id_size <= 0 || id != 0x00)
+		return response_frame::invalid;
+	packet.remove_prefix(static_cast<std::size_t>(id_size));
+	std::uint32_t text_length = 0;
+	const int text_length_size = read_varint(packet, text_length);
+	if (text_length_size <= 0 || text_length > packet.size() - static_cast<std::size_t>(text_length_size))
+		return response_frame::invalid;
+	json = packet.substr(static_cast<std::size_t>(text_length_size), text_length);
+	return response_frame::complete;
+}
+
+bool parse_status_json(std::string_view text, ping_result& result) {
+	const json status = json::parse(text.begin(), text.end(), nullptr, false);
+	if (status.is_discarded() || !status.is_object())
+		return false;
+	if (const auto description = status.find("description"); description != status.end()) {
+		std::string motd;
+		append_text(*description, motd);
+		result.motd = plain_text(motd);
+	}
+	if (const auto favicon = status.find("favicon"); favicon != status.end() && favicon->is_string()) {
+		const std::string& uri = favicon->get_ref<const std::string&>();
+		if (uri.starts_with(favicon_prefix)) {
+			// old servers wrap the base64 in lines
+			result.favicon.clear();
+			std::copy_if(uri.begin() + static_cast<std::ptrdiff_t>(favicon_prefix.size()), uri.end(), std::back_inserter(result.favicon),
+				[](char c) { return c != '\n' && c != '\r'; });
+		}
+	}
+	return true;
+}
+
+std::vector<ping_result> ping_addresses(const std::vector<std::string>& addresses, const ping_options& options) {
+	std::vector<ping_result> results(addresses.size());
+#ifdef __linux__
+	std::vector<ping_target> targets(addresses.size());
+	std::atomic<std::size_t> next{0};
+	const auto worker = [&]() {
+		for (std::size_t i; (i = next++) < addresses.size();) {
+			if (!resolve(addresses[i], targets[i]))
+				results[i].status = ping_status::unresolved;
+		}
+	};
+	{
+		std::vector<std::jthread> threads;
+		for (std::size_t i = 1; i < std::min(resolver_threads, addresses.size()); ++i)
+			threads.emplace_back(worker);
+		worker();
+	}
+	ping_loop(targets, results, options).run();
+#else
+	(void)options;
+#endif
+	return results;
+}
+
+std::string ping_cache_key(std::string_view address) {
+	server_address parsed{};
+	std::string_view host{};
+	if (parse_address(address, parsed, &host) != address_error::none)
+		return std::string(address);
+	return format_address(parsed, host);
+}
+
+ping_stats ping_servers(std::vector<nbtserver>& servers, const ping_options& options, ping_cache* cache) {
+	ping_stats stats{};
+	std::unordered_map<std::string_view, std::size_t> index; // address, position in addresses
+	std::vector<std::string> addresses;
+	for (const nbtserver& server : servers) {
+		if ((server.name.empty() || server.icon.empty()) && index.try_emplace(server.ip, addresses.size()).second)
+			addresses.push_back(server.ip);
+	}
+	if (addresses.empty())
+		return stats;
+
+	std::vector<ping_result> results(addresses.size());
+	std::vector<std::string> keys(cache ? addresses.size() : 0);
+	std::vector<std::size_t> missing; // positions in addresses that have to be pinged
+	std::vector<std::string> to_ping;
+	const std::int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	for (std::size_t i = 0; i < addresses.size(); ++i) {
+		if (cache) {
+			keys[i] = ping_cache_key(addresses[i]);
+			if (cache->lookup(keys[i], now, results[i])) {
+				++stats.cached;
+				continue;
+			}
+		}
+		missing.push_back(i);
+		to_ping.push_back(addresses[i]);
+	}
+	std::vector<ping_result> pinged = ping_addresses(to_ping, options);
+	for (std::size_t i = 0; i < missing.size(); ++i) {
+		ping_result& result = results[missing[i]] = std::move(pinged[i]);
+		if (cache) {
+			const std::chrono::seconds ttl = result.status == ping_status::ok ? options.ttl : options.negative_ttl;
+			cache->store(keys[missing[i]], result, now, now + ttl.count());
+		}
+	}
+
+	stats.pinged = missing.size();
+	for (const ping_result& result : results)
+		++stats.statuses[static_cast<std::size_t>(result.status)];
+	for (nbtserver& server : servers) {
+		if (!server.name.empty() && !server.icon.empty())
+			continue;
+		const ping_result& result = results[index.at(server.ip)];
+		if (result.status != ping_status::ok)
+			continue;
+		if (server.name.empty() && !result.motd.empty()) {
+			server.name = result.motd;
+			++stats.names;
+		}
+		if (server.icon.empty() && !result.favicon.empty()) {
+			server.icon = result.favicon;
+			++stats.icons;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,277 @@
+#include "ping_cache.hpp"
+#include "hash.hpp"
+#include "output.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+// File layout, numbers in native byte order (byte_order tells):
+//	file_header
+//	index: slot_count index_slots
+//	entries: entry_header, key, motd, favicon
+constexpr std::string_view magic("ENBTPNG\x01", 8);
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+constexpr std::uint64_t min_slots = 1024;
+// below this the file is never worth compacting
+constexpr std::uint64_t min_compact_size = 1 << 20;
+
+struct entry_header {
+	std::int64_t checked_at;
+	std::int64_t expires_at;
+	std::uint32_t latency_ms;
+	std::uint32_t key_size;
+	std::uint32_t motd_size;
+	std::uint32_t favicon_size;
+	std::uint8_t status;
+	std::uint8_t reserved[7];
+};
+static_assert(sizeof(entry_header) == 40 && std::is_trivially_copyable_v<entry_header>);
+static_assert(sizeof(ping_cache::file_header) == 48 && sizeof(ping_cache::index_slot) == 16);
+
+struct entry_view {
+	entry_header header;
+	std::string_view key;
+	std::string_view motd;
+	std::string_view favicon;
+	std::uint64_t size;
+};
+
+// Reads the entry at the start of bytes, false when it runs past them
+bool read_entry(std::string_view bytes, entry_view& entry) {
+	if (bytes.size() < sizeof(entry_header))
+		return false;
+	std::memcpy(&entry.header, bytes.data(), sizeof(entry_header));
+	const entry_header& h = entry.header;
+	entry.size = sizeof(entry_header) + std::uint64_t{h.key_size} + h.motd_size + h.favicon_size;
+	if (entry.size > bytes.size() || h.status >= ping_status_count)
+		return false;
+	entry.key = bytes.substr(sizeof(entry_header), h.key_size);
+	entry.motd = bytes.substr(sizeof(entry_header) + h.key_size, h.motd_size);
+	entry.favicon = bytes.substr(sizeof(entry_header) + h.key_size + h.motd_size, h.favicon_size);
+	return true;
+}
+
+std::string encode_entry(std::string_view key, const ping_result& result, std::int64_t checked_at, std::int64_t expires_at) {
+	entry_header h{};
+	h.checked_at = checked_at;
+	h.expires_at = expires_at;
+	h.latency_ms = result.latency_ms;
+	h.key_size = static_cast<std::uint32_t>(key.size());
+	h.motd_size = static_cast<std::uint32_t>(result.motd.size());
+	h.favicon_size = static_cast<std::uint32_t>(result.favicon.size());
+	h.status = static_cast<std::uint8_t>(result.status);
+	std::string out(reinterpret_cast<const char*>(&h), sizeof(h));
+	out += key;
+	out += result.motd;
+	out += result.favicon;
+	return out;
+}
+
+// An index at most a quarter full after a rewrite, so it takes a while to need the next one
+std::uint64_t slot_count_for(std::uint64_t entries) {
+	std::uint64_t slots = min_slots;
+	while (slots < entries * 4)
+		slots <<= 1;
+	return slots;
+}
+
+std::uint64_t index_offset(std::uint64_t slot) {
+	return sizeof(ping_cache::file_header) + slot * sizeof(ping_cache::index_slot);
+}
+}
+
+ping_cache::ping_cache(const fs::path& path) : path(path) {
+	std::error_code ec;
+	if (!fs::exists(path, ec)) {
+		opened = !ec;
+		return;
+	}
+	if (!file.open(path.string()))
+		return;
+	const std::string_view bytes = file.view();
+	if (bytes.empty()) {
+		opened = true;
+		return;
+	}
+	if (!bytes.starts_with(magic))
+		return;
+	opened = true;
+
+	// anything inconsistent is a cache from another machine or a broken one, it's started over
+	file_header read{};
+	if (bytes.size() < sizeof(read))
+		return;
+	std::memcpy(&read, bytes.data(), sizeof(read));
+	const std::uint64_t slots = read.slot_count;
+	if (read.byte_order != byte_order_mark || slots == 0 || (slots & (slots - 1)) != 0 || slots > bytes.size() / sizeof(index_slot)
+		|| read.entry_count > slots / 2 || read.dead_size > read.data_size || read.data_size > bytes.size() - index_offset(slots))
+		return;
+	header = read;
+}
+
+std::string_view ping_cache::entry_bytes(std::uint64_t offset, std::string_view appended) const {
+	if (offset < header.data_size)
+		return file.view().substr(static_cast<std::size_t>(index_offset(header.slot_count) + offset), static_cast<std::size_t>(header.data_size - offset));
+	offset -= header.data_size;
+	return offset < appended.size() ? appended.substr(static_cast<std::size_t>(offset)) : std::string_view{};
+}
+
+std::vector<ping_cache::index_slot> ping_cache::read_index() const {
+	std::vector<index_slot> slots(header.slot_count);
+	if (!slots.empty())
+		std::memcpy(slots.data(), file.data() + index_offset(0), slots.size() * sizeof(index_slot));
+	return slots;
+}
+
+std::uint64_t ping_cache::probe(const std::vector<index_slot>& slots, std::uint64_t hash, std::string_view key, std::string_view appended) const {
+	const std::uint64_t mask = slots.size() - 1;
+	for (std::uint64_t i = hash & mask;; i = (i + 1) & mask) {
+		const index_slot& slot = slots[i];
+		if (slot.offset == 0)
+			return i;
+		entry_view entry{};
+		// slots left pointing past the data by an interrupted flush are skipped like other keys
+		if (slot.hash == hash && read_entry(entry_bytes(slot.offset - 1, appended), entry) && entry.key == key)
+			return i;
+	}
+}
+
+bool ping_cache::lookup(std::string_view key, std::int64_t now, ping_result& result) const {
+	if (header.slot_count == 0)
+		return false;
+	const std::uint64_t hash = hash_bytes(key);
+	const std::uint64_t mask = header.slot_count - 1;
+	for (std::uint64_t i = hash & mask, probes = 0; probes < header.slot_count; i = (i + 1) & mask, ++probes) {
+		index_slot slot{};
+		std::memcpy(&slot, file.data() + index_offset(i), sizeof(slot));
+		if (slot.offset == 0)
+			return false;
+		entry_view entry{};
+		if (slot.hash != hash || !read_entry(entry_bytes(slot.offset - 1), entry) || entry.key != key)
+			continue;
+		if (entry.header.expires_at <= now)
+			return false;
+		result.status = static_cast<ping_status>(entry.header.status);
+		result.latency_ms = entry.header.latency_ms;
+		result.motd = entry.motd;
+		result.favicon = entry.favicon;
+		return true;
+	}
+	return false;
+}
+
+void ping_cache::store(std::string_view key, const ping_result& result, std::int64_t checked_at, std::int64_t expires_at) {
+	newest = std::max(newest, checked_at);
+	std::string encoded = encode_entry(key, result, checked_at, expires_at);
+	const auto [it, inserted] = pending_index.try_emplace(std::string(key), pending.size());
+	if (inserted)
+		pending.emplace_back(std::string(key), std::move(encoded));
+	else
+		pending[it->second].second = std::move(encoded);
+}
+
+bool ping_cache::flush() {
+	if (pending.empty())
+		return true;
+	if (header.slot_count == 0)
+		return rewrite();
+
+	// put the queued entries into a copy of the index, as if they were appended to the data
+	std::vector<index_slot> slots = read_index();
+	std::string appended;
+	std::uint64_t entries = header.entry_count;
+	std::uint64_t dead = header.dead_size;
+	for (const auto& [key, encoded] : pending) {
+		const std::uint64_t hash = hash_bytes(key);
+		const std::uint64_t at = probe(slots, hash, key, appended);
+		entry_view replaced{};
+		if (slots[at].offset && read_entry(entry_bytes(slots[at].offset - 1, appended), replaced)) {
+			dead += replaced.size;
+		} else if (++entries * 2 > slots.size()) {
+			return rewrite();
+		}
+		slots[at] = { hash, header.data_size + appended.size() + 1 };
+		appended += encoded;
+	}
+	const std::uint64_t data_size = header.data_size + appended.size();
+	if (data_size >= min_compact_size && dead * 2 > data_size)
+		return rewrite();
+
+	// entries first, then the index and the header that make them reachable. An
+	// interrupted flush leaves slots pointing past the old data size, which are ignored
+	file_header updated = header;
+	updated.entry_count = entries;
+	updated.data_size = data_size;
+	updated.dead_size = dead;
+	const std::uint64_t data_end = index_offset(header.slot_count) + header.data_size;
+	file.close();
+	std::FILE* out = std::fopen(path.string().c_str(), "r+b");
+	if (!out)
+		return false;
+	const bool written = seek_file(out, data_end)
+		&& std::fwrite(appended.data(), 1, appended.size(), out) == appended.size() && sync_file(out)
+		&& seek_file(out, index_offset(0))
+		&& std::fwrite(slots.data(), sizeof(index_slot), slots.size(), out) == slots.size()
+		&& std::fseek(out, 0, SEEK_SET) == 0 && std::fwrite(&updated, sizeof(updated), 1, out) == 1 && sync_file(out);
+	std::fclose(out);
+	if (!written || !file.open(path.string()))
+		return false;
+	header = updated;
+	pending.clear();
+	pending_index.clear();
+	return true;
+}
+
+bool ping_cache::rewrite() {
+	// the queued entries, then the file's that weren't replaced and are still of use
+	std::vector<std::string_view> kept;
+	for (const auto& [key, encoded] : pending)
+		kept.push_back(encoded);
+	for (const index_slot& slot : read_index()) {
+		entry_view entry{};
+		if (slot.offset && read_entry(entry_bytes(slot.offset - 1), entry) && entry.header.expires_at >= newest
+			&& !pending_index.contains(std::string(entry.key)))
+			kept.push_back(entry_bytes(slot.offset - 1).substr(0, static_cast<std::size_t>(entry.size)));
+	}
+
+	file_header rewritten{};
+	std::memcpy(rewritten.magic, magic.data(), magic.size());
+	rewritten.byte_order = byte_order_mark;
+	rewritten.slot_count = slot_count_for(kept.size());
+	rewritten.entry_count = kept.size();
+	std::vector<index_slot> slots(rewritten.slot_count);
+	const std::uint64_t mask = rewritten.slot_count - 1;
+	for (const std::string_view encoded : kept) {
+		entry_view entry{};
+		read_entry(encoded, entry);
+		const std::uint64_t hash = hash_bytes(entry.key);
+		std::uint64_t at = hash & mask;
+		while (slots[at].offset)
+			at = (at + 1) & mask;
+		slots[at] = { hash, rewritten.data_size + 1 };
+		rewritten.data_size += encoded.size();
+	}
+
+	atomic_output output(path);
+	if (!output.is_open())
+		return false;
+	std::ostream& out = output.stream();
+	out.write(reinterpret_cast<const char*>(&rewritten), sizeof(rewritten));
+	out.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(index_slot)));
+	for (const std::string_view encoded : kept)
+		out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+	out.flush();
+	// kept points into the mapping and the queue until everything is written
+	file.close();
+	output_result result{};
+	if (!output.commit(result) || !file.open(path.string()))
+		return false;
+	header = rewritten;
+	pending.clear();
+	pending_index.clear();
+	return true;
+}
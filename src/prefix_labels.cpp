@@ -0,0 +1,240 @@
+#include "prefix_labels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+// The labels are saved after the table: their count (8 bytes), offsets (count + 1)
+// padded to 8 bytes, and their text
+constexpr char cache_magic[8] = {'E', 'N', 'B', 'T', 'L', 'B', 'L', '\x02'};
+
+template <typename T>
+using labelled = interval_table::interval<T>;
+
+std::size_t padded(std::size_t bytes) {
+	return (bytes + 7) & ~std::size_t{7};
+}
+
+// A label as written, or the inside of a quoted one with "" read as "
+std::string read_label(std::string_view text) {
+	if (text.size() < 2 || text.front() != '"' || text.back() != '"')
+		return std::string(text);
+	text = text.substr(1, text.size() - 2);
+	std::string out;
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		out += text[i];
+		if (text[i] == '"' && i + 1 < text.size() && text[i + 1] == '"')
+			++i;
+	}
+	return out;
+}
+
+// Splits nested prefixes into disjoint intervals labelled by the longest prefix holding
+// them, joining neighbours with the same label. Two prefixes are either nested or
+// disjoint, so ordered by start and then largest first, every prefix comes after the
+// ones holding it and the open ones form a stack
+template <typename T>
+std::vector<labelled<T>> split_prefixes(std::vector<labelled<T>> prefixes, T max) {
+	std::stable_sort(prefixes.begin(), prefixes.end(), [](const labelled<T>& a, const labelled<T>& b) {
+		return a.start < b.start || (a.start == b.start && b.end < a.end);
+	});
+	std::vector<labelled<T>> out;
+	std::vector<labelled<T>> open;
+	T next{}; // first address not labelled yet
+	bool done = false; // the last address is labelled, next would overflow
+	const auto emit = [&](T start, T end, std::uint32_t label) {
+		if (!out.empty() && out.back().payload == label && interval_table::successor(out.back().end) == start)
+			out.back().end = end;
+		else
+			out.push_back({ start, end, label });
+	};
+	// labels what's left of the innermost open prefix
+	const auto close = [&]() {
+		const labelled<T> prefix = open.back();
+		open.pop_back();
+		if (done || prefix.end < next)
+			return;
+		emit(next, prefix.end, prefix.payload);
+		done = prefix.end == max;
+		if (!done)
+			next = interval_table::successor(prefix.end);
+	};
+
+	for (const labelled<T>& prefix : prefixes) {
+		while (!open.empty() && open.back().end < prefix.start)
+			close();
+		// the part of the holding prefix before this one. A prefix listed twice is
+		// opened again, so the later label wins
+		if (!open.empty() && next < prefix.start)
+			emit(next, interval_table::predecessor(prefix.start), open.back().payload);
+		next = prefix.start;
+		done = false;
+		open.push_back(prefix);
+	}
+	while (!open.empty())
+		close();
+	return out;
+}
+}
+
+prefix_labels::prefix_labels(const fs::path& path) {
+	interval_table::source_stamp stamp{};
+	if (!interval_table::stamp_of(path, stamp)) {
+		problem = "can't read " + path.string();
+		return;
+	}
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	std::string_view extra;
+	if (table.load(cache_path, cache_magic, stamp, extra) && read_labels(extra)) {
+		opened = from_cache = true;
+		return;
+	}
+
+	const mapped_file text(path.string());
+	if (!text.is_open()) {
+		problem = "can't read " + path.string();
+		return;
+	}
+	if (!compile(text.view()))
+		return;
+	table.save(cache_path, cache_magic, stamp, write_labels());
+	opened = true;
+}
+
+bool prefix_labels::compile(std::string_view text) {
+	using u128 = interval_table::u128;
+	std::vector<labelled<std::uint32_t>> v4;
+	std::vector<labelled<u128>> v6;
+	std::unordered_map<std::string, std::uint32_t> label_ids;
+	std::vector<std::string_view> labels;
+
+	std::size_t line_number = 0;
+	bool first_line = true;
+	while (!text.empty()) {
+		++line_number;
+		const std::size_t newline = text.find('\n');
+		std::string_view line = trim_address(text.substr(0, newline));
+		text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+		// a label can hold a #, so only whole lines are comments
+		if (line.empty() || line.front() == '#')
+			continue;
+		const bool header_allowed = first_line;
+		first_line = false;
+
+		const std::size_t comma = line.find(',');
+		labelled<std::uint32_t> range_v4{};
+		labelled<u128> range_v6{};
+		bool is_v4 = false;
+		const interval_table::cidr_error error = interval_table::parse_cidr(trim_address(line.substr(0, comma)), range_v4, range_v6, is_v4);
+		if (error == interval_table::cidr_error::address && header_allowed)
+			continue; // "network,label" and the like
+		if (error != interval_table::cidr_error::none) {
+			const char* what = error == interval_table::cidr_error::address ? "invalid address" : "invalid prefix length";
+			problem = "line " + std::to_string(line_number) + ": " + what + " '" + std::string(line) + '\'';
+			return false;
+		}
+		const std::string label = comma == std::string_view::npos ? std::string() : read_label(trim_address(line.substr(comma + 1)));
+		if (label.empty()) {
+			problem = "line " + std::to_string(line_number) + ": missing label '" + std::string(line) + '\'';
+			return false;
+		}
+		const auto [it, inserted] = label_ids.try_emplace(label, static_cast<std::uint32_t>(labels.size()));
+		if (inserted)
+			labels.push_back(it->first);
+
+		if (is_v4) {
+			range_v4.payload = it->second;
+			v4.push_back(range_v4);
+		} else {
+			range_v6.payload = it->second;
+			v6.push_back(range_v6);
+		}
+	}
+
+	owned_label_offsets.assign(1, 0);
+	owned_label_text.clear();
+	for (const std::string_view label : labels) {
+		owned_label_text += label;
+		owned_label_offsets.push_back(static_cast<std::uint32_t>(owned_label_text.size()));
+	}
+	if (owned_label_text.size() > UINT32_MAX) {
+		problem = "the labels are too long";
+		return false;
+	}
+	label_offsets = owned_label_offsets;
+	label_text = owned_label_text;
+
+	table.assign(split_prefixes(std::move(v4), ~std::uint32_t{0}), split_prefixes(std::move(v6), u128{ ~std::uint64_t{0}, ~std::uint64_t{0} }), true);
+	return true;
+}
+
+bool prefix_labels::read_labels(std::string_view extra) {
+	std::uint64_t count = 0;
+	if (extra.size() < sizeof(count))
+		return false;
+	std::memcpy(&count, extra.data(), sizeof(count));
+	extra.remove_prefix(sizeof(count));
+	if (count >= UINT32_MAX || padded((count + 1) * sizeof(std::uint32_t)) > extra.size())
+		return false;
+	// extra is 8 byte aligned, so are the offsets after the count
+	label_offsets = std::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t*>(extra.data()), static_cast<std::size_t>(count) + 1);
+	label_text = extra.substr(padded(label_offsets.size_bytes()));
+	// labels out of range are checked by lookup, the offsets here
+	return std::is_sorted(label_offsets.begin(), label_offsets.end()) && label_offsets.front() == 0 && label_offsets.back() == label_text.size();
+}
+
+std::string prefix_labels::write_labels() const {
+	const std::uint64_t count = label_count();
+	std::string out(sizeof(count) + padded(label_offsets.size_bytes()), '\0');
+	std::memcpy(out.data(), &count, sizeof(count));
+	std::memcpy(out.data() + sizeof(count), label_offsets.data(), label_offsets.size_bytes());
+	out += label_text;
+	return out;
+}
+
+std::string_view prefix_labels::lookup(const server_address& address) const {
+	const std::size_t interval = table.find(address);
+	if (interval == interval_table::npos)
+		return {};
+	const std::uint32_t label = table.payload(interval);
+	if (label >= label_count())
+		return {};
+	return label_text.substr(label_offsets[label], label_offsets[label + 1] - label_offsets[label]);
+}
+
+bool prefix_labels::name(nbtserver& server, std::string_view name_template) const {
+	if (!server.name.empty())
+		return false;
+	server_address address = server.address;
+	if (address.kind == address_kind::none && parse_address(server.ip, address) != address_error::none)
+		return false;
+	const std::string_view label = lookup(address);
+	if (label.empty())
+		return false;
+	std::string name;
+	while (!name_template.empty()) {
+		if (name_template.starts_with("{label}")) {
+			name += label;
+			name_template.remove_prefix(7);
+		} else if (name_template.starts_with("{ip}")) {
+			name += server.ip;
+			name_template.remove_prefix(4);
+		} else {
+			name += name_template.front();
+			name_template.remove_prefix(1);
+		}
+	}
+	server.name = std::move(name);
+	return true;
+}
+
+std::size_t prefix_labels::name_servers(std::vector<nbtserver>& servers, std::string_view name_template) const {
+	std::size_t named = 0;
+	for (nbtserver& server : servers)
+		named += name(server, name_template);
+	return named;
+}
@@ -0,0 +1,418 @@
+#include "registry.hpp"
+#include "NBTReader.h"
+#include "hash.hpp"
+#include "output.hpp"
+#include "static_servers.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Log layout, all numbers big endian:
+//	magic
+//	records: kind (1), ip length (2), ip, then for upserts compound length (4), compound
+constexpr std::string_view magic("ENBTREG\x01", 8);
+constexpr char kind_upsert = 1;
+constexpr char kind_delete = 2;
+
+// below this the log is never worth compacting
+constexpr std::uint64_t min_compact_size = 1 << 20;
+// records after the checkpoint below this are read on open rather than checkpointed
+constexpr std::uint64_t min_checkpoint_tail = 1 << 16;
+
+// Checkpoint layout, native byte order:
+//	checkpoint_header
+//	slots (16 bytes each), then live ips (16 bytes each)
+constexpr char checkpoint_magic[8] = {'E', 'N', 'B', 'T', 'R', 'I', 'X', '\x01'};
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+// log bytes hashed to tell the log the checkpoint was made for from a rewritten one
+constexpr std::uint64_t checkpoint_tail_bytes = 4096;
+
+struct checkpoint_header {
+	char magic[8];
+	std::uint32_t byte_order;
+	std::uint32_t reserved;
+	std::uint64_t log_size;
+	std::uint64_t log_tail_hash;
+	std::uint64_t slot_count;
+	std::uint64_t ip_count;
+	std::uint64_t live;
+};
+
+static_assert(sizeof(checkpoint_header) % 8 == 0);
+
+fs::path checkpoint_path(const fs::path& path) {
+	fs::path index = path;
+	index += ".index";
+	return index;
+}
+
+std::uint64_t log_tail_hash(std::string_view log, std::uint64_t size) {
+	const std::uint64_t from = size > magic.size() + checkpoint_tail_bytes ? size - checkpoint_tail_bytes : magic.size();
+	return hash_bytes(log.substr(static_cast<std::size_t>(from), static_cast<std::size_t>(size - from)));
+}
+
+using Reader = NBT::NBTReader<std::endian::big>;
+
+std::uint64_t record_size(std::size_t ip_size, std::size_t compound_size) {
+	return 1 + 2 + ip_size + 4 + compound_size;
+}
+
+static_server to_static(const nbtserver& server) {
+	return static_server{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures };
+}
+
+template <std::endian E>
+std::string encode_compound(const static_server& server) {
+	std::string compound(server_nbt_size(server), '\0');
+	encode_server_nbt<E>(reinterpret_cast<std::byte*>(compound.data()), server);
+	return compound;
+}
+}
+
+server_registry::server_registry(const fs::path& path) : path(path) {
+	if (!fs::exists(path)) {
+		std::ofstream created(path, std::ios::binary);
+		created.write(magic.data(), static_cast<std::streamsize>(magic.size()));
+		if (!created)
+			return;
+	}
+	opened = load();
+}
+
+bool server_registry::load() {
+	checkpoint.close();
+	checkpoint_size = 0;
+	base_slots = {};
+	base_ips = {};
+	changed.clear();
+	added.clear();
+	added_index.clear();
+	pending.clear();
+	live = 0;
+	live_count = 0;
+	if (!file.open(path.string()))
+		return false;
+
+	const std::string_view data = file.view();
+	if (!data.starts_with(magic)) {
+		std::cerr << path.string() << " isn't an enbt registry\n";
+		return false;
+	}
+	valid_size = data.size();
+
+	// the checkpoint stands in for the records it covers
+	const char* pos = data.data() + (load_checkpoint() ? checkpoint_size : magic.size());
+	const char* const limit = data.data() + data.size();
+	const char* record = pos;
+	try {
+		while (pos < limit) {
+			record = pos;
+			const char kind = *pos++;
+			const std::string_view ip = Reader::readString(pos, limit);
+			pos = ip.data() + ip.size();
+			if (kind == kind_delete) {
+				forget(ip);
+				continue;
+			}
+			if (kind != kind_upsert) {
+				pos = record;
+				break;
+			}
+			Reader::need(pos, 4, limit);
+			const std::uint32_t size = Reader::readNumber<std::uint32_t>(pos);
+			Reader::need(pos + 4, size, limit);
+			pos += 4 + size;
+			const slot current{ .offset = static_cast<std::uint64_t>(pos - size - data.data()), .size = size, .ip_size = static_cast<std::uint16_t>(ip.size()) };
+			place(ip, find(ip), current);
+		}
+	} catch (const NBT::parse_error&) {
+		// the last append didn't make it to disk in full
+		pos = record;
+	}
+	valid_size = static_cast<std::uint64_t>(pos - data.data());
+	if (pos < limit)
+		std::cerr << "warning: ignoring " << limit - pos << " bytes of incomplete records at the end of " << path.string() << '\n';
+	return true;
+}
+
+bool server_registry::load_checkpoint() {
+	if (!checkpoint.open(checkpoint_path(path).string()))
+		return false;
+	checkpoint_header header{};
+	if (checkpoint.size() < sizeof(header)) {
+		checkpoint.close();
+		return false;
+	}
+	std::memcpy(&header, checkpoint.data(), sizeof(header));
+	const std::string_view log = file.view();
+	// made for this log, which may have grown since but not been rewritten
+	const bool valid = std::memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) == 0 && header.byte_order == byte_order_mark
+		&& header.log_size >= magic.size() && header.log_size <= log.size()
+		&& header.slot_count < no_slot && header.ip_count <= header.slot_count
+		&& checkpoint.size() == sizeof(header) + header.slot_count * sizeof(stored_slot) + header.ip_count * sizeof(stored_ip)
+		&& header.log_tail_hash == log_tail_hash(log, header.log_size);
+	if (!valid) {
+		checkpoint.close();
+		return false;
+	}
+
+	// the mapping is page aligned and both arrays start on an 8 byte boundary
+	const auto* slots = reinterpret_cast<const stored_slot*>(checkpoint.data() + sizeof(header));
+	base_slots = std::span<const stored_slot>(slots, static_cast<std::size_t>(header.slot_count));
+	base_ips = std::span<const stored_ip>(reinterpret_cast<const stored_ip*>(slots + header.slot_count), static_cast<std::size_t>(header.ip_count));
+	checkpoint_size = header.log_size;
+	live = header.live;
+	live_count = base_ips.size();
+	return true;
+}
+
+void server_registry::save_checkpoint() {
+	if (!pending.empty())
+		return;
+	checkpoint_header header{};
+	std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+	header.byte_order = byte_order_mark;
+	header.log_size = valid_size;
+	header.log_tail_hash = log_tail_hash(file.view(), valid_size);
+	header.live = live;
+
+	std::vector<stored_slot> slots(slot_count());
+	std::vector<stored_ip> ips;
+	ips.reserve(live_count);
+	for (std::uint32_t i = 0; i < slots.size(); ++i) {
+		const slot s = get(i);
+		slots[i] = stored_slot{ .offset = s.offset, .size = s.size, .ip_size = s.ip_size, .reserved = 0 };
+		if (s.size)
+			ips.push_back(stored_ip{ .hash = hash_bytes(ip_of(s)), .slot = i });
+	}
+	std::sort(ips.begin(), ips.end(), [](const stored_ip& a, const stored_ip& b) { return a.hash != b.hash ? a.hash < b.hash : a.slot < b.slot; });
+	header.slot_count = slots.size();
+	header.ip_count = ips.size();
+
+	// the mapping has to go before the file is replaced, windows won't rename over it
+	checkpoint.close();
+	atomic_output output(checkpoint_path(path));
+	if (output.is_open()) {
+		std::ostream& out = output.stream();
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(stored_slot)));
+		out.write(reinterpret_cast<const char*>(ips.data()), static_cast<std::streamsize>(ips.size() * sizeof(stored_ip)));
+		output_result result{};
+		output.commit(result);
+	}
+	// maps the new checkpoint, or reads the log again when it couldn't be written
+	load();
+}
+
+server_registry::slot server_registry::get(std::uint32_t i) const {
+	if (i >= base_slots.size())
+		return added[i - base_slots.size()];
+	if (const auto it = changed.find(i); it != changed.end())
+		return it->second;
+	const stored_slot& stored = base_slots[i];
+	return slot{ .offset = stored.offset, .size = stored.size, .ip_size = stored.ip_size };
+}
+
+void server_registry::set(std::uint32_t i, const slot& s) {
+	if (i >= base_slots.size())
+		added[i - base_slots.size()] = s;
+	else
+		changed[i] = s;
+}
+
+std::uint32_t server_registry::find(std::string_view ip) const {
+	if (!added_index.empty()) {
+		if (const auto it = added_index.find(std::string(ip)); it != added_index.end())
+			return it->second;
+	}
+	if (base_ips.empty())
+		return no_slot;
+	const std::uint64_t hash = hash_bytes(ip);
+	auto it = std::lower_bound(base_ips.begin(), base_ips.end(), hash, [](const stored_ip& entry, std::uint64_t value) { return entry.hash < value; });
+	for (; it != base_ips.end() && it->hash == hash; ++it) {
+		// erased since the checkpoint when it has no compound anymore
+		const slot s = get(static_cast<std::uint32_t>(it->slot));
+		if (s.size && ip_of(s) == ip)
+			return static_cast<std::uint32_t>(it->slot);
+	}
+	return no_slot;
+}
+
+void server_registry::place(std::string_view ip, std::uint32_t i, const slot& current) {
+	if (i == no_slot) {
+		added_index.emplace(std::string(ip), static_cast<std::uint32_t>(slot_count()));
+		added.push_back(current);
+		++live_count;
+	} else {
+		live -= record_size(ip.size(), get(i).size);
+		set(i, current);
+	}
+	live += record_size(ip.size(), current.size);
+}
+
+std::string_view server_registry::bytes(std::uint64_t offset, std::size_t size) const {
+	if (offset < valid_size)
+		return file.view().substr(static_cast<std::size_t>(offset), size);
+	if (offset - valid_size > pending.size())
+		return {};
+	return std::string_view(pending).substr(static_cast<std::size_t>(offset - valid_size), size);
+}
+
+std::uint64_t server_registry::queue(char kind, std::string_view ip, std::string_view compound) {
+	std::array<std::byte, 4> number{};
+	pending += kind;
+	static_nbt::put_u16<std::endian::big>(number.begin(), static_cast<std::uint16_t>(ip.size()));
+	pending.append(reinterpret_cast<const char*>(number.data()), 2);
+	pending += ip;
+	if (kind == kind_delete)
+		return 0;
+	static_nbt::put_u32<std::endian::big>(number.begin(), static_cast<std::uint32_t>(compound.size()));
+	pending.append(reinterpret_cast<const char*>(number.data()), 4);
+	const std::uint64_t offset = valid_size + pending.size();
+	pending += compound;
+	return offset;
+}
+
+bool server_registry::upsert(const nbtserver& server) {
+	const std::string compound = encode_compound<std::endian::big>(to_static(server));
+	const std::uint32_t i = find(server.ip);
+	if (i != no_slot && compound == this->compound(get(i)))
+		return false;
+
+	const std::uint64_t offset = queue(kind_upsert, server.ip, compound);
+	place(server.ip, i, slot{ .offset = offset, .size = static_cast<std::uint32_t>(compound.size()), .ip_size = static_cast<std::uint16_t>(server.ip.size()) });
+	return true;
+}
+
+bool server_registry::forget(std::string_view ip) {
+	const std::uint32_t i = find(ip);
+	if (i == no_slot)
+		return false;
+	live -= record_size(ip.size(), get(i).size);
+	set(i, slot{});
+	added_index.erase(std::string(ip));
+	--live_count;
+	return true;
+}
+
+bool server_registry::erase(std::string_view ip) {
+	if (!forget(ip))
+		return false;
+	queue(kind_delete, ip, {});
+	return true;
+}
+
+bool server_registry::flush() {
+	if (pending.empty())
+		return true;
+
+	// drop a torn record left by an interrupted run before appending after it
+	file.close();
+	std::error_code ec;
+	if (fs::file_size(path, ec) != valid_size) {
+		fs::resize_file(path, valid_size, ec);
+		if (ec)
+			return false;
+	}
+
+	std::FILE* log = std::fopen(path.string().c_str(), "ab");
+	if (!log)
+		return false;
+	const bool written = std::fwrite(pending.data(), 1, pending.size(), log) == pending.size() && sync_file(log);
+	std::fclose(log);
+	if (!written)
+		return false;
+
+	// offsets stay the same, the records just move from pending into the mapping
+	valid_size += pending.size();
+	pending.clear();
+	if (!file.open(path.string()))
+		return false;
+	// checkpointing costs time in proportion to the live servers, so it waits for
+	// changes worth a quarter of them
+	if (valid_size - std::max<std::uint64_t>(checkpoint_size, magic.size()) > std::max(min_checkpoint_tail, live / 4))
+		save_checkpoint();
+	return true;
+}
+
+bool server_registry::should_compact() const {
+	const std::uint64_t size = log_size();
+	return size > min_compact_size && size - magic.size() > 2 * live;
+}
+
+bool server_registry::compact() {
+	if (!flush())
+		return false;
+	atomic_output output(path);
+	if (!output.is_open())
+		return false;
+	std::ostream& out = output.stream();
+	out.write(magic.data(), static_cast<std::streamsize>(magic.size()));
+
+	std::array<std::byte, 4> number{};
+	for (std::uint32_t i = 0; i < slot_count(); ++i) {
+		const slot s = get(i);
+		if (s.size == 0)
+			continue;
+		const std::string_view ip = ip_of(s);
+		out.put(kind_upsert);
+		static_nbt::put_u16<std::endian::big>(number.begin(), static_cast<std::uint16_t>(ip.size()));
+		out.write(reinterpret_cast<const char*>(number.data()), 2);
+		out.write(ip.data(), static_cast<std::streamsize>(ip.size()));
+		static_nbt::put_u32<std::endian::big>(number.begin(), s.size);
+		out.write(reinterpret_cast<const char*>(number.data()), 4);
+		const std::string_view stored = compound(s);
+		out.write(stored.data(), static_cast<std::streamsize>(stored.size()));
+	}
+
+	// the mapping has to go before the file is replaced, windows won't rename over it
+	file.close();
+	output_result result{};
+	if (!output.commit(result)) {
+		file.open(path.string());
+		return false;
+	}
+	if (!load())
+		return false;
+	save_checkpoint();
+	return true;
+}
+
+bool server_registry::write_servers_dat(std::ostream& out, std::endian endian) const {
+	std::array<std::byte, servers_dat_head_size> head{};
+	if (endian == std::endian::little)
+		encode_servers_dat_head<std::endian::little>(head.begin(), static_cast<std::uint32_t>(live_count));
+	else
+		encode_servers_dat_head<std::endian::big>(head.begin(), static_cast<std::uint32_t>(live_count));
+	out.write(reinterpret_cast<const char*>(head.data()), head.size());
+
+	for (std::uint32_t i = 0; i < slot_count(); ++i) {
+		const slot s = get(i);
+		if (s.size == 0)
+			continue;
+		const std::string_view stored = compound(s);
+		if (endian == std::endian::big) {
+			out.write(stored.data(), static_cast<std::streamsize>(stored.size()));
+			continue;
+		}
+		const Reader::Tag tag(NBT::idCompound, {}, stored.data(), stored.data(), stored.data() + stored.size());
+		const static_server server{
+			.name = tag.find("name").asString(),
+			.icon = tag.find("icon").asString(),
+			.ip = tag.find("ip").asString(),
+			.accept_textures = tag.find("acceptTextures").asByte() != 0,
+		};
+		const std::string encoded = encode_compound<std::endian::little>(server);
+		out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+	}
+
+	out.put(NBT::idEnd);
+	return static_cast<bool>(out);
+}
@@ -0,0 +1,186 @@
+#include "sample.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace {
+constexpr std::size_t read_block = 1 << 20;
+// csv bytes parsed at a time when the servers have to be prepared before sampling
+constexpr std::size_t prepare_batch = 1 << 20;
+
+bool is_separator(char c) {
+	return c == ',' || c == '|' || c == ';';
+}
+
+// Whether parse_servers_csv would take the line: it needs text after the third separator
+bool has_fields(std::string_view line) {
+	std::size_t separators = 0;
+	for (std::size_t i = 0; i < line.size(); ++i) {
+		if (is_separator(line[i]) && ++separators == 3)
+			return i + 1 < line.size();
+	}
+	return false;
+}
+
+// Splits a line that has_fields() accepted, like parse_servers_csv
+nbtserver parse_line(std::string_view line) {
+	std::array<std::string_view, 4> items{};
+	for (std::size_t i = 0, pos = 0; i < items.size(); ++i) {
+		std::size_t next_pos = pos;
+		while (next_pos < line.size() && !is_separator(line[next_pos]))
+			++next_pos;
+		items[i] = line.substr(pos, next_pos - pos);
+		pos = next_pos + 1;
+	}
+	return nbtserver{
+		.icon = std::string(items[1]),
+		.ip = std::string(items[2]),
+		.name = std::string(items[0]),
+		.accept_textures = items[3][0] == '1',
+	};
+}
+
+// Calls fn with every line of input, without its '\n'. Lines are views into the read
+// buffer, only the ones split across two reads are copied
+template <typename Fn>
+void for_each_line(std::istream& input, Fn&& fn) {
+	std::vector<char> buffer(read_block);
+	std::string carry;
+	while (input) {
+		input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		const auto got = static_cast<std::size_t>(input.gcount());
+		for (std::size_t start = 0; start < got;) {
+			const auto* newline = static_cast<const char*>(std::memchr(buffer.data() + start, '\n', got - start));
+			if (!newline) {
+				carry.append(buffer.data() + start, got - start);
+				break;
+			}
+			const auto end = static_cast<std::size_t>(newline - buffer.data());
+			if (carry.empty()) {
+				fn(std::string_view(buffer.data() + start, end - start));
+			} else {
+				carry.append(buffer.data() + start, end - start);
+				fn(std::string_view(carry));
+				carry.clear();
+			}
+			start = end + 1;
+		}
+	}
+	if (!carry.empty())
+		fn(std::string_view(carry));
+}
+}
+
+reservoir_sampler::reservoir_sampler(std::size_t capacity, std::uint64_t seed) : capacity(capacity), random(seed) {
+	if (capacity)
+		weight = std::exp(std::log(uniform()) / static_cast<double>(capacity));
+}
+
+// in (0, 1]
+double reservoir_sampler::uniform() {
+	return static_cast<double>((random() >> 11) + 1) * 0x1.0p-53;
+}
+
+// Draws the gap to the next pick after the item at next_pick
+void reservoir_sampler::skip() {
+	const double gap = std::floor(std::log(uniform()) / std::log1p(-weight));
+	next_pick += 1 + (gap < 1e18 ? static_cast<std::uint64_t>(gap) : std::uint64_t{1} << 62);
+}
+
+std::size_t reservoir_sampler::offer(std::uint64_t position) {
+	if (capacity == 0 || position != next_pick)
+		return npos;
+	// the first items fill the reservoir
+	if (position < capacity) {
+		if (position + 1 < capacity)
+			++next_pick;
+		else
+			skip();
+		return static_cast<std::size_t>(position);
+	}
+	const auto slot = static_cast<std::size_t>(random() % capacity);
+	weight *= std::exp(std::log(uniform()) / static_cast<double>(capacity));
+	skip();
+	return slot;
+}
+
+std::vector<nbtserver> sample_csv(std::istream& input, std::size_t count, std::uint64_t seed, const batch_hook& prepare, sample_stats& stats) {
+	reservoir_sampler sampler(count, seed);
+	std::vector<std::pair<std::uint64_t, nbtserver>> picked; // input position, server
+	const auto store = [&](std::size_t slot, std::uint64_t position, nbtserver&& server) {
+		if (slot == picked.size())
+			picked.emplace_back(position, std::move(server));
+		else
+			picked[slot] = {position, std::move(server)};
+	};
+
+	if (!prepare) {
+		for_each_line(input, [&](std::string_view line) {
+			if (!has_fields(line)) {
+				++stats.invalid;
+				return;
+			}
+			const std::uint64_t position = stats.seen++;
+			if (position != sampler.next())
+				return;
+			const std::size_t slot = sampler.offer(position);
+			store(slot, position, parse_line(line));
+		});
+	} else {
+		std::string chunk;
+		const auto flush = [&]() {
+			std::vector<nbtserver> batch = parse_servers_csv(chunk);
+			chunk.clear();
+			prepare(batch);
+			for (nbtserver& server : batch) {
+				const std::uint64_t position = stats.seen++;
+				const std::size_t slot = sampler.offer(position);
+				if (slot != reservoir_sampler::npos)
+					store(slot, position, std::move(server));
+			}
+		};
+		for_each_line(input, [&](std::string_view line) {
+			if (!has_fields(line)) {
+				++stats.invalid;
+				return;
+			}
+			chunk += line;
+			chunk += '\n';
+			if (chunk.size() >= prepare_batch)
+				flush();
+		});
+		if (!chunk.empty())
+			flush();
+	}
+
+	std::sort(picked.begin(), picked.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	std::vector<nbtserver> servers;
+	servers.reserve(picked.size());
+	for (auto& [position, server] : picked)
+		servers.push_back(std::move(server));
+	return servers;
+}
+
+void sample_servers(std::vector<nbtserver>& servers, std::size_t count, std::uint64_t seed) {
+	if (servers.size() <= count)
+		return;
+	reservoir_sampler sampler(count, seed);
+	std::vector<std::size_t> picked;
+	for (std::uint64_t position = sampler.next(); position < servers.size(); position = sampler.next()) {
+		const std::size_t slot = sampler.offer(position);
+		if (slot == picked.size())
+			picked.push_back(static_cast<std::size_t>(position));
+		else
+			picked[slot] = static_cast<std::size_t>(position);
+	}
+	std::sort(picked.begin(), picked.end());
+	for (std::size_t i = 0; i < picked.size(); ++i) {
+		if (picked[i] != i)
+			servers[i] = std::move(servers[picked[i]]);
+	}
+	servers.resize(picked.size());
+}
@@ -0,0 +1,105 @@
+#include "shard.hpp"
+#include "hash.hpp"
+#include "static_servers.hpp"
+#include <algorithm>
+
+namespace {
+std::uint64_t encoded_size(const nbtserver& server) {
+	return server_nbt_size(static_server{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures });
+}
+
+// head, list header and the root's idEnd around the compounds
+constexpr std::uint64_t shard_overhead = servers_dat_head_size + 1;
+
+// how many times the fewest shards that could hold everything are tried by ip hash
+constexpr std::size_t max_spread = 64;
+
+bool fits(const shard_limits& limits, std::size_t entries, std::uint64_t bytes) {
+	return (!limits.max_entries || entries <= limits.max_entries)
+		&& (!limits.max_bytes || bytes <= limits.max_bytes);
+}
+
+std::vector<std::vector<std::size_t>> partition_in_order(const std::vector<std::uint64_t>& sizes, const shard_limits& limits) {
+	std::vector<std::vector<std::size_t>> shards(1);
+	std::uint64_t bytes = shard_overhead;
+	for (std::size_t i = 0; i < sizes.size(); ++i) {
+		if (!shards.back().empty() && !fits(limits, shards.back().size() + 1, bytes + sizes[i])) {
+			shards.emplace_back();
+			bytes = shard_overhead;
+		}
+		shards.back().push_back(i);
+		bytes += sizes[i];
+	}
+	return shards;
+}
+
+bool partition_by_hash(const std::vector<nbtserver>& servers, const std::vector<std::uint64_t>& sizes, const shard_limits& limits, std::vector<std::vector<std::size_t>>& shards) {
+	std::uint64_t total_bytes = 0;
+	for (const std::uint64_t size : sizes)
+		total_bytes += size;
+
+	std::vector<std::uint64_t> hashes(servers.size());
+	for (std::size_t i = 0; i < servers.size(); ++i)
+		hashes[i] = hash_bytes(servers[i].ip);
+
+	// the fewest shards that could hold everything, then more until the hash spread fits
+	std::size_t count = 1;
+	if (limits.max_entries)
+		count = std::max(count, (servers.size() + limits.max_entries - 1) / limits.max_entries);
+	if (limits.max_bytes > shard_overhead)
+		count = std::max<std::size_t>(count, (total_bytes + limits.max_bytes - shard_overhead - 1) / (limits.max_bytes - shard_overhead));
+
+	// servers sharing an ip, or just its hash, never part, so past a point more shards
+	// only add empty ones
+	const std::size_t max_count = count * max_spread;
+	for (; count <= max_count; count += std::max<std::size_t>(1, count / 8)) {
+		shards.assign(count, {});
+		std::vector<std::uint64_t> bytes(count, shard_overhead);
+		bool spread_fits = true;
+		for (std::size_t i = 0; i < servers.size() && spread_fits; ++i) {
+			const std::size_t shard = static_cast<std::size_t>(hashes[i] % count);
+			shards[shard].push_back(i);
+			bytes[shard] += sizes[i];
+			if (shards[shard].size() > 1 && !fits(limits, shards[shard].size(), bytes[shard]))
+				spread_fits = false;
+		}
+		// empty shards stay, so a server's shard is always its hash modulo the count
+		if (spread_fits)
+			return true;
+	}
+	shards.clear();
+	return false;
+}
+}
+
+bool partition_servers(const std::vector<nbtserver>& servers, const shard_limits& limits, std::vector<std::vector<std::size_t>>& shards) {
+	shards.clear();
+	if (servers.empty())
+		return true;
+
+	std::vector<std::uint64_t> sizes(servers.size());
+	for (std::size_t i = 0; i < servers.size(); ++i)
+		sizes[i] = encoded_size(servers[i]);
+
+	if (limits.by_ip_hash)
+		return partition_by_hash(servers, sizes, limits, shards);
+	shards = partition_in_order(sizes, limits);
+	return true;
+}
+
+std::filesystem::path shard_path(const std::filesystem::path& output_path, std::size_t index) {
+	std::filesystem::path path = output_path;
+	path.replace_filename(output_path.stem().string() + "." + std::to_string(index) + output_path.extension().string());
+	return path;
+}
+
+std::vector<std::filesystem::path> remove_stale_shards(const std::filesystem::path& output_path, std::size_t count) {
+	std::vector<std::filesystem::path> removed;
+	for (std::size_t index = count;; ++index) {
+		const std::filesystem::path path = shard_path(output_path, index);
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(path, ec) || !std::filesystem::remove(path, ec))
+			return removed;
+		removed.push_back(path);
+	}
+}
@@ -0,0 +1,255 @@
+#include "sort.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <thread>
+
+namespace {
+// below this a single thread is faster
+constexpr std::size_t parallel_threshold = 1 << 15;
+// buckets this small are finished with a comparison sort
+constexpr std::size_t radix_cutoff = 64;
+
+char lower(char c) {
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::size_t thread_count(std::size_t items) {
+	if (items < parallel_threshold)
+		return 1;
+	return std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, items / (parallel_threshold / 2));
+}
+
+// Runs fn(i) for every i below count on a pool of workers
+template <typename Fn>
+void parallel_for(std::size_t count, std::size_t threads, Fn&& fn) {
+	std::atomic<std::size_t> next{0};
+	const auto worker = [&]() {
+		for (std::size_t i; (i = next++) < count;)
+			fn(i);
+	};
+	std::vector<std::jthread> pool;
+	for (std::size_t i = 1; i < std::min(threads, count); ++i)
+		pool.emplace_back(worker);
+	worker();
+}
+
+// Sorts chunks on their own threads, then merges neighbours pairwise, also in parallel
+template <typename T, typename Less>
+void parallel_sort(std::vector<T>& items, Less less) {
+	const std::size_t threads = thread_count(items.size());
+	if (threads == 1) {
+		std::sort(items.begin(), items.end(), less);
+		return;
+	}
+
+	const std::size_t chunk = (items.size() + threads - 1) / threads;
+	const auto bound = [&](std::size_t i) { return std::min(items.size(), i * chunk); };
+	parallel_for(threads, threads, [&](std::size_t i) {
+		std::sort(items.begin() + bound(i), items.begin() + bound(i + 1), less);
+	});
+
+	std::vector<T> scratch(items.size());
+	for (std::size_t width = 1; width < threads; width *= 2) {
+		const std::size_t pairs = (threads + 2 * width - 1) / (2 * width);
+		parallel_for(pairs, threads, [&](std::size_t pair) {
+			const std::size_t first = bound(2 * pair * width);
+			const std::size_t middle = bound((2 * pair + 1) * width);
+			const std::size_t last = bound((2 * pair + 2) * width);
+			std::merge(items.begin() + first, items.begin() + middle, items.begin() + middle, items.begin() + last, scratch.begin() + first, less);
+		});
+		items.swap(scratch);
+	}
+}
+
+// First 8 bytes of a key in an integer, so most comparisons never touch the string
+struct string_entry {
+	std::uint64_t prefix;
+	std::uint32_t index;
+};
+
+template <bool Fold>
+std::uint64_t prefix_of(std::string_view text) {
+	std::uint64_t prefix = 0;
+	for (std::size_t i = 0; i < 8; ++i) {
+		const unsigned char c = i < text.size() ? static_cast<unsigned char>(Fold ? lower(text[i]) : text[i]) : 0;
+		prefix = prefix << 8 | c;
+	}
+	return prefix;
+}
+
+template <bool Fold>
+int compare_text(std::string_view a, std::string_view b) {
+	const std::size_t size = std::min(a.size(), b.size());
+	for (std::size_t i = 0; i < size; ++i) {
+		const auto x = static_cast<unsigned char>(Fold ? lower(a[i]) : a[i]);
+		const auto y = static_cast<unsigned char>(Fold ? lower(b[i]) : b[i]);
+		if (x != y)
+			return x < y ? -1 : 1;
+	}
+	return a.size() == b.size() ? 0 : a.size() < b.size() ? -1 : 1;
+}
+
+template <bool Fold, typename Text>
+void sort_strings(std::vector<std::uint32_t>& order, Text text, bool reverse) {
+	std::vector<string_entry> entries(order.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		entries[i] = string_entry{ .prefix = prefix_of<Fold>(text(order[i])), .index = order[i] };
+
+	parallel_sort(entries, [&](const string_entry& a, const string_entry& b) {
+		int cmp = a.prefix == b.prefix ? compare_text<Fold>(text(a.index), text(b.index)) : a.prefix < b.prefix ? -1 : 1;
+		if (reverse)
+			cmp = -cmp;
+		return cmp != 0 ? cmp < 0 : a.index < b.index;
+	});
+	for (std::size_t i = 0; i < entries.size(); ++i)
+		order[i] = entries[i].index;
+}
+
+// class, 16 address bytes (IPv4 in the first 4), port
+constexpr std::size_t address_key_size = 1 + 16 + 2;
+
+struct address_entry {
+	std::array<std::uint8_t, address_key_size> key;
+	std::uint32_t index;
+};
+
+bool key_less(const address_entry& a, const address_entry& b, std::size_t from) {
+	const int cmp = std::memcmp(a.key.data() + from, b.key.data() + from, address_key_size - from);
+	return cmp != 0 ? cmp < 0 : a.index < b.index;
+}
+
+// MSD radix sort, one byte of the key per level. Every level distributes with a
+// counting sort, which is stable, so equal keys stay in index order
+void radix_sort(std::span<address_entry> items, std::span<address_entry> scratch, std::size_t byte) {
+	while (byte < address_key_size && items.size() > radix_cutoff) {
+		std::array<std::size_t, 257> offsets{};
+		for (const address_entry& entry : items)
+			++offsets[entry.key[byte] + 1u];
+		// skip levels where every key has the same byte
+		if (std::find(offsets.begin(), offsets.end(), items.size()) != offsets.end()) {
+			++byte;
+			continue;
+		}
+		for (std::size_t i = 1; i < offsets.size(); ++i)
+			offsets[i] += offsets[i - 1];
+		std::array<std::size_t, 256> next{};
+		std::copy_n(offsets.begin(), 256, next.begin());
+		for (const address_entry& entry : items)
+			scratch[next[entry.key[byte]]++] = entry;
+		std::copy(scratch.begin(), scratch.end(), items.begin());
+
+		for (std::size_t b = 0; b < 256; ++b) {
+			const std::size_t first = offsets[b];
+			const std::size_t last = offsets[b + 1];
+			if (last - first > 1)
+				radix_sort(items.subspan(first, last - first), scratch.subspan(first, last - first), byte + 1);
+		}
+		return;
+	}
+	std::sort(items.begin(), items.end(), [byte](const address_entry& a, const address_entry& b) { return key_less(a, b, std::min(byte, address_key_size)); });
+}
+
+void sort_addresses(const std::vector<nbtserver>& servers, std::vector<std::uint32_t>& order, bool reverse) {
+	std::vector<address_entry> numeric;
+	std::vector<std::uint32_t> hosts;
+	numeric.reserve(order.size());
+	for (const std::uint32_t index : order) {
+		server_address address = servers[index].address;
+		if (address.kind == address_kind::none && parse_address(servers[index].ip, address) != address_error::none)
+			address.kind = address_kind::none;
+		if (address.kind != address_kind::ipv4 && address.kind != address_kind::ipv6) {
+			hosts.push_back(index);
+			continue;
+		}
+
+		address_entry entry{ .key = {}, .index = index };
+		if (address.kind == address_kind::ipv4) {
+			entry.key[0] = 0;
+			for (std::size_t i = 0; i < 4; ++i)
+				entry.key[1 + i] = static_cast<std::uint8_t>(address.ipv4 >> (24 - 8 * i));
+		} else {
+			entry.key[0] = 1;
+			std::copy(address.ipv6.begin(), address.ipv6.end(), entry.key.begin() + 1);
+		}
+		entry.key[17] = static_cast<std::uint8_t>(address.port >> 8);
+		entry.key[18] = static_cast<std::uint8_t>(address.port);
+		numeric.push_back(entry);
+	}
+
+	// the top level splits on the class and the top 7 bits of the address, every bucket
+	// then sorts on its own worker
+	std::vector<address_entry> scratch(numeric.size());
+	std::array<std::size_t, 257> offsets{};
+	for (const address_entry& entry : numeric)
+		++offsets[(entry.key[0] << 7 | entry.key[1] >> 1) + 1u];
+	for (std::size_t i = 1; i < offsets.size(); ++i)
+		offsets[i] += offsets[i - 1];
+	{
+		std::array<std::size_t, 256> next{};
+		std::copy_n(offsets.begin(), 256, next.begin());
+		for (const address_entry& entry : numeric)
+			scratch[next[entry.key[0] << 7 | entry.key[1] >> 1]++] = entry;
+		numeric.swap(scratch);
+	}
+	parallel_for(256, thread_count(numeric.size()), [&](std::size_t b) {
+		const std::span<address_entry> items(numeric.data() + offsets[b], offsets[b + 1] - offsets[b]);
+		const std::span<address_entry> items_scratch(scratch.data() + offsets[b], items.size());
+		radix_sort(items, items_scratch, 1);
+	});
+
+	if (reverse) {
+		// reversed keys, but equal keys back in input order
+		std::reverse(numeric.begin(), numeric.end());
+		for (auto run = numeric.begin(); run != numeric.end();) {
+			const auto end = std::find_if(run, numeric.end(), [&](const address_entry& entry) { return entry.key != run->key; });
+			std::reverse(run, end);
+			run = end;
+		}
+	}
+
+	sort_strings<true>(hosts, [&](std::uint32_t index) { return std::string_view(servers[index].ip); }, reverse);
+
+	// IPv4 and IPv6 before host names, after them when reversed
+	order.clear();
+	const auto append_numeric = [&]() {
+		for (const address_entry& entry : numeric)
+			order.push_back(entry.index);
+	};
+	if (reverse)
+		order.insert(order.end(), hosts.begin(), hosts.end());
+	append_numeric();
+	if (!reverse)
+		order.insert(order.end(), hosts.begin(), hosts.end());
+}
+}
+
+std::vector<std::uint32_t> sort_order(const std::vector<nbtserver>& servers, sort_key key, bool reverse) {
+	std::vector<std::uint32_t> order(servers.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = static_cast<std::uint32_t>(i);
+
+	switch (key) {
+	case sort_key::name:
+		sort_strings<true>(order, [&](std::uint32_t index) { return std::string_view(servers[index].name); }, reverse);
+		break;
+	case sort_key::ip:
+		sort_strings<false>(order, [&](std::uint32_t index) { return std::string_view(servers[index].ip); }, reverse);
+		break;
+	case sort_key::addr:
+		sort_addresses(servers, order, reverse);
+		break;
+	}
+	return order;
+}
+
+void apply_order(std::vector<nbtserver>& servers, const std::vector<std::uint32_t>& order) {
+	std::vector<nbtserver> sorted;
+	sorted.reserve(order.size());
+	for (const std::uint32_t index : order)
+		sorted.push_back(std::move(servers[index]));
+	servers.swap(sorted);
+}
@@ -0,0 +1,367 @@
+#include "watch.hpp"
+#include "hash.hpp"
+#include "static_servers.hpp"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+// csv lines and whole files are hashed with different seeds, a file holding one line
+// isn't that line
+constexpr std::uint64_t csv_line_seed = 1;
+constexpr std::uint64_t file_seed = 2;
+
+std::string format_of(const fs::path& path) {
+	const std::string extension = path.extension().string();
+	if (extension == ".csv" || extension == ".toml" || extension == ".json")
+		return extension.substr(1);
+	return {};
+}
+
+static_server to_static(const nbtserver& server) {
+	return static_server{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures };
+}
+
+template <std::endian E>
+void append_compound(std::string& out, const static_server& server) {
+	const std::size_t at = out.size();
+	out.resize(at + server_nbt_size(server));
+	encode_server_nbt<E>(reinterpret_cast<std::byte*>(out.data() + at), server);
+}
+
+template <std::endian E>
+std::string encode_head(std::size_t count) {
+	std::string head(servers_dat_head_size, '\0');
+	encode_servers_dat_head<E>(reinterpret_cast<std::byte*>(head.data()), static_cast<std::uint32_t>(count));
+	return head;
+}
+
+// Read instead of mapped: a file truncated by its writer while it's mapped would fault
+bool read_file(const fs::path& path, std::string& text) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in.is_open())
+		return false;
+	std::ostringstream buffer;
+	buffer << in.rdbuf();
+	text = std::move(buffer).str();
+	return !in.bad();
+}
+}
+
+bool watch_supported() {
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+std::vector<watched_input> list_inputs(const fs::path& path, const std::string& format) {
+	std::error_code ec;
+	if (!fs::is_directory(path, ec))
+		return { { path, format } };
+	std::vector<watched_input> inputs;
+	for (const fs::directory_entry& entry : fs::directory_iterator(path, ec)) {
+		std::error_code type_ec;
+		const std::string file_format = format_of(entry.path());
+		if (!file_format.empty() && entry.is_regular_file(type_ec))
+			inputs.push_back({ entry.path(), file_format });
+	}
+	std::sort(inputs.begin(), inputs.end(), [](const watched_input& a, const watched_input& b) { return a.path.filename() < b.path.filename(); });
+	return inputs;
+}
+
+#ifdef __linux__
+namespace {
+constexpr std::uint32_t watch_mask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+}
+
+input_watcher::input_watcher(const std::vector<fs::path>& paths) {
+	fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0) {
+		problem = std::string("can't start inotify: ") + std::strerror(errno);
+		return;
+	}
+	for (const fs::path& path : paths) {
+		if (!watch(path, false)) {
+			close(fd);
+			fd = -1;
+			return;
+		}
+	}
+}
+
+bool input_watcher::add(const fs::path& file) {
+	return fd >= 0 && watch(file, true);
+}
+
+bool input_watcher::watch(const fs::path& path, bool optional) {
+	std::error_code ec;
+	const bool is_dir = !optional && fs::is_directory(path, ec);
+	fs::path dir = is_dir ? path : path.parent_path();
+	if (dir.empty())
+		dir = ".";
+	const std::string file = is_dir ? std::string() : path.filename().string();
+	if (optional && std::ranges::any_of(dirs, [&](const watched_dir& d) { return d.file == file && d.dir == dir; }))
+		return true;
+	// a directory watched twice gets the same descriptor, and both entries answer to it
+	const int wd = inotify_add_watch(fd, dir.c_str(), watch_mask);
+	if (wd < 0) {
+		if (!optional)
+			problem = "can't watch " + dir.string() + ": " + std::strerror(errno);
+		return false;
+	}
+	dirs.push_back({ wd, dir, file, optional });
+	return true;
+}
+
+input_watcher::~input_watcher() {
+	if (fd >= 0)
+		close(fd);
+}
+
+bool input_watcher::wait(std::chrono::milliseconds debounce) {
+	alignas(inotify_event) char buffer[16384];
+	bool changed = false;
+	for (;;) {
+		// no timeout until something changed, so an idle watch never wakes up
+		pollfd ready{ .fd = fd, .events = POLLIN, .revents = 0 };
+		const int events = poll(&ready, 1, changed ? static_cast<int>(debounce.count()) : -1);
+		if (events < 0 && errno == EINTR)
+			continue;
+		if (events < 0) {
+			problem = std::string("poll failed: ") + std::strerror(errno);
+			return false;
+		}
+		if (events == 0)
+			return true;
+
+		const ssize_t got = read(fd, buffer, sizeof(buffer));
+		if (got < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (got <= 0) {
+			problem = std::string("reading inotify failed: ") + std::strerror(errno);
+			return false;
+		}
+		for (ssize_t offset = 0; offset < got;) {
+			const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+			if (event->mask & IN_Q_OVERFLOW) {
+				changed = true; // events were lost, any of them could have been an input
+				continue;
+			}
+			for (const watched_dir& dir : dirs) {
+				if (dir.wd != event->wd)
+					continue;
+				if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) && !dir.optional) {
+					problem = dir.dir.string() + " was removed or moved";
+					return false;
+				}
+				if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) || (event->len && relevant(dir, event->name)))
+					changed = true;
+			}
+			// the directory of added files is gone, and so is its watch
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+				std::erase_if(dirs, [&](const watched_dir& dir) { return dir.wd == event->wd; });
+		}
+	}
+}
+#else
+input_watcher::input_watcher(const std::vector<fs::path>&) {
+	problem = "watching is only supported on Linux";
+}
+
+input_watcher::~input_watcher() = default;
+
+bool input_watcher::add(const fs::path&) {
+	return false;
+}
+
+bool input_watcher::watch(const fs::path&, bool) {
+	return false;
+}
+
+bool input_watcher::wait(std::chrono::milliseconds) {
+	return false;
+}
+#endif
+
+bool input_watcher::relevant(const watched_dir& dir, std::string_view name) const {
+	if (!dir.file.empty())
+		return name == dir.file;
+	return !format_of(fs::path(name)).empty();
+}
+
+incremental_servers::chunk* incremental_servers::take(std::uint64_t key, update_stats& stats) {
+	const auto it = chunks.find(key);
+	// one that isn't reusable is still taken again when it was prepared in this round
+	if (it == chunks.end() || (!it->second.reusable && it->second.round != round))
+		return nullptr;
+	++stats.reused; // from the last round, or listed twice in this one
+	it->second.round = round;
+	return &it->second;
+}
+
+incremental_servers::update_stats incremental_servers::update(const std::vector<watched_input>& inputs, const stage& prepare) {
+	update_stats stats{};
+	++round;
+	std::vector<std::uint64_t> next_order;
+	std::unordered_map<std::string, std::vector<std::uint64_t>> next_file_keys;
+
+	// prepares and encodes the servers of a line or file that wasn't in the last round
+	const auto fill = [&](std::uint64_t key, std::vector<nbtserver> servers, std::size_t invalid) {
+		++stats.parsed;
+		chunk& fresh = chunks[key];
+		fresh = chunk{};
+		fresh.round = round;
+		fresh.invalid = invalid;
+		fresh.reusable = prepare(servers);
+		for (nbtserver& server : servers) {
+			try {
+				if (endian == std::endian::little)
+					append_compound<std::endian::little>(fresh.compounds, to_static(server));
+				else
+					append_compound<std::endian::big>(fresh.compounds, to_static(server));
+			} catch (const std::length_error&) {
+				++fresh.invalid; // a string longer than nbt allows
+				continue;
+			}
+			fresh.servers.push_back(std::move(server));
+		}
+	};
+	// the file couldn't be used this round, its chunks from the last one stand in
+	const auto keep_last = [&](const watched_input& input) {
+		++stats.failed;
+		const auto last = file_keys.find(input.path.string());
+		if (last == file_keys.end())
+			return;
+		for (const std::uint64_t key : last->second) {
+			if (take(key, stats))
+				next_order.push_back(key);
+		}
+		next_file_keys[input.path.string()] = last->second;
+	};
+
+	for (const watched_input& input : inputs) {
+		++stats.files;
+		std::string text;
+		if (!read_file(input.path, text)) {
+			std::cerr << "warning: can't read " << input.path.string() << ", keeping its last servers\n";
+			keep_last(input);
+			continue;
+		}
+
+		if (input.format != "csv") {
+			const std::uint64_t key = hash_bytes(text, file_seed);
+			if (!take(key, stats)) {
+				std::vector<nbtserver> servers;
+				try {
+					servers = input.format == "toml" ? parse_servers_toml(text) : parse_servers_json(text);
+				} catch (const std::exception&) {
+					servers.clear();
+				}
+				// most likely caught halfway through an edit, or saved with a mistake
+				if (servers.empty() && !text.empty()) {
+					std::cerr << "warning: no servers in " << input.path.string() << ", keeping its last servers\n";
+					keep_last(input);
+					continue;
+				}
+				fill(key, std::move(servers), 0);
+			}
+			next_order.push_back(key);
+			next_file_keys[input.path.string()].push_back(key);
+			continue;
+		}
+
+		// split like parse_servers_csv, so a line gives the servers it would give there
+		std::vector<std::uint64_t>& keys = next_file_keys[input.path.string()];
+		for (std::string_view rest = text; !rest.empty();) {
+			const std::size_t eol = rest.find('\n');
+			const std::string_view line = rest.substr(0, eol);
+			rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+			const std::uint64_t key = hash_bytes(line, csv_line_seed);
+			if (!take(key, stats)) {
+				std::vector<nbtserver> servers;
+				static_nbt::for_each_csv_server(line, [&](const static_server& server) {
+					servers.push_back(nbtserver{ .icon = std::string(server.icon), .ip = std::string(server.ip),
+						.name = std::string(server.name), .accept_textures = server.accept_textures });
+				});
+				const std::size_t invalid = servers.empty();
+				fill(key, std::move(servers), invalid);
+			}
+			next_order.push_back(key);
+			keys.push_back(key);
+		}
+	}
+
+	// whatever no input has anymore
+	std::erase_if(chunks, [&](const auto& entry) { return entry.second.round != round; });
+	order = std::move(next_order);
+	file_keys = std::move(next_file_keys);
+	count = 0;
+	for (const std::uint64_t key : order) {
+		const chunk& c = chunks.at(key);
+		count += c.servers.size();
+		stats.invalid += c.invalid;
+	}
+	return stats;
+}
+
+void incremental_servers::clear() {
+	chunks.clear();
+	order.clear();
+	file_keys.clear();
+	count = 0;
+}
+
+std::vector<nbtserver> incremental_servers::servers() const {
+	std::vector<nbtserver> out;
+	out.reserve(count);
+	for (const std::uint64_t key : order) {
+		const chunk& c = chunks.at(key);
+		out.insert(out.end(), c.servers.begin(), c.servers.end());
+	}
+	return out;
+}
+
+std::string incremental_servers::servers_dat() const {
+	std::string out = endian == std::endian::little ? encode_head<std::endian::little>(count) : encode_head<std::endian::big>(count);
+	for (const std::uint64_t key : order)
+		out += chunks.at(key).compounds;
+	out += static_cast<char>(NBT::idEnd);
+	return out;
+}
+
+std::string incremental_servers::servers_dat(const std::vector<std::uint32_t>& positions) const {
+	// where every server's compound is, in input order
+	std::vector<std::string_view> compounds;
+	compounds.reserve(count);
+	for (const std::uint64_t key : order) {
+		const chunk& c = chunks.at(key);
+		std::string_view rest = c.compounds;
+		for (const nbtserver& server : c.servers) {
+			const std::size_t size = server_nbt_size(to_static(server));
+			compounds.push_back(rest.substr(0, size));
+			rest.remove_prefix(size);
+		}
+	}
+	std::string out = endian == std::endian::little ? encode_head<std::endian::little>(positions.size()) : encode_head<std::endian::big>(positions.size());
+	for (const std::uint32_t position : positions)
+		out += compounds[position];
+	out += static_cast<char>(NBT::idEnd);
+	return out;
+}
@@ -0,0 +1,101 @@
+#include "acutest.h"
+#include "address.hpp"
+#include "parse.hpp"
+#include <string>
+#include <vector>
+
+static std::string canonical(std::string_view text) {
+	server_address address{};
+	std::string_view host{};
+	if (parse_address(text, address, &host) != address_error::none)
+		return "invalid";
+	return format_address(address, host);
+}
+
+static address_error error_of(std::string_view text) {
+	server_address address{};
+	return parse_address(text, address);
+}
+
+void test_parse_ipv4(void) {
+	std::uint32_t value = 0;
+	TEST_CHECK(parse_ipv4("1.2.3.4", value) && value == 0x01020304);
+	TEST_CHECK(parse_ipv4("255.255.255.255", value) && value == 0xffffffff);
+	TEST_CHECK(parse_ipv4("001.002.003.004", value) && value == 0x01020304);
+	TEST_CHECK(!parse_ipv4("256.1.1.1", value));
+	TEST_CHECK(!parse_ipv4("1.2.3", value));
+	TEST_CHECK(!parse_ipv4("1.2.3.4.", value));
+	TEST_CHECK(!parse_ipv4(".1.2.3.4", value));
+	TEST_CHECK(!parse_ipv4("1..2.3", value));
+	TEST_CHECK(!parse_ipv4("1.2.3.4a", value));
+	TEST_CHECK(!parse_ipv4("1.2.3.0004", value));
+	TEST_CHECK(!parse_ipv4("1.2.3.\xb4", value));
+	TEST_CHECK(!parse_ipv4("1.2.3.-4", value));
+}
+
+void test_parse_ipv6(void) {
+	std::array<std::uint8_t, 16> value{};
+	TEST_CHECK(parse_ipv6("::", value) && (value == std::array<std::uint8_t, 16>{}));
+	TEST_CHECK(parse_ipv6("::1", value) && value[15] == 1);
+	TEST_CHECK(parse_ipv6("2001:DB8::1", value) && value[0] == 0x20 && value[1] == 0x01 && value[3] == 0xb8 && value[15] == 1);
+	TEST_CHECK(parse_ipv6("1:2:3:4:5:6:7:8", value) && value[14] == 0 && value[15] == 8);
+	TEST_CHECK(parse_ipv6("::ffff:1.2.3.4", value) && value[10] == 0xff && value[12] == 1 && value[15] == 4);
+	TEST_CHECK(!parse_ipv6("1:2:3:4:5:6:7:8:9", value));
+	TEST_CHECK(!parse_ipv6("1::2::3", value));
+	TEST_CHECK(!parse_ipv6("1:2:3:4:5:6:7", value));
+	TEST_CHECK(!parse_ipv6("1:", value));
+	TEST_CHECK(!parse_ipv6(":1", value));
+	TEST_CHECK(!parse_ipv6("12345::", value));
+	TEST_CHECK(!parse_ipv6("1.2.3.4::", value));
+}
+
+void test_canonical_address(void) {
+	TEST_CHECK(canonical(" 1.2.3.4 ") == "1.2.3.4");
+	TEST_CHECK(canonical("1.2.3.4:25565") == "1.2.3.4");
+	TEST_CHECK(canonical("001.002.003.004:25566") == "1.2.3.4:25566");
+	TEST_CHECK(canonical("Play.Example.NET.") == "play.example.net");
+	TEST_CHECK(canonical("play.example.net:25565") == "play.example.net");
+	TEST_CHECK(canonical("[2001:DB8:0:0:0:0:0:1]:25565") == "2001:db8::1");
+	TEST_CHECK(canonical("[2001:db8::1]:19132") == "[2001:db8::1]:19132");
+	TEST_CHECK(canonical("2001:db8:0:1:0:0:0:1") == "2001:db8:0:1::1");
+	TEST_CHECK(canonical("1:0:0:2:0:0:0:3") == "1:0:0:2::3");
+	TEST_CHECK(canonical("1:0:0:2:0:0:3:4") == "1::2:0:0:3:4");
+	TEST_CHECK(canonical("[::ffff:1.2.3.4]") == "::ffff:1.2.3.4");
+
+	TEST_CHECK(error_of("") == address_error::empty);
+	TEST_CHECK(error_of("1.2.3.256") == address_error::ipv4);
+	TEST_CHECK(error_of("1.2.3.4:0") == address_error::port);
+	TEST_CHECK(error_of("1.2.3.4:65536") == address_error::port);
+	TEST_CHECK(error_of("host:") == address_error::port);
+	TEST_CHECK(error_of("[::1]x") == address_error::port);
+	TEST_CHECK(error_of("[::1") == address_error::ipv6);
+	TEST_CHECK(error_of("-bad.example") == address_error::host);
+	TEST_CHECK(error_of("bad..example") == address_error::host);
+	TEST_CHECK(error_of("bad host") == address_error::host);
+}
+
+void test_canonicalize_servers(void) {
+	std::vector<nbtserver> servers{
+		{ .icon = "", .ip = "1.2.3.4:25565", .name = "a", .accept_textures = true },
+		{ .icon = "", .ip = "not valid!", .name = "b", .accept_textures = true },
+		{ .icon = "", .ip = "example.net", .name = "c", .accept_textures = true },
+		{ .icon = "", .ip = "1.2.3.4:0", .name = "d", .accept_textures = true },
+	};
+	const canonicalize_stats stats = canonicalize_servers(servers);
+	TEST_CHECK(servers.size() == 2);
+	TEST_CHECK(servers[0].ip == "1.2.3.4" && servers[0].address.kind == address_kind::ipv4 && servers[0].address.ipv4 == 0x01020304);
+	TEST_CHECK(servers[1].name == "c" && servers[1].address.kind == address_kind::host);
+	TEST_CHECK(stats.changed == 1);
+	TEST_CHECK(stats.rejected == 2);
+	TEST_CHECK(stats.errors[static_cast<std::size_t>(address_error::host)] == 1);
+	TEST_CHECK(stats.errors[static_cast<std::size_t>(address_error::port)] == 1);
+	TEST_CHECK(stats.examples.size() == 2 && stats.examples[0] == "not valid!");
+}
+
+TEST_LIST = {
+   { "Address - ipv4", test_parse_ipv4 },
+   { "Address - ipv6", test_parse_ipv6 },
+   { "Address - canonical form", test_canonical_address },
+   { "Address - canonicalize servers", test_canonicalize_servers },
+   { NULL, NULL }
+};
@@ -0,0 +1,127 @@
+#include "acutest.h"
+#include "append.hpp"
+#include "static_servers.hpp"
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static constexpr std::array<static_server, 2> old_servers{{
+	{ .name = "Server One", .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "192.168.1.1", .accept_textures = true },
+	{ .name = "Server Two", .icon = "/9j/4AAQ", .ip = "192.168.1.2", .accept_textures = false },
+}};
+
+static constexpr std::array<static_server, 3> all_servers{{
+	old_servers[0],
+	old_servers[1],
+	{ .name = "Server Three", .icon = "/9j/4AAQ", .ip = "play.example.net", .accept_textures = true },
+}};
+
+static const std::vector<nbtserver> new_servers{
+	{ .icon = "/9j/4AAQ", .ip = "play.example.net", .name = "Server Three", .accept_textures = true },
+};
+
+template <std::size_t N>
+static void write_file(const fs::path& path, const std::array<std::byte, N>& bytes, std::size_t extra_end_tags = 0) {
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	for (std::size_t i = 0; i < extra_end_tags; ++i)
+		out.put(NBT::idEnd);
+}
+
+static std::string read_file(const fs::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+template <std::size_t N>
+static std::string as_string(const std::array<std::byte, N>& bytes) {
+	return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+template <std::endian E>
+static void check_append(std::size_t extra_end_tags) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_append.dat";
+	write_file(path, make_servers_dat<old_servers, E>(), extra_end_tags);
+	TEST_CHECK(append_servers_in_place(path, new_servers, E));
+	TEST_CHECK(read_file(path) == as_string(make_servers_dat<all_servers, E>()));
+	fs::remove(path);
+}
+
+void test_append_in_place(void) {
+	check_append<std::endian::big>(0);
+	check_append<std::endian::little>(0);
+	// enbt used to close the root compound twice
+	check_append<std::endian::big>(1);
+}
+
+void test_append_empty_list(void) {
+	static constexpr std::array<static_server, 0> none{};
+	static constexpr std::array<static_server, 1> only_new{{ all_servers[2] }};
+	const fs::path path = fs::temp_directory_path() / "enbt_test_append_empty.dat";
+	write_file(path, make_servers_dat<none>());
+	TEST_CHECK(append_servers_in_place(path, new_servers, std::endian::big));
+	TEST_CHECK(read_file(path) == as_string(make_servers_dat<only_new>()));
+	fs::remove(path);
+}
+
+void test_append_unexpected_layout(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_append_layout.dat";
+	// big endian file read as little endian
+	write_file(path, make_servers_dat<old_servers>());
+	TEST_CHECK(!append_servers_in_place(path, new_servers, std::endian::little));
+	TEST_CHECK(read_file(path) == as_string(make_servers_dat<old_servers>()));
+
+	// something after the list
+	write_file(path, make_servers_dat<old_servers>());
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+		out.seekp(-1, std::ios::end);
+		out.put(NBT::idByte);
+	}
+	TEST_CHECK(!append_servers_in_place(path, new_servers, std::endian::big));
+
+	// an empty list followed by more end tags than enbt ever wrote
+	static constexpr std::array<static_server, 0> none{};
+	write_file(path, make_servers_dat<none>(), 100);
+	TEST_CHECK(!append_servers_in_place(path, new_servers, std::endian::big));
+
+	// another root tag after the list, a list of compounds laid out just like it
+	static constexpr std::array<static_server, 1> first{{ old_servers[0] }};
+	std::string bytes = as_string(make_servers_dat<first>());
+	bytes.pop_back();
+	std::array<std::byte, 1 + 2 + 6 + 1 + 4> hidden_head{};
+	auto out = hidden_head.begin();
+	*out++ = static_cast<std::byte>(NBT::idList);
+	out = static_nbt::put_str<std::endian::big>(out, "hidden");
+	*out++ = static_cast<std::byte>(NBT::idCompound);
+	static_nbt::put_u32<std::endian::big>(out, 1);
+	std::array<std::byte, server_nbt_size(old_servers[1])> hidden_server{};
+	encode_server_nbt(hidden_server.begin(), old_servers[1]);
+	bytes += as_string(hidden_head) + as_string(hidden_server) + static_cast<char>(NBT::idEnd);
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << bytes;
+	}
+	TEST_CHECK(!append_servers_in_place(path, new_servers, std::endian::big));
+	TEST_CHECK(read_file(path) == bytes);
+
+	std::vector<nbtserver> existing{};
+	write_file(path, make_servers_dat<old_servers>());
+	TEST_CHECK(read_servers_dat(path, existing, std::endian::big));
+	TEST_CHECK(existing.size() == 2);
+	TEST_CHECK(existing[1].ip == "192.168.1.2");
+	fs::remove(path);
+}
+
+TEST_LIST = {
+   { "Append - in place", test_append_in_place },
+   { "Append - empty list", test_append_empty_list },
+   { "Append - unexpected layout", test_append_unexpected_layout },
+   { NULL, NULL }
+};
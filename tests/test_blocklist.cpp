@@ -0,0 +1,183 @@
+#include "acutest.h"
+#include "blocklist.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static fs::path write_blocklist(const char* name, const std::string& text) {
+	const fs::path path = fs::temp_directory_path() / name;
+	fs::remove(path);
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	fs::remove(cache_path);
+	std::ofstream(path, std::ios::binary) << text;
+	return path;
+}
+
+static server_address address(const char* text) {
+	server_address parsed{};
+	TEST_CHECK(parse_address(text, parsed) == address_error::none);
+	return parsed;
+}
+
+void test_blocklist_ranges(void) {
+	const fs::path path = write_blocklist("enbt_test_blocklist.txt",
+		"# comment\n"
+		"10.0.0.0/8\n"
+		"192.168.1.7/24 # host bits are dropped\r\n"
+		"\n"
+		"192.168.2.0/24\n" // touches the one above, merged
+		"203.0.113.5\n"
+		"10.20.0.0/16\n" // inside 10.0.0.0/8
+		"2001:db8::/32\n"
+		"fe80::1\n");
+	const cidr_blocklist blocklist(path);
+	TEST_ASSERT(blocklist.is_open());
+	TEST_CHECK(!blocklist.cached());
+	TEST_CHECK(blocklist.size() == 5);
+
+	TEST_CHECK(blocklist.contains(address("10.0.0.0")));
+	TEST_CHECK(blocklist.contains(address("10.255.255.255:1234")));
+	TEST_CHECK(!blocklist.contains(address("11.0.0.0")));
+	TEST_CHECK(!blocklist.contains(address("9.255.255.255")));
+	TEST_CHECK(blocklist.contains(address("192.168.1.0")));
+	TEST_CHECK(blocklist.contains(address("192.168.2.255")));
+	TEST_CHECK(!blocklist.contains(address("192.168.3.0")));
+	TEST_CHECK(blocklist.contains(address("203.0.113.5")));
+	TEST_CHECK(!blocklist.contains(address("203.0.113.4")));
+	TEST_CHECK(!blocklist.contains(address("203.0.113.6")));
+	TEST_CHECK(blocklist.contains(address("[2001:db8:ffff::1]:25565")));
+	TEST_CHECK(!blocklist.contains(address("2001:db9::")));
+	TEST_CHECK(blocklist.contains(address("fe80::1")));
+	TEST_CHECK(!blocklist.contains(address("fe80::2")));
+	// IPv4-mapped
+	TEST_CHECK(blocklist.contains(address("::ffff:10.1.2.3")));
+	TEST_CHECK(!blocklist.contains(address("::ffff:11.1.2.3")));
+	TEST_CHECK(!blocklist.contains(address("play.example.net")));
+
+	std::vector<nbtserver> servers{
+		{ .icon = "", .ip = "10.1.1.1", .name = "a", .accept_textures = false },
+		{ .icon = "", .ip = "8.8.8.8", .name = "b", .accept_textures = false },
+		{ .icon = "", .ip = "play.example.net", .name = "c", .accept_textures = false },
+		{ .icon = "", .ip = "[2001:db8::5]:25566", .name = "d", .accept_textures = false },
+		{ .icon = "", .ip = "not an address!", .name = "e", .accept_textures = false },
+	};
+	TEST_CHECK(blocklist.exclude(servers) == 2);
+	TEST_ASSERT(servers.size() == 3);
+	TEST_CHECK(servers[0].name == "b" && servers[1].name == "c" && servers[2].name == "e");
+	fs::remove(path);
+}
+
+void test_blocklist_cache(void) {
+	const fs::path path = write_blocklist("enbt_test_blocklist_cache.txt", "10.0.0.0/8\n2001:db8::/32\n");
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	{
+		const cidr_blocklist blocklist(path);
+		TEST_CHECK(blocklist.is_open() && !blocklist.cached());
+	}
+	TEST_CHECK(fs::exists(cache_path));
+	{
+		const cidr_blocklist blocklist(path);
+		TEST_CHECK(blocklist.is_open() && blocklist.cached());
+		TEST_CHECK(blocklist.size() == 2);
+		TEST_CHECK(blocklist.contains(address("10.9.9.9")));
+		TEST_CHECK(blocklist.contains(address("2001:db8::1")));
+		TEST_CHECK(!blocklist.contains(address("11.0.0.0")));
+	}
+
+	// a changed list is compiled again
+	std::ofstream(path, std::ios::binary | std::ios::app) << "11.0.0.0/8\n";
+	{
+		const cidr_blocklist blocklist(path);
+		TEST_CHECK(blocklist.is_open() && !blocklist.cached());
+		TEST_CHECK(blocklist.size() == 2); // 10/8 and 11/8 merged
+		TEST_CHECK(blocklist.contains(address("11.0.0.0")));
+	}
+
+	// same size, only the time changed
+	fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(5));
+	{
+		const cidr_blocklist blocklist(path);
+		TEST_CHECK(blocklist.is_open() && !blocklist.cached());
+	}
+
+	// a damaged cache is ignored
+	fs::resize_file(cache_path, 100);
+	{
+		const cidr_blocklist blocklist(path);
+		TEST_CHECK(blocklist.is_open() && !blocklist.cached());
+		TEST_CHECK(blocklist.contains(address("11.0.0.0")));
+	}
+	fs::remove(path);
+	fs::remove(cache_path);
+}
+
+void test_blocklist_errors(void) {
+	const fs::path bad_address = write_blocklist("enbt_test_blocklist_bad.txt", "10.0.0.0/8\n\n10.0.0/8\n");
+	const cidr_blocklist first(bad_address);
+	TEST_CHECK(!first.is_open());
+	TEST_CHECK(first.error().starts_with("line 3:"));
+	fs::remove(bad_address);
+
+	const fs::path bad_prefix = write_blocklist("enbt_test_blocklist_bad.txt", "10.0.0.0/33\n");
+	TEST_CHECK(!cidr_blocklist(bad_prefix).is_open());
+	fs::remove(bad_prefix);
+
+	TEST_CHECK(!cidr_blocklist(fs::temp_directory_path() / "enbt_test_blocklist_missing.txt").is_open());
+}
+
+// Random ranges against a linear scan over them
+void test_blocklist_random(void) {
+	std::mt19937 random(7);
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+	std::string text;
+	for (int i = 0; i < 20000; ++i) {
+		const std::uint32_t ip = random();
+		const unsigned bits = 8 + random() % 25;
+		const std::uint32_t mask = ~std::uint32_t{0} << (32 - bits);
+		ranges.emplace_back(ip & mask, ip | ~mask);
+		text += std::to_string(ip >> 24) + '.' + std::to_string(ip >> 16 & 255) + '.' + std::to_string(ip >> 8 & 255) + '.'
+			+ std::to_string(ip & 255) + '/' + std::to_string(bits) + '\n';
+	}
+	const fs::path path = write_blocklist("enbt_test_blocklist_random.txt", text);
+	for (int pass = 0; pass < 2; ++pass) {
+		const cidr_blocklist blocklist(path);
+		TEST_ASSERT(blocklist.is_open());
+		TEST_CHECK(blocklist.cached() == (pass == 1));
+		std::size_t mismatches = 0;
+		for (int i = 0; i < 2000; ++i) {
+			// half of them at a range edge
+			std::uint32_t ip = random();
+			if (i % 2) {
+				const auto& range = ranges[random() % ranges.size()];
+				ip = i % 4 == 1 ? range.first - 1 : range.second + 1;
+			}
+			bool expected = false;
+			for (const auto& range : ranges)
+				expected = expected || (range.first <= ip && ip <= range.second);
+			server_address parsed{ .kind = address_kind::ipv4, .ipv4 = ip };
+			mismatches += blocklist.contains(parsed) != expected;
+		}
+		TEST_CHECK(mismatches == 0);
+	}
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	fs::remove(path);
+	fs::remove(cache_path);
+}
+
+TEST_LIST = {
+   { "Blocklist - ranges", test_blocklist_ranges },
+   { "Blocklist - cache", test_blocklist_cache },
+   { "Blocklist - errors", test_blocklist_errors },
+   { "Blocklist - random", test_blocklist_random },
+   { NULL, NULL }
+};
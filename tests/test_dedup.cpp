@@ -0,0 +1,98 @@
+#include "acutest.h"
+#include "dedup.hpp"
+#include <bit>
+#include <string>
+#include <vector>
+
+static std::vector<nbtserver> sample_servers() {
+	return {
+		{ .icon = "", .ip = "1.2.3.4", .name = "a", .accept_textures = true },
+		{ .icon = "", .ip = "Play.Example.net", .name = "b", .accept_textures = true },
+		{ .icon = "", .ip = " 1.2.3.4:25565", .name = "c", .accept_textures = true },
+		{ .icon = "", .ip = "1.2.3.4:25566", .name = "d", .accept_textures = true },
+		{ .icon = "", .ip = "play.example.net ", .name = "e", .accept_textures = true },
+		{ .icon = "", .ip = "1.2.3.4", .name = "f", .accept_textures = true },
+		{ .icon = "", .ip = "other.example.net", .name = "g", .accept_textures = true },
+	};
+}
+
+static std::string names(const std::vector<nbtserver>& servers) {
+	std::string out;
+	for (const nbtserver& server : servers)
+		out += server.name;
+	return out;
+}
+
+void test_address_key(void) {
+	TEST_CHECK(address_key("1.2.3.4") == address_key("1.2.3.4:25565"));
+	TEST_CHECK(address_key("1.2.3.4") == address_key("\t1.2.3.4 "));
+	TEST_CHECK(address_key("1.2.3.4") != address_key("1.2.3.4:25566"));
+	TEST_CHECK(address_key("1.2.3.4") == (0x01020304ULL << 16 | 25565));
+	TEST_CHECK(address_key("Example.NET") == address_key("example.net"));
+	// not an IPv4 address, hashed
+	TEST_CHECK(address_key("1.2.3.256") >> 63);
+	TEST_CHECK(address_key("1.2.3") >> 63);
+	TEST_CHECK(address_key("1.2.3.4.5") >> 63);
+}
+
+void test_dedup_first(void) {
+	std::vector<nbtserver> servers = sample_servers();
+	const dedup_stats stats = dedup_servers(servers, dedup_mode::first);
+	TEST_CHECK(names(servers) == "abdg");
+	TEST_CHECK(stats.removed == 3);
+	TEST_CHECK(stats.addresses == 2);
+}
+
+void test_dedup_last(void) {
+	std::vector<nbtserver> servers = sample_servers();
+	const dedup_stats stats = dedup_servers(servers, dedup_mode::last);
+	TEST_CHECK(names(servers) == "defg");
+	TEST_CHECK(stats.removed == 3);
+}
+
+void test_address_set_grows(void) {
+	std::vector<nbtserver> servers;
+	for (int i = 0; i < 100000; ++i)
+		servers.push_back({ .icon = "", .ip = i % 2 ? "10." + std::to_string(i >> 16) + '.' + std::to_string(i >> 8 & 255) + '.' + std::to_string(i % 256) : "host" + std::to_string(i), .name = "", .accept_textures = false });
+	servers.push_back(servers[12345]);
+	servers.push_back(servers[54321]);
+
+	address_set addresses(servers);
+	for (std::size_t i = 0; i < 100000; ++i)
+		TEST_CHECK_(addresses.insert(i) == address_set::npos, "%zu", i);
+	TEST_CHECK(addresses.insert(100000) == 12345);
+	TEST_CHECK(addresses.insert(100001) == 54321);
+	TEST_CHECK(addresses.size() == 100000);
+	// the fewest 12 byte slots at most 3/4 full, 32 bytes an address at most, and a 16
+	// byte record for each of the 50000 host names, twice that with the vector's slack
+	const std::size_t slots = std::bit_ceil((addresses.size() * 4 + 2) / 3);
+	TEST_CHECK(12 * slots <= 32 * addresses.size());
+	TEST_CHECK(addresses.memory() <= 12 * slots + 2 * 16 * 50000);
+}
+
+void test_address_set_hashed(void) {
+	const std::vector<nbtserver> servers = {
+		{ .icon = "", .ip = "[::1]:25565", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "0:0::1", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "[::1]:25566", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "Example.net:1", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = " example.NET:1", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "example.net", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "not an:address", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "NOT AN:ADDRESS ", .name = "", .accept_textures = false },
+	};
+	address_set addresses(servers);
+	const std::size_t expected[] = { address_set::npos, 0, address_set::npos, address_set::npos, 3, address_set::npos, address_set::npos, 6 };
+	for (std::size_t i = 0; i < servers.size(); ++i)
+		TEST_CHECK_(addresses.insert(i) == expected[i], "%zu", i);
+	TEST_CHECK(addresses.size() == 5 && addresses.duplicated() == 3);
+}
+
+TEST_LIST = {
+   { "Dedup - address key", test_address_key },
+   { "Dedup - keep first", test_dedup_first },
+   { "Dedup - keep last", test_dedup_last },
+   { "Dedup - table growth", test_address_set_grows },
+   { "Dedup - hashed addresses", test_address_set_hashed },
+   { NULL, NULL }
+};
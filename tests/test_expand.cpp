@@ -0,0 +1,101 @@
+#include "acutest.h"
+#include "expand.hpp"
+#include <iterator>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> ips(const server_ranges& ranges) {
+	std::vector<std::string> out;
+	nbtserver server{};
+	for (std::uint64_t i = 0; i < ranges.size(); ++i) {
+		ranges.at(i, server);
+		out.push_back(server.ip);
+	}
+	return out;
+}
+
+void test_expand_cidr(void) {
+	const server_ranges ranges("Net {n},,10.20.0.7/30,1\nSix,,[2001:db8::/126]:25566,0\nPort,,192.168.1.0/31:25570,0\n");
+	TEST_ASSERT(ranges.ok());
+	TEST_CHECK(ranges.size() == 10);
+	const std::vector<std::string> expected{
+		"10.20.0.4", "10.20.0.5", "10.20.0.6", "10.20.0.7",
+		"[2001:db8::]:25566", "[2001:db8::1]:25566", "[2001:db8::2]:25566", "[2001:db8::3]:25566",
+		"192.168.1.0:25570", "192.168.1.1:25570",
+	};
+	TEST_CHECK(ips(ranges) == expected);
+
+	nbtserver server{};
+	ranges.at(2, server);
+	TEST_CHECK(server.name == "Net 3");
+	TEST_CHECK(server.accept_textures);
+	TEST_CHECK(server.address.kind == address_kind::ipv4 && server.address.ipv4 == 0x0a140006);
+	ranges.at(7, server);
+	TEST_CHECK(server.name == "Six");
+	TEST_CHECK(!server.accept_textures);
+	TEST_CHECK(server.address.kind == address_kind::ipv6 && server.address.port == 25566);
+
+	TEST_CHECK(server_ranges("a,,10.0.0.0/8,1\n").size() == 1 << 24);
+	TEST_CHECK(server_ranges("a,,10.0.0.1/32,1\n").size() == 1);
+}
+
+void test_expand_patterns(void) {
+	const server_ranges ranges("{ip} #{n},icon,play-[8-10].example.net,1\nb,,10.0.[0-1].[1-2]:25566,0\nc,,srv[01-03]x,0\nplain,,[::1]:25566,0\n");
+	TEST_ASSERT(ranges.ok());
+	const std::vector<std::string> expected{
+		"play-8.example.net", "play-9.example.net", "play-10.example.net",
+		"10.0.0.1:25566", "10.0.0.2:25566", "10.0.1.1:25566", "10.0.1.2:25566",
+		"srv01x", "srv02x", "srv03x",
+		"[::1]:25566",
+	};
+	TEST_CHECK(ips(ranges) == expected);
+
+	nbtserver server{};
+	ranges.at(1, server);
+	TEST_CHECK(server.name == "play-9.example.net #2");
+	TEST_CHECK(server.icon == "icon");
+	TEST_CHECK(server.address.kind == address_kind::host);
+	ranges.at(4, server);
+	TEST_CHECK(server.address.kind == address_kind::ipv4 && server.address.port == 25566);
+}
+
+void test_expand_errors(void) {
+	TEST_CHECK(server_ranges("a,,10.0.0.0/33,1\n").error().starts_with("line 1:"));
+	TEST_CHECK(!server_ranges("a,,10.0.0/8,1\n").ok());
+	TEST_CHECK(!server_ranges("a,,10.0.0.0/8:0,1\n").ok());
+	TEST_CHECK(!server_ranges("a,,10.0.0.0/0,1\n").ok());
+	TEST_CHECK(!server_ranges("a,,2001:db8::/64,1\n").ok());
+	TEST_CHECK(!server_ranges("a,,2001:db8::/97,1\n").ok());
+	TEST_CHECK(server_ranges("a,,2001:db8::/98,1\n").ok());
+	TEST_CHECK(!server_ranges("a,,h[5-4],1\n").ok());
+	// more than an NBT list can hold
+	TEST_CHECK(!server_ranges("a,,h[0-99999].[0-99999],1\n").ok());
+	const server_ranges over("a,,10.0.0.0/2,1\nb,,11.0.0.0/2,1\n");
+	TEST_CHECK(over.error().starts_with("line 2:"));
+}
+
+void test_expand_iterate(void) {
+	const server_ranges ranges("a,,10.0.0.0/24,1\n");
+	const expanded_servers all(ranges);
+	TEST_CHECK(all.size() == 256);
+	std::size_t count = 0;
+	for (const nbtserver& server : all)
+		count += server.ip.starts_with("10.0.0.");
+	TEST_CHECK(count == 256);
+
+	const expanded_servers odd(ranges, [](const nbtserver& server) { return server.address.ipv4 % 2 == 1; });
+	TEST_CHECK(odd.size() == 128);
+	std::vector<std::string> seen;
+	for (const nbtserver& server : odd)
+		seen.push_back(server.ip);
+	TEST_CHECK(seen.size() == 128);
+	TEST_CHECK(seen.front() == "10.0.0.1" && seen.back() == "10.0.0.255");
+}
+
+TEST_LIST = {
+   { "Expand - cidr", test_expand_cidr },
+   { "Expand - patterns", test_expand_patterns },
+   { "Expand - errors", test_expand_errors },
+   { "Expand - iterate", test_expand_iterate },
+   { NULL, NULL }
+};
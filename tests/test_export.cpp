@@ -0,0 +1,127 @@
+#include "acutest.h"
+#include "export.hpp"
+#include "parse.hpp"
+#include "static_servers.hpp"
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static constexpr std::array<static_server, 3> sample_servers{{
+	{ .name = "Server One", .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "192.168.1.1", .accept_textures = true },
+	{ .name = "Server \"Two\"\t\\", .icon = "/9j/4AAQ", .ip = "192.168.1.2", .accept_textures = false },
+	{ .name = "Server, Three", .icon = "/9j/4AAQ", .ip = "play.example.net", .accept_textures = true },
+}};
+
+static fs::path write_sample_dat() {
+	static constexpr auto bytes = make_servers_dat<sample_servers>();
+	const fs::path path = fs::temp_directory_path() / "enbt_test_export.dat";
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return path;
+}
+
+static void check_round_trip(const std::vector<nbtserver>& servers, std::size_t expected) {
+	TEST_CHECK(servers.size() == expected);
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		TEST_CHECK(servers[i].name == sample_servers[i].name);
+		TEST_CHECK(servers[i].icon == sample_servers[i].icon);
+		TEST_CHECK(servers[i].ip == sample_servers[i].ip);
+		TEST_CHECK(servers[i].accept_textures == sample_servers[i].accept_textures);
+	}
+}
+
+void test_export_json(void) {
+	const fs::path path = write_sample_dat();
+	std::ostringstream out;
+	TEST_CHECK(export_servers(path, out, "json", std::endian::big));
+	check_round_trip(parse_servers_json(out.str()), 3);
+	fs::remove(path);
+}
+
+void test_export_toml(void) {
+	const fs::path path = write_sample_dat();
+	std::ostringstream out;
+	TEST_CHECK(export_servers(path, out, "toml", std::endian::big));
+	check_round_trip(parse_servers_toml(out.str()), 3);
+	fs::remove(path);
+}
+
+void test_export_csv(void) {
+	const fs::path path = write_sample_dat();
+	std::ostringstream out;
+	TEST_CHECK(export_servers(path, out, "csv", std::endian::big));
+	// the third name holds a delimiter and can't be written as csv
+	check_round_trip(parse_servers_csv(out.str()), 2);
+	fs::remove(path);
+}
+
+void test_export_empty_icon(void) {
+	static constexpr std::array<static_server, 2> no_icons{{
+		{ .name = "No Icon", .icon = "", .ip = "10.0.0.1", .accept_textures = false },
+		{ .name = "Icon", .icon = "/9j/4AAQ", .ip = "10.0.0.2", .accept_textures = true },
+	}};
+	static constexpr auto bytes = make_servers_dat<no_icons>();
+	const fs::path path = fs::temp_directory_path() / "enbt_test_export_empty_icon.dat";
+	std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+	for (const char* format : { "toml", "json", "csv" }) {
+		std::ostringstream out;
+		TEST_CHECK(export_servers(path, out, format, std::endian::big));
+		const std::string text = out.str();
+		if (std::string_view(format) == "toml")
+			TEST_CHECK(text.find("icon = \"\"\n") != std::string::npos);
+		const std::vector<nbtserver> servers = std::string_view(format) == "toml" ? parse_servers_toml(text)
+			: std::string_view(format) == "json" ? parse_servers_json(text) : parse_servers_csv(text);
+		TEST_CHECK_(servers.size() == 2, "%s", format);
+		if (servers.size() == 2)
+			TEST_CHECK(servers[0].icon.empty() && servers[0].name == "No Icon" && servers[1].icon == "/9j/4AAQ");
+	}
+	fs::remove(path);
+}
+
+void test_export_empty_name(void) {
+	static constexpr std::array<static_server, 2> no_names{{
+		{ .name = "", .icon = "/9j/4AAQ", .ip = "10.0.0.1", .accept_textures = true },
+		{ .name = "Named", .icon = "", .ip = "10.0.0.2", .accept_textures = false },
+	}};
+	static constexpr auto bytes = make_servers_dat<no_names>();
+	const fs::path path = fs::temp_directory_path() / "enbt_test_export_empty_name.dat";
+	std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+	for (const char* format : { "toml", "json", "csv" }) {
+		std::ostringstream out;
+		TEST_CHECK(export_servers(path, out, format, std::endian::big));
+		const std::string text = out.str();
+		if (std::string_view(format) == "toml")
+			TEST_CHECK(text.find("name = \"\"\n") != std::string::npos);
+		const std::vector<nbtserver> servers = std::string_view(format) == "toml" ? parse_servers_toml(text)
+			: std::string_view(format) == "json" ? parse_servers_json(text) : parse_servers_csv(text);
+		TEST_CHECK_(servers.size() == 2, "%s", format);
+		if (servers.size() == 2)
+			TEST_CHECK(servers[0].name.empty() && servers[0].ip == "10.0.0.1" && servers[1].name == "Named");
+	}
+	fs::remove(path);
+}
+
+void test_export_missing_file(void) {
+	std::ostringstream out;
+	TEST_CHECK(!export_servers(fs::temp_directory_path() / "enbt_test_export_missing.dat", out, "csv", std::endian::big));
+	TEST_CHECK(out.str().empty());
+}
+
+TEST_LIST = {
+   { "Export - json", test_export_json },
+   { "Export - toml", test_export_toml },
+   { "Export - csv", test_export_csv },
+   { "Export - empty icon", test_export_empty_icon },
+   { "Export - empty name", test_export_empty_name },
+   { "Export - missing file", test_export_missing_file },
+   { NULL, NULL }
+};
@@ -0,0 +1,82 @@
+#include "acutest.h"
+#include "external.hpp"
+#include "static_servers.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::string sample_csv() {
+	// enough for many runs at the smallest budget, and several merge passes
+	std::mt19937 random(7);
+	std::string csv;
+	for (int i = 0; i < 60000; ++i) {
+		const unsigned address = random() % 5000;
+		csv += "Server " + std::to_string(random() % 500) + ",/9j/4AAQSkZJRgABAQIAJQAl,";
+		csv += address % 4 ? "10.0." + std::to_string(address >> 8) + '.' + std::to_string(address & 255) : "Host" + std::to_string(address % 700) + ".example.net";
+		csv += i % 2 ? ",1\n" : ",0\n";
+	}
+	return csv;
+}
+
+static std::string encode(const std::vector<nbtserver>& servers) {
+	std::string out(servers_dat_head_size, '\0');
+	encode_servers_dat_head(reinterpret_cast<std::byte*>(out.data()), static_cast<std::uint32_t>(servers.size()));
+	for (const nbtserver& server : servers) {
+		const static_server view{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures };
+		const std::size_t at = out.size();
+		out.resize(at + server_nbt_size(view));
+		encode_server_nbt(reinterpret_cast<std::byte*>(out.data() + at), view);
+	}
+	out += NBT::idEnd;
+	return out;
+}
+
+static std::string read_file(const fs::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+static void check_external(const external_options& options, std::vector<nbtserver> expected) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_external.dat";
+	std::istringstream input(sample_csv());
+	external_stats stats{};
+	output_result result{};
+	TEST_CHECK(write_servers_external(input, "csv", path, options, {}, stats, result));
+	TEST_CHECK(stats.written == expected.size());
+	const std::string written = read_file(path);
+	TEST_CHECK(written == encode(expected));
+	TEST_CHECK(result.written && result.size == written.size() && result.hash == hash_bytes(written));
+	fs::remove(path);
+}
+
+void test_external_stream(void) {
+	check_external(external_options{ .mem_limit = 1 << 20 }, parse_servers_csv(sample_csv()));
+}
+
+void test_external_sort(void) {
+	std::vector<nbtserver> servers = parse_servers_csv(sample_csv());
+	apply_order(servers, sort_order(servers, sort_key::name, true));
+	check_external(external_options{ .mem_limit = 1 << 20, .sort = true, .key = sort_key::name, .reverse = true }, servers);
+}
+
+void test_external_dedup(void) {
+	for (const dedup_mode mode : {dedup_mode::first, dedup_mode::last}) {
+		std::vector<nbtserver> servers = parse_servers_csv(sample_csv());
+		dedup_servers(servers, mode);
+		apply_order(servers, sort_order(servers, sort_key::addr, false));
+		check_external(external_options{ .mem_limit = 1 << 20, .dedup = true, .dedup_keep = mode }, servers);
+	}
+}
+
+TEST_LIST = {
+   { "External - streamed batches", test_external_stream },
+   { "External - sorted runs", test_external_sort },
+   { "External - dedup across runs", test_external_dedup },
+   { NULL, NULL }
+};
@@ -0,0 +1,108 @@
+#include "acutest.h"
+#include "filter.hpp"
+#include <string>
+#include <vector>
+
+static std::vector<nbtserver> sample_servers() {
+	return {
+		{ .icon = "", .ip = "10.1.2.3", .name = "EU-Alpha", .accept_textures = true },
+		{ .icon = "", .ip = "192.168.0.7:25566", .name = "EU-Beta", .accept_textures = false },
+		{ .icon = "", .ip = "[fd00::1]:25570", .name = "US-Gamma", .accept_textures = true },
+		{ .icon = "", .ip = "play.example.net", .name = "us-delta", .accept_textures = false },
+		{ .icon = "x", .ip = "8.8.8.8", .name = "Epsilon (1.20)", .accept_textures = true },
+	};
+}
+
+static std::string run(const char* expression) {
+	std::vector<nbtserver> servers = sample_servers();
+	const std::size_t dropped = server_filter(expression).apply(servers);
+	TEST_CHECK(dropped + servers.size() == sample_servers().size());
+	// indices of the servers that are left
+	std::string out;
+	const std::vector<nbtserver> all = sample_servers();
+	for (const nbtserver& server : servers) {
+		for (std::size_t i = 0; i < all.size(); ++i) {
+			if (all[i].name == server.name)
+				out += static_cast<char>('0' + i);
+		}
+	}
+	return out;
+}
+
+void test_filter_strings(void) {
+	TEST_CHECK(run("name == \"EU-Beta\"") == "1");
+	TEST_CHECK(run("name != \"EU-Beta\"") == "0234");
+	TEST_CHECK(run("name ~ \"^EU-\"") == "01");
+	TEST_CHECK(run("name ~ \"ta$\"") == "13");
+	TEST_CHECK(run("name ~ \"^EU-Beta$\"") == "1");
+	TEST_CHECK(run("name ~ \"\\\\(1\\\\.20\\\\)\"") == "4");
+	TEST_CHECK(run("name ~ \"^[a-z]\"") == "3");
+	TEST_CHECK(run("name !~ \"^(EU|US)-\"") == "34");
+	TEST_CHECK(run("icon == \"\"") == "0123");
+	TEST_CHECK(run("ip ~ example") == "3");
+}
+
+void test_filter_numbers(void) {
+	TEST_CHECK(run("accept_textures == true") == "024");
+	TEST_CHECK(run("acceptTextures == 0") == "13");
+	TEST_CHECK(run("port == 25565") == "034");
+	TEST_CHECK(run("port > 25565") == "12");
+	TEST_CHECK(run("port >= 25566 && port < 25570") == "1");
+	TEST_CHECK(run("port <= 25566") == "0134");
+}
+
+void test_filter_cidr(void) {
+	TEST_CHECK(run("ip in 10.0.0.0/8") == "0");
+	TEST_CHECK(run("ip in [10.0.0.0/8, 192.168.0.0/16]") == "01");
+	TEST_CHECK(run("ip in fd00::/8") == "2");
+	TEST_CHECK(run("ip in \"8.8.8.8\"") == "4");
+	TEST_CHECK(run("ip in 0.0.0.0/0") == "014");
+	TEST_CHECK(run("!(ip in 0.0.0.0/0)") == "23");
+	TEST_CHECK(run("ip in 192.168.0.6/31") == "1");
+	TEST_CHECK(run("ip in 192.168.0.8/31") == "");
+
+	// parsed addresses are used when they're there
+	nbtserver server{ .icon = "", .ip = "not parsed again", .name = "", .accept_textures = false };
+	server.address.kind = address_kind::ipv4;
+	server.address.ipv4 = 0x0a000001;
+	TEST_CHECK(server_filter("ip in 10.0.0.0/8").matches(server));
+}
+
+void test_filter_logic(void) {
+	TEST_CHECK(run("name ~ EU && accept_textures == 1 || port == 25570") == "02");
+	TEST_CHECK(run("name ~ EU && (accept_textures == 1 || port == 25566)") == "01");
+	TEST_CHECK(run("!accept_textures == 1") == "13");
+	TEST_CHECK(run("!!(name ~ US)") == "2");
+	TEST_CHECK(run("port == 1 || port == 2 || name ~ Eps") == "4");
+	TEST_CHECK(run("name ~ E && name ~ p && name ~ s") == "4");
+}
+
+void test_filter_errors(void) {
+	const auto column = [](const char* expression) -> std::size_t {
+		try {
+			server_filter filter(expression);
+		} catch (const filter_error& e) {
+			return e.column();
+		}
+		return 0;
+	};
+	TEST_CHECK(column("") == 1);
+	TEST_CHECK(column("nam == x") == 1);
+	TEST_CHECK(column("name = x") == 6);
+	TEST_CHECK(column("name == x &&") == 13);
+	TEST_CHECK(column("(name == x") == 11);
+	TEST_CHECK(column("name ~ \"(\"") == 8);
+	TEST_CHECK(column("port == x") == 9);
+	TEST_CHECK(column("name in 10.0.0.0/8") == 6);
+	TEST_CHECK(column("ip in 10.0.0.0/33") == 7);
+	TEST_CHECK(column("name == x)") == 10);
+}
+
+TEST_LIST = {
+   { "Filter - strings", test_filter_strings },
+   { "Filter - numbers", test_filter_numbers },
+   { "Filter - cidr", test_filter_cidr },
+   { "Filter - logic", test_filter_logic },
+   { "Filter - errors", test_filter_errors },
+   { NULL, NULL }
+};
@@ -0,0 +1,192 @@
+#include "acutest.h"
+#include "icon.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::string reference_base64(const std::string& bytes) {
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+	std::uint32_t bits = 0;
+	int count = 0;
+	for (const unsigned char byte : bytes) {
+		bits = bits << 8 | byte;
+		count += 8;
+		while (count >= 6) {
+			count -= 6;
+			out += alphabet[bits >> count & 63];
+		}
+	}
+	if (count)
+		out += alphabet[bits << (6 - count) & 63];
+	while (out.size() % 4)
+		out += '=';
+	return out;
+}
+
+// The start of a PNG: signature and IHDR, then some bytes standing in for the rest
+static std::string png(std::uint32_t width, std::uint32_t height, char filler = 'x') {
+	std::string bytes("\x89PNG\r\n\x1a\n", 8);
+	const auto be32 = [&](std::uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8)
+			bytes += static_cast<char>(value >> shift & 0xff);
+	};
+	be32(13);
+	bytes += "IHDR";
+	be32(width);
+	be32(height);
+	bytes += std::string("\x08\x06\x00\x00\x00", 5);
+	bytes += std::string(40, filler);
+	return bytes;
+}
+
+static std::string write_file(const char* name, const std::string& bytes) {
+	const fs::path path = fs::temp_directory_path() / name;
+	std::ofstream(path, std::ios::binary) << bytes;
+	return path.string();
+}
+
+void test_base64(void) {
+	TEST_CHECK(base64_encode("") == "");
+	TEST_CHECK(base64_encode("f") == "Zg==");
+	TEST_CHECK(base64_encode("fo") == "Zm8=");
+	TEST_CHECK(base64_encode("foo") == "Zm9v");
+	TEST_CHECK(base64_encode("foobar") == "Zm9vYmFy");
+
+	// every length around the vector step, and every byte value
+	std::mt19937 random(5);
+	for (std::size_t size = 0; size < 200; ++size) {
+		std::string bytes(size, '\0');
+		for (char& byte : bytes)
+			byte = static_cast<char>(random());
+		TEST_CHECK(base64_encode(bytes) == reference_base64(bytes));
+		TEST_MSG("size %zu", size);
+	}
+	std::string large(100000, '\0');
+	for (std::size_t i = 0; i < large.size(); ++i)
+		large[i] = static_cast<char>(i * 7 + i / 256);
+	TEST_CHECK(base64_encode(large) == reference_base64(large));
+}
+
+void test_check_png(void) {
+	TEST_CHECK(check_png(png(64, 64)) == icon_error::none);
+	TEST_CHECK(check_png(png(32, 32)) == icon_error::dimensions);
+	TEST_CHECK(check_png(png(64, 128)) == icon_error::dimensions);
+	std::string bad = png(64, 64);
+	bad[1] = 'J';
+	TEST_CHECK(check_png(bad) == icon_error::not_png);
+	bad = png(64, 64);
+	bad[12] = 'i';
+	TEST_CHECK(check_png(bad) == icon_error::not_png);
+	TEST_CHECK(check_png(png(64, 64).substr(0, 20)) == icon_error::not_png);
+	TEST_CHECK(check_png("") == icon_error::not_png);
+}
+
+void test_icon_cache(void) {
+	const std::string lobby = write_file("enbt_test_icon_lobby.png", png(64, 64, 'a'));
+	const std::string copy = write_file("enbt_test_icon_copy.png", png(64, 64, 'a'));
+	const std::string other = write_file("enbt_test_icon_other.png", png(64, 64, 'b'));
+	const std::string small = write_file("enbt_test_icon_small.png", png(16, 16));
+	const std::string missing = (fs::temp_directory_path() / "enbt_test_icon_missing.png").string();
+	fs::remove(missing);
+
+	std::vector<nbtserver> servers;
+	for (const std::string& icon : {"@" + lobby, "@" + copy, "@" + other, "@" + lobby, "@" + small, "@" + missing, std::string("aWNvbg==")})
+		servers.push_back({ .icon = icon, .ip = "localhost", .name = "", .accept_textures = false });
+
+	icon_cache icons;
+	icons.resolve(servers);
+	const std::string encoded = reference_base64(png(64, 64, 'a'));
+	TEST_CHECK(servers[0].icon == encoded);
+	TEST_CHECK(servers[1].icon == encoded);
+	TEST_CHECK(servers[2].icon == reference_base64(png(64, 64, 'b')));
+	TEST_CHECK(servers[3].icon == encoded);
+	TEST_CHECK(servers[4].icon.empty());
+	TEST_CHECK(servers[5].icon.empty());
+	TEST_CHECK(servers[6].icon == "aWNvbg==");
+
+	TEST_CHECK(icons.files() == 5);
+	TEST_CHECK(icons.images() == 2);
+	TEST_ASSERT(icons.failures().size() == 2);
+	TEST_CHECK(icons.failures()[0].first == small && icons.failures()[0].second == icon_error::dimensions);
+	TEST_CHECK(icons.failures()[1].first == missing && icons.failures()[1].second == icon_error::unreadable);
+
+	// resolved icons are left alone when they come through again
+	icons.resolve(servers);
+	TEST_CHECK(servers[0].icon == encoded);
+	TEST_CHECK(icons.failures().size() == 2);
+}
+
+void test_base64_alphabet(void) {
+	const std::string digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	TEST_CHECK(in_base64_alphabet(digits));
+	TEST_CHECK(in_base64_alphabet(""));
+	// every byte value, at every position of a vector step and in the tail
+	for (int c = 0; c < 256; ++c) {
+		const bool digit = digits.find(static_cast<char>(c)) != std::string::npos;
+		for (std::size_t position = 0; position < 40; ++position) {
+			std::string text(40, 'A');
+			text[position] = static_cast<char>(c);
+			if (in_base64_alphabet(text) != digit) {
+				TEST_CHECK(false);
+				TEST_MSG("byte %d at %zu", c, position);
+			}
+		}
+	}
+}
+
+void test_check_icon(void) {
+	const std::string icon = base64_encode(png(64, 64));
+	TEST_CHECK(check_icon(icon) == icon_error::none);
+	TEST_CHECK(check_icon("") == icon_error::none);
+	TEST_CHECK(check_icon(base64_encode(png(64, 64) + "ab")) == icon_error::none); // '=' padding
+	TEST_CHECK(check_icon(base64_encode(png(64, 64) + "a")) == icon_error::none); // '==' padding
+
+	// the README examples are JPEG
+	TEST_CHECK(check_icon("/9j/4AAQSkZJRgABAQIAJQAl") == icon_error::not_png);
+	TEST_CHECK(check_icon(base64_encode(png(16, 16))) == icon_error::dimensions);
+	TEST_CHECK(check_icon(base64_encode("\x89PNG")) == icon_error::not_png);
+
+	TEST_CHECK(check_icon("data:image/png;base64," + icon) == icon_error::base64);
+	TEST_CHECK(check_icon(icon.substr(0, icon.size() - 1)) == icon_error::base64);
+	std::string broken = icon;
+	broken[40] = '*';
+	TEST_CHECK(check_icon(broken) == icon_error::base64);
+	broken = icon;
+	broken[4] = '=';
+	TEST_CHECK(check_icon(broken) == icon_error::base64);
+	TEST_CHECK(check_icon(icon.substr(0, icon.size() - 4) + "A===") == icon_error::base64);
+
+	std::string large = png(64, 64);
+	large.resize(30000, 'z');
+	TEST_CHECK(check_icon(base64_encode(large)) == icon_error::oversize);
+}
+
+void test_validate_icons(void) {
+	std::vector<nbtserver> servers;
+	for (const std::string& icon : {base64_encode(png(64, 64)), std::string(), std::string("/9j/4AAQSkZJRgABAQIAJQAl"), std::string("not base64!")})
+		servers.push_back({ .icon = icon, .ip = std::to_string(servers.size()) + ".example.net", .name = "", .accept_textures = false });
+	const icon_check_stats stats = validate_icons(servers);
+	TEST_ASSERT(servers.size() == 4);
+	TEST_CHECK(!servers[0].icon.empty());
+	TEST_CHECK(servers[2].icon.empty() && servers[3].icon.empty());
+	TEST_CHECK(stats.cleared == 2);
+	TEST_CHECK(stats.errors[static_cast<std::size_t>(icon_error::not_png)] == 1);
+	TEST_CHECK(stats.errors[static_cast<std::size_t>(icon_error::base64)] == 1);
+	TEST_CHECK((stats.examples == std::vector<std::string>{"2.example.net", "3.example.net"}));
+}
+
+TEST_LIST = {
+   { "Icon - base64", test_base64 },
+   { "Icon - check png", test_check_png },
+   { "Icon - base64 alphabet", test_base64_alphabet },
+   { "Icon - check icon", test_check_icon },
+   { "Icon - validate", test_validate_icons },
+   { "Icon - cache", test_icon_cache },
+   { NULL, NULL }
+};
@@ -0,0 +1,83 @@
+#include "acutest.h"
+#include "interval_table.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using u128 = interval_table::u128;
+
+static server_address address(const char* text) {
+	server_address parsed{};
+	TEST_CHECK(parse_address(text, parsed) == address_error::none);
+	return parsed;
+}
+
+void test_interval_table_parse_cidr(void) {
+	interval_table::interval<std::uint32_t> v4{};
+	interval_table::interval<u128> v6{};
+	bool is_v4 = false;
+	TEST_CHECK(interval_table::parse_cidr("10.1.2.3/8", v4, v6, is_v4) == interval_table::cidr_error::none);
+	TEST_CHECK(is_v4 && v4.start == 0x0a000000 && v4.end == 0x0affffff);
+	TEST_CHECK(interval_table::parse_cidr("0.0.0.0/0", v4, v6, is_v4) == interval_table::cidr_error::none);
+	TEST_CHECK(v4.start == 0 && v4.end == UINT32_MAX);
+	TEST_CHECK(interval_table::parse_cidr("2001:db8::1/64", v4, v6, is_v4) == interval_table::cidr_error::none);
+	TEST_CHECK(!is_v4 && v6.start == (u128{ 0x20010db800000000, 0 }) && v6.end == (u128{ 0x20010db800000000, UINT64_MAX }));
+	TEST_CHECK(interval_table::parse_cidr("fe80::1", v4, v6, is_v4) == interval_table::cidr_error::none);
+	TEST_CHECK(v6.start == v6.end && v6.start == (u128{ 0xfe80000000000000, 1 }));
+	TEST_CHECK(interval_table::parse_cidr("example.net/8", v4, v6, is_v4) == interval_table::cidr_error::address);
+	TEST_CHECK(interval_table::parse_cidr("10.0.0.0/33", v4, v6, is_v4) == interval_table::cidr_error::prefix_length);
+	TEST_CHECK(interval_table::parse_cidr("10.0.0.0/", v4, v6, is_v4) == interval_table::cidr_error::prefix_length);
+	TEST_CHECK(interval_table::successor(u128{ 1, UINT64_MAX }) == (u128{ 2, 0 }));
+	TEST_CHECK(interval_table::predecessor(u128{ 2, 0 }) == (u128{ 1, UINT64_MAX }));
+}
+
+void test_interval_table_cache(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_interval_table.cache";
+	fs::remove(path);
+	constexpr char magic[8] = {'E', 'N', 'B', 'T', 'T', 'E', 'S', 'T'};
+	const interval_table::source_stamp stamp{ 123, 456 };
+
+	interval_table table;
+	table.assign({ { 0x0a000000, 0x0affffff, 7 }, { 0x0b000000, 0x0b000000, 8 } }, { { u128{ 0x20010db800000000, 0 }, u128{ 0x20010db8ffffffff, UINT64_MAX }, 9 } }, true);
+	TEST_CHECK(table.size() == 3);
+	TEST_CHECK(table.payload(table.find(address("10.1.2.3"))) == 7);
+	TEST_CHECK(table.payload(table.find(address("11.0.0.0"))) == 8);
+	TEST_CHECK(table.find(address("11.0.0.1")) == interval_table::npos);
+	TEST_CHECK(table.payload(table.find(address("2001:db8::5"))) == 9);
+	TEST_CHECK(table.payload(table.find(address("::ffff:10.0.0.1"))) == 7);
+	TEST_CHECK(table.find(address("example.net")) == interval_table::npos);
+	table.save(path, magic, stamp, "extra");
+
+	interval_table mapped;
+	std::string_view extra;
+	TEST_ASSERT(mapped.load(path, magic, stamp, extra));
+	TEST_CHECK(extra == "extra");
+	TEST_CHECK(reinterpret_cast<std::uintptr_t>(extra.data()) % 8 == 0);
+	TEST_CHECK(mapped.size() == 3);
+	TEST_CHECK(mapped.payload(mapped.find(address("11.0.0.0"))) == 8);
+	TEST_CHECK(mapped.payload(mapped.find(address("2001:db8:ffff::"))) == 9);
+
+	// another magic or text
+	interval_table other;
+	constexpr char other_magic[8] = {'E', 'N', 'B', 'T', 'T', 'E', 'S', 'U'};
+	TEST_CHECK(!other.load(path, other_magic, stamp, extra));
+	TEST_CHECK(!other.load(path, magic, { 124, 456 }, extra));
+
+	// without payloads
+	interval_table plain;
+	plain.assign({ { 1, 2, 0 } }, {}, false);
+	plain.save(path, magic, stamp, {});
+	TEST_ASSERT(other.load(path, magic, stamp, extra));
+	TEST_CHECK(extra.empty() && other.size() == 1 && other.find(address("0.0.0.2")) == 0 && other.payload(0) == 0);
+	fs::remove(path);
+}
+
+TEST_LIST = {
+   { "Interval table - parse cidr", test_interval_table_parse_cidr },
+   { "Interval table - cache", test_interval_table_cache },
+   { NULL, NULL }
+};
@@ -0,0 +1,112 @@
+#include "acutest.h"
+#include "NBTDocument.h"
+#include "NBTReader.h"
+#include "static_servers.hpp"
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+static constexpr std::array<static_server, 3> sample_servers{{
+	{ .name = "Server One", .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "192.168.1.1", .accept_textures = true },
+	{ .name = "Server Two", .icon = "", .ip = "192.168.1.2", .accept_textures = false },
+	{ .name = "Server Three", .icon = "/9j/4AAQ", .ip = "play.example.net", .accept_textures = true },
+}};
+
+static constexpr auto sample_dat = make_servers_dat<sample_servers>();
+
+static std::string_view sample_bytes() {
+	return {reinterpret_cast<const char*>(sample_dat.data()), sample_dat.size()};
+}
+
+void test_nbtdocument_unchanged(void) {
+	NBT::NBTDocument doc(sample_bytes());
+	TEST_CHECK(doc.size(doc.serverList()) == 3);
+	TEST_CHECK(!doc.isDirty(doc.root()));
+	TEST_CHECK(doc.serialize() == sample_bytes());
+}
+
+void test_nbtdocument_edit(void) {
+	NBT::NBTDocument doc(sample_bytes());
+	const auto server = doc.findServer("192.168.1.2");
+	TEST_ASSERT(server != doc.npos);
+	doc.setString(doc.find(server, "name"), "Renamed");
+	doc.setInteger(doc.find(server, "acceptTextures"), 1);
+
+	const auto first = doc.firstChild(doc.serverList());
+	TEST_CHECK(!doc.isDirty(first));
+	TEST_CHECK(doc.isDirty(server));
+	TEST_CHECK(doc.isDirty(doc.root()));
+
+	const std::string out = doc.serialize();
+	NBT::NBTReader reader{std::string_view(out)};
+	std::array<std::string_view, 3> names{"Server One", "Renamed", "Server Three"};
+	std::size_t i = 0;
+	for (const auto& entry : reader.servers()) {
+		TEST_CHECK(entry.name == names[i]);
+		TEST_CHECK(entry.ip == sample_servers[i].ip);
+		TEST_CHECK(entry.acceptTextures);
+		++i;
+	}
+	TEST_CHECK(i == 3);
+}
+
+void test_nbtdocument_add_remove(void) {
+	NBT::NBTDocument doc(sample_bytes());
+	doc.remove(doc.findServer("192.168.1.1"));
+	TEST_CHECK(doc.addServer("Server Four", "", "10.0.0.4", false) != doc.npos);
+
+	const std::string out = doc.serialize();
+	NBT::NBTReader reader{std::string_view(out)};
+	TEST_CHECK(reader.serverCount() == 3);
+	std::array<std::string_view, 3> ips{"192.168.1.2", "play.example.net", "10.0.0.4"};
+	std::size_t i = 0;
+	for (const auto& entry : reader.servers())
+		TEST_CHECK(entry.ip == ips[i++]);
+	TEST_CHECK(i == 3);
+}
+
+void test_nbtdocument_save_over_source(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_document.dat";
+	{
+		NBT::NBTDocument doc(sample_bytes());
+		TEST_CHECK(doc.save(path));
+	}
+	{
+		NBT::NBTDocument doc(path);
+		TEST_ASSERT(doc.isOpen());
+		doc.setString(doc.find(doc.findServer("play.example.net"), "icon"), "iVBORw0KGgo=");
+		TEST_CHECK(doc.save(path));
+	}
+	NBT::NBTReader reader(path);
+	TEST_ASSERT(reader.isOpen());
+	std::size_t i = 0;
+	for (const auto& entry : reader.servers()) {
+		if (i++ == 2)
+			TEST_CHECK(entry.icon == "iVBORw0KGgo=");
+	}
+	fs::remove(path);
+}
+
+void test_nbtdocument_empty(void) {
+	NBT::NBTDocument doc;
+	doc.addServer("Only", "", "1.1.1.1", true);
+	const std::string out = doc.serialize();
+	NBT::NBTReader reader{std::string_view(out)};
+	TEST_CHECK(reader.serverCount() == 1);
+	static constexpr std::array<static_server, 1> only{{{ .name = "Only", .icon = "", .ip = "1.1.1.1", .accept_textures = true }}};
+	constexpr auto expected = make_servers_dat<only>();
+	TEST_CHECK(out == std::string_view(reinterpret_cast<const char*>(expected.data()), expected.size()));
+}
+
+TEST_LIST = {
+   { "NBTDocument - unchanged", test_nbtdocument_unchanged },
+   { "NBTDocument - edit", test_nbtdocument_edit },
+   { "NBTDocument - add and remove", test_nbtdocument_add_remove },
+   { "NBTDocument - save over source", test_nbtdocument_save_over_source },
+   { "NBTDocument - empty", test_nbtdocument_empty },
+   { NULL, NULL }
+};
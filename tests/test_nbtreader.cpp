@@ -0,0 +1,105 @@
+#include "acutest.h"
+#include "NBTReader.h"
+#include "NBTWriter.h"
+#include "static_servers.hpp"
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static constexpr std::array<static_server, 3> sample_servers{{
+	{ .name = "Server One", .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "192.168.1.1", .accept_textures = true },
+	{ .name = "Server Two", .icon = "", .ip = "192.168.1.2", .accept_textures = false },
+	{ .name = "Server Three", .icon = "/9j/4AAQ", .ip = "play.example.net", .accept_textures = true },
+}};
+
+template <std::endian E>
+static std::string_view sample_bytes() {
+	static constexpr auto bytes = make_servers_dat<sample_servers, E>();
+	return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+template <std::endian E>
+static void check_sample_servers(const NBT::NBTReader<E>& reader) {
+	TEST_CHECK(reader.serverCount() == 3);
+	std::size_t i = 0;
+	for (const auto& server : reader.servers()) {
+		TEST_ASSERT(i < sample_servers.size());
+		TEST_CHECK(server.name == sample_servers[i].name);
+		TEST_CHECK(server.icon == sample_servers[i].icon);
+		TEST_CHECK(server.ip == sample_servers[i].ip);
+		TEST_CHECK(server.acceptTextures == sample_servers[i].accept_textures);
+		TEST_CHECK(server.raw.size() == server_nbt_size(sample_servers[i]));
+		++i;
+	}
+	TEST_CHECK(i == sample_servers.size());
+}
+
+void test_nbtreader_servers(void) {
+	check_sample_servers(NBT::NBTReader<std::endian::big>(sample_bytes<std::endian::big>()));
+	check_sample_servers(NBT::NBTReader<std::endian::little>(sample_bytes<std::endian::little>()));
+}
+
+void test_nbtreader_zero_copy(void) {
+	const std::string_view bytes = sample_bytes<std::endian::big>();
+	NBT::NBTReader reader(bytes);
+	for (const auto& server : reader.servers()) {
+		TEST_CHECK(server.name.data() > bytes.data());
+		TEST_CHECK(server.name.data() + server.name.size() < bytes.data() + bytes.size());
+	}
+	TEST_CHECK(reader.root().end() == bytes.data() + bytes.size());
+}
+
+void test_nbtreader_mapped_file(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_reader.dat";
+	{
+		NBT::NBTWriter<> writer(path.string().data(), false);
+		writer.writeListHead("servers", NBT::idCompound, 3);
+		for (const static_server& server : sample_servers) {
+			writer.writeCompound("");
+			writer.writeString("name", std::string(server.name).data());
+			writer.writeString("icon", std::string(server.icon).data());
+			writer.writeString("ip", std::string(server.ip).data());
+			writer.writeByte("acceptTextures", server.accept_textures);
+			writer.endCompound();
+		}
+		writer.writeIntArrayHead("skipped", 2);
+		writer.writeInt("", 1);
+		writer.writeInt("", 2);
+		writer.close();
+	}
+	{
+		NBT::NBTReader reader(path);
+		TEST_ASSERT(reader.isOpen());
+		check_sample_servers(reader);
+		const auto skipped = reader.root().find("skipped");
+		TEST_CHECK(skipped.type() == NBT::idIntArray);
+		TEST_CHECK(skipped.arraySize() == 2);
+	}
+	fs::remove(path);
+}
+
+void test_nbtreader_truncated(void) {
+	const std::string_view bytes = sample_bytes<std::endian::big>();
+	NBT::NBTReader reader(bytes.substr(0, bytes.size() / 2));
+	bool threw = false;
+	try {
+		for (const auto& server : reader.servers())
+			(void)server;
+	} catch (const NBT::parse_error&) {
+		threw = true;
+	}
+	TEST_CHECK(threw);
+}
+
+TEST_LIST = {
+   { "NBTReader - servers", test_nbtreader_servers },
+   { "NBTReader - zero copy", test_nbtreader_zero_copy },
+   { "NBTReader - mapped file", test_nbtreader_mapped_file },
+   { "NBTReader - truncated", test_nbtreader_truncated },
+   { NULL, NULL }
+};
@@ -0,0 +1,119 @@
+#include "acutest.h"
+#include "NBTWriter.h"
+#include "static_servers.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+template <std::endian E>
+static std::vector<unsigned char> write_sample(const std::string& file_name) {
+	const fs::path path = fs::temp_directory_path() / file_name;
+	{
+		NBT::NBTWriter<E> writer(path.string().data(), false);
+		writer.writeListHead("servers", NBT::idCompound, 1);
+		writer.writeCompound("");
+		writer.writeString("ip", "1.2.3.4");
+		writer.writeInt("port", 0x01020304);
+		writer.endCompound();
+		writer.close();
+	}
+	std::ifstream in(path, std::ios::binary);
+	std::vector<unsigned char> bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	in.close();
+	fs::remove(path);
+	return bytes;
+}
+
+void test_nbtwriter_big_endian(void) {
+	const auto bytes = write_sample<std::endian::big>("enbt_test_big.dat");
+	const std::vector<unsigned char> expected{
+		10, 0, 0,
+		9, 0, 7, 's', 'e', 'r', 'v', 'e', 'r', 's', 10, 0, 0, 0, 1,
+		8, 0, 2, 'i', 'p', 0, 7, '1', '.', '2', '.', '3', '.', '4',
+		3, 0, 4, 'p', 'o', 'r', 't', 1, 2, 3, 4,
+		0,
+		0,
+	};
+	TEST_CHECK(bytes == expected);
+}
+
+void test_nbtwriter_little_endian(void) {
+	const auto bytes = write_sample<std::endian::little>("enbt_test_little.dat");
+	const std::vector<unsigned char> expected{
+		10, 0, 0,
+		9, 7, 0, 's', 'e', 'r', 'v', 'e', 'r', 's', 10, 1, 0, 0, 0,
+		8, 2, 0, 'i', 'p', 7, 0, '1', '.', '2', '.', '3', '.', '4',
+		3, 4, 0, 'p', 'o', 'r', 't', 4, 3, 2, 1,
+		0,
+		0,
+	};
+	TEST_CHECK(bytes == expected);
+}
+
+static constexpr std::array<static_server, 2> builtin_servers{{
+	{ .name = "Server One", .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "192.168.1.1", .accept_textures = true },
+	{ .name = "Server Two", .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "192.168.1.2", .accept_textures = false },
+}};
+
+template <std::endian E>
+static std::vector<unsigned char> write_builtin_servers(const std::string& file_name) {
+	const fs::path path = fs::temp_directory_path() / file_name;
+	{
+		NBT::NBTWriter<E> writer(path.string().data(), false);
+		writer.writeListHead("servers", NBT::idCompound, builtin_servers.size());
+		for (const static_server& server : builtin_servers) {
+			writer.writeCompound("");
+			writer.writeString("name", std::string(server.name).data());
+			writer.writeString("icon", std::string(server.icon).data());
+			writer.writeString("ip", std::string(server.ip).data());
+			writer.writeByte("acceptTextures", server.accept_textures);
+			writer.endCompound();
+		}
+		writer.close();
+	}
+	std::ifstream in(path, std::ios::binary);
+	std::vector<unsigned char> bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+	in.close();
+	fs::remove(path);
+	return bytes;
+}
+
+template <std::size_t N>
+static std::vector<unsigned char> to_bytes(const std::array<std::byte, N>& bytes) {
+	std::vector<unsigned char> out(N);
+	std::transform(bytes.begin(), bytes.end(), out.begin(), [](std::byte b) { return static_cast<unsigned char>(b); });
+	return out;
+}
+
+void test_static_servers_matches_writer(void) {
+	constexpr auto big = make_servers_dat<builtin_servers>();
+	constexpr auto little = make_servers_dat<builtin_servers, std::endian::little>();
+	static_assert(big.size() == servers_dat_size(builtin_servers));
+	TEST_CHECK(to_bytes(big) == write_builtin_servers<std::endian::big>("enbt_test_static_big.dat"));
+	TEST_CHECK(to_bytes(little) == write_builtin_servers<std::endian::little>("enbt_test_static_little.dat"));
+}
+
+void test_static_servers_csv(void) {
+	constexpr auto from_csv = make_servers_dat_csv<
+		"Server One,/9j/4AAQSkZJRgABAQIAJQAl,192.168.1.1,1\n"
+		"incomplete|entry\n"
+		"Server Two;/9j/4AAQSkZJRgABAQIAJQAl;192.168.1.2;0\n">();
+	constexpr auto from_array = make_servers_dat<builtin_servers>();
+	static_assert(from_csv == from_array);
+	TEST_CHECK(to_bytes(from_csv) == to_bytes(from_array));
+}
+
+TEST_LIST = {
+   { "NBTWriter - big endian", test_nbtwriter_big_endian },
+   { "NBTWriter - little endian", test_nbtwriter_little_endian },
+   { "Static servers - matches NBTWriter", test_static_servers_matches_writer },
+   { "Static servers - csv literal", test_static_servers_csv },
+   { NULL, NULL }
+};
@@ -0,0 +1,221 @@
+#include "acutest.h"
+#include "hash.hpp"
+#include "output.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void test_hash_xxh64(void) {
+	TEST_CHECK(hash_bytes("") == 0xEF46DB3751D8E999ULL);
+	TEST_CHECK(hash_bytes("a") == 0xD24EC4F1A98C6E5BULL);
+	TEST_CHECK(hash_bytes("abc") == 0x44BC2CF5AD770999ULL);
+	TEST_CHECK(hash_hex(0xEF46DB3751D8E999ULL) == "ef46db3751d8e999");
+	// 32 bytes and more go through the four accumulators
+	TEST_CHECK(hash_bytes("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ULL);
+	std::string bytes;
+	for (int i = 0; i < 1024; ++i)
+		bytes.push_back(static_cast<char>(i & 255));
+	TEST_CHECK(hash_bytes(bytes) == 0x6F3914F18FE4DF57ULL);
+
+	// streaming in uneven pieces matches the one shot hash
+	std::string data;
+	for (int i = 0; i < 1000; ++i)
+		data += std::to_string(i * 7919);
+	xxh64 hasher;
+	for (std::size_t pos = 0, step = 1; pos < data.size(); pos += step, step = step * 3 % 61 + 1)
+		hasher.update(std::string_view(data).substr(pos, step));
+	TEST_CHECK(hasher.digest() == hash_bytes(data));
+}
+
+void test_atomic_output_replace(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_atomic.dat";
+	{
+		std::ofstream old_file(path, std::ios::binary);
+		old_file << "old contents";
+	}
+
+	atomic_output output(path);
+	TEST_ASSERT(output.is_open());
+	output.stream() << "new contents";
+	TEST_CHECK(read_file(path) == "old contents");
+
+	output_result result{};
+	TEST_CHECK(output.commit(result));
+	TEST_CHECK(result.written);
+	TEST_CHECK(result.size == 12);
+	TEST_CHECK(result.hash == hash_bytes("new contents"));
+	TEST_CHECK(read_file(path) == "new contents");
+	TEST_CHECK(!fs::exists(output.temp_path()));
+	fs::remove(path);
+}
+
+void test_atomic_output_permissions(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_atomic_permissions.dat";
+	{
+		std::ofstream old_file(path, std::ios::binary);
+		old_file << "old contents";
+	}
+	const fs::perms mode = fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read;
+	fs::permissions(path, mode, fs::perm_options::replace);
+
+	atomic_output output(path);
+	output.stream() << "new contents";
+	output_result result{};
+	TEST_CHECK(output.commit(result));
+	TEST_CHECK(result.written);
+	TEST_CHECK(fs::status(path).permissions() == mode);
+	fs::remove(path);
+}
+
+void test_atomic_output_unchanged(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_atomic_unchanged.dat";
+	{
+		std::ofstream old_file(path, std::ios::binary);
+		old_file << "same contents";
+	}
+	const auto old_time = fs::last_write_time(path);
+
+	output_result result{};
+	{
+		atomic_output output(path);
+		output.stream() << "same contents";
+		TEST_CHECK(output.commit(result));
+	}
+	TEST_CHECK(!result.written);
+	TEST_CHECK(fs::last_write_time(path) == old_time);
+	fs::remove(path);
+}
+
+void test_atomic_output_discard(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_atomic_discard.dat";
+	fs::path temp;
+	{
+		atomic_output output(path);
+		output.stream() << "never committed";
+		temp = output.temp_path();
+		TEST_CHECK(fs::exists(temp));
+	}
+	TEST_CHECK(!fs::exists(temp));
+	TEST_CHECK(!fs::exists(path));
+}
+
+void test_atomic_output_copy(void) {
+	const fs::path source = fs::temp_directory_path() / "enbt_test_copy_source.dat";
+	const fs::path target = fs::temp_directory_path() / "enbt_test_copy_target.dat";
+	const std::string contents(100000, 'x');
+	{
+		std::ofstream source_file(source, std::ios::binary);
+		source_file << contents;
+	}
+
+	output_result result{};
+	{
+		atomic_output output(target);
+		TEST_CHECK(output.copy_from(source, contents, hash_bytes(contents)));
+		TEST_CHECK(output.commit(result));
+	}
+	TEST_CHECK(result.written);
+	TEST_CHECK(result.hash == hash_bytes(contents));
+	TEST_CHECK(read_file(target) == contents);
+	TEST_CHECK(file_matches(target, contents.size(), hash_bytes(contents)));
+
+	// a missing source falls back to writing the bytes
+	fs::remove(source);
+	fs::remove(target);
+	{
+		atomic_output output(target);
+		TEST_CHECK(output.copy_from(source, contents, hash_bytes(contents)));
+		TEST_CHECK(output.commit(result));
+	}
+	TEST_CHECK(read_file(target) == contents);
+	fs::remove(target);
+}
+
+void test_atomic_output_start_from(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_start_from.dat";
+	const std::string contents = std::string(8, '0') + std::string(100000, 'x') + "tail";
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << contents;
+	}
+
+	// the start of the file itself, more bytes after it and one patched inside it
+	output_result result{};
+	{
+		atomic_output output(path);
+		TEST_CHECK(output.start_from(path, std::string_view(contents).substr(0, contents.size() - 4)));
+		output.stream() << "new tail";
+		TEST_CHECK(output.patch(0, "1"));
+		TEST_CHECK(read_file(path) == contents);
+		TEST_CHECK(output.commit(result));
+	}
+	const std::string expected = "1" + contents.substr(1, contents.size() - 5) + "new tail";
+	TEST_CHECK(result.written);
+	TEST_CHECK(result.size == expected.size());
+	TEST_CHECK(!result.hashed);
+	TEST_CHECK(read_file(path) == expected);
+
+	// without a source the bytes are written
+	const fs::path target = fs::temp_directory_path() / "enbt_test_start_from_target.dat";
+	{
+		atomic_output output(target);
+		TEST_CHECK(output.start_from(fs::temp_directory_path() / "enbt_test_start_from_missing.dat", "abc"));
+		output.stream() << "def";
+		TEST_CHECK(output.commit(result));
+	}
+	TEST_CHECK(read_file(target) == "abcdef");
+	fs::remove(target);
+	fs::remove(path);
+}
+
+void test_write_outputs_failed_first(void) {
+	const fs::path directory = fs::temp_directory_path() / "enbt_test_write_outputs";
+	fs::remove_all(directory);
+	fs::create_directories(directory);
+	// the name leaves no room for the temporary file's, so the first target can't be
+	// replaced (not even by root), and it holds an older list of the same size
+	const fs::path first = directory / (std::string(250, 'a') + ".dat");
+	const std::string old_contents(4096, 'o');
+	const std::string contents(4096, 'n');
+	std::ofstream(first, std::ios::binary) << old_contents;
+	const std::vector<fs::path> targets{ first, directory / "b.dat", directory / "c.dat" };
+
+	std::vector<output_result> results{};
+	const std::vector<char> written = write_outputs(targets, contents, hash_bytes(contents), results);
+	TEST_ASSERT(written.size() == 3 && results.size() == 3);
+	TEST_CHECK(!written[0]);
+	TEST_CHECK(read_file(first) == old_contents);
+	for (std::size_t i = 1; i < targets.size(); ++i) {
+		TEST_CHECK(written[i] && results[i].written);
+		TEST_CHECK(results[i].hash == hash_bytes(contents));
+		TEST_CHECK_(read_file(targets[i]) == contents, "%s", targets[i].string().c_str());
+	}
+
+	// with the first one written the others are copies of it
+	const std::vector<fs::path> fine{ directory / "d.dat", directory / "e.dat" };
+	const std::vector<char> all = write_outputs(fine, contents, hash_bytes(contents), results);
+	TEST_CHECK(all[0] && all[1]);
+	TEST_CHECK(read_file(fine[1]) == contents);
+	fs::remove_all(directory);
+}
+
+TEST_LIST = {
+   { "Hash - xxh64", test_hash_xxh64 },
+   { "Atomic output - replace", test_atomic_output_replace },
+   { "Atomic output - permissions", test_atomic_output_permissions },
+   { "Atomic output - unchanged", test_atomic_output_unchanged },
+   { "Atomic output - discard", test_atomic_output_discard },
+   { "Atomic output - copy", test_atomic_output_copy },
+   { "Atomic output - start from", test_atomic_output_start_from },
+   { "Write outputs - failed first target", test_write_outputs_failed_first },
+   { NULL, NULL }
+};
@@ -0,0 +1,98 @@
+#include "acutest.h"
+#include "parse_cache.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static fs::path fresh_directory(const char* name) {
+	const fs::path directory = fs::temp_directory_path() / name;
+	fs::remove_all(directory);
+	return directory;
+}
+
+void test_parse_cache_entries(void) {
+	const fs::path directory = fresh_directory("enbt_test_parse_cache");
+	const parse_cache cache(directory / "nested");
+	TEST_ASSERT(cache.is_open());
+
+	parse_cache::entry missing{};
+	TEST_CHECK(!cache.load(1, "format=csv", missing));
+
+	const std::string nbt("\x0a\x00\x00\x09\x00\x07servers\x0a\x00\x00\x00\x00\x00", 18);
+	TEST_CHECK(cache.store(1, "format=csv", 3, nbt));
+	parse_cache::entry found{};
+	TEST_ASSERT(cache.load(1, "format=csv", found));
+	TEST_CHECK(found.server_count == 3);
+	TEST_CHECK(found.bytes == nbt);
+
+	// another input or other options miss
+	parse_cache::entry other{};
+	TEST_CHECK(!cache.load(2, "format=csv", other));
+	TEST_CHECK(!cache.load(1, "format=json", other));
+
+	// storing again replaces the entry
+	TEST_CHECK(cache.store(1, "format=csv", 0, ""));
+	parse_cache::entry replaced{};
+	TEST_ASSERT(cache.load(1, "format=csv", replaced));
+	TEST_CHECK(replaced.server_count == 0 && replaced.bytes.empty());
+
+	// a damaged entry is a miss
+	for (const fs::directory_entry& file : fs::directory_iterator(directory / "nested"))
+		fs::resize_file(file.path(), 20);
+	parse_cache::entry damaged{};
+	TEST_CHECK(!cache.load(1, "format=csv", damaged));
+	fs::remove_all(directory);
+}
+
+void test_parse_cache_input_hashes(void) {
+	const fs::path directory = fresh_directory("enbt_test_parse_cache_inputs");
+	const parse_cache cache(directory);
+	TEST_ASSERT(cache.is_open());
+	const fs::path input = fs::temp_directory_path() / "enbt_test_parse_cache_input.csv";
+	std::ofstream(input, std::ios::binary) << "A,,1.2.3.4,1\n";
+
+	// just written, so its time can't be trusted yet
+	parse_cache::file_stamp stamp{};
+	std::uint64_t hash = 0;
+	TEST_CHECK(!cache.known_hash(input, stamp, hash));
+	TEST_CHECK(stamp.size == 13);
+	cache.remember_hash(input, stamp, 42);
+	TEST_CHECK(!cache.known_hash(input, stamp, hash));
+
+	fs::last_write_time(input, fs::last_write_time(input) - std::chrono::seconds(60));
+	TEST_CHECK(!cache.known_hash(input, stamp, hash));
+	cache.remember_hash(input, stamp, 42);
+	TEST_CHECK(cache.known_hash(input, stamp, hash));
+	TEST_CHECK(hash == 42);
+
+	// a new time or size means hashing the input again
+	fs::last_write_time(input, fs::last_write_time(input) + std::chrono::seconds(5));
+	TEST_CHECK(!cache.known_hash(input, stamp, hash));
+	cache.remember_hash(input, stamp, 43);
+	std::ofstream(input, std::ios::binary | std::ios::app) << "B,,5.6.7.8,0\n";
+	fs::last_write_time(input, fs::file_time_type{ fs::file_time_type::duration(stamp.time) });
+	TEST_CHECK(!cache.known_hash(input, stamp, hash));
+
+	TEST_CHECK(!cache.known_hash(fs::temp_directory_path() / "enbt_test_parse_cache_missing.csv", stamp, hash));
+	fs::remove(input);
+	fs::remove_all(directory);
+}
+
+void test_parse_cache_unusable(void) {
+	const fs::path file = fs::temp_directory_path() / "enbt_test_parse_cache_file";
+	std::ofstream(file, std::ios::binary) << "not a directory";
+	const parse_cache cache(file);
+	TEST_CHECK(!cache.is_open());
+	TEST_CHECK(!cache.error().empty());
+	fs::remove(file);
+}
+
+TEST_LIST = {
+   { "Parse cache - entries", test_parse_cache_entries },
+   { "Parse cache - input hashes", test_parse_cache_input_hashes },
+   { "Parse cache - unusable", test_parse_cache_unusable },
+   { NULL, NULL }
+};
@@ -0,0 +1,253 @@
+#include "acutest.h"
+#include "ping.hpp"
+#include "ping_cache.hpp"
+#include <filesystem>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::string varint(std::uint32_t value) {
+	std::string out;
+	do {
+		auto byte = static_cast<unsigned char>(value & 0x7f);
+		value >>= 7;
+		out += static_cast<char>(value ? byte | 0x80 : byte);
+	} while (value);
+	return out;
+}
+
+static std::string status_response(const std::string& json) {
+	const std::string packet = varint(0x00) + varint(static_cast<std::uint32_t>(json.size())) + json;
+	return varint(static_cast<std::uint32_t>(packet.size())) + packet;
+}
+
+static int loopback_socket(std::uint16_t& port) {
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	bind(fd, reinterpret_cast<sockaddr*>(&address), length);
+	getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+	port = ntohs(address.sin_port);
+	return fd;
+}
+
+// A fake server on 127.0.0.1 that answers every connection the same way
+class fake_responder {
+public:
+	enum class mode { status, silent, garbage };
+
+	explicit fake_responder(mode behaviour, std::string json = {}) : behaviour(behaviour), response(status_response(json)) {
+		listener = loopback_socket(port);
+		listen(listener, 128);
+		server = std::thread([this] { serve(); });
+	}
+	~fake_responder() {
+		shutdown(listener, SHUT_RDWR); // wakes accept
+		server.join();
+		close(listener);
+		for (const int fd : held)
+			close(fd);
+	}
+
+	std::string address() const { return "127.0.0.1:" + std::to_string(port); }
+
+	std::uint16_t port = 0;
+	std::atomic<int> connections{0};
+	std::string last_request;
+
+private:
+	void serve() {
+		for (int client; (client = accept(listener, nullptr, nullptr)) >= 0;) {
+			++connections;
+			if (behaviour == mode::silent) {
+				held.push_back(client);
+				continue;
+			}
+			// handshake then status request, which ends the handshake's next state 1 with 01 00
+			std::string request;
+			char buffer[512];
+			while (!request.ends_with(std::string_view("\x01\x01\x00", 3))) {
+				const ssize_t got = recv(client, buffer, sizeof(buffer), 0);
+				if (got <= 0)
+					break;
+				request.append(buffer, static_cast<std::size_t>(got));
+			}
+			last_request = request;
+			if (behaviour == mode::garbage) {
+				send(client, "hello\n", 6, MSG_NOSIGNAL);
+			} else {
+				// in two parts, so the client sees a partial packet first
+				send(client, response.data(), 3, MSG_NOSIGNAL);
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				send(client, response.data() + 3, response.size() - 3, MSG_NOSIGNAL);
+			}
+			close(client);
+		}
+	}
+
+	mode behaviour;
+	std::string response;
+	int listener = -1;
+	std::vector<int> held;
+	std::thread server;
+};
+
+static const std::string lobby_json = R"({"version":{"name":"1.21","protocol":767},"players":{"max":20,"online":3},)"
+	R"("description":{"text":"§aLobby §lEU","extra":[{"text":"\n  mini games "}]},"favicon":"data:image/png;base64,iVBO\nRw0K"})";
+
+void test_ping_protocol(void) {
+	const std::string request = status_request("localhost", 25565);
+	TEST_CHECK(request == std::string("\x13\x00\xff\xff\xff\xff\x0f\x09localhost\x63\xdd\x01\x01\x00", 22));
+
+	const std::string response = status_response(R"({"description":"hi"})");
+	std::string_view json{};
+	for (std::size_t size = 0; size < response.size(); ++size)
+		TEST_CHECK(read_status_response(response.substr(0, size), json) == response_frame::incomplete);
+	TEST_CHECK(read_status_response(response, json) == response_frame::complete);
+	TEST_CHECK(json == R"({"description":"hi"})");
+
+	std::string other_packet = response;
+	other_packet[1] = 0x01;
+	TEST_CHECK(read_status_response(other_packet, json) == response_frame::invalid);
+	TEST_CHECK(read_status_response("\xff\xff\xff\xff\xff\x01", json) == response_frame::invalid);
+	TEST_CHECK(read_status_response(std::string_view("\x04\x00\x09{}", 5), json) == response_frame::invalid); // text longer than the packet
+}
+
+void test_ping_status_json(void) {
+	ping_result result{};
+	TEST_CHECK(parse_status_json(lobby_json, result));
+	TEST_CHECK(result.motd == "Lobby EU mini games");
+	TEST_CHECK(result.favicon == "iVBORw0K");
+
+	ping_result plain{};
+	TEST_CHECK(parse_status_json(R"({"description":"A  Minecraft Server","favicon":"data:image/jpeg;base64,/9j/"})", plain));
+	TEST_CHECK(plain.motd == "A Minecraft Server");
+	TEST_CHECK(plain.favicon.empty());
+
+	ping_result empty{};
+	TEST_CHECK(parse_status_json("{}", empty));
+	TEST_CHECK(empty.motd.empty() && empty.favicon.empty());
+	TEST_CHECK(!parse_status_json("[1, 2]", empty));
+	TEST_CHECK(!parse_status_json("{\"description\":", empty));
+}
+
+void test_ping_addresses(void) {
+	fake_responder lobby(fake_responder::mode::status, lobby_json);
+	fake_responder silent(fake_responder::mode::silent);
+	fake_responder garbage(fake_responder::mode::garbage);
+	std::uint16_t closed_port = 0;
+	close(loopback_socket(closed_port)); // nothing listens there
+
+	const std::vector<std::string> addresses{lobby.address(), silent.address(), garbage.address(),
+		"127.0.0.1:" + std::to_string(closed_port), "300.1.1.1"};
+	const auto started = std::chrono::steady_clock::now();
+	const std::vector<ping_result> results = ping_addresses(addresses, { .concurrency = 10, .timeout = std::chrono::milliseconds(300) });
+	const auto took = std::chrono::steady_clock::now() - started;
+	TEST_ASSERT(results.size() == addresses.size());
+	TEST_CHECK(results[0].status == ping_status::ok);
+	TEST_CHECK(results[0].motd == "Lobby EU mini games");
+	TEST_CHECK(results[0].favicon == "iVBORw0K");
+	TEST_CHECK(results[1].status == ping_status::timeout);
+	TEST_CHECK(results[2].status == ping_status::bad_response);
+	TEST_CHECK(results[3].status == ping_status::unreachable);
+	TEST_CHECK(results[4].status == ping_status::unresolved);
+	// one timeout, the others don't wait for it
+	TEST_CHECK(took < std::chrono::milliseconds(2000));
+
+	// the handshake names the address without its port
+	TEST_CHECK(lobby.last_request.substr(7, 10) == std::string("\x09" "127.0.0.1"));
+}
+
+void test_ping_concurrency(void) {
+	fake_responder lobby(fake_responder::mode::status, lobby_json);
+	const std::vector<std::string> addresses(40, lobby.address());
+	const std::vector<ping_result> results = ping_addresses(addresses, { .concurrency = 4, .timeout = std::chrono::milliseconds(2000) });
+	std::size_t answered = 0;
+	for (const ping_result& result : results)
+		answered += result.status == ping_status::ok;
+	TEST_CHECK(answered == addresses.size());
+	TEST_CHECK(lobby.connections == 40);
+}
+
+void test_ping_servers(void) {
+	fake_responder lobby(fake_responder::mode::status, lobby_json);
+	std::vector<nbtserver> servers{
+		{ .icon = "", .ip = lobby.address(), .name = "", .accept_textures = false },
+		{ .icon = "", .ip = lobby.address(), .name = "Mine", .accept_textures = false },
+		{ .icon = "aWNvbg==", .ip = "127.0.0.1:1", .name = "Complete", .accept_textures = false },
+	};
+	const ping_stats stats = ping_servers(servers, {});
+	TEST_CHECK(stats.pinged == 1); // one address, the complete server isn't pinged
+	TEST_CHECK(lobby.connections == 1);
+	TEST_CHECK(stats.statuses[static_cast<std::size_t>(ping_status::ok)] == 1);
+	TEST_CHECK(stats.names == 1 && stats.icons == 2);
+	TEST_CHECK(servers[0].name == "Lobby EU mini games" && servers[0].icon == "iVBORw0K");
+	TEST_CHECK(servers[1].name == "Mine" && servers[1].icon == "iVBORw0K");
+	TEST_CHECK(servers[2].name == "Complete" && servers[2].icon == "aWNvbg==");
+}
+
+void test_ping_servers_cached(void) {
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "enbt_test_ping_servers.cache";
+	std::filesystem::remove(path);
+	fake_responder lobby(fake_responder::mode::status, lobby_json);
+	std::uint16_t closed_port = 0;
+	close(loopback_socket(closed_port));
+	const auto servers = [&]() {
+		return std::vector<nbtserver>{
+			{ .icon = "", .ip = lobby.address(), .name = "", .accept_textures = false },
+			{ .icon = "", .ip = "127.0.0.1:" + std::to_string(closed_port), .name = "", .accept_textures = false },
+		};
+	};
+
+	// with no time to live the results are stored already expired, so they're pinged again
+	ping_options expiring{};
+	expiring.ttl = std::chrono::seconds(0);
+	expiring.negative_ttl = std::chrono::seconds(0);
+	std::vector<nbtserver> first = servers();
+	{
+		ping_cache cache(path);
+		const ping_stats stats = ping_servers(first, expiring, &cache);
+		TEST_CHECK(stats.pinged == 2 && stats.cached == 0);
+		TEST_CHECK(cache.flush());
+	}
+	std::vector<nbtserver> second = servers();
+	{
+		ping_cache cache(path);
+		const ping_stats stats = ping_servers(second, {}, &cache);
+		TEST_CHECK(stats.pinged == 2 && stats.cached == 0);
+		TEST_CHECK(cache.flush());
+	}
+	TEST_CHECK(lobby.connections == 2);
+
+	// the answer and the failure both come from the cache now
+	std::vector<nbtserver> third = servers();
+	ping_cache cache(path);
+	const ping_stats stats = ping_servers(third, {}, &cache);
+	TEST_CHECK(stats.pinged == 0 && stats.cached == 2);
+	TEST_CHECK(stats.statuses[static_cast<std::size_t>(ping_status::ok)] == 1);
+	TEST_CHECK(stats.statuses[static_cast<std::size_t>(ping_status::unreachable)] == 1);
+	TEST_CHECK(lobby.connections == 2);
+	TEST_CHECK(third[0].name == "Lobby EU mini games" && third[0].icon == "iVBORw0K");
+	TEST_CHECK(third[1].name.empty());
+
+	TEST_CHECK(ping_cache_key("Play.Example.NET:25565") == "play.example.net");
+	TEST_CHECK(ping_cache_key("not an address!") == "not an address!");
+}
+
+TEST_LIST = {
+   { "Ping - protocol", test_ping_protocol },
+   { "Ping - status json", test_ping_status_json },
+   { "Ping - addresses", test_ping_addresses },
+   { "Ping - concurrency", test_ping_concurrency },
+   { "Ping - servers", test_ping_servers },
+   { "Ping - servers cached", test_ping_servers_cached },
+   { NULL, NULL }
+};
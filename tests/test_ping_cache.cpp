@@ -0,0 +1,125 @@
+#include "acutest.h"
+#include "ping_cache.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static fs::path cache_path(const char* name) {
+	const fs::path path = fs::temp_directory_path() / name;
+	fs::remove(path);
+	return path;
+}
+
+static ping_result answer(const std::string& motd, const std::string& favicon = "iVBORw0K") {
+	return ping_result{ .status = ping_status::ok, .latency_ms = 42, .motd = motd, .favicon = favicon };
+}
+
+void test_ping_cache_entries(void) {
+	const fs::path path = cache_path("enbt_test_ping.cache");
+	{
+		ping_cache cache(path);
+		TEST_ASSERT(cache.is_open());
+		ping_result result{};
+		TEST_CHECK(!cache.lookup("play.example.net", 1000, result));
+		cache.store("play.example.net", answer("Lobby"), 1000, 2000);
+		cache.store("10.0.0.1", ping_result{ .status = ping_status::timeout, .latency_ms = 0, .motd = "", .favicon = "" }, 1000, 1100);
+		cache.store("play.example.net", answer("Lobby 2"), 1000, 2000); // replaces the queued one
+		TEST_CHECK(cache.flush());
+		TEST_CHECK(cache.size() == 2);
+		TEST_CHECK(cache.lookup("play.example.net", 1500, result));
+		TEST_CHECK(result.motd == "Lobby 2");
+	}
+
+	ping_cache cache(path);
+	TEST_ASSERT(cache.is_open());
+	TEST_CHECK(cache.size() == 2);
+	ping_result result{};
+	TEST_CHECK(cache.lookup("play.example.net", 1999, result));
+	TEST_CHECK(result.status == ping_status::ok && result.latency_ms == 42 && result.motd == "Lobby 2" && result.favicon == "iVBORw0K");
+	TEST_CHECK(!cache.lookup("play.example.net", 2000, result)); // expired
+	ping_result failed{};
+	TEST_CHECK(cache.lookup("10.0.0.1", 1050, failed));
+	TEST_CHECK(failed.status == ping_status::timeout);
+	TEST_CHECK(!cache.lookup("10.0.0.1", 1100, failed));
+	TEST_CHECK(!cache.lookup("10.0.0.2", 1050, failed));
+
+	// a small update goes in place
+	const auto size = fs::file_size(path);
+	cache.store("10.0.0.1", answer("Back"), 3000, 4000);
+	cache.store("10.0.0.3", answer("New"), 3000, 4000);
+	TEST_CHECK(cache.flush());
+	TEST_CHECK(cache.size() == 3);
+	TEST_CHECK(fs::file_size(path) > size);
+	TEST_CHECK(cache.lookup("10.0.0.1", 3500, result) && result.motd == "Back");
+
+	ping_cache reopened(path);
+	TEST_CHECK(reopened.size() == 3);
+	TEST_CHECK(reopened.lookup("10.0.0.3", 3500, result) && result.motd == "New");
+	TEST_CHECK(reopened.lookup("play.example.net", 1500, result) && result.motd == "Lobby 2");
+}
+
+void test_ping_cache_growth(void) {
+	const fs::path path = cache_path("enbt_test_ping_growth.cache");
+	{
+		ping_cache cache(path);
+		// in several flushes, so the index fills up and is rewritten bigger on the way
+		for (int round = 0; round < 5; ++round) {
+			for (int i = 0; i < 1000; ++i)
+				cache.store("host" + std::to_string(round * 1000 + i), answer("motd " + std::to_string(round * 1000 + i)), 100, 200);
+			TEST_CHECK(cache.flush());
+		}
+		TEST_CHECK(cache.size() == 5000);
+	}
+	ping_cache cache(path);
+	TEST_CHECK(cache.size() == 5000);
+	std::size_t found = 0;
+	for (int i = 0; i < 5000; ++i) {
+		ping_result result{};
+		found += cache.lookup("host" + std::to_string(i), 150, result) && result.motd == "motd " + std::to_string(i);
+	}
+	TEST_CHECK(found == 5000);
+}
+
+void test_ping_cache_compaction(void) {
+	const fs::path path = cache_path("enbt_test_ping_compact.cache");
+	ping_cache cache(path);
+	const std::string favicon(100000, 'A');
+	// the same ten entries over and over, so most of the file becomes dead
+	for (int round = 0; round < 10; ++round) {
+		for (int i = 0; i < 10; ++i)
+			cache.store("host" + std::to_string(i), answer("round " + std::to_string(round), favicon), round, 1000);
+		TEST_CHECK(cache.flush());
+	}
+	TEST_CHECK(fs::file_size(path) < 3 * 10 * favicon.size());
+	ping_result result{};
+	TEST_CHECK(cache.lookup("host7", 500, result) && result.motd == "round 9" && result.favicon.size() == favicon.size());
+}
+
+void test_ping_cache_foreign_file(void) {
+	const fs::path path = cache_path("enbt_test_ping_foreign.cache");
+	std::ofstream(path, std::ios::binary) << "servers,,play.example.net,1\n";
+	ping_cache cache(path);
+	TEST_CHECK(!cache.is_open());
+	TEST_CHECK(fs::file_size(path) == 28);
+
+	// ours, but broken: started over
+	const fs::path broken = cache_path("enbt_test_ping_broken.cache");
+	std::ofstream(broken, std::ios::binary) << std::string("ENBTPNG\x01garbage", 15);
+	ping_cache restarted(broken);
+	TEST_ASSERT(restarted.is_open());
+	TEST_CHECK(restarted.size() == 0);
+	restarted.store("a", answer("A"), 1, 2);
+	TEST_CHECK(restarted.flush());
+	ping_result result{};
+	TEST_CHECK(ping_cache(broken).lookup("a", 1, result));
+}
+
+TEST_LIST = {
+   { "Ping cache - entries", test_ping_cache_entries },
+   { "Ping cache - growth", test_ping_cache_growth },
+   { "Ping cache - compaction", test_ping_cache_compaction },
+   { "Ping cache - foreign file", test_ping_cache_foreign_file },
+   { NULL, NULL }
+};
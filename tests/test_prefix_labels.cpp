@@ -0,0 +1,202 @@
+#include "acutest.h"
+#include "prefix_labels.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static fs::path write_labels(const char* name, const std::string& text) {
+	const fs::path path = fs::temp_directory_path() / name;
+	fs::remove(path);
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	fs::remove(cache_path);
+	std::ofstream(path, std::ios::binary) << text;
+	return path;
+}
+
+static void remove_labels(const fs::path& path) {
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	fs::remove(path);
+	fs::remove(cache_path);
+}
+
+static server_address address(const char* text) {
+	server_address parsed{};
+	TEST_CHECK(parse_address(text, parsed) == address_error::none);
+	return parsed;
+}
+
+void test_prefix_labels_lookup(void) {
+	const fs::path path = write_labels("enbt_test_prefix_labels.csv",
+		"network,label\n"
+		"# comment\n"
+		"10.0.0.0/8,DE|Hetzner\n"
+		"10.20.0.0/16,FI|Hetzner\r\n" // inside 10/8, wins there
+		"10.20.30.0/24,DE|Hetzner\n" // inside both, same label as the outer one
+		"10.1.2.3/16,\"US|Example, Inc.\"\n" // host bits are dropped
+		"203.0.113.5,NL|Single\n"
+		"203.0.113.5/32,NL|Listed again\n" // the later label wins
+		"0.0.0.0/0,ZZ|Anywhere\n"
+		"2001:db8::/32,FR|OVH\n"
+		"2001:db8:1::/48,FR|OVH #2\n");
+	const prefix_labels labels(path);
+	TEST_ASSERT(labels.is_open());
+	TEST_CHECK(!labels.cached());
+	TEST_CHECK(labels.label_count() == 8);
+
+	TEST_CHECK(labels.lookup(address("10.0.0.0")) == "DE|Hetzner");
+	TEST_CHECK(labels.lookup(address("10.19.255.255")) == "DE|Hetzner");
+	TEST_CHECK(labels.lookup(address("10.20.0.0")) == "FI|Hetzner");
+	TEST_CHECK(labels.lookup(address("10.20.30.7:25566")) == "DE|Hetzner");
+	TEST_CHECK(labels.lookup(address("10.20.31.0")) == "FI|Hetzner");
+	TEST_CHECK(labels.lookup(address("10.21.0.0")) == "DE|Hetzner");
+	TEST_CHECK(labels.lookup(address("10.1.200.1")) == "US|Example, Inc.");
+	TEST_CHECK(labels.lookup(address("10.255.255.255")) == "DE|Hetzner");
+	TEST_CHECK(labels.lookup(address("203.0.113.5")) == "NL|Listed again");
+	TEST_CHECK(labels.lookup(address("203.0.113.6")) == "ZZ|Anywhere");
+	TEST_CHECK(labels.lookup(address("0.0.0.0")) == "ZZ|Anywhere");
+	TEST_CHECK(labels.lookup(address("255.255.255.255")) == "ZZ|Anywhere");
+	TEST_CHECK(labels.lookup(address("::ffff:10.20.0.1")) == "FI|Hetzner"); // IPv4-mapped
+	TEST_CHECK(labels.lookup(address("[2001:db8:ffff::1]:25565")) == "FR|OVH");
+	TEST_CHECK(labels.lookup(address("2001:db8:1::1")) == "FR|OVH #2");
+	TEST_CHECK(labels.lookup(address("2001:db9::")).empty());
+	TEST_CHECK(labels.lookup(address("play.example.net")).empty());
+
+	std::vector<nbtserver> servers{
+		{ .icon = "", .ip = "10.20.0.9", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "10.20.0.9", .name = "Named", .accept_textures = false },
+		{ .icon = "", .ip = "[2001:db8::5]:25566", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "play.example.net", .name = "", .accept_textures = false },
+		{ .icon = "", .ip = "not an address!", .name = "", .accept_textures = false },
+	};
+	TEST_CHECK(labels.name_servers(servers, "[{label}] {ip}") == 2);
+	TEST_CHECK(servers[0].name == "[FI|Hetzner] 10.20.0.9");
+	TEST_CHECK(servers[1].name == "Named");
+	TEST_CHECK(servers[2].name == "[FR|OVH] [2001:db8::5]:25566");
+	TEST_CHECK(servers[3].name.empty() && servers[4].name.empty());
+
+	nbtserver plain{ .icon = "", .ip = "203.0.113.5", .name = "", .accept_textures = false };
+	TEST_CHECK(labels.name(plain, "{label} {x}"));
+	TEST_CHECK(plain.name == "NL|Listed again {x}");
+	remove_labels(path);
+}
+
+void test_prefix_labels_cache(void) {
+	const fs::path path = write_labels("enbt_test_prefix_labels_cache.csv", "10.0.0.0/8,A\n10.1.0.0/16,B\n2001:db8::/32,C\n");
+	fs::path cache_path = path;
+	cache_path += ".cache";
+	{
+		const prefix_labels labels(path);
+		TEST_CHECK(labels.is_open() && !labels.cached());
+	}
+	TEST_CHECK(fs::exists(cache_path));
+	{
+		const prefix_labels labels(path);
+		TEST_CHECK(labels.is_open() && labels.cached());
+		TEST_CHECK(labels.size() == 4); // 10/8 split around 10.1/16, and the IPv6 one
+		TEST_CHECK(labels.label_count() == 3);
+		TEST_CHECK(labels.lookup(address("10.9.9.9")) == "A");
+		TEST_CHECK(labels.lookup(address("10.1.9.9")) == "B");
+		TEST_CHECK(labels.lookup(address("2001:db8::1")) == "C");
+		TEST_CHECK(labels.lookup(address("11.0.0.0")).empty());
+	}
+
+	// a changed file is compiled again
+	std::ofstream(path, std::ios::binary | std::ios::app) << "11.0.0.0/8,D\n";
+	{
+		const prefix_labels labels(path);
+		TEST_CHECK(labels.is_open() && !labels.cached());
+		TEST_CHECK(labels.lookup(address("11.0.0.0")) == "D");
+	}
+
+	// a damaged cache is ignored
+	fs::resize_file(cache_path, 100);
+	{
+		const prefix_labels labels(path);
+		TEST_CHECK(labels.is_open() && !labels.cached());
+		TEST_CHECK(labels.lookup(address("10.1.0.0")) == "B");
+	}
+	remove_labels(path);
+}
+
+void test_prefix_labels_errors(void) {
+	const fs::path bad_address = write_labels("enbt_test_prefix_labels_bad.csv", "10.0.0.0/8,A\n\n10.0.0/8,B\n");
+	const prefix_labels first(bad_address);
+	TEST_CHECK(!first.is_open());
+	TEST_CHECK(first.error().starts_with("line 3:"));
+	remove_labels(bad_address);
+
+	const fs::path bad_prefix = write_labels("enbt_test_prefix_labels_bad.csv", "10.0.0.0/33,A\n");
+	TEST_CHECK(!prefix_labels(bad_prefix).is_open());
+	remove_labels(bad_prefix);
+
+	const fs::path no_label = write_labels("enbt_test_prefix_labels_bad.csv", "10.0.0.0/8,A\n10.1.0.0/16, \n");
+	const prefix_labels second(no_label);
+	TEST_CHECK(!second.is_open());
+	TEST_CHECK(second.error().starts_with("line 2: missing label"));
+	remove_labels(no_label);
+
+	TEST_CHECK(!prefix_labels(fs::temp_directory_path() / "enbt_test_prefix_labels_missing.csv").is_open());
+}
+
+// Random nested prefixes against a scan for the longest one holding the address
+void test_prefix_labels_random(void) {
+	struct prefix {
+		std::uint32_t first;
+		std::uint32_t last;
+		unsigned bits;
+		std::string label;
+	};
+	std::mt19937 random(11);
+	std::vector<prefix> prefixes;
+	std::string text;
+	for (int i = 0; i < 5000; ++i) {
+		// crowded into 10/8, so they nest
+		const std::uint32_t ip = 0x0a000000 | (random() & 0x00ffffff);
+		const unsigned bits = 8 + random() % 25;
+		const std::uint32_t mask = ~std::uint32_t{0} << (32 - bits);
+		const std::string label = "L" + std::to_string(random() % 50);
+		prefixes.push_back({ ip & mask, ip | ~mask, bits, label });
+		text += std::to_string(ip >> 24) + '.' + std::to_string(ip >> 16 & 255) + '.' + std::to_string(ip >> 8 & 255) + '.'
+			+ std::to_string(ip & 255) + '/' + std::to_string(bits) + ',' + label + '\n';
+	}
+	const fs::path path = write_labels("enbt_test_prefix_labels_random.csv", text);
+	for (int pass = 0; pass < 2; ++pass) {
+		const prefix_labels labels(path);
+		TEST_ASSERT(labels.is_open());
+		TEST_CHECK(labels.cached() == (pass == 1));
+		std::size_t mismatches = 0;
+		for (int i = 0; i < 2000; ++i) {
+			// half of them at a prefix edge
+			std::uint32_t ip = 0x0a000000 | (random() & 0x00ffffff);
+			if (i % 2) {
+				const prefix& edge = prefixes[random() % prefixes.size()];
+				ip = i % 4 == 1 ? edge.first - 1 : edge.last + 1;
+			}
+			// longest, and the last one listed among equals
+			const prefix* best = nullptr;
+			for (const prefix& candidate : prefixes) {
+				if (candidate.first <= ip && ip <= candidate.last && (!best || candidate.bits >= best->bits))
+					best = &candidate;
+			}
+			server_address parsed{ .kind = address_kind::ipv4, .ipv4 = ip };
+			mismatches += labels.lookup(parsed) != (best ? std::string_view(best->label) : std::string_view());
+		}
+		TEST_CHECK(mismatches == 0);
+	}
+	remove_labels(path);
+}
+
+TEST_LIST = {
+   { "Prefix labels - lookup", test_prefix_labels_lookup },
+   { "Prefix labels - cache", test_prefix_labels_cache },
+   { "Prefix labels - errors", test_prefix_labels_errors },
+   { "Prefix labels - random", test_prefix_labels_random },
+   { NULL, NULL }
+};
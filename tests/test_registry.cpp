@@ -0,0 +1,197 @@
+#include "acutest.h"
+#include "registry.hpp"
+#include "static_servers.hpp"
+#include <array>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static constexpr std::array<static_server, 2> expected_servers{{
+	{ .name = "Renamed", .icon = "/9j/4AAQ", .ip = "192.168.1.1", .accept_textures = true },
+	{ .name = "Server Three", .icon = "", .ip = "play.example.net", .accept_textures = false },
+}};
+
+template <std::size_t N>
+static std::string as_string(const std::array<std::byte, N>& bytes) {
+	return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+static std::string export_registry(const server_registry& registry, std::endian endian) {
+	std::ostringstream out;
+	TEST_CHECK(registry.write_servers_dat(out, endian));
+	return std::move(out).str();
+}
+
+static void remove_registry(const fs::path& path) {
+	fs::remove(path);
+	fs::path index = path;
+	fs::remove(index += ".index");
+}
+
+static void fill(server_registry& registry) {
+	TEST_CHECK(registry.upsert({ .icon = "/9j/4AAQ", .ip = "192.168.1.1", .name = "Server One", .accept_textures = true }));
+	TEST_CHECK(registry.upsert({ .icon = "", .ip = "192.168.1.2", .name = "Server Two", .accept_textures = false }));
+	TEST_CHECK(registry.upsert({ .icon = "", .ip = "play.example.net", .name = "Server Three", .accept_textures = false }));
+	TEST_CHECK(registry.upsert({ .icon = "/9j/4AAQ", .ip = "192.168.1.1", .name = "Renamed", .accept_textures = true }));
+	TEST_CHECK(!registry.upsert({ .icon = "/9j/4AAQ", .ip = "192.168.1.1", .name = "Renamed", .accept_textures = true }));
+	TEST_CHECK(registry.erase("192.168.1.2"));
+	TEST_CHECK(!registry.erase("192.168.1.2"));
+}
+
+void test_registry_upsert_erase(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_registry.enbtr";
+	remove_registry(path);
+	{
+		server_registry registry(path);
+		TEST_CHECK(registry.is_open());
+		fill(registry);
+		TEST_CHECK(registry.size() == 2);
+		// unflushed records export the same as flushed ones
+		TEST_CHECK(export_registry(registry, std::endian::big) == as_string(make_servers_dat<expected_servers>()));
+		TEST_CHECK(registry.flush());
+	}
+	server_registry reopened(path);
+	TEST_CHECK(reopened.is_open());
+	TEST_CHECK(reopened.size() == 2);
+	TEST_CHECK(export_registry(reopened, std::endian::big) == as_string(make_servers_dat<expected_servers>()));
+	TEST_CHECK(export_registry(reopened, std::endian::little) == as_string(make_servers_dat<expected_servers, std::endian::little>()));
+	remove_registry(path);
+}
+
+void test_registry_torn_record(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_registry_torn.enbtr";
+	remove_registry(path);
+	{
+		server_registry registry(path);
+		fill(registry);
+		TEST_CHECK(registry.flush());
+	}
+	// an append that was cut short
+	const auto full_size = fs::file_size(path);
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::app);
+		out.write("\x01\x00\x07" "1.2.3.4\x00\x00", 12);
+	}
+	server_registry registry(path);
+	TEST_CHECK(registry.is_open());
+	TEST_CHECK(registry.size() == 2);
+	TEST_CHECK(registry.upsert({ .icon = "", .ip = "1.2.3.4", .name = "Late", .accept_textures = false }));
+	TEST_CHECK(registry.flush());
+	TEST_CHECK(registry.size() == 3);
+	TEST_CHECK(fs::file_size(path) > full_size);
+	server_registry reopened(path);
+	TEST_CHECK(reopened.size() == 3);
+	remove_registry(path);
+}
+
+void test_registry_compact(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_registry_compact.enbtr";
+	remove_registry(path);
+	server_registry registry(path);
+	fill(registry);
+	TEST_CHECK(registry.flush());
+	const auto log_size = registry.log_size();
+	TEST_CHECK(registry.live_size() < log_size);
+
+	TEST_CHECK(registry.compact());
+	TEST_CHECK(registry.log_size() < log_size);
+	TEST_CHECK(registry.log_size() == fs::file_size(path));
+	TEST_CHECK(registry.live_size() + 8 == registry.log_size());
+	TEST_CHECK(export_registry(registry, std::endian::big) == as_string(make_servers_dat<expected_servers>()));
+	remove_registry(path);
+}
+
+void test_registry_checkpoint(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_registry_checkpoint.enbtr";
+	fs::path index = path;
+	index += ".index";
+	remove_registry(path);
+	{
+		server_registry registry(path);
+		fill(registry);
+		TEST_CHECK(registry.compact());
+	}
+	TEST_CHECK(fs::exists(index));
+	const fs::path old_index = fs::temp_directory_path() / "enbt_test_registry_checkpoint.old";
+	fs::copy_file(index, old_index, fs::copy_options::overwrite_existing);
+
+	// changes after the checkpoint, to servers in it and to new ones
+	std::string expected;
+	{
+		server_registry registry(path);
+		TEST_CHECK(registry.size() == 2);
+		TEST_CHECK(export_registry(registry, std::endian::big) == as_string(make_servers_dat<expected_servers>()));
+		TEST_CHECK(registry.upsert({ .icon = "", .ip = "play.example.net", .name = "Changed", .accept_textures = true }));
+		TEST_CHECK(registry.erase("192.168.1.1"));
+		TEST_CHECK(!registry.erase("192.168.1.1"));
+		TEST_CHECK(registry.upsert({ .icon = "", .ip = "10.0.0.1", .name = "New", .accept_textures = false }));
+		TEST_CHECK(registry.upsert({ .icon = "", .ip = "192.168.1.1", .name = "Back", .accept_textures = false }));
+		TEST_CHECK(!registry.upsert({ .icon = "", .ip = "192.168.1.1", .name = "Back", .accept_textures = false }));
+		TEST_CHECK(registry.size() == 3);
+		TEST_CHECK(registry.flush());
+		expected = export_registry(registry, std::endian::big);
+	}
+	{
+		server_registry reopened(path);
+		TEST_CHECK(reopened.size() == 3);
+		TEST_CHECK(export_registry(reopened, std::endian::big) == expected);
+	}
+	// the log read in full gives the same
+	fs::remove(index);
+	{
+		server_registry unindexed(path);
+		TEST_CHECK(unindexed.size() == 3);
+		TEST_CHECK(export_registry(unindexed, std::endian::big) == expected);
+		TEST_CHECK(unindexed.compact());
+		TEST_CHECK(export_registry(unindexed, std::endian::big) == expected);
+	}
+	// a checkpoint of the log before it was compacted again is ignored
+	fs::copy_file(old_index, index, fs::copy_options::overwrite_existing);
+	{
+		server_registry stale(path);
+		TEST_CHECK(stale.size() == 3);
+		TEST_CHECK(export_registry(stale, std::endian::big) == expected);
+	}
+	fs::remove(old_index);
+	remove_registry(path);
+}
+
+void test_registry_checkpoint_on_flush(void) {
+	const fs::path path = fs::temp_directory_path() / "enbt_test_registry_growth.enbtr";
+	fs::path index = path;
+	index += ".index";
+	remove_registry(path);
+	std::string expected;
+	{
+		server_registry registry(path);
+		for (int i = 0; i < 3000; ++i)
+			registry.upsert({ .icon = "/9j/4AAQSkZJRgABAQIAJQAl", .ip = "10.0." + std::to_string(i / 256) + '.' + std::to_string(i % 256), .name = "Server " + std::to_string(i), .accept_textures = true });
+		TEST_CHECK(!fs::exists(index));
+		TEST_CHECK(registry.flush());
+		TEST_CHECK(fs::exists(index));
+		// a small change doesn't rewrite it
+		const auto checkpointed = fs::last_write_time(index);
+		TEST_CHECK(registry.erase("10.0.0.7"));
+		TEST_CHECK(registry.flush());
+		TEST_CHECK(fs::last_write_time(index) == checkpointed);
+		expected = export_registry(registry, std::endian::big);
+	}
+	server_registry reopened(path);
+	TEST_CHECK(reopened.size() == 2999);
+	TEST_CHECK(export_registry(reopened, std::endian::big) == expected);
+	remove_registry(path);
+}
+
+TEST_LIST = {
+   { "Registry - upsert and erase", test_registry_upsert_erase },
+   { "Registry - torn record", test_registry_torn_record },
+   { "Registry - compact", test_registry_compact },
+   { "Registry - checkpoint", test_registry_checkpoint },
+   { "Registry - checkpoint on flush", test_registry_checkpoint_on_flush },
+   { NULL, NULL }
+};
@@ -0,0 +1,112 @@
+#include "acutest.h"
+#include "sample.hpp"
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string csv_lines(std::size_t count) {
+	std::string csv;
+	for (std::size_t i = 0; i < count; ++i)
+		csv += "Server " + std::to_string(i) + ",," + std::to_string(i) + ".example.net," + std::to_string(i % 2) + '\n';
+	return csv;
+}
+
+static std::vector<nbtserver> numbered(std::size_t count) {
+	std::vector<nbtserver> servers;
+	for (std::size_t i = 0; i < count; ++i)
+		servers.push_back({ .icon = "", .ip = std::to_string(i), .name = "", .accept_textures = false });
+	return servers;
+}
+
+void test_sampler_uniform(void) {
+	// every item of 100 should be picked about as often as any other
+	std::vector<std::size_t> picks(100);
+	for (std::uint64_t seed = 0; seed < 2000; ++seed) {
+		reservoir_sampler sampler(10, seed);
+		std::vector<std::size_t> slots(10);
+		for (std::uint64_t position = sampler.next(); position < picks.size(); position = sampler.next())
+			slots[sampler.offer(position)] = static_cast<std::size_t>(position);
+		for (const std::size_t picked : slots)
+			++picks[picked];
+	}
+	// 200 expected for each
+	TEST_CHECK(*std::min_element(picks.begin(), picks.end()) > 130);
+	TEST_CHECK(*std::max_element(picks.begin(), picks.end()) < 270);
+
+	// items that aren't next() are skipped
+	reservoir_sampler sampler(3, 1);
+	TEST_CHECK(sampler.offer(1) == reservoir_sampler::npos);
+	TEST_CHECK(sampler.offer(0) == 0);
+	TEST_CHECK(sampler.offer(1) == 1);
+	TEST_CHECK(sampler.offer(2) == 2);
+	TEST_CHECK(sampler.next() >= 3);
+}
+
+void test_sample_servers(void) {
+	std::vector<nbtserver> servers = numbered(1000);
+	sample_servers(servers, 50, 42);
+	TEST_ASSERT(servers.size() == 50);
+	// input order, no repeats
+	TEST_CHECK(std::is_sorted(servers.begin(), servers.end(), [](const nbtserver& a, const nbtserver& b) { return std::stoi(a.ip) < std::stoi(b.ip); }));
+	TEST_CHECK(std::adjacent_find(servers.begin(), servers.end(), [](const nbtserver& a, const nbtserver& b) { return a.ip == b.ip; }) == servers.end());
+
+	std::vector<nbtserver> again = numbered(1000);
+	sample_servers(again, 50, 42);
+	TEST_CHECK(std::equal(servers.begin(), servers.end(), again.begin(), [](const nbtserver& a, const nbtserver& b) { return a.ip == b.ip; }));
+
+	std::vector<nbtserver> few = numbered(10);
+	sample_servers(few, 50, 42);
+	TEST_CHECK(few.size() == 10);
+}
+
+void test_sample_csv(void) {
+	// bigger than one read, so some lines are split across reads
+	std::string csv = "bad line\n,,\n" + csv_lines(60000) + "a,b,c,\nlast,,last.example.net,1";
+	std::istringstream input(csv);
+	sample_stats stats{};
+	const std::vector<nbtserver> servers = sample_csv(input, 1000, 7, {}, stats);
+	TEST_CHECK(stats.seen == 60001);
+	TEST_CHECK(stats.invalid == 3);
+	TEST_ASSERT(servers.size() == 1000);
+	std::size_t in_order = 0;
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		const nbtserver& server = servers[i];
+		if (server.name == "last") {
+			TEST_CHECK(server.ip == "last.example.net" && server.accept_textures);
+			continue;
+		}
+		const std::string number = server.name.substr(7);
+		TEST_CHECK(server.ip == number + ".example.net");
+		TEST_CHECK(server.icon.empty());
+		TEST_CHECK(server.accept_textures == (std::stoi(number) % 2 == 1));
+		in_order += i == 0 || servers[i - 1].name == "last" || std::stoi(servers[i - 1].name.substr(7)) < std::stoi(number);
+	}
+	TEST_CHECK(in_order == servers.size() - (servers.back().name == "last"));
+
+	// same seed, same sample
+	std::istringstream again(csv);
+	sample_stats again_stats{};
+	const std::vector<nbtserver> repeated = sample_csv(again, 1000, 7, {}, again_stats);
+	TEST_CHECK(std::equal(servers.begin(), servers.end(), repeated.begin(), repeated.end(), [](const nbtserver& a, const nbtserver& b) { return a.name == b.name; }));
+}
+
+void test_sample_csv_prepared(void) {
+	std::istringstream input(csv_lines(5000));
+	sample_stats stats{};
+	// only even servers make it through, the sample is taken from those
+	const std::vector<nbtserver> servers = sample_csv(input, 100, 3, [](std::vector<nbtserver>& batch) {
+		std::erase_if(batch, [](const nbtserver& server) { return server.accept_textures; });
+	}, stats);
+	TEST_CHECK(stats.seen == 2500);
+	TEST_ASSERT(servers.size() == 100);
+	TEST_CHECK(std::none_of(servers.begin(), servers.end(), [](const nbtserver& server) { return server.accept_textures; }));
+}
+
+TEST_LIST = {
+   { "Sample - uniform", test_sampler_uniform },
+   { "Sample - servers", test_sample_servers },
+   { "Sample - csv", test_sample_csv },
+   { "Sample - csv prepared", test_sample_csv_prepared },
+   { NULL, NULL }
+};
@@ -0,0 +1,158 @@
+#include "acutest.h"
+#include "hash.hpp"
+#include "shard.hpp"
+#include "static_servers.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static std::vector<nbtserver> make_servers(std::size_t count) {
+	std::vector<nbtserver> servers{};
+	for (std::size_t i = 0; i < count; ++i) {
+		servers.emplace_back(nbtserver{
+			.icon = "/9j/4AAQ",
+			.ip = "10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256),
+			.name = "Server" + std::to_string(i),
+			.accept_textures = true
+		});
+	}
+	return servers;
+}
+
+static std::uint64_t shard_bytes(const std::vector<nbtserver>& servers, const std::vector<std::size_t>& shard) {
+	std::uint64_t bytes = servers_dat_head_size + 1;
+	for (const std::size_t i : shard)
+		bytes += server_nbt_size(static_server{ .name = servers[i].name, .icon = servers[i].icon, .ip = servers[i].ip, .accept_textures = true });
+	return bytes;
+}
+
+static void check_complete(const std::vector<std::vector<std::size_t>>& shards, std::size_t count) {
+	std::vector<std::size_t> all{};
+	for (const auto& shard : shards) {
+		TEST_CHECK(std::is_sorted(shard.begin(), shard.end()));
+		all.insert(all.end(), shard.begin(), shard.end());
+	}
+	std::sort(all.begin(), all.end());
+	TEST_CHECK(all.size() == count);
+	for (std::size_t i = 0; i < all.size(); ++i)
+		TEST_CHECK(all[i] == i);
+}
+
+void test_shard_max_entries(void) {
+	const auto servers = make_servers(1000);
+	std::vector<std::vector<std::size_t>> shards{};
+	TEST_ASSERT(partition_servers(servers, shard_limits{ .max_entries = 300 }, shards));
+	TEST_CHECK(shards.size() == 4);
+	TEST_CHECK(shards[0].front() == 0 && shards[0].back() == 299);
+	TEST_CHECK(shards[3].size() == 100);
+	check_complete(shards, servers.size());
+}
+
+void test_shard_max_bytes(void) {
+	const auto servers = make_servers(1000);
+	const shard_limits limits{ .max_bytes = 8192 };
+	std::vector<std::vector<std::size_t>> shards{};
+	TEST_ASSERT(partition_servers(servers, limits, shards));
+	TEST_CHECK(shards.size() > 1);
+	for (const auto& shard : shards)
+		TEST_CHECK(shard_bytes(servers, shard) <= limits.max_bytes);
+	check_complete(shards, servers.size());
+}
+
+void test_shard_by_ip_hash(void) {
+	const auto servers = make_servers(1000);
+	const shard_limits limits{ .max_entries = 300, .max_bytes = 16384, .by_ip_hash = true };
+	std::vector<std::vector<std::size_t>> shards{};
+	TEST_ASSERT(partition_servers(servers, limits, shards));
+	for (const auto& shard : shards) {
+		TEST_CHECK(shard.size() <= limits.max_entries);
+		TEST_CHECK(shard_bytes(servers, shard) <= limits.max_bytes);
+	}
+	check_complete(shards, servers.size());
+	// stable between runs
+	std::vector<std::vector<std::size_t>> again{};
+	TEST_CHECK(partition_servers(servers, limits, again) && again == shards);
+}
+
+void test_shard_by_ip_hash_keeps_empty_shards(void) {
+	// few servers over many shards leave some of them empty, the others keep their index
+	for (std::size_t count = 2; count < 40; ++count) {
+		const auto servers = make_servers(count);
+		std::vector<std::vector<std::size_t>> shards{};
+		TEST_ASSERT(partition_servers(servers, shard_limits{ .max_entries = 1, .by_ip_hash = true }, shards));
+		TEST_CHECK(shards.size() >= count);
+		for (std::size_t k = 0; k < shards.size(); ++k) {
+			TEST_CHECK(shards[k].size() <= 1);
+			for (const std::size_t i : shards[k])
+				TEST_CHECK(hash_bytes(servers[i].ip) % shards.size() == k);
+		}
+		check_complete(shards, servers.size());
+	}
+}
+
+void test_shard_by_ip_hash_colliding(void) {
+	// two ips whose hashes fall in the same shard for the fewest shards and the next
+	// count, so only more shards than that part them
+	auto servers = make_servers(1000);
+	std::size_t other = 1;
+	const std::uint64_t first = hash_bytes(servers[0].ip);
+	while (hash_bytes(servers[other].ip) % 2 != first % 2 || hash_bytes(servers[other].ip) % 3 != first % 3)
+		++other;
+	servers = { servers[0], servers[other] };
+	std::vector<std::vector<std::size_t>> shards{};
+	TEST_ASSERT(partition_servers(servers, shard_limits{ .max_entries = 1, .by_ip_hash = true }, shards));
+	TEST_CHECK(shards.size() > 3);
+	for (const auto& shard : shards)
+		TEST_CHECK(shard.size() <= 1);
+	check_complete(shards, servers.size());
+}
+
+void test_shard_by_ip_hash_duplicate_ips(void) {
+	auto servers = make_servers(3);
+	servers[2].ip = servers[0].ip;
+	std::vector<std::vector<std::size_t>> shards{};
+	TEST_CHECK(!partition_servers(servers, shard_limits{ .max_entries = 1, .by_ip_hash = true }, shards));
+	TEST_CHECK(shards.empty());
+
+	// room for both of them
+	TEST_ASSERT(partition_servers(servers, shard_limits{ .max_entries = 2, .by_ip_hash = true }, shards));
+	for (const auto& shard : shards)
+		TEST_CHECK(shard.size() <= 2);
+	check_complete(shards, servers.size());
+}
+
+void test_shard_remove_stale(void) {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "enbt_test_shard_stale";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	const std::filesystem::path output = directory / "servers.dat";
+	for (const std::size_t index : { 0, 1, 2, 3, 5 })
+		std::ofstream(shard_path(output, index)) << "old";
+
+	const auto removed = remove_stale_shards(output, 2);
+	TEST_CHECK(removed.size() == 2);
+	TEST_CHECK(std::filesystem::exists(shard_path(output, 1)));
+	TEST_CHECK(!std::filesystem::exists(shard_path(output, 2)) && !std::filesystem::exists(shard_path(output, 3)));
+	// only the run right after the last shard is taken for leftovers
+	TEST_CHECK(std::filesystem::exists(shard_path(output, 5)));
+	std::filesystem::remove_all(directory);
+}
+
+void test_shard_path(void) {
+	TEST_CHECK(shard_path("some/dir/servers.dat", 3) == "some/dir/servers.3.dat");
+	TEST_CHECK(shard_path("list", 0) == "list.0");
+}
+
+TEST_LIST = {
+   { "Shard - max entries", test_shard_max_entries },
+   { "Shard - max bytes", test_shard_max_bytes },
+   { "Shard - by ip hash", test_shard_by_ip_hash },
+   { "Shard - by ip hash keeps empty shards", test_shard_by_ip_hash_keeps_empty_shards },
+   { "Shard - by ip hash colliding", test_shard_by_ip_hash_colliding },
+   { "Shard - by ip hash duplicate ips", test_shard_by_ip_hash_duplicate_ips },
+   { "Shard - remove stale", test_shard_remove_stale },
+   { "Shard - path", test_shard_path },
+   { NULL, NULL }
+};
@@ -0,0 +1,82 @@
+#include "acutest.h"
+#include "sort.hpp"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<nbtserver> sample_servers() {
+	return {
+		{ .icon = "", .ip = "10.0.0.2", .name = "bravo", .accept_textures = true },
+		{ .icon = "", .ip = "9.0.0.1", .name = "Alpha", .accept_textures = true },
+		{ .icon = "", .ip = "play.example.net", .name = "charlie", .accept_textures = true },
+		{ .icon = "", .ip = "10.0.0.2:25566", .name = "alpha", .accept_textures = true },
+		{ .icon = "", .ip = "[::1]:25565", .name = "delta", .accept_textures = true },
+		{ .icon = "", .ip = "9.0.0.1", .name = "echo", .accept_textures = true },
+	};
+}
+
+static std::vector<std::uint32_t> order_of(sort_key key, bool reverse) {
+	return sort_order(sample_servers(), key, reverse);
+}
+
+void test_sort_name(void) {
+	TEST_CHECK((order_of(sort_key::name, false) == std::vector<std::uint32_t>{1, 3, 0, 2, 4, 5}));
+	// equal names keep their input order when reversed too
+	TEST_CHECK((order_of(sort_key::name, true) == std::vector<std::uint32_t>{5, 4, 2, 0, 1, 3}));
+}
+
+void test_sort_ip(void) {
+	TEST_CHECK((order_of(sort_key::ip, false) == std::vector<std::uint32_t>{0, 3, 1, 5, 4, 2}));
+}
+
+void test_sort_addr(void) {
+	TEST_CHECK((order_of(sort_key::addr, false) == std::vector<std::uint32_t>{1, 5, 0, 3, 4, 2}));
+	TEST_CHECK((order_of(sort_key::addr, true) == std::vector<std::uint32_t>{2, 4, 3, 0, 1, 5}));
+}
+
+void test_sort_large(void) {
+	// big enough for the parallel paths and radix buckets
+	std::mt19937 random(42);
+	std::vector<nbtserver> servers(100000);
+	for (std::size_t i = 0; i < servers.size(); ++i) {
+		const std::uint32_t address = random() % 50000;
+		servers[i].ip = std::to_string(address >> 8 & 255) + '.' + std::to_string(address & 255) + ".0.1";
+		servers[i].name = "server " + std::to_string(random() % 1000);
+		servers[i].accept_textures = false;
+	}
+
+	const auto check = [&](sort_key key, bool reverse, auto less) {
+		std::vector<std::uint32_t> expected(servers.size());
+		for (std::size_t i = 0; i < expected.size(); ++i)
+			expected[i] = static_cast<std::uint32_t>(i);
+		std::stable_sort(expected.begin(), expected.end(), [&](std::uint32_t a, std::uint32_t b) {
+			return reverse ? less(servers[b], servers[a]) : less(servers[a], servers[b]);
+		});
+		TEST_CHECK(sort_order(servers, key, reverse) == expected);
+	};
+	const auto by_name = [](const nbtserver& a, const nbtserver& b) { return a.name < b.name; };
+	for (nbtserver& server : servers)
+		parse_address(server.ip, server.address);
+	const auto by_addr = [](const nbtserver& a, const nbtserver& b) { return a.address.ipv4 < b.address.ipv4; };
+	check(sort_key::name, false, by_name);
+	check(sort_key::name, true, by_name);
+	check(sort_key::addr, false, by_addr);
+	check(sort_key::addr, true, by_addr);
+}
+
+void test_apply_order(void) {
+	std::vector<nbtserver> servers = sample_servers();
+	apply_order(servers, {5, 4, 3, 2, 1, 0});
+	TEST_CHECK(servers.size() == 6);
+	TEST_CHECK(servers[0].name == "echo" && servers[5].name == "bravo");
+}
+
+TEST_LIST = {
+   { "Sort - name", test_sort_name },
+   { "Sort - ip", test_sort_ip },
+   { "Sort - addr", test_sort_addr },
+   { "Sort - large input", test_sort_large },
+   { "Sort - apply order", test_apply_order },
+   { NULL, NULL }
+};
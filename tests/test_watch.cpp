@@ -0,0 +1,183 @@
+#include "acutest.h"
+#include "watch.hpp"
+#include "static_servers.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static fs::path fresh_directory(const char* name) {
+	const fs::path directory = fs::temp_directory_path() / name;
+	fs::remove_all(directory);
+	fs::create_directories(directory);
+	return directory;
+}
+
+static std::string encode(const std::vector<nbtserver>& servers) {
+	std::string out(servers_dat_head_size, '\0');
+	encode_servers_dat_head(reinterpret_cast<std::byte*>(out.data()), static_cast<std::uint32_t>(servers.size()));
+	for (const nbtserver& server : servers) {
+		const static_server view{ .name = server.name, .icon = server.icon, .ip = server.ip, .accept_textures = server.accept_textures };
+		const std::size_t at = out.size();
+		out.resize(at + server_nbt_size(view));
+		encode_server_nbt(reinterpret_cast<std::byte*>(out.data() + at), view);
+	}
+	out += NBT::idEnd;
+	return out;
+}
+
+void test_watch_incremental_csv(void) {
+	const fs::path directory = fresh_directory("enbt_test_watch_csv");
+	const fs::path input = directory / "servers.csv";
+	std::ofstream(input, std::ios::binary) << "A,,1.1.1.1,1\nB,,2.2.2.2,0\nbroken\nC,,3.3.3.3,1\n";
+
+	std::size_t prepared = 0;
+	const incremental_servers::stage prepare = [&](std::vector<nbtserver>& servers) {
+		prepared += servers.size();
+		for (nbtserver& server : servers)
+			server.name += "!";
+		return true;
+	};
+	incremental_servers servers(std::endian::big);
+	incremental_servers::update_stats stats = servers.update({ { input, "csv" } }, prepare);
+	TEST_CHECK(stats.files == 1 && stats.parsed == 4 && stats.reused == 0 && stats.invalid == 1);
+	TEST_CHECK(servers.size() == 3 && prepared == 3);
+	TEST_ASSERT(servers.servers().size() == 3);
+	TEST_CHECK(servers.servers()[0].name == "A!");
+
+	// only the new and changed lines are parsed and prepared
+	std::ofstream(input, std::ios::binary) << "A,,1.1.1.1,1\nB,,2.2.2.2,1\nC,,3.3.3.3,1\nD,,4.4.4.4,0\n";
+	prepared = 0;
+	stats = servers.update({ { input, "csv" } }, prepare);
+	TEST_CHECK(stats.parsed == 2 && stats.reused == 2 && stats.invalid == 0);
+	TEST_CHECK(prepared == 2);
+	const std::vector<nbtserver> now = servers.servers();
+	TEST_ASSERT(now.size() == 4);
+	TEST_CHECK(now[1].name == "B!" && now[1].accept_textures);
+	TEST_CHECK(now[3].name == "D!");
+	TEST_CHECK(servers.servers_dat() == encode(now));
+	TEST_CHECK(servers.servers_dat({ 3, 0 }) == encode({ now[3], now[0] }));
+
+	// a file that can't be read keeps its last servers
+	fs::remove(input);
+	stats = servers.update({ { input, "csv" } }, prepare);
+	TEST_CHECK(stats.failed == 1 && stats.reused == 4);
+	TEST_CHECK(servers.servers_dat() == encode(now));
+	fs::remove_all(directory);
+}
+
+void test_watch_incremental_files(void) {
+	const fs::path directory = fresh_directory("enbt_test_watch_files");
+	std::ofstream(directory / "b.toml", std::ios::binary) << "[[servers]]\nicon = \"/9j/4AAQSkZJRgABAQIAJQAl\"\nip = \"5.5.5.5\"\nname = \"Toml\"\naccept_textures = true\n";
+	std::ofstream(directory / "a.csv", std::ios::binary) << "A,,1.1.1.1,1\n";
+	std::ofstream(directory / "notes.txt", std::ios::binary) << "not an input\n";
+
+	const std::vector<watched_input> inputs = list_inputs(directory, "");
+	TEST_ASSERT(inputs.size() == 2);
+	TEST_CHECK(inputs[0].path.filename() == "a.csv" && inputs[0].format == "csv");
+	TEST_CHECK(inputs[1].path.filename() == "b.toml" && inputs[1].format == "toml");
+
+	incremental_servers servers(std::endian::little);
+	const incremental_servers::stage prepare = [](std::vector<nbtserver>&) { return true; };
+	incremental_servers::update_stats stats = servers.update(inputs, prepare);
+	TEST_CHECK(stats.files == 2 && stats.parsed == 2);
+	TEST_ASSERT(servers.size() == 2);
+	TEST_CHECK(servers.servers()[1].name == "Toml");
+
+	// a toml file saved halfway keeps what it had
+	std::ofstream(directory / "b.toml", std::ios::binary) << "[[servers]\nip = ";
+	stats = servers.update(inputs, prepare);
+	TEST_CHECK(stats.failed == 1 && stats.parsed == 0);
+	TEST_ASSERT(servers.size() == 2);
+	TEST_CHECK(servers.servers()[1].name == "Toml");
+	fs::remove_all(directory);
+}
+
+void test_watch_prepares_again(void) {
+	const fs::path directory = fresh_directory("enbt_test_watch_again");
+	const fs::path input = directory / "servers.csv";
+	std::ofstream(input, std::ios::binary) << "A,@a.png,1.1.1.1,1\nB,,2.2.2.2,0\nA,@a.png,1.1.1.1,1\n";
+
+	// servers with an @ icon depend on more than their line
+	std::size_t prepared = 0;
+	std::string icon = "first";
+	const incremental_servers::stage prepare = [&](std::vector<nbtserver>& servers) {
+		bool reusable = true;
+		for (nbtserver& server : servers) {
+			++prepared;
+			if (server.icon.starts_with('@')) {
+				server.icon = icon;
+				reusable = false;
+			}
+		}
+		return reusable;
+	};
+	incremental_servers servers(std::endian::big);
+	incremental_servers::update_stats stats = servers.update({ { input, "csv" } }, prepare);
+	// the line listed twice is prepared once per round
+	TEST_CHECK(stats.parsed == 2 && stats.reused == 1 && prepared == 2);
+
+	prepared = 0;
+	icon = "second";
+	stats = servers.update({ { input, "csv" } }, prepare);
+	TEST_CHECK(stats.parsed == 1 && stats.reused == 2 && prepared == 1);
+	TEST_ASSERT(servers.size() == 3);
+	TEST_CHECK(servers.servers()[0].icon == "second" && servers.servers()[2].icon == "second");
+	TEST_CHECK(servers.servers_dat() == encode(servers.servers()));
+
+	// everything once cleared
+	prepared = 0;
+	servers.clear();
+	stats = servers.update({ { input, "csv" } }, prepare);
+	TEST_CHECK(stats.parsed == 2 && prepared == 2);
+	fs::remove_all(directory);
+}
+
+void test_watch_waits_for_changes(void) {
+	TEST_ASSERT(watch_supported());
+	const fs::path directory = fresh_directory("enbt_test_watch_wait");
+	const fs::path input = directory / "servers.csv";
+	std::ofstream(input, std::ios::binary) << "A,,1.1.1.1,1\n";
+
+	input_watcher watcher({ input });
+	TEST_ASSERT(watcher.is_open());
+	std::thread writer([&] {
+		// other files in the directory are no change
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		std::ofstream(directory / "other.csv", std::ios::binary) << "B,,2.2.2.2,1\n";
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		std::ofstream(input, std::ios::binary | std::ios::app) << "C,,3.3.3.3,1\n";
+	});
+	const auto started = std::chrono::steady_clock::now();
+	TEST_CHECK(watcher.wait(std::chrono::milliseconds(10)));
+	TEST_CHECK(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(40));
+	writer.join();
+
+	// an added file is watched too, and its directory going away is only a change
+	const fs::path icons = fresh_directory("enbt_test_watch_icons");
+	TEST_CHECK(watcher.add(icons / "a.png"));
+	TEST_CHECK(watcher.add(icons / "a.png"));
+	TEST_CHECK(!watcher.add(directory / "missing" / "b.png"));
+	std::ofstream(icons / "a.png", std::ios::binary) << "png";
+	TEST_CHECK(watcher.wait(std::chrono::milliseconds(10)));
+	fs::remove_all(icons);
+	TEST_CHECK(watcher.wait(std::chrono::milliseconds(10)));
+	TEST_CHECK(watcher.error().empty());
+
+	// the watched directory going away ends the watch
+	fs::remove_all(directory);
+	TEST_CHECK(!watcher.wait(std::chrono::milliseconds(10)));
+	TEST_CHECK(!watcher.error().empty());
+}
+
+TEST_LIST = {
+   { "Watch - incremental csv", test_watch_incremental_csv },
+   { "Watch - incremental files", test_watch_incremental_files },
+   { "Watch - prepares again", test_watch_prepares_again },
+   { "Watch - waits for changes", test_watch_waits_for_changes },
+   { NULL, NULL }
+};